@@ -21,12 +21,16 @@ import android.content.res.AssetManager;
 import android.opengl.GLSurfaceView;
 import android.os.Bundle;
 import android.util.Log;
+import android.view.Choreographer;
 import android.view.KeyEvent;
 import android.view.View;
 import android.view.WindowManager;
 import com.google.vr.ndk.base.AndroidCompat;
 import com.google.vr.ndk.base.GvrLayout;
+import javax.microedition.khronos.egl.EGL10;
 import javax.microedition.khronos.egl.EGLConfig;
+import javax.microedition.khronos.egl.EGLContext;
+import javax.microedition.khronos.egl.EGLDisplay;
 import javax.microedition.khronos.opengles.GL10;
 
 /**
@@ -37,6 +41,8 @@ import javax.microedition.khronos.opengles.GL10;
  */
 public class MainActivity extends Activity {
   private static final String TAG = "MainActivity";
+  // From EGL14, which works with EGLContext objects of a different type.
+  private static final int EGL_CONTEXT_CLIENT_VERSION = 0x3098;
   // Opaque native pointer to the DemoApp C++ object.
   // This object is owned by the MainActivity instance and passed to the native methods.
   private long nativeControllerPaint;
@@ -58,6 +64,7 @@ public class MainActivity extends Activity {
   private GvrLayout gvrLayout;
   private GLSurfaceView surfaceView;
   private AssetManager assetManager;
+  private long vsyncPeriodNanos;
 
   @Override
   protected void onCreate(Bundle savedInstanceState) {
@@ -97,6 +104,7 @@ public class MainActivity extends Activity {
     surfaceView = new GLSurfaceView(this);
     surfaceView.setEGLContextClientVersion(2);
     surfaceView.setEGLConfigChooser(8, 8, 8, 0, 0, 0);
+    surfaceView.setEGLContextFactory(contextFactory);
     surfaceView.setRenderer(renderer);
 
     // Note that we are not setting setPreserveEGLContextOnPause(true) here,
@@ -116,6 +124,9 @@ public class MainActivity extends Activity {
 
     // Prevent screen from dimming/locking.
     getWindow().addFlags(WindowManager.LayoutParams.FLAG_KEEP_SCREEN_ON);
+
+    float refreshRate = getWindowManager().getDefaultDisplay().getRefreshRate();
+    vsyncPeriodNanos = (long) (1e9 / refreshRate);
   }
 
   @Override
@@ -131,6 +142,7 @@ public class MainActivity extends Activity {
 
   @Override
   protected void onPause() {
+    Choreographer.getInstance().removeFrameCallback(vsyncCallback);
     surfaceView.onPause();
     gvrLayout.onPause();
     nativeOnPause(nativeControllerPaint);
@@ -144,6 +156,7 @@ public class MainActivity extends Activity {
     surfaceView.onResume();
     nativeOnResume(nativeControllerPaint);
     surfaceView.queueEvent(refreshViewerProfileRunnable);
+    Choreographer.getInstance().postFrameCallback(vsyncCallback);
   }
 
   @Override
@@ -176,6 +189,31 @@ public class MainActivity extends Activity {
                 | View.SYSTEM_UI_FLAG_IMMERSIVE_STICKY);
   }
 
+  // Creates an OpenGL ES 3 context if the device supports it, so that the native code can use
+  // uniform buffers, and an OpenGL ES 2 context otherwise.
+  private final GLSurfaceView.EGLContextFactory contextFactory =
+      new GLSurfaceView.EGLContextFactory() {
+        @Override
+        public EGLContext createContext(EGL10 egl, EGLDisplay display, EGLConfig config) {
+          int[] attribs = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL10.EGL_NONE};
+          EGLContext context =
+              egl.eglCreateContext(display, config, EGL10.EGL_NO_CONTEXT, attribs);
+          if (context == null || context == EGL10.EGL_NO_CONTEXT) {
+            Log.w(TAG, "OpenGL ES 3 is not available, falling back to OpenGL ES 2.");
+            attribs[1] = 2;
+            context = egl.eglCreateContext(display, config, EGL10.EGL_NO_CONTEXT, attribs);
+          }
+          return context;
+        }
+
+        @Override
+        public void destroyContext(EGL10 egl, EGLDisplay display, EGLContext context) {
+          if (!egl.eglDestroyContext(display, context)) {
+            Log.e(TAG, "eglDestroyContext failed: " + egl.eglGetError());
+          }
+        }
+      };
+
   private final GLSurfaceView.Renderer renderer =
       new GLSurfaceView.Renderer() {
         @Override
@@ -194,11 +232,23 @@ public class MainActivity extends Activity {
         }
       };
 
+  // Forwards the vsync timestamps of the display to the native frame scheduler.
+  private final Choreographer.FrameCallback vsyncCallback =
+      new Choreographer.FrameCallback() {
+        @Override
+        public void doFrame(long frameTimeNanos) {
+          nativeOnVsync(nativeControllerPaint, frameTimeNanos, vsyncPeriodNanos);
+          Choreographer.getInstance().postFrameCallback(this);
+        }
+      };
+
   private native long nativeOnCreate(AssetManager assetManager, long gvrContextPtr);
   private native void nativeOnResume(long controllerPaintJptr);
   private native void nativeOnPause(long controllerPaintJptr);
   private native void nativeOnSurfaceCreated(long controllerPaintJptr);
   private native void nativeOnSurfaceChanged(int width, int height, long controllerPaintJptr);
   private native void nativeOnDrawFrame(long controllerPaintJptr);
+  private native void nativeOnVsync(
+      long controllerPaintJptr, long frameTimeNanos, long vsyncPeriodNanos);
   private native void nativeOnDestroy(long controllerPaintJptr);
 }
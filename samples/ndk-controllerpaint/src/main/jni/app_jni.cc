@@ -60,6 +60,14 @@ NATIVE_METHOD(void, nativeOnDrawFrame)
   ptr(controller_paint_jptr)->OnDrawFrame();
 }
 
+NATIVE_METHOD(void, nativeOnVsync)
+(JNIEnv* env, jobject obj, jlong controller_paint_jptr, jlong frame_time_nanos,
+ jlong period_nanos) {
+  ptr(controller_paint_jptr)
+      ->OnVsync(static_cast<uint64_t>(frame_time_nanos),
+                static_cast<uint64_t>(period_nanos));
+}
+
 NATIVE_METHOD(void, nativeOnDestroy)
 (JNIEnv* env, jobject obj, jlong controller_paint_jptr) {
   delete ptr(controller_paint_jptr);
@@ -39,6 +39,9 @@ NATIVE_METHOD(void, nativeOnSurfaceChanged)
  jlong controller_paint_jptr);
 NATIVE_METHOD(void, nativeOnDrawFrame)
 (JNIEnv* env, jobject obj, jlong controller_paint_jptr);
+NATIVE_METHOD(void, nativeOnVsync)
+(JNIEnv* env, jobject obj, jlong controller_paint_jptr, jlong frame_time_nanos,
+ jlong period_nanos);
 NATIVE_METHOD(void, nativeOnDestroy)
 (JNIEnv* env, jobject obj, jlong controller_paint_jptr);
 }
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "asset_archive.h"  // NOLINT
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include "utils.h"  // NOLINT
+#else
+#include <stdio.h>
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif  // #ifdef __ANDROID__
+
+AssetArchive::AssetArchive()
+    : data_(nullptr),
+      size_(0),
+      map_base_(nullptr),
+      map_length_(0),
+#ifdef __ANDROID__
+      asset_(nullptr),
+#endif  // #ifdef __ANDROID__
+      entry_count_(0),
+      name_table_size_(0) {
+}
+
+AssetArchive::~AssetArchive() {
+  if (map_base_) munmap(map_base_, map_length_);
+#ifdef __ANDROID__
+  if (asset_) AAsset_close(asset_);
+#endif  // #ifdef __ANDROID__
+}
+
+#ifdef __ANDROID__
+std::unique_ptr<AssetArchive> AssetArchive::OpenFromAssets(
+    AAssetManager* asset_mgr, const char* asset_name) {
+  std::unique_ptr<AssetArchive> archive(new AssetArchive);
+  AAsset* asset = AAssetManager_open(asset_mgr, asset_name,
+                                     AASSET_MODE_RANDOM);
+  if (!asset) {
+    LOGE("Asset archive %s not found.", asset_name);
+    return nullptr;
+  }
+
+  // Uncompressed assets can be mapped straight from the APK.
+  off64_t start;
+  off64_t length;
+  const int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+  if (fd >= 0) {
+    const bool mapped =
+        archive->MapFileRange(fd, start, static_cast<size_t>(length));
+    close(fd);
+    if (mapped) {
+      AAsset_close(asset);
+      return archive;
+    }
+  }
+
+  // The asset is compressed in the APK: let the asset manager inflate it.
+  archive->data_ = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+  archive->size_ = static_cast<size_t>(AAsset_getLength64(asset));
+  archive->asset_ = asset;
+  if (!archive->data_ || !archive->Validate()) {
+    LOGE("Asset archive %s is invalid.", asset_name);
+    return nullptr;
+  }
+  return archive;
+}
+#endif  // #ifdef __ANDROID__
+
+std::unique_ptr<AssetArchive> AssetArchive::OpenFromFile(const char* path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    LOGE("Asset archive %s could not be opened.", path);
+    return nullptr;
+  }
+  struct stat file_stat;
+  std::unique_ptr<AssetArchive> archive(new AssetArchive);
+  const bool mapped =
+      fstat(fd, &file_stat) == 0 &&
+      archive->MapFileRange(fd, 0, static_cast<size_t>(file_stat.st_size));
+  close(fd);
+  if (!mapped) {
+    LOGE("Asset archive %s is invalid.", path);
+    return nullptr;
+  }
+  return archive;
+}
+
+bool AssetArchive::Find(const char* name, View* view) const {
+  const size_t name_length = strlen(name);
+  const uint64_t hash = HashAssetName(name, name_length);
+
+  // Entries are sorted by hash, so binary search for it.
+  uint32_t low = 0;
+  uint32_t high = entry_count_;
+  while (low < high) {
+    const uint32_t mid = low + (high - low) / 2;
+    if (GetEntry(mid).name_hash < hash) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low == entry_count_) return false;
+  const AssetArchiveEntry entry = GetEntry(low);
+  if (entry.name_hash != hash) return false;
+
+  const char* names = reinterpret_cast<const char*>(
+      data_ + sizeof(AssetArchiveHeader) +
+      entry_count_ * sizeof(AssetArchiveEntry));
+  if (entry.name_length != name_length ||
+      memcmp(names + entry.name_offset, name, name_length) != 0) {
+    return false;
+  }
+  view->data = data_ + entry.offset;
+  view->size = static_cast<size_t>(entry.size);
+  return true;
+}
+
+int AssetArchive::GetAssetCount() const {
+  return static_cast<int>(entry_count_);
+}
+
+bool AssetArchive::MapFileRange(int fd, int64_t offset, size_t length) {
+  // mmap() needs a page-aligned offset, so map from the enclosing page.
+  const int64_t page_size = sysconf(_SC_PAGESIZE);
+  const int64_t map_offset = offset - offset % page_size;
+  const size_t map_length = length + static_cast<size_t>(offset - map_offset);
+  void* base =
+      mmap(nullptr, map_length, PROT_READ, MAP_PRIVATE, fd, map_offset);
+  if (base == MAP_FAILED) return false;
+  map_base_ = base;
+  map_length_ = map_length;
+  data_ = static_cast<const uint8_t*>(base) + (offset - map_offset);
+  size_ = length;
+  return Validate();
+}
+
+bool AssetArchive::Validate() {
+  if (size_ < sizeof(AssetArchiveHeader)) return false;
+  AssetArchiveHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, kAssetArchiveMagic, sizeof(header.magic)) != 0 ||
+      header.version != kAssetArchiveVersion) {
+    return false;
+  }
+  const uint64_t index_end =
+      sizeof(AssetArchiveHeader) +
+      static_cast<uint64_t>(header.entry_count) * sizeof(AssetArchiveEntry) +
+      header.name_table_size;
+  if (index_end > size_) return false;
+
+  entry_count_ = header.entry_count;
+  name_table_size_ = header.name_table_size;
+  for (uint32_t i = 0; i < entry_count_; ++i) {
+    const AssetArchiveEntry entry = GetEntry(i);
+    if (entry.compression != kAssetCompressionNone ||
+        entry.offset > size_ || entry.size > size_ - entry.offset ||
+        static_cast<uint64_t>(entry.name_offset) + entry.name_length >
+            name_table_size_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+AssetArchiveEntry AssetArchive::GetEntry(uint32_t index) const {
+  AssetArchiveEntry entry;
+  memcpy(&entry,
+         data_ + sizeof(AssetArchiveHeader) + index * sizeof(AssetArchiveEntry),
+         sizeof(entry));
+  return entry;
+}
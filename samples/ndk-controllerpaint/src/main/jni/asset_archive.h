@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_ASSET_ARCHIVE_H_  // NOLINT
+#define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_ASSET_ARCHIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "asset_archive_format.h"  // NOLINT
+
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif  // #ifdef __ANDROID__
+
+// Read-only view of an asset archive produced by tools/asset_packer.
+//
+// The archive is mapped into memory once when it is opened, and lookups
+// return views that point directly into the mapping, so no per-asset open or
+// copy takes place. Views remain valid for the lifetime of the archive.
+class AssetArchive {
+ public:
+  // A contiguous, read-only range of bytes inside the archive.
+  struct View {
+    const uint8_t* data;
+    size_t size;
+  };
+
+#ifdef __ANDROID__
+  // Opens the archive stored as the APK asset |asset_name|. If the asset is
+  // stored uncompressed in the APK, it is mapped through its file descriptor;
+  // otherwise the asset manager's buffer is used. Returns null on failure.
+  static std::unique_ptr<AssetArchive> OpenFromAssets(
+      AAssetManager* asset_mgr, const char* asset_name);
+#endif  // #ifdef __ANDROID__
+
+  // Opens the archive stored in the file at |path|. Returns null on failure.
+  static std::unique_ptr<AssetArchive> OpenFromFile(const char* path);
+
+  ~AssetArchive();
+
+  // Looks up the asset called |name|. Returns false if there is no such
+  // asset.
+  bool Find(const char* name, View* view) const;
+
+  // Returns the number of assets in the archive.
+  int GetAssetCount() const;
+
+ private:
+  AssetArchive();
+
+  // Maps |length| bytes of |fd| starting at |offset| and validates them.
+  bool MapFileRange(int fd, int64_t offset, size_t length);
+
+  // Validates the archive stored at |data_|.
+  bool Validate();
+
+  // Returns a copy of index entry |index|. The index is only guaranteed to be
+  // 4-byte aligned inside an APK, so entries are not accessed in place.
+  AssetArchiveEntry GetEntry(uint32_t index) const;
+
+  // The archive contents.
+  const uint8_t* data_;
+  size_t size_;
+
+  // The memory mapping that contains the archive, if any.
+  void* map_base_;
+  size_t map_length_;
+
+#ifdef __ANDROID__
+  // The asset that owns |data_| when it could not be mapped.
+  AAsset* asset_;
+#endif  // #ifdef __ANDROID__
+
+  uint32_t entry_count_;
+  uint32_t name_table_size_;
+
+  // Disallow copy and assign.
+  AssetArchive(const AssetArchive& other) = delete;
+  AssetArchive& operator=(const AssetArchive& other) = delete;
+};
+
+#endif  // CONTROLLER_PAINT_APP_SRC_MAIN_JNI_ASSET_ARCHIVE_H_  // NOLINT
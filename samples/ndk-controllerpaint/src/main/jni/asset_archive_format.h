@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_ASSET_ARCHIVE_FORMAT_H_  // NOLINT
+#define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_ASSET_ARCHIVE_FORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On-disk layout of an asset archive, shared by the runtime reader
+// (asset_archive.h) and the host-side packer (tools/asset_packer.cc).
+//
+// All values are little-endian. An archive is laid out as:
+//
+//   AssetArchiveHeader
+//   AssetArchiveEntry[entry_count], sorted by name_hash
+//   name table (entry names, not NUL-terminated)
+//   entry data, each entry starting at a multiple of its alignment
+//
+// Offsets are relative to the start of the archive. Names are hashed with
+// HashAssetName(); the packer rejects archives with colliding hashes.
+
+static const char kAssetArchiveMagic[4] = {'G', 'P', 'A', 'K'};
+static const uint32_t kAssetArchiveVersion = 1;
+
+enum AssetCompression {
+  // Data is stored as is and can be used in place.
+  kAssetCompressionNone = 0,
+};
+
+struct AssetArchiveHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t name_table_size;
+};
+
+struct AssetArchiveEntry {
+  uint64_t name_hash;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t name_offset;
+  uint32_t name_length;
+  uint32_t alignment;
+  uint32_t compression;
+};
+
+static_assert(sizeof(AssetArchiveHeader) == 16, "Unexpected header size.");
+static_assert(sizeof(AssetArchiveEntry) == 40, "Unexpected entry size.");
+
+// 64-bit FNV-1a hash of an asset name.
+inline uint64_t HashAssetName(const char* name, size_t length) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<uint8_t>(name[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+#endif  // CONTROLLER_PAINT_APP_SRC_MAIN_JNI_ASSET_ARCHIVE_FORMAT_H_  // NOLINT
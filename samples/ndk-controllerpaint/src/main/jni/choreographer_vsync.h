@@ -0,0 +1,60 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_CHOREOGRAPHERVSYNC_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_CHOREOGRAPHERVSYNC_H_  // NOLINT
+
+#include <atomic>
+#include <cstdint>
+
+#include "frame_scheduler.h"  // NOLINT
+
+/**
+ * VsyncProvider fed with the frame times of a Java Choreographer.FrameCallback,
+ * which are the vsync timestamps of the display, in System.nanoTime() units
+ * (CLOCK_MONOTONIC).
+ *
+ * OnVsync() is called on the UI thread, and GetVsync() on the rendering
+ * thread.
+ */
+class ChoreographerVsync : public VsyncProvider {
+ public:
+  ChoreographerVsync();
+
+  /**
+   * Record a vsync at |frame_time_nanos|. |period_nanos| is the refresh
+   * period of the display.
+   */
+  void OnVsync(uint64_t frame_time_nanos, uint64_t period_nanos);
+
+  /**
+   * Forget the timing, e.g. while the activity is paused and callbacks stop.
+   */
+  void Reset();
+
+  bool GetVsync(uint64_t* vsync_nanos, uint64_t* period_nanos) const override;
+
+ private:
+  std::atomic<uint64_t> vsync_nanos_;
+  std::atomic<uint64_t> period_nanos_;
+
+  // Disallow copy and assign.
+  ChoreographerVsync(const ChoreographerVsync& other) = delete;
+  ChoreographerVsync& operator=(const ChoreographerVsync& other) = delete;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_CHOREOGRAPHERVSYNC_H_  // NOLINT
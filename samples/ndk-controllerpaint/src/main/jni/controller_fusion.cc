@@ -0,0 +1,238 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "controller_fusion.h"  // NOLINT
+
+#include <math.h>
+
+namespace {
+
+const float kGravity = 9.80665f;
+
+// Accelerometer readings further than this from 1 g are not used for the
+// tilt correction, since the controller is being accelerated.
+const float kGravityTolerance = 0.1f * kGravity;
+
+// The quaternion product below is written as four 4-wide multiply-adds over
+// (x, y, z, w), so that the compiler can turn it into SIMD instructions:
+//
+//   a * b = a.w * b + a.x * (b permuted by kMulIndex[0], times kMulSign[0])
+//         + a.y * (... kMulIndex[1] ...) + a.z * (... kMulIndex[2] ...)
+const int kMulIndex[3][4] = {{3, 2, 1, 0}, {2, 3, 0, 1}, {1, 0, 3, 2}};
+const float kMulSign[3][4] = {
+    {1.0f, -1.0f, 1.0f, -1.0f},
+    {1.0f, 1.0f, -1.0f, -1.0f},
+    {-1.0f, 1.0f, 1.0f, -1.0f},
+};
+
+// Sets |result| to the Hamilton product |a| * |b|.
+void QuatMul(const float a[4], const float b[4], float result[4]) {
+  float terms[3][4];
+  for (int k = 0; k < 3; ++k) {
+    for (int i = 0; i < 4; ++i) {
+      terms[k][i] = kMulSign[k][i] * b[kMulIndex[k][i]];
+    }
+  }
+  for (int i = 0; i < 4; ++i) {
+    result[i] = a[3] * b[i] + a[0] * terms[0][i] + a[1] * terms[1][i] +
+                a[2] * terms[2][i];
+  }
+}
+
+void QuatNormalize(float q[4]) {
+  float norm_squared = 0.0f;
+  for (int i = 0; i < 4; ++i) norm_squared += q[i] * q[i];
+  const float inverse_norm = 1.0f / sqrtf(norm_squared);
+  for (int i = 0; i < 4; ++i) q[i] *= inverse_norm;
+}
+
+// Rotates |q| by the angular velocity |omega|, in the space that |q| rotates
+// from, over |seconds|.
+void QuatIntegrate(const float omega[3], float seconds, float q[4]) {
+  float half_angle[3];
+  float half_angle_squared = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    half_angle[i] = 0.5f * omega[i] * seconds;
+    half_angle_squared += half_angle[i] * half_angle[i];
+  }
+  float delta[4];
+  if (half_angle_squared < 1e-8f) {
+    // First order approximation; QuatNormalize below makes it unit length.
+    for (int i = 0; i < 3; ++i) delta[i] = half_angle[i];
+    delta[3] = 1.0f;
+  } else {
+    const float half_angle_norm = sqrtf(half_angle_squared);
+    const float scale = sinf(half_angle_norm) / half_angle_norm;
+    for (int i = 0; i < 3; ++i) delta[i] = half_angle[i] * scale;
+    delta[3] = cosf(half_angle_norm);
+  }
+  float result[4];
+  QuatMul(q, delta, result);
+  for (int i = 0; i < 4; ++i) q[i] = result[i];
+  QuatNormalize(q);
+}
+
+// Moves |q| by |fraction| of the way to |target|, along the shorter arc.
+void QuatBlend(const float target[4], float fraction, float q[4]) {
+  float cos_angle = 0.0f;
+  for (int i = 0; i < 4; ++i) cos_angle += q[i] * target[i];
+  const float sign = cos_angle < 0.0f ? -1.0f : 1.0f;
+  cos_angle *= sign;
+  float weight_q = 1.0f - fraction;
+  float weight_target = fraction;
+  if (cos_angle < 0.9995f) {
+    const float angle = acosf(cos_angle);
+    const float sin_angle = sinf(angle);
+    weight_q = sinf((1.0f - fraction) * angle) / sin_angle;
+    weight_target = sinf(fraction * angle) / sin_angle;
+  }
+  for (int i = 0; i < 4; ++i) {
+    q[i] = weight_q * q[i] + sign * weight_target * target[i];
+  }
+  QuatNormalize(q);
+}
+
+// Returns the "up" direction of start space in the controller space of |q|,
+// i.e. the direction in which the accelerometer should measure gravity.
+void UpInControllerSpace(const float q[4], float up[3]) {
+  // Second row of the rotation matrix of |q|, which is the second column of
+  // its inverse.
+  const float x = q[0], y = q[1], z = q[2], w = q[3];
+  up[0] = 2.0f * (x * y + z * w);
+  up[1] = 1.0f - 2.0f * (x * x + z * z);
+  up[2] = 2.0f * (y * z - x * w);
+}
+
+gvr::ControllerQuat ToControllerQuat(const float q[4]) {
+  gvr::ControllerQuat result;
+  result.qx = q[0];
+  result.qy = q[1];
+  result.qz = q[2];
+  result.qw = q[3];
+  return result;
+}
+
+}  // namespace
+
+ControllerFusion::Params ControllerFusion::DefaultParams() {
+  Params params;
+  params.orientation_gain = 0.02f;
+  params.accel_gain = 0.5f;
+  params.max_gyro_interval_nanos = 100000000;  // 100ms
+  params.max_prediction_nanos = 50000000;      // 50ms
+  return params;
+}
+
+ControllerFusion::ControllerFusion() : ControllerFusion(DefaultParams()) {}
+
+ControllerFusion::ControllerFusion(const Params& params) : params_(params) {
+  Reset();
+}
+
+void ControllerFusion::Reset() {
+  initialized_ = false;
+  for (int i = 0; i < 3; ++i) {
+    orientation_[i] = 0.0f;
+    angular_velocity_[i] = 0.0f;
+    gravity_[i] = 0.0f;
+  }
+  orientation_[3] = 1.0f;
+  orientation_timestamp_ = 0;
+  gyro_timestamp_ = 0;
+  accel_timestamp_ = 0;
+  have_gravity_ = false;
+}
+
+void ControllerFusion::AddSample(const ControllerSensorSample& sample) {
+  const float fused[4] = {sample.orientation.qx, sample.orientation.qy,
+                          sample.orientation.qz, sample.orientation.qw};
+  if (!initialized_) {
+    if (sample.orientation_timestamp <= 0) return;
+    for (int i = 0; i < 4; ++i) orientation_[i] = fused[i];
+    QuatNormalize(orientation_);
+    orientation_timestamp_ = sample.orientation_timestamp;
+    gyro_timestamp_ = sample.gyro_timestamp;
+    accel_timestamp_ = sample.accel_timestamp;
+    initialized_ = true;
+    return;
+  }
+
+  if (sample.accel_timestamp > accel_timestamp_) {
+    accel_timestamp_ = sample.accel_timestamp;
+    const float accel[3] = {sample.accel.x, sample.accel.y, sample.accel.z};
+    const float norm =
+        sqrtf(accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2]);
+    have_gravity_ = fabsf(norm - kGravity) < kGravityTolerance;
+    if (have_gravity_) {
+      for (int i = 0; i < 3; ++i) gravity_[i] = accel[i] / norm;
+    }
+  }
+
+  if (sample.gyro_timestamp > gyro_timestamp_) {
+    const int64_t interval_nanos = sample.gyro_timestamp - gyro_timestamp_;
+    gyro_timestamp_ = sample.gyro_timestamp;
+    angular_velocity_[0] = sample.gyro.x;
+    angular_velocity_[1] = sample.gyro.y;
+    angular_velocity_[2] = sample.gyro.z;
+    if (interval_nanos <= params_.max_gyro_interval_nanos) {
+      float omega[3] = {angular_velocity_[0], angular_velocity_[1],
+                        angular_velocity_[2]};
+      if (have_gravity_) {
+        // The cross product of the measured and the estimated direction of
+        // gravity is the axis of the rotation that brings the estimate to
+        // the measurement.
+        float up[3];
+        UpInControllerSpace(orientation_, up);
+        omega[0] += params_.accel_gain * (gravity_[1] * up[2] -
+                                          gravity_[2] * up[1]);
+        omega[1] += params_.accel_gain * (gravity_[2] * up[0] -
+                                          gravity_[0] * up[2]);
+        omega[2] += params_.accel_gain * (gravity_[0] * up[1] -
+                                          gravity_[1] * up[0]);
+      }
+      QuatIntegrate(omega, interval_nanos * 1e-9f, orientation_);
+    }
+  }
+
+  if (sample.orientation_timestamp > orientation_timestamp_) {
+    orientation_timestamp_ = sample.orientation_timestamp;
+    QuatBlend(fused, params_.orientation_gain, orientation_);
+  }
+}
+
+void ControllerFusion::AddSamples(const ControllerSensorSample* samples,
+                                  size_t count) {
+  for (size_t i = 0; i < count; ++i) AddSample(samples[i]);
+}
+
+bool ControllerFusion::IsInitialized() const { return initialized_; }
+
+gvr::ControllerQuat ControllerFusion::GetOrientation() const {
+  return ToControllerQuat(orientation_);
+}
+
+gvr::ControllerQuat ControllerFusion::GetPredictedOrientation(
+    int64_t time_nanos) const {
+  int64_t ahead_nanos = time_nanos - gyro_timestamp_;
+  if (ahead_nanos < 0) ahead_nanos = 0;
+  if (ahead_nanos > params_.max_prediction_nanos) {
+    ahead_nanos = params_.max_prediction_nanos;
+  }
+  float predicted[4] = {orientation_[0], orientation_[1], orientation_[2],
+                        orientation_[3]};
+  QuatIntegrate(angular_velocity_, ahead_nanos * 1e-9f, predicted);
+  return ToControllerQuat(predicted);
+}
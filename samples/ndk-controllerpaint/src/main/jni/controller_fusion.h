@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_CONTROLLER_FUSION_H_  // NOLINT
+#define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_CONTROLLER_FUSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+// One reading of the controller sensors, as reported by gvr::ControllerState.
+// Each sensor has its own timestamp, in nanoseconds. The gyro (rad/s) and
+// accelerometer (m/s^2) readings are in controller space; the orientation
+// rotates controller space to start space.
+struct ControllerSensorSample {
+  int64_t orientation_timestamp;
+  gvr::ControllerQuat orientation;
+  int64_t gyro_timestamp;
+  gvr::ControllerVec3 gyro;
+  int64_t accel_timestamp;
+  gvr::ControllerVec3 accel;
+};
+
+// Fuses the raw gyro and accelerometer readings of the controller with its
+// fused orientation, in the manner of a Mahony filter:
+//
+//  * Each new gyro reading is integrated over the time since the previous
+//    one, so the estimate follows fast motion.
+//  * While the controller is not accelerating, the accelerometer measures
+//    gravity, and the tilt error it reveals is fed back into the angular
+//    velocity.
+//  * Each new fused orientation pulls the estimate towards it by a fixed
+//    fraction, which removes gyro drift, including about the vertical axis.
+//
+// The latest angular velocity also predicts the orientation ahead, to the
+// time the frame is displayed.
+//
+// The filter only depends on the readings and their timestamps, never on
+// when it is called, so replaying a sensor log gives the same result however
+// it is batched. Readings whose timestamps did not advance are ignored, so
+// the same state may be added every frame.
+class ControllerFusion {
+ public:
+  struct Params {
+    // Fraction of the way to each new fused orientation that the estimate
+    // moves.
+    float orientation_gain;
+    // Proportional gain of the accelerometer tilt correction, in rad/s per
+    // unit of error.
+    float accel_gain;
+    // Gyro intervals longer than this, e.g. after the controller reconnects,
+    // are not integrated.
+    int64_t max_gyro_interval_nanos;
+    // Furthest ahead of the latest gyro reading that is predicted.
+    int64_t max_prediction_nanos;
+  };
+
+  // Returns the parameters used by the default constructor.
+  static Params DefaultParams();
+
+  ControllerFusion();
+  explicit ControllerFusion(const Params& params);
+
+  // Forgets the estimate, e.g. when the controller disconnects.
+  void Reset();
+
+  // Adds one reading.
+  void AddSample(const ControllerSensorSample& sample);
+
+  // Adds |count| readings, in time order.
+  void AddSamples(const ControllerSensorSample* samples, size_t count);
+
+  // Returns true once a fused orientation has been received.
+  bool IsInitialized() const;
+
+  // Returns the estimated orientation at the latest gyro reading.
+  gvr::ControllerQuat GetOrientation() const;
+
+  // Returns the orientation predicted for |time_nanos|, in the timebase of
+  // the readings, at the latest angular velocity.
+  gvr::ControllerQuat GetPredictedOrientation(int64_t time_nanos) const;
+
+ private:
+  const Params params_;
+  bool initialized_;
+  // Orientation estimate, as x, y, z, w.
+  float orientation_[4];
+  // Latest angular velocity, in controller space, without the tilt
+  // correction.
+  float angular_velocity_[3];
+  int64_t orientation_timestamp_;
+  int64_t gyro_timestamp_;
+  int64_t accel_timestamp_;
+  // Latest accelerometer reading, if it measured gravity alone.
+  bool have_gravity_;
+  float gravity_[3];
+};
+
+#endif  // CONTROLLER_PAINT_APP_SRC_MAIN_JNI_CONTROLLER_FUSION_H_  // NOLINT
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cubemap_impostor.h"  // NOLINT
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "utils.h"  // NOLINT
+
+namespace {
+
+// Direction each face looks at, and its up vector, following the cube map
+// conventions of the GL specification: for +X, the face's s axis points to
+// -Z and its t axis to -Y.
+static const float kFaceForward[CubemapImpostor::kFaceCount][3] = {
+    {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f},
+    {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f},
+};
+static const float kFaceUp[CubemapImpostor::kFaceCount][3] = {
+    {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+    {0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+};
+
+// Faces are cleared to transparent black. Their depth is only used while
+// they are rendered.
+static const RenderPassDesc kFacePass = {
+    kLoadActionClear, kStoreActionStore, kLoadActionClear,
+    kStoreActionDiscard, {0.0f, 0.0f, 0.0f, 0.0f}, 1.0f};
+
+}  // namespace
+
+CubemapImpostor::CubemapImpostor()
+    : face_size_(0),
+      framebuffer_(0),
+      texture_(0),
+      depth_renderbuffer_(0),
+      face_pass_(kFacePass) {}
+
+void CubemapImpostor::Init(int face_size, GpuMemoryTracker* gpu_memory) {
+  face_size_ = face_size;
+  texture_ = gpu_memory->CreateTextureCubeMap(GL_RGBA, GL_UNSIGNED_BYTE,
+                                              face_size);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+  glGenRenderbuffers(1, &depth_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, face_size,
+                        face_size);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_);
+  for (int face = 0; face < kFaceCount; ++face) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, texture_,
+                           0);
+    CHECK(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+          GL_FRAMEBUFFER_COMPLETE);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  CHECK(glGetError() == GL_NO_ERROR);
+}
+
+GLuint CubemapImpostor::GetTexture() const { return texture_; }
+
+void CubemapImpostor::BeginFace(int face) {
+  // Each face has a pass of its own, so that the depth of the previous face
+  // is discarded before the color attachment changes.
+  if (face_pass_.IsActive()) face_pass_.End();
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                         GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, texture_, 0);
+  face_pass_.Begin(framebuffer_, {face_size_, face_size_});
+}
+
+void CubemapImpostor::End() {
+  if (face_pass_.IsActive()) face_pass_.End();
+}
+
+gvr::Mat4f CubemapImpostor::FaceViewMatrix(int face) {
+  const float* forward = kFaceForward[face];
+  const float* up = kFaceUp[face];
+  // Rows are the face's right, up and backward axes. The up vectors above
+  // are already orthogonal to the forward ones.
+  const float right[3] = {
+      forward[1] * up[2] - forward[2] * up[1],
+      forward[2] * up[0] - forward[0] * up[2],
+      forward[0] * up[1] - forward[1] * up[0],
+  };
+  gvr::Mat4f view;
+  for (int i = 0; i < 3; ++i) {
+    view.m[0][i] = right[i];
+    view.m[1][i] = up[i];
+    view.m[2][i] = -forward[i];
+    view.m[3][i] = 0.0f;
+    view.m[i][3] = 0.0f;
+  }
+  view.m[3][3] = 1.0f;
+  return view;
+}
+
+gvr::Mat4f CubemapImpostor::FaceProjectionMatrix(float near_clip,
+                                                 float far_clip) {
+  const gvr::Rectf fov = {45.0f, 45.0f, 45.0f, 45.0f};
+  return Utils::PerspectiveMatrixFromView(fov, near_clip, far_clip);
+}
+
+int CubemapImpostor::FacesTouchedBy(const std::array<float, 3>& min_coords,
+                                    const std::array<float, 3>& max_coords) {
+  int mask = 0;
+  for (int face = 0; face < kFaceCount; ++face) {
+    // Face |face| sees the points whose coordinate along its axis is at
+    // least the absolute value of each of the other two coordinates.
+    const int axis = face / 2;
+    const float max_along =
+        face % 2 == 0 ? max_coords[axis] : -min_coords[axis];
+    if (max_along < 0.0f) continue;
+    bool touched = true;
+    for (int other = 0; other < 3; ++other) {
+      if (other == axis) continue;
+      const float min_abs =
+          min_coords[other] <= 0.0f && max_coords[other] >= 0.0f
+              ? 0.0f
+              : std::min(fabsf(min_coords[other]), fabsf(max_coords[other]));
+      if (max_along < min_abs) touched = false;
+    }
+    if (touched) mask |= 1 << face;
+  }
+  return mask;
+}
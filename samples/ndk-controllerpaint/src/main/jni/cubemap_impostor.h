@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_CUBEMAP_IMPOSTOR_H_  // NOLINT
+#define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_CUBEMAP_IMPOSTOR_H_
+
+#include <GLES2/gl2.h>
+
+#include <array>
+
+#include "render_pass.h"  // NOLINT
+#include "vr/gvr/capi/include/gvr_types.h"
+
+class GpuMemoryTracker;
+
+// A cube map that caches what is seen from the origin, so that far away
+// geometry can be drawn as a single textured cube around the eye instead of
+// being rendered again every frame. This is only correct when the eye stays
+// near the origin, as with 3DoF head tracking; the error grows with the ratio
+// of the eye's distance from the origin to the distance of the geometry.
+//
+// Faces are numbered like the GL cube map targets, starting at
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X: +X, -X, +Y, -Y, +Z and -Z. Face contents
+// are expected to be premultiplied by alpha, over a transparent background.
+//
+// Usage, on the rendering thread:
+//
+//   impostor.Init(face_size, &gpu_memory);   // After the GL context exists.
+//   ...
+//   impostor.BeginFace(face);
+//   <draw with FaceViewMatrix(face) and FaceProjectionMatrix()>
+//   ...                                      // More faces.
+//   impostor.End();
+//   <draw a cube around the eye that samples GetTexture()>
+class CubemapImpostor {
+ public:
+  static const int kFaceCount = 6;
+
+  // Bit mask with one bit per face.
+  static const int kAllFaces = (1 << kFaceCount) - 1;
+
+  CubemapImpostor();
+
+  // Creates the cube map, with |face_size| x |face_size| faces, and a depth
+  // buffer to render its faces with.
+  void Init(int face_size, GpuMemoryTracker* gpu_memory);
+
+  // Returns the cube map texture.
+  GLuint GetTexture() const;
+
+  // Binds the framebuffer to render |face|, and clears it to transparent
+  // black and to the far depth. The depth of the previous face, if any, is
+  // discarded.
+  void BeginFace(int face);
+
+  // Discards the depth of the last face and unbinds the framebuffer. The
+  // caller must restore its own viewport.
+  void End();
+
+  // Returns the view matrix that looks from the origin through |face|.
+  static gvr::Mat4f FaceViewMatrix(int face);
+
+  // Returns the projection matrix of every face: a 90 degree square frustum.
+  static gvr::Mat4f FaceProjectionMatrix(float near_clip, float far_clip);
+
+  // Returns the mask of the faces that may see some part of the axis-aligned
+  // box from |min_coords| to |max_coords|. The test is conservative.
+  static int FacesTouchedBy(const std::array<float, 3>& min_coords,
+                            const std::array<float, 3>& max_coords);
+
+ private:
+  int face_size_;
+  GLuint framebuffer_;
+  GLuint texture_;
+  GLuint depth_renderbuffer_;
+  RenderPass face_pass_;
+
+  // Disallow copy and assign.
+  CubemapImpostor(const CubemapImpostor& other) = delete;
+  CubemapImpostor& operator=(const CubemapImpostor& other) = delete;
+};
+
+#endif  // CONTROLLER_PAINT_APP_SRC_MAIN_JNI_CUBEMAP_IMPOSTOR_H_  // NOLINT
@@ -16,11 +16,19 @@
 
 #include "demoapp.h"  // NOLINT
 
+#ifdef __ANDROID__
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 #include <jni.h>
+#endif  // #ifdef __ANDROID__
+#include <string.h>
+
+#include <algorithm>
 #include <string>
+#include <utility>
 
+#include "render_pass.h"  // NOLINT
+#include "trace_log.h"  // NOLINT
 #include "utils.h"  // NOLINT
 
 namespace {
@@ -29,6 +37,56 @@ namespace {
 // paint by simply touching the touchpad.
 static const bool kRequireClickToPaint = true;
 
+// If true, every kOverdrawPassInterval frames the left eye is drawn again
+// with an additive counting shader, and the per-pixel overdraw is logged.
+// This is a debugging aid: the pass reads back its target and stalls the GPU.
+static const bool kAnalyzeOverdraw = false;
+static const int kOverdrawPassInterval = 60;
+
+// If true, committed strokes are cached in a cube map around the origin,
+// which is drawn instead of them. Strokes are far away compared to the eye
+// offsets and the head only rotates, so the cached view is off by a small
+// fraction of a pixel (see tools/impostor_error.cc), and the cost of a frame
+// does not grow with the size of the drawing.
+static const bool kCacheCommittedStrokes = true;
+
+// Size of each face of the stroke cache, in pixels.
+static const int kImpostorFaceSize = 1024;
+
+// Size of the overdraw analysis target.
+static const gvr::Sizei kOverdrawTargetSize = {512, 512};
+
+// If true and the context supports OpenGL ES 3, per-draw constants are
+// written into a ring of uniform buffers once per FlushDraws() call, instead
+// of being set with several glUniform*() calls per draw.
+static const bool kUseUniformBuffers = true;
+
+// Uniform buffer binding point of the DrawConstants block.
+static const GLuint kDrawConstantsBinding = 0;
+
+// If true, the raw gyro and accelerometer readings of the controller are
+// fused with its orientation (see ControllerFusion), and the cursor and the
+// paint anchor use the fused orientation predicted to the display time.
+static const bool kFuseControllerSensors = true;
+
+// If true, each frame's controller readings are logged in the format read by
+// tools/controller_fusion_eval.cc. Extract the log with:
+//   adb logcat -s ControllerDemoCPP | sed -n 's/.*sensors: //p'
+static const bool kLogControllerSensors = false;
+
+// Initial size of the per-frame segment of the uniform ring buffer. It grows
+// if a frame needs more.
+static const GLsizeiptr kDrawConstantsFrameCapacity = 32 * 1024;
+
+// Per-draw constants, laid out like the DrawConstants uniform block of the
+// OpenGL ES 3 shaders under std140 rules.
+struct DrawConstants {
+  std::array<float, 16> mvp;  // Column-major, as from MatrixToGLArray().
+  std::array<float, 4> color;
+};
+static_assert(sizeof(DrawConstants) == 80,
+              "DrawConstants must match the std140 block layout.");
+
 // Near and far clipping planes.
 static const float kNearClip = 0.1f;
 static const float kFarClip = 1000.0f;
@@ -39,8 +97,9 @@ static const float kDefaultPaintDistance = 200.0f;
 // File name for the paint texture. This is stored in the app's assets.
 // The paint texture is stored in raw RGB format, with each three bytes
 // encoding a pixel (the first byte is R, the second is G, the third is B).
-static const char kPaintTexturePath[] = "paint_texture64x64.bin";
-static const char kGroundTexturePath[] = "ground_texture64x64.bin";
+static const char kTextureArchivePath[] = "textures.pak";
+static const char kPaintTextureName[] = "paint_texture64x64.bin";
+static const char kGroundTextureName[] = "ground_texture64x64.bin";
 
 // Width and height of the paint texture, in pixels.
 static const int kPaintTextureWidth = 64;
@@ -55,6 +114,13 @@ static const std::array<float, 4> kGroundColor =
 static const std::array<float, 4> kCursorBorderColor =
     { 1.0f, 1.0f, 1.0f, 1.0f };
 
+// The eye buffer is cleared to the sky color. Depth is only needed while the
+// eyes are drawn, so it is neither loaded nor stored (or resolved).
+static const RenderPassDesc kEyeBufferPass = {
+    kLoadActionClear, kStoreActionStore, kLoadActionClear,
+    kStoreActionDiscard, {kSkyColor[0], kSkyColor[1], kSkyColor[2], 1.0f},
+    1.0f};
+
 // Vertex shader.
 static const char* kPaintShaderVp =
     "uniform mat4 u_MVP;\n"
@@ -77,6 +143,109 @@ static const char* kPaintShaderFp =
     "      fract(v_TexCoords.s), fract(v_TexCoords.t)));\n"
     "}\n";
 
+// Fragment shader for alpha-tested draws: like kPaintShaderFp, but discards
+// fragments whose texture alpha is below one half.
+static const char* kPaintShaderAlphaTestFp =
+    "precision mediump float;\n"
+    "uniform vec4 u_Color;\n"
+    "varying vec2 v_TexCoords;\n"
+    "uniform sampler2D u_Sampler;\n"
+    "void main() {\n"
+    "  vec4 texel = texture2D(u_Sampler, vec2(\n"
+    "      fract(v_TexCoords.s), fract(v_TexCoords.t)));\n"
+    "  if (texel.a < 0.5) discard;\n"
+    "  gl_FragColor = u_Color * texel;\n"
+    "}\n";
+
+// OpenGL ES 3 versions of the shaders above, which read the per-draw
+// constants from a uniform block. Members shared between stages must have
+// the same precision, hence the explicit highp.
+static const char* kPaintShaderVpEs3 =
+    "#version 300 es\n"
+    "layout(std140) uniform DrawConstants {\n"
+    "  highp mat4 u_MVP;\n"
+    "  highp vec4 u_Color;\n"
+    "};\n"
+    "in vec4 a_Position;\n"
+    "in vec2 a_TexCoords;\n"
+    "out vec2 v_TexCoords;\n"
+    "void main() {\n"
+    "  gl_Position = u_MVP * a_Position;\n"
+    "  v_TexCoords = a_TexCoords;\n"
+    "}\n";
+
+static const char* kPaintShaderFpEs3 =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "layout(std140) uniform DrawConstants {\n"
+    "  highp mat4 u_MVP;\n"
+    "  highp vec4 u_Color;\n"
+    "};\n"
+    "in vec2 v_TexCoords;\n"
+    "uniform sampler2D u_Sampler;\n"
+    "out vec4 o_FragColor;\n"
+    "void main() {\n"
+    "  o_FragColor = u_Color * texture(u_Sampler, fract(v_TexCoords));\n"
+    "}\n";
+
+static const char* kPaintShaderAlphaTestFpEs3 =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "layout(std140) uniform DrawConstants {\n"
+    "  highp mat4 u_MVP;\n"
+    "  highp vec4 u_Color;\n"
+    "};\n"
+    "in vec2 v_TexCoords;\n"
+    "uniform sampler2D u_Sampler;\n"
+    "out vec4 o_FragColor;\n"
+    "void main() {\n"
+    "  vec4 texel = texture(u_Sampler, fract(v_TexCoords));\n"
+    "  if (texel.a < 0.5) discard;\n"
+    "  o_FragColor = u_Color * texel;\n"
+    "}\n";
+
+// Shaders for the stroke cache: they sample the cube map in the direction of
+// each vertex of a cube centered on the eye.
+static const char* kImpostorShaderVp =
+    "uniform mat4 u_MVP;\n"
+    "attribute vec4 a_Position;\n"
+    "varying vec3 v_Direction;\n"
+    "void main() {\n"
+    "  gl_Position = u_MVP * a_Position;\n"
+    "  v_Direction = a_Position.xyz;\n"
+    "}\n";
+
+static const char* kImpostorShaderFp =
+    "precision mediump float;\n"
+    "varying vec3 v_Direction;\n"
+    "uniform samplerCube u_Sampler;\n"
+    "void main() {\n"
+    "  gl_FragColor = textureCube(u_Sampler, v_Direction);\n"
+    "}\n";
+
+static const char* kImpostorShaderVpEs3 =
+    "#version 300 es\n"
+    "layout(std140) uniform DrawConstants {\n"
+    "  highp mat4 u_MVP;\n"
+    "  highp vec4 u_Color;\n"
+    "};\n"
+    "in vec4 a_Position;\n"
+    "out vec3 v_Direction;\n"
+    "void main() {\n"
+    "  gl_Position = u_MVP * a_Position;\n"
+    "  v_Direction = a_Position.xyz;\n"
+    "}\n";
+
+static const char* kImpostorShaderFpEs3 =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "in vec3 v_Direction;\n"
+    "uniform samplerCube u_Sampler;\n"
+    "out vec4 o_FragColor;\n"
+    "void main() {\n"
+    "  o_FragColor = texture(u_Sampler, v_Direction);\n"
+    "}\n";
+
 // In geometry data, this is the offset where texture coordinates start.
 static int kGeomTexCoordOffset = 3;  // in elements, not bytes.
 
@@ -102,17 +271,19 @@ static const gvr::Mat4f kGroundModelMatrix = {
     0.0f, 0.0f, 0.0f, 1.0f,
 };
 
+// Indices of the two triangles of a quad whose 4 vertices are given in
+// order around its edge. Used by the ground and the cursor.
+static const uint16_t kQuadIndices[] = {0, 1, 2, 0, 2, 3};
+static const int kQuadIndexCount = 6;
+
 // Geometry of the ground plane.
 static float kGroundGeom[] = {
     // Data is X, Y, Z (vertex coords), S, T (texture coords).
     kGroundSize, 0.0f, -kGroundSize, kGroundTexRepeat, 0.0f,
     -kGroundSize, 0.0f, -kGroundSize, 0.0f, 0.0f,
     -kGroundSize, 0.0f, kGroundSize, 0.0f, kGroundTexRepeat,
-    kGroundSize, 0.0f, -kGroundSize, kGroundTexRepeat, 0.0f,
-    -kGroundSize, 0.0f, kGroundSize, 0.0f, kGroundTexRepeat,
     kGroundSize, 0.0f, kGroundSize, kGroundTexRepeat, kGroundTexRepeat,
 };
-static int kGroundVertexCount = 6;
 
 // Size of the cursor.
 static float kCursorScale = 1.0f;
@@ -123,11 +294,32 @@ static float kCursorGeom[] = {
     kCursorScale, kCursorScale, 0.0f, 1.0f, 0.0f,
     -kCursorScale, kCursorScale, 0.0f, 0.0f, 0.0f,
     -kCursorScale, -kCursorScale, 0.0f, 0.0f, 1.0f,
-    kCursorScale, kCursorScale, 0.0f, 1.0f, 0.0f,
-    -kCursorScale, -kCursorScale, 0.0f, 0.0f, 1.0f,
     kCursorScale, -kCursorScale, 0.0f, 1.0f, 1.0f,
 };
-static int kCursorVertexCount = 6;
+
+// Geometry of the cube that the stroke cache is drawn on. Its size does not
+// matter as long as it is within the clipping planes.
+static float kImpostorCubeGeom[] = {
+    // Data is X, Y, Z (vertex coords), S, T (unused texture coords).
+    -1.0f, -1.0f, -1.0f, 0.0f, 0.0f,
+    1.0f, -1.0f, -1.0f, 0.0f, 0.0f,
+    1.0f, 1.0f, -1.0f, 0.0f, 0.0f,
+    -1.0f, 1.0f, -1.0f, 0.0f, 0.0f,
+    -1.0f, -1.0f, 1.0f, 0.0f, 0.0f,
+    1.0f, -1.0f, 1.0f, 0.0f, 0.0f,
+    1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+    -1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+};
+static const uint16_t kImpostorCubeIndices[] = {
+    0, 1, 2, 0, 2, 3,  // -Z
+    4, 6, 5, 4, 7, 6,  // +Z
+    0, 3, 7, 0, 7, 4,  // -X
+    1, 5, 6, 1, 6, 2,  // +X
+    0, 4, 5, 0, 5, 1,  // -Y
+    3, 2, 6, 3, 6, 7,  // +Y
+};
+static const int kImpostorCubeIndexCount = 36;
+static const std::array<float, 4> kImpostorColor = {1.0f, 1.0f, 1.0f, 1.0f};
 
 // Available colors the user can paint with.
 static const std::array<std::array<float, 4>, 10> kColors = {
@@ -148,13 +340,26 @@ static const std::array<std::array<float, 4>, 10> kColors = {
 // This is given as a fraction of the touch pad.
 static const float kColorSwitchThreshold = 0.4f;
 
-// Maximum number of drawn vertices to allow a color switch.
-// If more than this number of vertices have been drawn, then a color
+// Maximum number of drawn segments to allow a color switch.
+// If more than this number of segments have been drawn, then a color
 // switch gesture is forbidden.
-static const int kMaxVerticesForColorSwitch = 10;
+static const int kMaxSegmentsForColorSwitch = 1;
 
 // Prediction time to use when estimating head pose.
-static const int64_t kPredictionTimeWithoutVsyncNanos = 50000000;  // 50ms
+static const uint64_t kPredictionTimeWithoutVsyncNanos = 50000000;  // 50ms
+
+// Time left between the estimated end of a frame and its vsync deadline, to
+// absorb oversleeping and frames slower than the estimate.
+static const uint64_t kFrameScheduleMarginNanos = 2000000;  // 2ms
+
+// Maximum time to wait for the swap chain to provide a frame before the frame
+// is counted as dropped.
+static const uint64_t kFrameAcquireBudgetNanos = 4000000;  // 4ms
+
+// Number of submitted frames the GPU may still be working on when a new frame
+// begins, and the longest time to wait for it to catch up.
+static const int kMaxFramesInFlight = 2;
+static const uint64_t kFrameLimiterBudgetNanos = 8000000;  // 8ms
 
 // Minimum length of any paint segment. If the user tries to draw something
 // smaller than this length, it is ignored.
@@ -164,42 +369,135 @@ static const float kMinPaintSegmentLength = 4.0f;
 // number, we commit the geometry to the GPU as a VBO.
 static const int kVboCommitThreshold = 50;
 
+// Consecutive segments of a stroke share their vertices, so the texture
+// coordinate along the stroke keeps increasing (the shader wraps it with
+// fract()). To keep it precise at mediump, a stroke starts over from fresh
+// vertices once it reaches this value.
+static const float kMaxStrokeTexU = 8.0f;
+
 // Minimum and maximum stroke widths.
 static const float kMinStrokeWidth = 1.5f;
 static const float kMaxStrokeWidth = 4.0f;
 
+// Logcat tag used by the trace logger for messages from the frame loop.
+static const char kTraceLogTag[] = "ControllerDemoCPP";
+
+// Render target scales, in tenths of the maximum effective render target
+// size. Because we are using 2X MSAA, we can render to half as many pixels
+// (sqrt(2)/2 ~= 7/10ths in each dimension) and achieve similar quality. Lower
+// steps are used when the swapchain exceeds its memory budget.
+static const int kRenderScaleLadder[] = {7, 6, 5};
+static const int kRenderScaleLadderSize =
+    sizeof(kRenderScaleLadder) / sizeof(kRenderScaleLadder[0]);
+
+// Soft GPU memory budgets. When the committed paint geometry exceeds its
+// budget, the oldest strokes are deleted until it is back to 3/4 of it.
+static const size_t kVboBudgetBytes = 8 * 1024 * 1024;
+static const size_t kSwapChainBudgetBytes = 48 * 1024 * 1024;
+
+// Binds the DrawConstants uniform block of |program| to
+// kDrawConstantsBinding. OpenGL ES 3 only.
+void BindDrawConstantsBlock(int program) {
+  const GLuint block = glGetUniformBlockIndex(program, "DrawConstants");
+  CHECK(block != GL_INVALID_INDEX);
+  glUniformBlockBinding(program, block, kDrawConstantsBinding);
+}
+
+// Computes the bounding box of |geom|, which is formatted like
+// DemoApp::recent_geom_.
+void GeometryBounds(const std::vector<float>& geom,
+                    std::array<float, 3>* min_coords,
+                    std::array<float, 3>* max_coords) {
+  *min_coords = {{geom[0], geom[1], geom[2]}};
+  *max_coords = *min_coords;
+  for (size_t i = 0; i + 2 < geom.size(); i += 5) {
+    for (int k = 0; k < 3; ++k) {
+      (*min_coords)[k] = std::min((*min_coords)[k], geom[i + k]);
+      (*max_coords)[k] = std::max((*max_coords)[k], geom[i + k]);
+    }
+  }
+}
+
+// Returns the center of the bounding box of |geom|.
+std::array<float, 3> GeometryCenter(const std::vector<float>& geom) {
+  std::array<float, 3> min_coords;
+  std::array<float, 3> max_coords;
+  GeometryBounds(geom, &min_coords, &max_coords);
+  return {{(min_coords[0] + max_coords[0]) * 0.5f,
+           (min_coords[1] + max_coords[1]) * 0.5f,
+           (min_coords[2] + max_coords[2]) * 0.5f}};
+}
+
+// Returns the distance from the eye to |point| along the view axis.
+float ViewDepth(const gvr::Mat4f& view_matrix,
+                const std::array<float, 3>& point) {
+  return -Utils::MatrixVectorMul(view_matrix, point)[2];
+}
+
 }  // namespace
 
+#ifdef __ANDROID__
 DemoApp::DemoApp(JNIEnv* env, jobject asset_mgr_obj, jlong gvr_context_ptr)
     :  // This is the GVR context pointer obtained from Java:
-      gvr_context_(reinterpret_cast<gvr_context*>(gvr_context_ptr)),
+      DemoApp(reinterpret_cast<gvr_context*>(gvr_context_ptr),
+              AssetArchive::OpenFromAssets(
+                  AAssetManager_fromJava(env, asset_mgr_obj),
+                  kTextureArchivePath)) {}
+#endif  // #ifdef __ANDROID__
+
+DemoApp::DemoApp(gvr_context* gvr_context,
+                 std::unique_ptr<AssetArchive> asset_archive)
+    : gvr_context_(gvr_context),
       // Wrap the gvr_context* into a GvrApi C++ object for convenience:
       gvr_api_(gvr::GvrApi::WrapNonOwned(gvr_context_)),
       gvr_api_initialized_(false),
       viewport_list_(gvr_api_->CreateEmptyBufferViewportList()),
       scratch_viewport_(gvr_api_->CreateBufferViewport()),
-      shader_(-1),
-      shader_u_color_(-1),
-      shader_u_mvp_matrix_(-1),
-      shader_u_sampler_(-1),
-      shader_a_position_(-1),
-      shader_a_texcoords_(-1),
+      render_quality_(0),
+      frame_acquirer_(gvr_api_.get(), FrameAcquirer::kPolicyWait,
+                      kFrameAcquireBudgetNanos),
+      frame_limiter_(kMaxFramesInFlight, FrameLimiter::kPolicyWait,
+                     kFrameLimiterBudgetNanos),
+      frame_scheduler_(kFrameScheduleMarginNanos,
+                       kPredictionTimeWithoutVsyncNanos),
+      paint_shader_{-1, -1, -1, -1, -1, -1},
+      alpha_test_shader_{-1, -1, -1, -1, -1, -1},
+      impostor_shader_{-1, -1, -1, -1, -1, -1},
+      overdraw_shader_{-1, -1, -1, -1, -1, -1},
+      shader_(&paint_shader_),
+      use_uniform_buffers_(false),
+      frames_until_overdraw_pass_(kOverdrawPassInterval),
+      impostor_dirty_faces_(0),
+      impostor_valid_(false),
+      rendering_impostor_(false),
       ground_texture_(-1),
       paint_texture_(-1),
-      asset_mgr_(AAssetManager_fromJava(env, asset_mgr_obj)),
+      asset_archive_(std::move(asset_archive)),
       recent_geom_vertex_count_(0),
-      brush_stroke_total_vertices_(0),
+      brush_stroke_segment_count_(0),
       selected_color_(0),
       painting_(false),
       has_continuation_(false),
+      stroke_tex_u_(0.0f),
+      clear_drawing_pending_(false),
       switched_color_(false),
       stroke_width_(kMinStrokeWidth) {
-  CHECK(asset_mgr_);
+  CHECK(asset_archive_);
+  TraceLog::Start(kTraceLogTag, nullptr);
+  gpu_memory_.SetSoftBudget(
+      GpuMemoryTracker::kCategoryBuffer, kVboBudgetBytes,
+      [this](GpuMemoryTracker::Category, size_t) {
+        TrimDrawing(kVboBudgetBytes / 4 * 3);
+      });
+  gpu_memory_.SetSoftBudget(
+      GpuMemoryTracker::kCategorySwapChain, kSwapChainBudgetBytes,
+      [this](GpuMemoryTracker::Category, size_t) { LowerRenderQuality(); });
   LOGD("DemoApp initialized.");
 }
 
 DemoApp::~DemoApp() {
   LOGD("DemoApp shutdown.");
+  TraceLog::Stop();
 }
 
 void DemoApp::OnResume() {
@@ -212,9 +510,35 @@ void DemoApp::OnResume() {
 
 void DemoApp::OnPause() {
   LOGD("DemoApp::OnPause");
-  // The GL context is not preserved when pausing. Delete the drawing VBOs to
-  // avoid dangling GL object IDs.
-  ClearDrawing();
+  const FrameStats frames = frame_acquirer_.GetStats();
+  LOGD("Frames acquired: %llu, late: %llu, dropped: %llu, max wait: %llu ns",
+       static_cast<unsigned long long>(frames.frames_acquired),  // NOLINT
+       static_cast<unsigned long long>(frames.frames_late),      // NOLINT
+       static_cast<unsigned long long>(frames.frames_dropped),   // NOLINT
+       static_cast<unsigned long long>(frames.max_wait_nanos));  // NOLINT
+  const FrameLatencyStats latency = frame_limiter_.GetStats();
+  const uint64_t mean_lag_nanos =
+      latency.frames_completed
+          ? latency.total_lag_nanos / latency.frames_completed
+          : 0;
+  LOGD("CPU to GPU lag: mean %llu ns, max %llu ns; limited frames: %llu",
+       static_cast<unsigned long long>(mean_lag_nanos),           // NOLINT
+       static_cast<unsigned long long>(latency.max_lag_nanos),    // NOLINT
+       static_cast<unsigned long long>(latency.frames_limited));  // NOLINT
+  const FrameScheduleStats schedule = frame_scheduler_.GetStats();
+  const uint64_t mean_latency_nanos =
+      schedule.frames_scheduled
+          ? schedule.total_latency_nanos / schedule.frames_scheduled
+          : 0;
+  LOGD("Scheduled frames: %llu, missed deadlines: %llu, mean latency %llu ns",
+       static_cast<unsigned long long>(schedule.frames_scheduled),  // NOLINT
+       static_cast<unsigned long long>(schedule.deadlines_missed),  // NOLINT
+       static_cast<unsigned long long>(mean_latency_nanos));        // NOLINT
+  vsync_.Reset();
+  // There is no GL context on this thread, so the rendering thread clears
+  // the drawing: OnSurfaceCreated() if the context is lost, as it is when
+  // pausing, or else the next OnDrawFrame().
+  clear_drawing_pending_ = true;
   if (gvr_api_initialized_) gvr_api_->PauseTracking();
   if (controller_api_) controller_api_->Pause();
 }
@@ -224,46 +548,87 @@ void DemoApp::OnSurfaceCreated() {
 
   LOGD("Initializing GL on GvrApi.");
   gvr_api_->InitializeGl();
+  // Any GPU objects from a previous GL context are gone, including the
+  // drawing VBOs, so they are forgotten rather than deleted.
+  gpu_memory_.Reset();
+  committed_vbos_.clear();
+  impostor_valid_ = false;
+  clear_drawing_pending_ = false;
+  RenderPass::InitializeGl();
+  hidden_area_.InitializeGl();
+  if (!fence_.InitializeGl()) {
+    LOGW("EGL_KHR_fence_sync is not supported; frames in flight unlimited.");
+  }
+  frame_limiter_.SetFence(&fence_);
+  frame_scheduler_.SetFence(&fence_);
+  frame_scheduler_.SetVsyncProvider(&vsync_);
 
   LOGD("Initializing ControllerApi.");
   controller_api_.reset(new gvr::ControllerApi);
   CHECK(controller_api_);
-  CHECK(controller_api_->Init(gvr::ControllerApi::DefaultOptions(),
-                              gvr_context_));
+  int32_t controller_options = gvr::ControllerApi::DefaultOptions();
+  if (kFuseControllerSensors || kLogControllerSensors) {
+    controller_options |= GVR_CONTROLLER_ENABLE_GYRO |
+                          GVR_CONTROLLER_ENABLE_ACCEL;
+  }
+  CHECK(controller_api_->Init(controller_options, gvr_context_));
   controller_api_->Resume();
 
   LOGD("Initializing framebuffer.");
-  std::vector<gvr::BufferSpec> specs;
-  specs.push_back(gvr_api_->CreateBufferSpec());
-  framebuf_size_ = gvr_api_->GetMaximumEffectiveRenderTargetSize();
-  // Because we are using 2X MSAA, we can render to half as many pixels and
-  // achieve similar quality. Scale each dimension by sqrt(2)/2 ~= 7/10ths.
-  framebuf_size_.width = (7 * framebuf_size_.width) / 10;
-  framebuf_size_.height = (7 * framebuf_size_.height) / 10;
-
-  specs[0].SetSize(framebuf_size_);
-  specs[0].SetColorFormat(GVR_COLOR_FORMAT_RGBA_8888);
-  specs[0].SetDepthStencilFormat(GVR_DEPTH_STENCIL_FORMAT_DEPTH_16);
-  specs[0].SetSamples(2);
-  swapchain_.reset(new gvr::SwapChain(gvr_api_->CreateSwapChain(specs)));
+  framebuf_size_ = GetRenderTargetSize();
+  std::vector<GpuMemoryTracker::SwapChainBufferDesc> buffers(1);
+  buffers[0].size = framebuf_size_;
+  buffers[0].samples = 2;
+  buffers[0].color_format = GVR_COLOR_FORMAT_RGBA_8888;
+  buffers[0].depth_stencil_format = GVR_DEPTH_STENCIL_FORMAT_DEPTH_16;
+  swapchain_ = gpu_memory_.CreateSwapChain(gvr_api_.get(), buffers);
 
   LOGD("Compiling shaders.");
-  int vp = Utils::BuildShader(GL_VERTEX_SHADER, kPaintShaderVp);
-  int fp = Utils::BuildShader(GL_FRAGMENT_SHADER, kPaintShaderFp);
-  shader_ = Utils::BuildProgram(vp, fp);
-  shader_u_color_ = glGetUniformLocation(shader_, "u_Color");
-  shader_u_mvp_matrix_ = glGetUniformLocation(shader_, "u_MVP");
-  shader_u_sampler_ = glGetUniformLocation(shader_, "u_Sampler");
-  shader_a_position_ = glGetAttribLocation(shader_, "a_Position");
-  shader_a_texcoords_ = glGetAttribLocation(shader_, "a_TexCoords");
+  use_uniform_buffers_ =
+      kUseUniformBuffers && Utils::GetGlesMajorVersion() >= 3;
+  if (use_uniform_buffers_) {
+    LOGD("Using uniform buffers for per-draw constants.");
+    uniform_ring_.Init(kDrawConstantsFrameCapacity, &gpu_memory_);
+    paint_shader_ = BuildShaderProgram(kPaintShaderVpEs3, kPaintShaderFpEs3);
+    alpha_test_shader_ =
+        BuildShaderProgram(kPaintShaderVpEs3, kPaintShaderAlphaTestFpEs3);
+    impostor_shader_ =
+        BuildShaderProgram(kImpostorShaderVpEs3, kImpostorShaderFpEs3);
+    BindDrawConstantsBlock(paint_shader_.program);
+    BindDrawConstantsBlock(alpha_test_shader_.program);
+    BindDrawConstantsBlock(impostor_shader_.program);
+  } else {
+    paint_shader_ = BuildShaderProgram(kPaintShaderVp, kPaintShaderFp);
+    alpha_test_shader_ =
+        BuildShaderProgram(kPaintShaderVp, kPaintShaderAlphaTestFp);
+    impostor_shader_ =
+        BuildShaderProgram(kImpostorShaderVp, kImpostorShaderFp);
+  }
+  if (kAnalyzeOverdraw) {
+    if (use_uniform_buffers_) {
+      overdraw_shader_ = BuildShaderProgram(
+          kPaintShaderVpEs3, OverdrawAnalyzer::kCountingFragmentShaderEs3);
+      BindDrawConstantsBlock(overdraw_shader_.program);
+    } else {
+      overdraw_shader_ = BuildShaderProgram(
+          kPaintShaderVp, OverdrawAnalyzer::kCountingFragmentShader);
+    }
+    overdraw_analyzer_.Init(kOverdrawTargetSize, &gpu_memory_);
+  }
+  if (kCacheCommittedStrokes) {
+    stroke_impostor_.Init(kImpostorFaceSize, &gpu_memory_);
+    impostor_dirty_faces_ = CubemapImpostor::kAllFaces;
+    impostor_valid_ = false;
+  }
   CHECK(glGetError() == GL_NO_ERROR);
 
   LOGD("Loading textures.");
-  paint_texture_ = Utils::LoadRawTextureFromAsset(
-      asset_mgr_, kPaintTexturePath, kPaintTextureWidth, kPaintTextureHeight);
-  ground_texture_ = Utils::LoadRawTextureFromAsset(
-      asset_mgr_, kGroundTexturePath, kGroundTextureWidth,
-      kGroundTextureHeight);
+  paint_texture_ = Utils::LoadRawTextureFromArchive(
+      *asset_archive_, kPaintTextureName, kPaintTextureWidth,
+      kPaintTextureHeight, &gpu_memory_);
+  ground_texture_ = Utils::LoadRawTextureFromArchive(
+      *asset_archive_, kGroundTextureName, kGroundTextureWidth,
+      kGroundTextureHeight, &gpu_memory_);
 
   CHECK(glGetError() == GL_NO_ERROR);
   gvr_api_initialized_ = true;
@@ -277,15 +642,23 @@ void DemoApp::OnSurfaceChanged(int width, int height) {
 }
 
 void DemoApp::OnDrawFrame() {
-  PrepareFramebuffer();
-
-  // Enable blending so we get a transparency effect.
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable(GL_BLEND);
+  // Acquire the frame before any other work, so that a frame that cannot be
+  // rendered costs nothing more. The drop is recorded by |frame_acquirer_|.
+  gvr::Frame frame = frame_acquirer_.AcquireFrame(swapchain_.get());
+  if (!frame) return;
+
+  // Wait for the GPU before sampling any input, so that the head pose and
+  // controller state are as recent as possible. If it is still behind, skip
+  // the optional work below.
+  const bool gpu_caught_up = frame_limiter_.BeginFrame();
+  // Then wait until the latest start that still meets the next vsync.
+  gvr::ClockTimePoint pred_time;
+  pred_time.monotonic_system_time_nanos = frame_scheduler_.BeginFrame();
+  if (clear_drawing_pending_.exchange(false)) ClearDrawing();
+  if (use_uniform_buffers_) uniform_ring_.BeginFrame();
+  if (kCacheCommittedStrokes) UpdateStrokeImpostor();
 
   viewport_list_.SetToRecommendedBufferViewports();
-  gvr::ClockTimePoint pred_time = gvr::GvrApi::GetTimePointNow();
-  pred_time.monotonic_system_time_nanos += kPredictionTimeWithoutVsyncNanos;
 
   gvr::Mat4f head_view =
       gvr_api_->GetHeadSpaceFromStartSpaceRotation(pred_time);
@@ -306,54 +679,132 @@ void DemoApp::OnDrawFrame() {
 
   // Read current controller state.
   controller_state_.Update(*controller_api_);
+  UpdateControllerOrientation(pred_time.monotonic_system_time_nanos);
 
   // Print new API status and connection state, if they changed.
   if (controller_state_.GetApiStatus() != old_status ||
       controller_state_.GetConnectionState() != old_connection_state) {
-    LOGD("DemoApp: controller API status: %s, connection state: %s",
-         gvr_controller_api_status_to_string(controller_state_.GetApiStatus()),
-         gvr_controller_connection_state_to_string(
-             controller_state_.GetConnectionState()));
+    TRACE_LOGD(
+        "DemoApp: controller API status: %s, connection state: %s",
+        gvr_controller_api_status_to_string(controller_state_.GetApiStatus()),
+        gvr_controller_connection_state_to_string(
+            controller_state_.GetConnectionState()));
   }
   // Print new controller battery level and charging state, if they changed.
   if (controller_state_.GetBatteryLevel() != old_battery_level ||
       controller_state_.GetBatteryCharging() != old_battery_charging) {
-    LOGD("DemoApp: controller battery level: %s, charging: %s",
-         gvr::ControllerApi::ToString(controller_state_.GetBatteryLevel()),
-         controller_state_.GetBatteryCharging() ? "true" : "false");
+    TRACE_LOGD(
+        "DemoApp: controller battery level: %s, charging: %s",
+        gvr::ControllerApi::ToString(controller_state_.GetBatteryLevel()),
+        controller_state_.GetBatteryCharging() ? "true" : "false");
   }
 
-  gvr::Frame frame = swapchain_->AcquireFrame();
-  frame.BindBuffer(0);
-
-  glClearColor(kSkyColor[0], kSkyColor[1], kSkyColor[2], 1.0f);
+  RenderPass eye_pass(kEyeBufferPass);
+  eye_pass.Begin(&frame, 0, framebuf_size_);
   viewport_list_.GetBufferViewport(0, &scratch_viewport_);
   DrawEye(GVR_LEFT_EYE, left_eye_view, scratch_viewport_);
   viewport_list_.GetBufferViewport(1, &scratch_viewport_);
   DrawEye(GVR_RIGHT_EYE, right_eye_view, scratch_viewport_);
-  frame.Unbind();
+  eye_pass.End();
   frame.Submit(viewport_list_, head_view);
+  frame_limiter_.EndFrame();
+  frame_scheduler_.EndFrame();
+  // The acquired frame keeps its size, so a resize applies from the next one.
+  PrepareFramebuffer();
+
+  if (kAnalyzeOverdraw && gpu_caught_up &&
+      --frames_until_overdraw_pass_ == 0) {
+    frames_until_overdraw_pass_ = kOverdrawPassInterval;
+    viewport_list_.GetBufferViewport(0, &scratch_viewport_);
+    AnalyzeOverdraw(left_eye_view, scratch_viewport_);
+  }
+  if (use_uniform_buffers_) uniform_ring_.EndFrame();
+
+  gpu_memory_.CheckBudgets();
+}
+
+void DemoApp::OnVsync(uint64_t frame_time_nanos, uint64_t period_nanos) {
+  vsync_.OnVsync(frame_time_nanos, period_nanos);
+}
+
+void DemoApp::UpdateControllerOrientation(int64_t display_time_nanos) {
+  controller_orientation_ = controller_state_.GetOrientation();
+  if (!kFuseControllerSensors && !kLogControllerSensors) return;
+  if (controller_state_.GetConnectionState() != gvr::kControllerConnected) {
+    controller_fusion_.Reset();
+    return;
+  }
+
+  ControllerSensorSample sample;
+  sample.orientation_timestamp =
+      controller_state_.GetLastOrientationTimestamp();
+  sample.orientation = controller_state_.GetOrientation();
+  sample.gyro_timestamp = controller_state_.GetLastGyroTimestamp();
+  sample.gyro = controller_state_.GetGyro();
+  sample.accel_timestamp = controller_state_.GetLastAccelTimestamp();
+  sample.accel = controller_state_.GetAccel();
+  if (kLogControllerSensors) {
+    LOGD("sensors: %lld %f %f %f %f %lld %f %f %f %lld %f %f %f",
+         static_cast<long long>(sample.orientation_timestamp),  // NOLINT
+         sample.orientation.qx, sample.orientation.qy, sample.orientation.qz,
+         sample.orientation.qw,
+         static_cast<long long>(sample.gyro_timestamp),  // NOLINT
+         sample.gyro.x, sample.gyro.y, sample.gyro.z,
+         static_cast<long long>(sample.accel_timestamp),  // NOLINT
+         sample.accel.x, sample.accel.y, sample.accel.z);
+  }
+  if (!kFuseControllerSensors) return;
+  controller_fusion_.AddSample(sample);
+  if (controller_fusion_.IsInitialized()) {
+    controller_orientation_ =
+        controller_fusion_.GetPredictedOrientation(display_time_nanos);
+  }
+}
+
+DemoApp::ShaderProgram DemoApp::BuildShaderProgram(
+    const char* vertex_source, const char* fragment_source) {
+  int vp = Utils::BuildShader(GL_VERTEX_SHADER, vertex_source);
+  int fp = Utils::BuildShader(GL_FRAGMENT_SHADER, fragment_source);
+  ShaderProgram shader;
+  shader.program = Utils::BuildProgram(vp, fp);
+  shader.u_color = glGetUniformLocation(shader.program, "u_Color");
+  shader.u_mvp_matrix = glGetUniformLocation(shader.program, "u_MVP");
+  shader.u_sampler = glGetUniformLocation(shader.program, "u_Sampler");
+  shader.a_position = glGetAttribLocation(shader.program, "a_Position");
+  shader.a_texcoords = glGetAttribLocation(shader.program, "a_TexCoords");
+  return shader;
 }
 
 void DemoApp::PrepareFramebuffer() {
-  gvr::Sizei recommended_size = gvr_api_->GetMaximumEffectiveRenderTargetSize();
-  // Because we are using 2X MSAA, we can render to half as many pixels and
-  // achieve similar quality. Scale each dimension by sqrt(2)/2 ~= 7/10ths.
-  recommended_size.width = (7 * recommended_size.width) / 10;
-  recommended_size.height = (7 * recommended_size.height) / 10;
+  const gvr::Sizei recommended_size = GetRenderTargetSize();
   if (framebuf_size_.width != recommended_size.width ||
       framebuf_size_.height != recommended_size.height) {
     // We need to resize the framebuffer.
-    swapchain_->ResizeBuffer(0, recommended_size);
+    gpu_memory_.ResizeSwapChainBuffer(swapchain_.get(), 0, recommended_size);
     framebuf_size_ = recommended_size;
   }
 }
 
+gvr::Sizei DemoApp::GetRenderTargetSize() {
+  gvr::Sizei size = gvr_api_->GetMaximumEffectiveRenderTargetSize();
+  const int scale = kRenderScaleLadder[render_quality_];
+  size.width = (scale * size.width) / 10;
+  size.height = (scale * size.height) / 10;
+  return size;
+}
+
+void DemoApp::LowerRenderQuality() {
+  if (render_quality_ + 1 >= kRenderScaleLadderSize) return;
+  ++render_quality_;
+  LOGW("Lowering render target scale to %d/10.",
+       kRenderScaleLadder[render_quality_]);
+}
+
 void DemoApp::CheckColorSwitch() {
   if (switched_color_ || !controller_state_.IsTouching()) return;
   float x_diff = fabs(controller_state_.GetTouchPos().x - touch_down_x_);
   if (x_diff < kColorSwitchThreshold) return;
-  if (brush_stroke_total_vertices_ > kMaxVerticesForColorSwitch) return;
+  if (brush_stroke_segment_count_ > kMaxSegmentsForColorSwitch) return;
   if (controller_state_.GetTouchPos().x > touch_down_x_) {
     selected_color_ = (selected_color_ + 1) % kColors.size();
   } else {
@@ -375,6 +826,10 @@ void DemoApp::CheckChangeStrokeWidth() {
 void DemoApp::DrawEye(gvr::Eye which_eye, const gvr::Mat4f& eye_view_matrix,
                       const gvr::BufferViewport& viewport) {
   Utils::SetUpViewportAndScissor(framebuf_size_, viewport);
+  // Keep the pixels that the lenses never show out of every pass below.
+  glEnable(GL_DEPTH_TEST);
+  hidden_area_.Update(gvr_api_.get(), which_eye, viewport.GetSourceFov());
+  hidden_area_.Draw(which_eye);
 
   gvr::Mat4f proj_matrix =
       Utils::PerspectiveMatrixFromView(viewport.GetSourceFov(), kNearClip,
@@ -382,7 +837,7 @@ void DemoApp::DrawEye(gvr::Eye which_eye, const gvr::Mat4f& eye_view_matrix,
 
   // Figure out the point the cursor is pointing to.
   const gvr::Mat4f cursor_mat =
-      Utils::ControllerQuatToMatrix(controller_state_.GetOrientation());
+      Utils::ControllerQuatToMatrix(controller_orientation_);
   const std::array<float, 3> neutral_pos = { 0, 0, -kDefaultPaintDistance };
   const std::array<float, 3> target_pos = Utils::MatrixVectorMul(
       cursor_mat, neutral_pos);
@@ -427,25 +882,204 @@ void DemoApp::DrawEye(gvr::Eye which_eye, const gvr::Mat4f& eye_view_matrix,
     }
   }
 
-  glUseProgram(shader_);
+  DrawScene(eye_view_matrix, proj_matrix);
+
+  CHECK(glGetError() == GL_NO_ERROR);
+}
+
+void DemoApp::DrawScene(const gvr::Mat4f& view_matrix,
+                        const gvr::Mat4f& proj_matrix) {
+  DrawGround(view_matrix, proj_matrix);
+  DrawPaintedGeometry(view_matrix, proj_matrix);
+  DrawCursor(view_matrix, proj_matrix);
+  FlushDraws();
+}
+
+void DemoApp::FlushDraws() {
+  // Group the draws by material. Opaque draws go front to back so that
+  // hidden fragments fail the depth test early; blended draws go back to
+  // front so that they blend correctly. Overlay draws keep their order.
+  std::stable_sort(draw_list_.begin(), draw_list_.end(),
+                   [](const DrawItem& a, const DrawItem& b) {
+                     if (a.material != b.material) {
+                       return a.material < b.material;
+                     }
+                     switch (a.material) {
+                       case kMaterialOpaque:
+                       case kMaterialAlphaTested:
+                         return a.view_depth < b.view_depth;
+                       case kMaterialBlended:
+                         return a.view_depth > b.view_depth;
+                       default:
+                         return false;
+                     }
+                   });
+
+  // Write the constants of all the draws with a single mapping.
+  GLintptr constants_offset = 0;
+  GLsizeiptr constants_stride = 0;
+  if (use_uniform_buffers_ && !draw_list_.empty()) {
+    constants_stride = uniform_ring_.AlignSize(sizeof(DrawConstants));
+    uint8_t* constants = static_cast<uint8_t*>(uniform_ring_.Map(
+        constants_stride * draw_list_.size(), &constants_offset));
+    for (size_t i = 0; i < draw_list_.size(); ++i) {
+      DrawConstants draw_constants;
+      draw_constants.mvp = Utils::MatrixToGLArray(draw_list_[i].mvp);
+      draw_constants.color = draw_list_[i].color;
+      memcpy(constants + i * constants_stride, &draw_constants,
+             sizeof(draw_constants));
+    }
+    uniform_ring_.Unmap();
+  }
+
+  const bool counting_overdraw = shader_ == &overdraw_shader_;
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, ground_texture_);
-  DrawGround(eye_view_matrix, proj_matrix);
-  glBindTexture(GL_TEXTURE_2D, paint_texture_);
-  DrawPaintedGeometry(eye_view_matrix, proj_matrix);
-  DrawCursor(eye_view_matrix, proj_matrix);
+  GLuint bound_texture = 0;
+  glBindTexture(GL_TEXTURE_2D, bound_texture);
+  const ShaderProgram* bound_shader = nullptr;
+  for (size_t i = 0; i < draw_list_.size(); ++i) {
+    const DrawItem& item = draw_list_[i];
+    if (i == 0 || item.material != draw_list_[i - 1].material) {
+      SetMaterialState(item.material);
+    }
+    const ShaderProgram* shader = shader_;
+    if (!counting_overdraw && item.material == kMaterialAlphaTested) {
+      shader = &alpha_test_shader_;
+    } else if (!counting_overdraw && item.material == kMaterialCachedLayer) {
+      shader = &impostor_shader_;
+    }
+    if (shader != bound_shader) {
+      glUseProgram(shader->program);
+      bound_shader = shader;
+    }
+    if (item.material == kMaterialCachedLayer) {
+      glBindTexture(GL_TEXTURE_CUBE_MAP, item.texture);
+    } else if (item.texture != bound_texture) {
+      glBindTexture(GL_TEXTURE_2D, item.texture);
+      bound_texture = item.texture;
+    }
+    if (use_uniform_buffers_) {
+      glBindBufferRange(GL_UNIFORM_BUFFER, kDrawConstantsBinding,
+                        uniform_ring_.GetBuffer(),
+                        constants_offset + i * constants_stride,
+                        sizeof(DrawConstants));
+    }
+    DrawObject(*shader, item);
+  }
+  draw_list_.clear();
 
+  // Depth writes must be on for the depth buffer to be cleared.
+  glDepthMask(GL_TRUE);
+}
+
+void DemoApp::SetMaterialState(Material material) {
+  const bool counting_overdraw = shader_ == &overdraw_shader_;
+  switch (material) {
+    case kMaterialOpaque:
+    case kMaterialAlphaTested:
+      if (!counting_overdraw) glDisable(GL_BLEND);
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_TRUE);
+      // In the stroke cache, opaque objects only occlude the strokes.
+      if (rendering_impostor_) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+      }
+      break;
+    case kMaterialCachedLayer:
+      if (!counting_overdraw) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+      }
+      glDisable(GL_DEPTH_TEST);
+      glDepthMask(GL_FALSE);
+      break;
+    case kMaterialBlended:
+      if (rendering_impostor_) {
+        // Accumulate premultiplied color and coverage, so that the cache can
+        // be composited over the scene later.
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                            GL_ONE_MINUS_SRC_ALPHA);
+      } else if (!counting_overdraw) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_FALSE);
+      break;
+    case kMaterialOverlay:
+      if (!counting_overdraw) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+      glDisable(GL_DEPTH_TEST);
+      glDepthMask(GL_FALSE);
+      break;
+  }
+}
+
+DemoApp::Material DemoApp::MaterialForColor(
+    const std::array<float, 4>& color) {
+  // Utils::ColorFromHex() maps an alpha of 0xff to 255/256.
+  return color[3] >= 255.0f / 256.0f ? kMaterialOpaque : kMaterialBlended;
+}
+
+void DemoApp::UpdateStrokeImpostor() {
+  if (impostor_dirty_faces_ != 0) {
+    const gvr::Mat4f proj_matrix =
+        CubemapImpostor::FaceProjectionMatrix(kNearClip, kFarClip);
+    rendering_impostor_ = true;
+    for (int face = 0; face < CubemapImpostor::kFaceCount; ++face) {
+      if ((impostor_dirty_faces_ & (1 << face)) == 0) continue;
+      stroke_impostor_.BeginFace(face);
+      const gvr::Mat4f view_matrix = CubemapImpostor::FaceViewMatrix(face);
+      const gvr::Mat4f mvp = Utils::MatrixMul(proj_matrix, view_matrix);
+      // The ground is only drawn into the depth buffer, to hide the strokes
+      // below it.
+      DrawGround(view_matrix, proj_matrix);
+      for (const auto& it : committed_vbos_) {
+        if ((it.impostor_faces & (1 << face)) == 0) continue;
+        const std::array<float, 4>& color = kColors[it.color];
+        QueueDraw(MaterialForColor(color), ViewDepth(view_matrix, it.center),
+                  mvp, color, paint_texture_, 0, it.vbo, 0, it.ibo,
+                  it.index_count);
+      }
+      FlushDraws();
+    }
+    stroke_impostor_.End();
+    rendering_impostor_ = false;
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    impostor_dirty_faces_ = 0;
+  }
+  for (auto& it : committed_vbos_) it.in_impostor = true;
+  impostor_valid_ = true;
+}
+
+void DemoApp::AnalyzeOverdraw(const gvr::Mat4f& eye_view_matrix,
+                              const gvr::BufferViewport& viewport) {
+  const gvr::Mat4f proj_matrix =
+      Utils::PerspectiveMatrixFromView(viewport.GetSourceFov(), kNearClip,
+                                       kFarClip);
+  overdraw_analyzer_.BeginPass();
+  shader_ = &overdraw_shader_;
+  DrawScene(eye_view_matrix, proj_matrix);
+  shader_ = &paint_shader_;
+  const OverdrawStats stats = overdraw_analyzer_.EndPass();
   CHECK(glGetError() == GL_NO_ERROR);
+  TRACE_LOGD("DemoApp: overdraw mean %.2f, p95 %d, max %d layers",
+             stats.mean_layers, stats.p95_layers, stats.max_layers);
 }
 
-void DemoApp::AddVertex(const std::array<float, 3>& coords, float u, float v) {
-  ++recent_geom_vertex_count_;
-  ++brush_stroke_total_vertices_;
+uint16_t DemoApp::AddVertex(const std::array<float, 3>& coords, float u,
+                           float v) {
+  CHECK(recent_geom_vertex_count_ <= UINT16_MAX);
   recent_geom_.push_back(coords[0]);
   recent_geom_.push_back(coords[1]);
   recent_geom_.push_back(coords[2]);
   recent_geom_.push_back(u);
   recent_geom_.push_back(v);
+  return static_cast<uint16_t>(recent_geom_vertex_count_++);
 }
 
 void DemoApp::AddPaintSegment(const std::array<float, 3>& start_point,
@@ -471,12 +1105,32 @@ void DemoApp::AddPaintSegment(const std::array<float, 3>& start_point,
       1, end_point, stroke_width_, cross);
   const std::array<float, 3> end_bottom = Utils::VecAdd(
       1, end_point, -stroke_width_, cross);
-  AddVertex(start_top, 0.0f, 0.0f);
-  AddVertex(start_bottom, 0.0f, 1.0f);
-  AddVertex(end_top, 1.0f, 0.0f);
-  AddVertex(start_bottom, 0.0f, 1.0f);
-  AddVertex(end_bottom, 1.0f, 1.0f);
-  AddVertex(end_top, 1.0f, 0.0f);
+
+  // Share the end vertices of the previous segment if they are still in
+  // |recent_geom_|. The last two vertices are always the previous segment's
+  // end, so the triangles reuse the most recently transformed vertices.
+  uint16_t start_top_index;
+  uint16_t start_bottom_index;
+  if (has_continuation_ && recent_geom_vertex_count_ > 0 &&
+      stroke_tex_u_ < kMaxStrokeTexU) {
+    start_top_index = static_cast<uint16_t>(recent_geom_vertex_count_ - 2);
+    start_bottom_index = static_cast<uint16_t>(recent_geom_vertex_count_ - 1);
+  } else {
+    stroke_tex_u_ = 0.0f;
+    start_top_index = AddVertex(start_top, stroke_tex_u_, 0.0f);
+    start_bottom_index = AddVertex(start_bottom, stroke_tex_u_, 1.0f);
+  }
+  stroke_tex_u_ += 1.0f;
+  const uint16_t end_top_index = AddVertex(end_top, stroke_tex_u_, 0.0f);
+  const uint16_t end_bottom_index =
+      AddVertex(end_bottom, stroke_tex_u_, 1.0f);
+  const uint16_t indices[] = {
+      start_top_index, start_bottom_index, end_top_index,
+      start_bottom_index, end_bottom_index, end_top_index,
+  };
+  recent_indices_.insert(recent_indices_.end(), indices, indices + 6);
+  ++brush_stroke_segment_count_;
+
   if (recent_geom_vertex_count_ > kVboCommitThreshold) {
     CommitToVbo();
   }
@@ -498,44 +1152,94 @@ void DemoApp::StopPainting(bool commit_cur_segment) {
     CommitToVbo();
   }
   recent_geom_.clear();
+  recent_indices_.clear();
   recent_geom_vertex_count_ = 0;
   painting_ = false;
   has_continuation_ = false;
-  brush_stroke_total_vertices_ = 0;
+  brush_stroke_segment_count_ = 0;
 }
 
 void DemoApp::ClearDrawing() {
   for (auto it : committed_vbos_) {
-    glDeleteBuffers(1, &it.vbo);
+    gpu_memory_.DeleteBuffer(it.vbo);
+    gpu_memory_.DeleteBuffer(it.ibo);
+    impostor_dirty_faces_ |= it.impostor_faces;
   }
   committed_vbos_.clear();
+  impostor_valid_ = false;
 }
 
-void DemoApp::DrawObject(const gvr::Mat4f& mvp,
-                         const std::array<float, 4>& color, const float* data,
-                         GLuint vbo, int vertex_count) {
-  if (!data) {
+void DemoApp::TrimDrawing(size_t max_bytes) {
+  size_t bytes = gpu_memory_.GetLiveBytes(GpuMemoryTracker::kCategoryBuffer);
+  size_t trimmed = 0;
+  while (trimmed < committed_vbos_.size() && bytes > max_bytes) {
+    gpu_memory_.DeleteBuffer(committed_vbos_[trimmed].vbo);
+    gpu_memory_.DeleteBuffer(committed_vbos_[trimmed].ibo);
+    impostor_dirty_faces_ |= committed_vbos_[trimmed].impostor_faces;
+    impostor_valid_ = false;
+    bytes -= committed_vbos_[trimmed].bytes;
+    ++trimmed;
+  }
+  committed_vbos_.erase(committed_vbos_.begin(),
+                        committed_vbos_.begin() + trimmed);
+  LOGW("Deleted the %zu oldest paint VBOs to stay within the GPU budget.",
+       trimmed);
+}
+
+void DemoApp::QueueDraw(Material material, float view_depth,
+                        const gvr::Mat4f& mvp,
+                        const std::array<float, 4>& color, GLuint texture,
+                        const float* data, GLuint vbo,
+                        const uint16_t* indices, GLuint ibo,
+                        int index_count) {
+  draw_list_.push_back({material, view_depth, mvp, color, texture, data, vbo,
+                        indices, ibo, index_count});
+}
+
+void DemoApp::DrawObject(const ShaderProgram& shader, const DrawItem& item) {
+  if (!item.data) {
     // Use VBO.
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  }
-
-  glUniform1i(shader_u_sampler_, 0);  // texture unit 0
-  glUniformMatrix4fv(shader_u_mvp_matrix_, 1, GL_FALSE,
-                     Utils::MatrixToGLArray(mvp).data());
-  glUniform4f(shader_u_color_, color[0], color[1], color[2], color[3]);
-  glEnableVertexAttribArray(shader_a_position_);
-  glEnableVertexAttribArray(shader_a_texcoords_);
-  glVertexAttribPointer(shader_a_position_, 3, GL_FLOAT, false,
-                        kGeomDataStride, data);
-  glVertexAttribPointer(shader_a_texcoords_, 2, GL_FLOAT, false,
-                        kGeomDataStride, data + kGeomTexCoordOffset);
-  glDrawArrays(GL_TRIANGLES, 0, vertex_count);
-  glDisableVertexAttribArray(shader_a_position_);
-  glDisableVertexAttribArray(shader_a_texcoords_);
-
-  if (!data) {
+    glBindBuffer(GL_ARRAY_BUFFER, item.vbo);
+  }
+  if (!item.indices) {
+    // Use IBO.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, item.ibo);
+  }
+
+  glUniform1i(shader.u_sampler, 0);  // texture unit 0
+  // Programs that use uniform buffers have no such uniforms; FlushDraws()
+  // has bound their constants.
+  if (shader.u_mvp_matrix >= 0) {
+    glUniformMatrix4fv(shader.u_mvp_matrix, 1, GL_FALSE,
+                       Utils::MatrixToGLArray(item.mvp).data());
+  }
+  if (shader.u_color >= 0) {
+    const std::array<float, 4>& color = item.color;
+    glUniform4f(shader.u_color, color[0], color[1], color[2], color[3]);
+  }
+  glEnableVertexAttribArray(shader.a_position);
+  glVertexAttribPointer(shader.a_position, 3, GL_FLOAT, false,
+                        kGeomDataStride, item.data);
+  // The overdraw shader does not read texture coordinates, so the attribute
+  // may have been optimized out.
+  if (shader.a_texcoords >= 0) {
+    glEnableVertexAttribArray(shader.a_texcoords);
+    glVertexAttribPointer(shader.a_texcoords, 2, GL_FLOAT, false,
+                          kGeomDataStride, item.data + kGeomTexCoordOffset);
+  }
+  glDrawElements(GL_TRIANGLES, item.index_count, GL_UNSIGNED_SHORT,
+                 item.indices);
+  glDisableVertexAttribArray(shader.a_position);
+  if (shader.a_texcoords >= 0) {
+    glDisableVertexAttribArray(shader.a_texcoords);
+  }
+
+  if (!item.data) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
   }
+  if (!item.indices) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
 }
 
 void DemoApp::DrawGround(const gvr::Mat4f& view_matrix,
@@ -543,7 +1247,10 @@ void DemoApp::DrawGround(const gvr::Mat4f& view_matrix,
   gvr::Mat4f mv = Utils::MatrixMul(view_matrix, kGroundModelMatrix);
   gvr::Mat4f mvp = Utils::MatrixMul(proj_matrix, mv);
 
-  DrawObject(mvp, kGroundColor, kGroundGeom, 0, kGroundVertexCount);
+  // The ground is the only opaque draw, so its depth does not matter.
+  QueueDraw(MaterialForColor(kGroundColor), 0.0f, mvp, kGroundColor,
+            ground_texture_, kGroundGeom, 0, kQuadIndices, 0,
+            kQuadIndexCount);
 }
 
 void DemoApp::DrawPaintedGeometry(const gvr::Mat4f& view_matrix,
@@ -551,32 +1258,64 @@ void DemoApp::DrawPaintedGeometry(const gvr::Mat4f& view_matrix,
   gvr::Mat4f mv = view_matrix;
   gvr::Mat4f mvp = Utils::MatrixMul(proj_matrix, mv);
 
-  // Draw committed VBOs.
-  for (auto it : committed_vbos_) {
-    DrawObject(mvp, kColors[it.color], 0, it.vbo, it.vertex_count);
+  // Draw the stroke cache, with the eye at its center.
+  const bool use_impostor = kCacheCommittedStrokes && impostor_valid_;
+  if (use_impostor) {
+    gvr::Mat4f rotation = view_matrix;
+    rotation.m[0][3] = rotation.m[1][3] = rotation.m[2][3] = 0.0f;
+    QueueDraw(kMaterialCachedLayer, 0.0f,
+              Utils::MatrixMul(proj_matrix, rotation), kImpostorColor,
+              stroke_impostor_.GetTexture(), kImpostorCubeGeom, 0,
+              kImpostorCubeIndices, 0, kImpostorCubeIndexCount);
+  }
+
+  // Draw committed VBOs that are not in the cache yet.
+  for (const auto& it : committed_vbos_) {
+    if (use_impostor && it.in_impostor) continue;
+    const std::array<float, 4>& color = kColors[it.color];
+    QueueDraw(MaterialForColor(color), ViewDepth(view_matrix, it.center),
+              mvp, color, paint_texture_, 0, it.vbo, 0, it.ibo,
+              it.index_count);
   }
 
   // Draw recent geometry (directly from main memory).
-  if (recent_geom_vertex_count_ > 0) {
-    DrawObject(mvp, kColors[selected_color_], recent_geom_.data(), 0,
-               recent_geom_vertex_count_);
+  if (!recent_indices_.empty()) {
+    const std::array<float, 4>& color = kColors[selected_color_];
+    QueueDraw(MaterialForColor(color),
+              ViewDepth(view_matrix, GeometryCenter(recent_geom_)), mvp,
+              color, paint_texture_, recent_geom_.data(), 0,
+              recent_indices_.data(), 0, recent_indices_.size());
   }
 }
 
 void DemoApp::CommitToVbo() {
   // Only commit if we have at least a triangle.
-  if (recent_geom_vertex_count_ > 2) {
+  if (!recent_indices_.empty()) {
     VboInfo info;
-    glGenBuffers(1, &info.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, info.vbo);
-    glBufferData(GL_ARRAY_BUFFER, recent_geom_.size() * sizeof(float),
-                 recent_geom_.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    info.vertex_count = recent_geom_vertex_count_;
+    const size_t vertex_bytes = recent_geom_.size() * sizeof(float);
+    const size_t index_bytes = recent_indices_.size() * sizeof(uint16_t);
+    info.vbo = gpu_memory_.CreateBuffer(GL_ARRAY_BUFFER, vertex_bytes,
+                                        recent_geom_.data(), GL_STATIC_DRAW);
+    info.ibo = gpu_memory_.CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, index_bytes,
+                                        recent_indices_.data(),
+                                        GL_STATIC_DRAW);
+    info.index_count = recent_indices_.size();
     info.color = selected_color_;
+    info.bytes = vertex_bytes + index_bytes;
+    std::array<float, 3> min_coords;
+    std::array<float, 3> max_coords;
+    GeometryBounds(recent_geom_, &min_coords, &max_coords);
+    for (int k = 0; k < 3; ++k) {
+      info.center[k] = (min_coords[k] + max_coords[k]) * 0.5f;
+    }
+    info.impostor_faces =
+        CubemapImpostor::FacesTouchedBy(min_coords, max_coords);
+    info.in_impostor = false;
+    impostor_dirty_faces_ |= info.impostor_faces;
     committed_vbos_.push_back(info);
   }
   recent_geom_.clear();
+  recent_indices_.clear();
   recent_geom_vertex_count_ = 0;
 }
 
@@ -589,11 +1328,12 @@ void DemoApp::DrawCursorRect(float scale, const std::array<float, 4> color,
       0.0f,  0.0f, 0.0f, 1.0f,
   };
   gvr::Mat4f controller_matrix =
-      Utils::ControllerQuatToMatrix(controller_state_.GetOrientation());
+      Utils::ControllerQuatToMatrix(controller_orientation_);
   gvr::Mat4f model_matrix = Utils::MatrixMul(controller_matrix, neutral_matrix);
   gvr::Mat4f mv = Utils::MatrixMul(view_matrix, model_matrix);
   gvr::Mat4f mvp = Utils::MatrixMul(proj_matrix, mv);
-  DrawObject(mvp, color, kCursorGeom, 0, kCursorVertexCount);
+  QueueDraw(kMaterialOverlay, 0.0f, mvp, color, paint_texture_, kCursorGeom,
+            0, kQuadIndices, 0, kQuadIndexCount);
 }
 
 void DemoApp::DrawCursor(const gvr::Mat4f& view_matrix,
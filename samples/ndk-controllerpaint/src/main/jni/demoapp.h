@@ -17,15 +17,30 @@
 #ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_DEMOAPP_H_  // NOLINT
 #define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_DEMOAPP_H_
 
+#ifdef __ANDROID__
 #include <android/asset_manager.h>
-#include <GLES2/gl2.h>
 #include <jni.h>
+#endif  // #ifdef __ANDROID__
+#include <GLES2/gl2.h>
 
 #include <array>
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <memory>
 #include <vector>
 
+#include "asset_archive.h"  // NOLINT
+#include "choreographer_vsync.h"  // NOLINT
+#include "controller_fusion.h"  // NOLINT
+#include "cubemap_impostor.h"  // NOLINT
+#include "egl_fence.h"  // NOLINT
+#include "frame_acquirer.h"  // NOLINT
+#include "frame_limiter.h"  // NOLINT
+#include "frame_scheduler.h"  // NOLINT
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "hidden_area_mesh.h"  // NOLINT
+#include "overdraw_analyzer.h"  // NOLINT
+#include "uniform_ring_buffer.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
 #include "vr/gvr/capi/include/gvr_controller.h"
 
@@ -41,11 +56,17 @@
 // them together.
 class DemoApp {
  public:
+#ifdef __ANDROID__
   // Initializes the demo app.
   // |asset_manager| is the Android Asset Manager obtained from Java.
   // |gvr_context_ptr| a jlong representing a pointer to the GVR context
   //     obtained from Java.
   DemoApp(JNIEnv* env, jobject asset_manager, jlong gvr_context_ptr);
+#endif  // #ifdef __ANDROID__
+  // Initializes the demo app with the textures in |asset_archive|. Host
+  // builds, which have no asset manager, open the archive from a file.
+  DemoApp(gvr_context* gvr_context,
+          std::unique_ptr<AssetArchive> asset_archive);
   ~DemoApp();
   // Must be called when the Activity gets onResume().
   // Must be called on the UI thread.
@@ -62,8 +83,15 @@ class DemoApp {
   // Must be called when the GL renderer gets onDrawFrame().
   // Must be called on the rendering thread.
   void OnDrawFrame();
+  // Must be called for each Choreographer frame callback, with the vsync
+  // time and the refresh period of the display.
+  // Must be called on the UI thread.
+  void OnVsync(uint64_t frame_time_nanos, uint64_t period_nanos);
 
  private:
+  // Times the painting functions on the host, see tools/perf_suite.cc.
+  friend class DemoAppPeer;
+
   // Quick explanation of the implementation:
   //
   // When the user paints, we generate geometry (a series of connected
@@ -77,19 +105,105 @@ class DemoApp {
   // rendered quickly without us needing to push it down the bus from
   // CPU to GPU on every frame.
 
-  // Prepares the GvrApi framebuffer for rendering, resizing if needed.
+  // Resizes the GvrApi framebuffer if its recommended size changed. The frame
+  // that is already acquired keeps its size, so this is called after
+  // submitting.
   void PrepareFramebuffer();
 
+  // A linked shader program and the uniform/attrib locations in it. The
+  // locations are looked up after we compile/link the shader. Programs built
+  // for uniform buffers take u_Color and u_MVP from the DrawConstants block
+  // instead, so their locations are -1.
+  struct ShaderProgram {
+    int program;
+    int u_color;
+    int u_mvp_matrix;  // Model-view-projection matrix.
+    int u_sampler;
+    int a_position;
+    int a_texcoords;
+  };
+
+  // How a draw is combined with what is already in the framebuffer. Draws
+  // are rendered grouped by material, in this order.
+  enum Material {
+    // Covers what is behind it: no blending, depth test and depth writes.
+    // Drawn front to back.
+    kMaterialOpaque,
+    // Like kMaterialOpaque, but fragments with a low texture alpha are
+    // discarded.
+    kMaterialAlphaTested,
+    // The cached stroke layer: premultiplied alpha blending, no depth test
+    // and no depth writes. Occlusion by the ground is baked into it.
+    kMaterialCachedLayer,
+    // Translucent: blending and depth test, no depth writes. Drawn back to
+    // front.
+    kMaterialBlended,
+    // Drawn over everything else with blending and no depth test, in the
+    // order in which the draws were queued.
+    kMaterialOverlay,
+  };
+
+  // A queued draw of an indexed object, which may have its geometry and
+  // indices specified via regular pointers, or as VBO/IBO handles.
+  struct DrawItem {
+    Material material;
+    // Distance from the eye along the view axis, used for sorting.
+    float view_depth;
+    gvr::Mat4f mvp;  // Model-view-projection matrix.
+    std::array<float, 4> color;
+    GLuint texture;
+    // If non-NULL, points to the data to draw. Otherwise |vbo| is used.
+    const float* data;
+    GLuint vbo;
+    // If non-NULL, points to the 16-bit indices to draw. Otherwise |ibo| is
+    // used.
+    const uint16_t* indices;
+    GLuint ibo;
+    int index_count;
+  };
+
+  // Compiles and links a shader program and looks up its locations.
+  static ShaderProgram BuildShaderProgram(const char* vertex_source,
+                                          const char* fragment_source);
+
+  // Returns the material for a draw of the given color: opaque if the color
+  // has full alpha, blended otherwise.
+  static Material MaterialForColor(const std::array<float, 4>& color);
+
   // Draws the image for the indicated eye.
   void DrawEye(gvr::Eye which_eye, const gvr::Mat4f& eye_view_matrix,
                const gvr::BufferViewport& params);
 
+  // Draws the ground, the painted geometry and the cursor with |shader_|.
+  void DrawScene(const gvr::Mat4f& view_matrix, const gvr::Mat4f& proj_matrix);
+
+  // Renders and clears |draw_list_|, one material at a time.
+  void FlushDraws();
+
+  // Sets the blend and depth state for |material|. Blending is left alone
+  // while counting overdraw, as the counting pass relies on additive
+  // blending.
+  void SetMaterialState(Material material);
+
+  // Renders the faces of |stroke_impostor_| that committed strokes were
+  // added to or removed from since the last call.
+  void UpdateStrokeImpostor();
+
+  // Draws the left eye's view again with the overdraw counting shader and
+  // logs the resulting overdraw statistics.
+  void AnalyzeOverdraw(const gvr::Mat4f& eye_view_matrix,
+                       const gvr::BufferViewport& viewport);
+
+  // Sets |controller_orientation_| from |controller_state_|, which must have
+  // just been updated, fusing the raw sensor readings if enabled.
+  void UpdateControllerOrientation(int64_t display_time_nanos);
+
   // Draws the ground plane below the player.
   void DrawGround(const gvr::Mat4f& view_matrix, const gvr::Mat4f& proj_matrix);
 
   // Draws the cursor that indicates where the controller is pointing.
   // This method obtains the current cursor orientation from
-  // |controller_state_|, which is assumed to be up to date.
+  // |controller_orientation_|, which is assumed to be up to date.
   void DrawCursor(const gvr::Mat4f& view_matrix, const gvr::Mat4f& proj_matrix);
 
   // Draws a rectangle. The cursor is made of several rectangles.
@@ -112,11 +226,12 @@ class DemoApp {
   // create new geometry.
   void StopPainting(bool commit_cur_segment);
 
-  // Adds a single vertex to the geometry.
-  void AddVertex(const std::array<float, 3>& coords, float u, float v);
+  // Adds a single vertex to the geometry and returns its index.
+  uint16_t AddVertex(const std::array<float, 3>& coords, float u, float v);
 
   // Renders all the geometry the user painted, including the recent
-  // uncommitted geometry and the committed VBOs.
+  // uncommitted geometry and the committed VBOs. Committed VBOs that are
+  // cached in |stroke_impostor_| are drawn through it.
   void DrawPaintedGeometry(const gvr::Mat4f& view_matrix,
                            const gvr::Mat4f& proj_matrix);
 
@@ -126,17 +241,14 @@ class DemoApp {
   // normally.
   void CommitToVbo();
 
-  // Draws a single object, which may have its geometry specified via a regular
-  // pointer, or as a VBO handle.
-  //
-  // @param mvp The model-view-projection matrix to use.
-  // @param color The color to use.
-  // @param data If non-NULL, points to the data to draw.
-  //     If this is NULL, then this method will use a VBO to draw.
-  // @param vbo If data == NULL, this is the VBO to use.
-  // @param vertex_count The number of vertices to draw.
-  void DrawObject(const gvr::Mat4f& mvp, const std::array<float, 4>& color,
-                  const float* data, GLuint vbo, int vertex_count);
+  // Queues a single object to be drawn by FlushDraws(). See DrawItem.
+  void QueueDraw(Material material, float view_depth, const gvr::Mat4f& mvp,
+                 const std::array<float, 4>& color, GLuint texture,
+                 const float* data, GLuint vbo, const uint16_t* indices,
+                 GLuint ibo, int index_count);
+
+  // Draws a single object with |shader|. The texture must be bound to unit 0.
+  void DrawObject(const ShaderProgram& shader, const DrawItem& item);
 
   // Checks if the user performed the "switch color" gesture and switches
   // color, if applicable.
@@ -148,6 +260,17 @@ class DemoApp {
   // Clears the whole drawing.
   void ClearDrawing();
 
+  // Deletes the oldest committed VBOs until the committed geometry takes at
+  // most |max_bytes| of GPU memory. Called when the buffer budget is exceeded.
+  void TrimDrawing(size_t max_bytes);
+
+  // Moves one step down the render target quality ladder, if possible. Called
+  // when the swap chain budget is exceeded.
+  void LowerRenderQuality();
+
+  // Returns the framebuffer size for the current render quality.
+  gvr::Sizei GetRenderTargetSize();
+
   // Gvr API entry point.
   gvr_context* gvr_context_;
   std::unique_ptr<gvr::GvrApi> gvr_api_;
@@ -158,7 +281,7 @@ class DemoApp {
 
   // Handle to the swapchain. On every frame, we have to check if the buffers
   // are still the right size for the frame (since they can be resized at any
-  // time). This is done by PrepareFramebuffer().
+  // time). This is done by PrepareFramebuffer(), after each frame.
   std::unique_ptr<gvr::SwapChain> swapchain_;
 
   // List of rendering params (used to render each eye).
@@ -168,17 +291,76 @@ class DemoApp {
   // Size of the offscreen framebuffer.
   gvr::Sizei framebuf_size_;
 
+  // Index into the render target quality ladder (see kRenderScaleLadder).
+  int render_quality_;
+
+  // Accounts for the GPU memory used by VBOs, textures and the swapchain.
+  GpuMemoryTracker gpu_memory_;
+
+  // Acquires each frame from |swapchain_| within a time budget.
+  FrameAcquirer frame_acquirer_;
+
+  // Keeps the CPU from running more than kMaxFramesInFlight frames ahead of
+  // the GPU.
+  FrameLimiter frame_limiter_;
+  EglFence fence_;
+
+  // Delays the start of each frame so that it completes just before a vsync.
+  FrameScheduler frame_scheduler_;
+  ChoreographerVsync vsync_;
+
   // The shader we use to render our geometry. Since this is a very simple
-  // demo, we use only one shader.
-  int shader_;
+  // demo, we use only one shader, except when analyzing overdraw.
+  ShaderProgram paint_shader_;
+
+  // Variant of the paint shader for kMaterialAlphaTested.
+  ShaderProgram alpha_test_shader_;
+
+  // Shader for kMaterialCachedLayer, which samples |stroke_impostor_|.
+  ShaderProgram impostor_shader_;
+
+  // The overdraw counting shader. Only built if kAnalyzeOverdraw is true.
+  ShaderProgram overdraw_shader_;
+
+  // The shader that FlushDraws() draws with: |paint_shader_| (or
+  // |alpha_test_shader_| for alpha-tested draws), or |overdraw_shader_|
+  // for every draw while counting overdraw.
+  const ShaderProgram* shader_;
+
+  // Draws queued for the eye being rendered.
+  std::vector<DrawItem> draw_list_;
+
+  // If true, the context is OpenGL ES 3 and per-draw constants are uploaded
+  // through |uniform_ring_| rather than with glUniform*() calls.
+  bool use_uniform_buffers_;
 
-  // Uniform/attrib locations in the shader. These are looked up after we
-  // compile/link the shader.
-  int shader_u_color_;
-  int shader_u_mvp_matrix_;  // Model-view-projection matrix.
-  int shader_u_sampler_;
-  int shader_a_position_;
-  int shader_a_texcoords_;
+  // Holds the per-draw constants of the frames in flight when
+  // |use_uniform_buffers_| is true.
+  UniformRingBuffer uniform_ring_;
+
+  // Masks the parts of the eye buffers that the lenses never show.
+  HiddenAreaMesh hidden_area_;
+
+  // Measures overdraw when kAnalyzeOverdraw is true.
+  OverdrawAnalyzer overdraw_analyzer_;
+
+  // Frames left until the next overdraw analysis pass.
+  int frames_until_overdraw_pass_;
+
+  // Caches the committed strokes as seen from the origin, when
+  // kCacheCommittedStrokes is true.
+  CubemapImpostor stroke_impostor_;
+
+  // Faces of |stroke_impostor_| that must be rendered again.
+  int impostor_dirty_faces_;
+
+  // False if strokes were removed since |stroke_impostor_| was last updated,
+  // in which case it must not be drawn until it is.
+  bool impostor_valid_;
+
+  // True while UpdateStrokeImpostor() renders: the ground only writes depth,
+  // and blended draws accumulate premultiplied alpha.
+  bool rendering_impostor_;
 
   // Ground texture.
   int ground_texture_;
@@ -186,12 +368,19 @@ class DemoApp {
   // Paint texture. This is the texture we use for painting.
   int paint_texture_;
 
-  // Android asset manager (we use it to load the texture).
-  AAssetManager* asset_mgr_;
+  // Archive that holds the textures. It is mapped once and kept open so that
+  // the textures can be reloaded without reading them again when the surface
+  // is recreated.
+  std::unique_ptr<AssetArchive> asset_archive_;
 
   // The last controller state (updated once per frame).
   gvr::ControllerState controller_state_;
 
+  // Fuses the raw controller sensor readings, and the orientation of the
+  // controller for the current frame, predicted to its display time.
+  ControllerFusion controller_fusion_;
+  gvr::ControllerQuat controller_orientation_;
+
   // The vertex and texture coordinates representing recently painted geometry.
   // As this array grows beyond a certain limit, we commit that geometry
   // to a VBO for performance. This is formatted for rendering, with
@@ -199,13 +388,17 @@ class DemoApp {
   // vertex coordinates in world space and s,t are the texture coordinates.
   std::vector<float> recent_geom_;
 
+  // The triangles of the recently painted geometry, as indices into
+  // recent_geom_. Each segment adds two triangles.
+  std::vector<uint16_t> recent_indices_;
+
   // Count of vertices in recent_geom_.
   int recent_geom_vertex_count_;
 
-  // Total vertices in the current brush stroke (the brush
+  // Total segments in the current brush stroke (the brush
   // stroke starts when the user first touches the touchpad and continues
   // until they release it).
-  int brush_stroke_total_vertices_;
+  int brush_stroke_segment_count_;
 
   // Currently selected color (index).
   int selected_color_;
@@ -225,16 +418,31 @@ class DemoApp {
   // If has_continuation_ == true, these are the continuation points.
   std::array<std::array<float, 3>, 2> continuation_points_;
 
+  // Texture coordinate along the stroke at the continuation points.
+  float stroke_tex_u_;
+
   // This is the list of committed VBOs that contains the static parts
   // of the current drawing. As the drawing accumulates in painted_geom_,
   // we push it to a static VBO on the GPU for performance.
   struct VboInfo {
     GLuint vbo;
-    int vertex_count;
+    GLuint ibo;
+    int index_count;
     int color;
+    size_t bytes;
+    // Center of the bounding box of the geometry, for depth sorting.
+    std::array<float, 3> center;
+    // Faces of |stroke_impostor_| that may show the geometry.
+    int impostor_faces;
+    // True if |stroke_impostor_| contains the geometry.
+    bool in_impostor;
   };
   std::vector<VboInfo> committed_vbos_;
 
+  // Set by OnPause(), which runs on the UI thread, so that the rendering
+  // thread clears the drawing.
+  std::atomic<bool> clear_drawing_pending_;
+
   // Touchpad coordinates where touch started. We use this to detect
   // the swipe gestures that cause the drawing color to change.
   float touch_down_x_;
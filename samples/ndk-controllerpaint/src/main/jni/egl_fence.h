@@ -0,0 +1,57 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_EGLFENCE_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_EGLFENCE_H_  // NOLINT
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "frame_limiter.h"  // NOLINT
+
+/**
+ * GpuFence implemented with EGL_KHR_fence_sync, which is available with
+ * OpenGL ES 2 contexts too.
+ */
+class EglFence : public GpuFence {
+ public:
+  EglFence();
+
+  /**
+   * Look up the fence functions for the current display. Must be called on
+   * the rendering thread with a current EGL context. Returns false if
+   * EGL_KHR_fence_sync is not supported, in which case Insert() returns
+   * null.
+   */
+  bool InitializeGl();
+
+  Handle Insert() override;
+  bool Wait(Handle fence, uint64_t timeout_nanos) override;
+  void Delete(Handle fence) override;
+
+ private:
+  EGLDisplay display_;
+  PFNEGLCREATESYNCKHRPROC create_sync_;
+  PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync_;
+  PFNEGLDESTROYSYNCKHRPROC destroy_sync_;
+
+  // Disallow copy and assign.
+  EglFence(const EglFence& other) = delete;
+  EglFence& operator=(const EglFence& other) = delete;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_EGLFENCE_H_  // NOLINT
@@ -0,0 +1,103 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_acquirer.h"  // NOLINT
+
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+
+namespace {
+// Time to sleep between acquisition attempts under kPolicyWait.
+static const std::chrono::microseconds kRetrySleep(500);
+
+static uint64_t NowNanos() {
+  return static_cast<uint64_t>(
+      gvr::GvrApi::GetTimePointNow().monotonic_system_time_nanos);
+}
+}  // anonymous namespace
+
+FrameAcquirer::FrameAcquirer(gvr::GvrApi* gvr_api, Policy policy,
+                             uint64_t wait_budget_nanos)
+    : gvr_api_(gvr_api),
+      policy_(policy),
+      wait_budget_nanos_(wait_budget_nanos),
+      frames_acquired_(0),
+      frames_late_(0),
+      frames_dropped_(0),
+      total_wait_nanos_(0),
+      max_wait_nanos_(0) {}
+
+gvr::Frame FrameAcquirer::AcquireFrame(gvr::SwapChain* swapchain) {
+  gvr::Frame frame = swapchain->AcquireFrame();
+  if (frame) {
+    ++frames_acquired_;
+    return frame;
+  }
+
+  // No frame was available. Clear the sticky error so that it does not mask
+  // later errors, then retry as allowed by the policy.
+  const uint64_t start_nanos = NowNanos();
+  uint64_t waited_nanos = 0;
+  while (!frame && policy_ != kPolicySkip &&
+         waited_nanos < wait_budget_nanos_) {
+    if (gvr_api_->GetError() == gvr::kErrorNoFrameAvailable) {
+      gvr_api_->ClearError();
+    }
+    if (policy_ == kPolicyWait) {
+      std::this_thread::sleep_for(kRetrySleep);
+    }
+    frame = swapchain->AcquireFrame();
+    waited_nanos = NowNanos() - start_nanos;
+  }
+  if (gvr_api_->GetError() == gvr::kErrorNoFrameAvailable) {
+    gvr_api_->ClearError();
+  }
+
+  RecordWait(waited_nanos);
+  if (frame) {
+    ++frames_acquired_;
+    ++frames_late_;
+  } else {
+    ++frames_dropped_;
+  }
+  return frame;
+}
+
+FrameStats FrameAcquirer::GetStats() const {
+  FrameStats stats;
+  stats.frames_acquired = frames_acquired_.load();
+  stats.frames_late = frames_late_.load();
+  stats.frames_dropped = frames_dropped_.load();
+  stats.total_wait_nanos = total_wait_nanos_.load();
+  stats.max_wait_nanos = max_wait_nanos_.load();
+  return stats;
+}
+
+void FrameAcquirer::ResetStats() {
+  frames_acquired_ = 0;
+  frames_late_ = 0;
+  frames_dropped_ = 0;
+  total_wait_nanos_ = 0;
+  max_wait_nanos_ = 0;
+}
+
+void FrameAcquirer::RecordWait(uint64_t wait_nanos) {
+  total_wait_nanos_ += wait_nanos;
+  // RecordWait() is never called concurrently with itself, so the maximum
+  // needs no compare-and-swap loop.
+  if (wait_nanos > max_wait_nanos_.load()) {
+    max_wait_nanos_ = wait_nanos;
+  }
+}
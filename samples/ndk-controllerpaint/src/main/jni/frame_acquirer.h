@@ -0,0 +1,104 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_FRAMEACQUIRER_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_FRAMEACQUIRER_H_  // NOLINT
+
+#include <atomic>
+#include <cstdint>
+
+#include "vr/gvr/capi/include/gvr.h"
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * Counters describing how frame acquisition has gone so far. A frame is
+ * "late" if it was only obtained after one or more retries, and "dropped" if
+ * the wait budget ran out before the swap chain had a frame available.
+ */
+struct FrameStats {
+  uint64_t frames_acquired;
+  uint64_t frames_late;
+  uint64_t frames_dropped;
+  uint64_t total_wait_nanos;
+  uint64_t max_wait_nanos;
+};
+
+/**
+ * Acquires frames from a gvr::SwapChain according to a simple retry policy,
+ * and keeps track of the frames that could not be acquired in time.
+ *
+ * AcquireFrame() must be called on the rendering thread. GetStats() and
+ * ResetStats() may be called from any thread.
+ */
+class FrameAcquirer {
+ public:
+  enum Policy {
+    // Return immediately if no frame is available.
+    kPolicySkip,
+    // Retry, sleeping between attempts, until the wait budget is spent.
+    kPolicyWait,
+    // Retry without sleeping until the wait budget is spent.
+    kPolicySpin,
+  };
+
+  /**
+   * Create a FrameAcquirer.
+   *
+   * @param gvr_api The (non-owned) GvrApi, used to read and clear the
+   *     GVR_ERROR_NO_FRAME_AVAILABLE error state.
+   * @param policy What to do when no frame is immediately available.
+   * @param wait_budget_nanos Maximum time to spend retrying per frame.
+   */
+  FrameAcquirer(gvr::GvrApi* gvr_api, Policy policy,
+                uint64_t wait_budget_nanos);
+
+  /**
+   * Try to acquire a frame from |swapchain|. The returned frame must be
+   * checked for validity; an invalid frame means the frame was dropped and
+   * no rendering work should be done for it.
+   */
+  gvr::Frame AcquireFrame(gvr::SwapChain* swapchain);
+
+  /**
+   * Return a snapshot of the acquisition counters.
+   */
+  FrameStats GetStats() const;
+
+  /**
+   * Reset all acquisition counters to zero.
+   */
+  void ResetStats();
+
+ private:
+  void RecordWait(uint64_t wait_nanos);
+
+  gvr::GvrApi* gvr_api_;
+  const Policy policy_;
+  const uint64_t wait_budget_nanos_;
+
+  std::atomic<uint64_t> frames_acquired_;
+  std::atomic<uint64_t> frames_late_;
+  std::atomic<uint64_t> frames_dropped_;
+  std::atomic<uint64_t> total_wait_nanos_;
+  std::atomic<uint64_t> max_wait_nanos_;
+
+  // Disallow copy and assign.
+  FrameAcquirer(const FrameAcquirer& other) = delete;
+  FrameAcquirer& operator=(const FrameAcquirer& other) = delete;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_FRAMEACQUIRER_H_  // NOLINT
@@ -0,0 +1,139 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_limiter.h"  // NOLINT
+
+#include <chrono>  // NOLINT
+#include <utility>
+
+namespace {
+static uint64_t SteadyNowNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+}  // anonymous namespace
+
+FrameLimiter::FrameLimiter(int max_frames_in_flight, Policy policy,
+                           uint64_t wait_budget_nanos)
+    : max_frames_in_flight_(max_frames_in_flight),
+      policy_(policy),
+      wait_budget_nanos_(wait_budget_nanos),
+      fence_(nullptr),
+      clock_(SteadyNowNanos),
+      frames_completed_(0),
+      frames_limited_(0),
+      total_wait_nanos_(0),
+      max_wait_nanos_(0),
+      total_lag_nanos_(0),
+      max_lag_nanos_(0),
+      frames_untracked_(0) {}
+
+void FrameLimiter::SetFence(GpuFence* fence) {
+  fence_ = fence;
+  pending_.clear();
+}
+
+bool FrameLimiter::BeginFrame() {
+  if (!fence_) return true;
+
+  // Retire the frames that the GPU has finished, oldest first.
+  while (!pending_.empty() && fence_->Wait(pending_.front().fence, 0)) {
+    RetireFrame(clock_());
+  }
+  if (static_cast<int>(pending_.size()) < max_frames_in_flight_) {
+    return true;
+  }
+
+  ++frames_limited_;
+  if (policy_ == kPolicySkip) return false;
+
+  // Wait for the oldest frames until we are under the limit or out of
+  // budget.
+  const uint64_t start_nanos = clock_();
+  uint64_t waited_nanos = 0;
+  while (static_cast<int>(pending_.size()) >= max_frames_in_flight_ &&
+         waited_nanos < wait_budget_nanos_) {
+    const bool signaled = fence_->Wait(pending_.front().fence,
+                                       wait_budget_nanos_ - waited_nanos);
+    waited_nanos = clock_() - start_nanos;
+    if (!signaled) break;
+    RetireFrame(start_nanos + waited_nanos);
+  }
+  total_wait_nanos_ += waited_nanos;
+  UpdateMax(&max_wait_nanos_, waited_nanos);
+  return static_cast<int>(pending_.size()) < max_frames_in_flight_;
+}
+
+void FrameLimiter::EndFrame() {
+  if (!fence_) return;
+  const GpuFence::Handle fence = fence_->Insert();
+  if (!fence) return;
+  // A frame may be submitted over the limit, when BeginFrame() returned
+  // false. Stop tracking the oldest frame then, so that the queue of fences
+  // stays bounded however long the GPU falls behind.
+  if (static_cast<int>(pending_.size()) >= max_frames_in_flight_) {
+    fence_->Delete(pending_.front().fence);
+    pending_.pop_front();
+    ++frames_untracked_;
+  }
+  pending_.push_back({fence, clock_()});
+}
+
+int FrameLimiter::GetFramesInFlight() const {
+  return static_cast<int>(pending_.size());
+}
+
+FrameLatencyStats FrameLimiter::GetStats() const {
+  FrameLatencyStats stats;
+  stats.frames_completed = frames_completed_.load();
+  stats.frames_limited = frames_limited_.load();
+  stats.total_wait_nanos = total_wait_nanos_.load();
+  stats.max_wait_nanos = max_wait_nanos_.load();
+  stats.total_lag_nanos = total_lag_nanos_.load();
+  stats.max_lag_nanos = max_lag_nanos_.load();
+  stats.frames_untracked = frames_untracked_.load();
+  return stats;
+}
+
+void FrameLimiter::ResetStats() {
+  frames_completed_ = 0;
+  frames_limited_ = 0;
+  total_wait_nanos_ = 0;
+  max_wait_nanos_ = 0;
+  total_lag_nanos_ = 0;
+  max_lag_nanos_ = 0;
+  frames_untracked_ = 0;
+}
+
+void FrameLimiter::SetClock(std::function<uint64_t()> clock) {
+  clock_ = std::move(clock);
+}
+
+void FrameLimiter::RetireFrame(uint64_t now_nanos) {
+  const PendingFrame& frame = pending_.front();
+  const uint64_t lag_nanos =
+      now_nanos > frame.submit_nanos ? now_nanos - frame.submit_nanos : 0;
+  fence_->Delete(frame.fence);
+  pending_.pop_front();
+  ++frames_completed_;
+  total_lag_nanos_ += lag_nanos;
+  UpdateMax(&max_lag_nanos_, lag_nanos);
+}
+
+void FrameLimiter::UpdateMax(std::atomic<uint64_t>* max, uint64_t value) {
+  if (value > max->load()) *max = value;
+}
@@ -0,0 +1,175 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_FRAMELIMITER_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_FRAMELIMITER_H_  // NOLINT
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/**
+ * GPU fences, as used by FrameLimiter. Implemented with EGL fence syncs on
+ * the device (see EglFence); a stub implementation lets FrameLimiter run
+ * without a GPU.
+ */
+class GpuFence {
+ public:
+  typedef void* Handle;
+
+  virtual ~GpuFence() {}
+
+  /**
+   * Insert a fence after the commands issued so far, and return it, or null
+   * if fences are not supported.
+   */
+  virtual Handle Insert() = 0;
+
+  /**
+   * Wait up to |timeout_nanos| for |fence| to be signaled. A timeout of zero
+   * only polls. Returns true if the fence is signaled.
+   */
+  virtual bool Wait(Handle fence, uint64_t timeout_nanos) = 0;
+
+  /**
+   * Delete |fence|.
+   */
+  virtual void Delete(Handle fence) = 0;
+};
+
+/**
+ * Counters describing how far the CPU ran ahead of the GPU. The lag of a
+ * frame is the time between its submission and the first time the CPU saw
+ * that the GPU had finished it. Fences are polled once per frame, so the lag
+ * is an upper bound, with a resolution of about a frame. Frames that were
+ * no longer tracked when they finished (see FrameLimiter::EndFrame()) only
+ * count in |frames_untracked|.
+ */
+struct FrameLatencyStats {
+  uint64_t frames_completed;
+  uint64_t frames_limited;
+  uint64_t total_wait_nanos;
+  uint64_t max_wait_nanos;
+  uint64_t total_lag_nanos;
+  uint64_t max_lag_nanos;
+  uint64_t frames_untracked;
+};
+
+/**
+ * Limits the number of frames that the GPU has not finished yet, so that the
+ * driver cannot queue several frames of work, each of which adds to the
+ * latency between head pose sampling and display.
+ *
+ * BeginFrame() and EndFrame() must be called on the rendering thread.
+ * GetStats() and ResetStats() may be called from any thread.
+ */
+class FrameLimiter {
+ public:
+  enum Policy {
+    // Report that too many frames are in flight, so that the caller can skip
+    // work that is not needed for this frame.
+    kPolicySkip,
+    // Wait, up to the wait budget, for the oldest frame to finish.
+    kPolicyWait,
+  };
+
+  /**
+   * Create a FrameLimiter.
+   *
+   * @param max_frames_in_flight Number of submitted frames that the GPU may
+   *     not have finished when a new frame begins.
+   * @param policy What to do when that number is reached.
+   * @param wait_budget_nanos Maximum time to wait per frame under
+   *     kPolicyWait.
+   */
+  FrameLimiter(int max_frames_in_flight, Policy policy,
+               uint64_t wait_budget_nanos);
+
+  /**
+   * Set the (non-owned) fences to use, or null to disable limiting. Any
+   * outstanding fences are forgotten, so this must also be called when the
+   * GL context is recreated.
+   */
+  void SetFence(GpuFence* fence);
+
+  /**
+   * Call before sampling the head pose of a new frame. Returns true if fewer
+   * than max_frames_in_flight frames are still being processed by the GPU.
+   */
+  bool BeginFrame();
+
+  /**
+   * Call right after a frame has been submitted. If max_frames_in_flight
+   * frames are already in flight, the oldest one is no longer tracked.
+   */
+  void EndFrame();
+
+  /**
+   * Return the number of submitted frames that the GPU was not known to
+   * have finished at the last BeginFrame() or EndFrame(), at most
+   * max_frames_in_flight.
+   */
+  int GetFramesInFlight() const;
+
+  /**
+   * Return a snapshot of the latency counters.
+   */
+  FrameLatencyStats GetStats() const;
+
+  /**
+   * Reset all latency counters to zero.
+   */
+  void ResetStats();
+
+  /**
+   * Override the clock, in nanoseconds, e.g. to run with a stub fence.
+   */
+  void SetClock(std::function<uint64_t()> clock);
+
+ private:
+  struct PendingFrame {
+    GpuFence::Handle fence;
+    uint64_t submit_nanos;
+  };
+
+  void RetireFrame(uint64_t now_nanos);
+  // Only called on the rendering thread, the only writer of the maxima, so
+  // a plain compare and store is enough.
+  static void UpdateMax(std::atomic<uint64_t>* max, uint64_t value);
+
+  const int max_frames_in_flight_;
+  const Policy policy_;
+  const uint64_t wait_budget_nanos_;
+  GpuFence* fence_;
+  std::function<uint64_t()> clock_;
+  std::deque<PendingFrame> pending_;
+
+  std::atomic<uint64_t> frames_completed_;
+  std::atomic<uint64_t> frames_limited_;
+  std::atomic<uint64_t> total_wait_nanos_;
+  std::atomic<uint64_t> max_wait_nanos_;
+  std::atomic<uint64_t> total_lag_nanos_;
+  std::atomic<uint64_t> max_lag_nanos_;
+  std::atomic<uint64_t> frames_untracked_;
+
+  // Disallow copy and assign.
+  FrameLimiter(const FrameLimiter& other) = delete;
+  FrameLimiter& operator=(const FrameLimiter& other) = delete;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_FRAMELIMITER_H_  // NOLINT
@@ -0,0 +1,192 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_FRAMESCHEDULER_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_FRAMESCHEDULER_H_  // NOLINT
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "frame_limiter.h"  // NOLINT
+
+/**
+ * Source of display vsync timing, as used by FrameScheduler. Implemented with
+ * Choreographer callbacks on the device (see ChoreographerVsync); a simulated
+ * display lets FrameScheduler run on a host.
+ */
+class VsyncProvider {
+ public:
+  virtual ~VsyncProvider() {}
+
+  /**
+   * Return the time of a recent vsync and the refresh period, both in
+   * nanoseconds of CLOCK_MONOTONIC. Returns false if no timing is known yet.
+   */
+  virtual bool GetVsync(uint64_t* vsync_nanos,
+                        uint64_t* period_nanos) const = 0;
+};
+
+/**
+ * Counters describing how well frames were scheduled against vsync. The
+ * latency of a frame is the time between the start of its work, when the
+ * head pose is sampled, and its predicted display time.
+ */
+struct FrameScheduleStats {
+  uint64_t frames_scheduled;
+  uint64_t deadlines_missed;
+  uint64_t total_delay_nanos;
+  uint64_t total_latency_nanos;
+  uint64_t max_latency_nanos;
+};
+
+/**
+ * Delays the start of each frame so that its work completes just before a
+ * vsync deadline, rather than as soon as the renderer is called. Starting
+ * later shortens the time between sampling the head pose and displaying the
+ * frame.
+ *
+ * The cost of a frame is measured from the start of its work until the GPU
+ * has finished it, and the largest cost of the last kCostWindow frames is used
+ * as the estimate for the next frame. The rendering thread never waits for
+ * the GPU: the fence of a frame is only waited on while a later frame sleeps
+ * until its start, so its cost is sampled when a later frame begins. If the
+ * GPU had already finished by then, the cost is counted up to that point,
+ * which overestimates it. Without vsync timing the scheduler does not delay
+ * frames, and predicts a fixed time ahead.
+ *
+ * BeginFrame() and EndFrame() must be called on the rendering thread.
+ * GetStats() and ResetStats() may be called from any thread.
+ */
+class FrameScheduler {
+ public:
+  /**
+   * Create a FrameScheduler.
+   *
+   * @param safety_margin_nanos Time to leave between the estimated end of a
+   *     frame and its deadline, to absorb oversleeping and cost spikes.
+   * @param fallback_prediction_nanos How far ahead to predict the display
+   *     time when there is no vsync timing.
+   */
+  FrameScheduler(uint64_t safety_margin_nanos,
+                 uint64_t fallback_prediction_nanos);
+
+  /**
+   * Set the (non-owned) vsync source, or null to stop delaying frames.
+   */
+  void SetVsyncProvider(VsyncProvider* vsync);
+
+  /**
+   * Set the (non-owned) fences used to find out when the GPU has finished a
+   * frame, or null to measure only the CPU cost of frames. A pending fence is
+   * forgotten, so this must also be called when the GL context is recreated.
+   */
+  void SetFence(GpuFence* fence);
+
+  /**
+   * Wait until it is time to start the work of a new frame, then return the
+   * time, in nanoseconds of CLOCK_MONOTONIC, at which the frame is expected
+   * to be displayed. Call right before sampling the head pose.
+   */
+  uint64_t BeginFrame();
+
+  /**
+   * Call right after a frame has been submitted. If fences are set, inserts
+   * one to find out later when the GPU finishes the frame. Never waits.
+   */
+  void EndFrame();
+
+  /**
+   * Call instead of EndFrame() when the frame begun is not submitted, e.g.
+   * because no swap chain buffer was available. The frame is neither
+   * counted nor sampled for its cost.
+   */
+  void AbortFrame();
+
+  /**
+   * Return the current estimate of the cost of a frame, in nanoseconds.
+   */
+  uint64_t GetFrameCostEstimate() const;
+
+  /**
+   * Return a snapshot of the scheduling counters.
+   */
+  FrameScheduleStats GetStats() const;
+
+  /**
+   * Reset all scheduling counters to zero.
+   */
+  void ResetStats();
+
+  /**
+   * Override the clock, in nanoseconds of CLOCK_MONOTONIC, and the function
+   * used to sleep, e.g. to run against a simulated display.
+   */
+  void SetClock(std::function<uint64_t()> clock,
+                std::function<void(uint64_t)> sleep);
+
+ private:
+  static const int kCostWindow = 16;
+  // Frames whose fence is kept at most; older frames are sampled as still
+  // running.
+  static const int kMaxPendingFrames = 3;
+
+  void RetireFrame(uint64_t start_nanos, uint64_t end_nanos,
+                   uint64_t deadline_nanos);
+  void PollPendingFrames(uint64_t timeout_nanos);
+  void AddCostSample(uint64_t cost_nanos);
+
+  const uint64_t safety_margin_nanos_;
+  const uint64_t fallback_prediction_nanos_;
+  VsyncProvider* vsync_;
+  GpuFence* fence_;
+  std::function<uint64_t()> clock_;
+  std::function<void(uint64_t)> sleep_;
+
+  uint64_t cost_samples_[kCostWindow];
+  int next_cost_sample_;
+  uint64_t cost_estimate_nanos_;
+
+  // The frame in progress. |deadline_nanos_| is zero if it was not scheduled
+  // against vsync. Its delay and latency are only counted once it ends.
+  uint64_t start_nanos_;
+  uint64_t deadline_nanos_;
+  uint64_t delay_nanos_;
+  uint64_t latency_nanos_;
+
+  // Frames submitted that the GPU is not known to have finished, oldest
+  // first.
+  struct PendingFrame {
+    GpuFence::Handle fence;
+    uint64_t start_nanos;
+    uint64_t deadline_nanos;
+  };
+  std::deque<PendingFrame> pending_;
+
+  std::atomic<uint64_t> frames_scheduled_;
+  std::atomic<uint64_t> deadlines_missed_;
+  std::atomic<uint64_t> total_delay_nanos_;
+  std::atomic<uint64_t> total_latency_nanos_;
+  std::atomic<uint64_t> max_latency_nanos_;
+
+  // Disallow copy and assign.
+  FrameScheduler(const FrameScheduler& other) = delete;
+  FrameScheduler& operator=(const FrameScheduler& other) = delete;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_FRAMESCHEDULER_H_  // NOLINT
@@ -0,0 +1,249 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hidden_area_mesh.h"  // NOLINT
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "logging.h"  // NOLINT
+
+namespace {
+// Draws the mask at the near plane, so that everything behind it fails the
+// depth test.
+static const char* kMaskShaderVp = R"glsl(
+    attribute vec2 a_Position;
+
+    void main() {
+      gl_Position = vec4(a_Position * 2.0 - 1.0, -1.0, 1.0);
+    })glsl";
+
+static const char* kMaskShaderFp = R"glsl(
+    precision lowp float;
+
+    void main() {
+      gl_FragColor = vec4(0.0);
+    })glsl";
+
+// Relative distance by which the mask is pushed away from the center.
+static const float kMargin = 0.01f;
+
+// Sides of the unit square.
+enum Side { kSideLeft, kSideRight, kSideBottom, kSideTop };
+
+// Returns the side of the unit square that |point|, which lies on its
+// boundary, is on.
+static Side SideOf(const gvr::Vec2f& point) {
+  const float distances[4] = {point.x, 1.0f - point.x, point.y,
+                              1.0f - point.y};
+  return static_cast<Side>(std::min_element(distances, distances + 4) -
+                           distances);
+}
+
+static bool IsVertical(Side side) {
+  return side == kSideLeft || side == kSideRight;
+}
+
+// Returns the point of the boundary of the unit square at |position| in
+// [0, 4), going counterclockwise from the lower left corner.
+static gvr::Vec2f BoundaryPoint(float position) {
+  const int side = static_cast<int>(position);
+  const float f = position - side;
+  switch (side) {
+    case 0:
+      return {f, 0.0f};
+    case 1:
+      return {1.0f, f};
+    case 2:
+      return {1.0f - f, 1.0f};
+    default:
+      return {0.0f, 1.0f - f};
+  }
+}
+
+// Returns the largest t such that |origin| + t * |direction| is in the unit
+// square. |origin| must be in the square.
+static float RayExit(const gvr::Vec2f& origin, const gvr::Vec2f& direction) {
+  float t = INFINITY;
+  if (direction.x > 0.0f) t = std::min(t, (1.0f - origin.x) / direction.x);
+  if (direction.x < 0.0f) t = std::min(t, -origin.x / direction.x);
+  if (direction.y > 0.0f) t = std::min(t, (1.0f - origin.y) / direction.y);
+  if (direction.y < 0.0f) t = std::min(t, -origin.y / direction.y);
+  return t;
+}
+
+static void AddTriangle(const gvr::Vec2f& a, const gvr::Vec2f& b,
+                        const gvr::Vec2f& c, std::vector<float>* mesh) {
+  mesh->insert(mesh->end(), {a.x, a.y, b.x, b.y, c.x, c.y});
+}
+
+static bool SamePoint(const gvr::Vec2f& a, const gvr::Vec2f& b) {
+  return fabsf(a.x - b.x) < 1e-6f && fabsf(a.y - b.y) < 1e-6f;
+}
+
+static int CompileShader(int type, const char* source) {
+  const int shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  int status;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  CHECK(status != 0);
+  return shader;
+}
+}  // anonymous namespace
+
+HiddenAreaMesh::HiddenAreaMesh() : program_(0), position_param_(-1) {
+  Invalidate();
+}
+
+void HiddenAreaMesh::InitializeGl() {
+  const int vertex_shader = CompileShader(GL_VERTEX_SHADER, kMaskShaderVp);
+  const int fragment_shader =
+      CompileShader(GL_FRAGMENT_SHADER, kMaskShaderFp);
+  program_ = glCreateProgram();
+  glAttachShader(program_, vertex_shader);
+  glAttachShader(program_, fragment_shader);
+  glLinkProgram(program_);
+  int status;
+  glGetProgramiv(program_, GL_LINK_STATUS, &status);
+  CHECK(status != 0);
+  // The linked program no longer needs the shaders.
+  glDetachShader(program_, vertex_shader);
+  glDetachShader(program_, fragment_shader);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  position_param_ = glGetAttribLocation(program_, "a_Position");
+  CHECK(glGetError() == GL_NO_ERROR);
+}
+
+void HiddenAreaMesh::Invalidate() {
+  for (EyeMask& mask : masks_) {
+    mask.valid = false;
+    mask.hidden_fraction = 0.0f;
+  }
+}
+
+void HiddenAreaMesh::Update(gvr::GvrApi* gvr_api, gvr::Eye eye,
+                            const gvr::Rectf& fov) {
+  const std::string viewer_model = gvr_api->GetViewerModel();
+  if (viewer_model != viewer_model_) {
+    viewer_model_ = viewer_model;
+    Invalidate();
+  }
+  EyeMask& mask = masks_[eye == GVR_LEFT_EYE ? 0 : 1];
+  if (mask.valid && mask.fov.left == fov.left && mask.fov.right == fov.right &&
+      mask.fov.bottom == fov.bottom && mask.fov.top == fov.top) {
+    return;
+  }
+
+  // Because of chromatic aberration, each channel shows a slightly different
+  // area. Keep the one that reaches the farthest from the center.
+  const gvr::Vec2f center =
+      gvr_api->ComputeDistortedPoint(eye, {0.5f, 0.5f})[1];
+  mask.vertices = BuildMesh([gvr_api, eye, &center](const gvr::Vec2f& uv) {
+    const std::array<gvr::Vec2f, 3> channels =
+        gvr_api->ComputeDistortedPoint(eye, uv);
+    gvr::Vec2f farthest = channels[0];
+    float farthest_distance = -1.0f;
+    for (const gvr::Vec2f& point : channels) {
+      const float dx = point.x - center.x;
+      const float dy = point.y - center.y;
+      if (dx * dx + dy * dy > farthest_distance) {
+        farthest_distance = dx * dx + dy * dy;
+        farthest = point;
+      }
+    }
+    return farthest;
+  });
+  mask.fov = fov;
+  mask.valid = true;
+  mask.hidden_fraction = MeshArea(mask.vertices);
+  LOGD("HiddenAreaMesh: %s eye mask has %zu triangles, hides %.1f%%.",
+       eye == GVR_LEFT_EYE ? "left" : "right", mask.vertices.size() / 6,
+       100.0f * mask.hidden_fraction);
+}
+
+void HiddenAreaMesh::Draw(gvr::Eye eye) const {
+  const EyeMask& mask = masks_[eye == GVR_LEFT_EYE ? 0 : 1];
+  if (!mask.valid || mask.vertices.empty()) return;
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glUseProgram(program_);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glVertexAttribPointer(position_param_, 2, GL_FLOAT, GL_FALSE, 0,
+                        mask.vertices.data());
+  glEnableVertexAttribArray(position_param_);
+  glDrawArrays(GL_TRIANGLES, 0, mask.vertices.size() / 2);
+  glDisableVertexAttribArray(position_param_);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+float HiddenAreaMesh::GetHiddenFraction(gvr::Eye eye) const {
+  return masks_[eye == GVR_LEFT_EYE ? 0 : 1].hidden_fraction;
+}
+
+std::vector<float> HiddenAreaMesh::BuildMesh(
+    const DistortionFunction& distort) {
+  // The area that is shown is the image of the boundary of the screen, which
+  // is star-shaped around the image of the center of the screen. Cast a ray
+  // from that center through the image of each boundary point; what lies on
+  // the ray beyond that point, up to the edge of the viewport, is hidden.
+  const gvr::Vec2f center = distort({0.5f, 0.5f});
+  std::vector<gvr::Vec2f> inner(kBoundarySamples);
+  std::vector<gvr::Vec2f> outer(kBoundarySamples);
+  for (int i = 0; i < kBoundarySamples; ++i) {
+    const gvr::Vec2f shown =
+        distort(BoundaryPoint(4.0f * i / kBoundarySamples));
+    const gvr::Vec2f direction = {shown.x - center.x, shown.y - center.y};
+    const float exit = RayExit(center, direction);
+    // The margin keeps the chords between samples outside of the area shown.
+    const float t = std::min(1.0f + kMargin, exit);
+    inner[i] = {center.x + t * direction.x, center.y + t * direction.y};
+    outer[i] = {center.x + exit * direction.x, center.y + exit * direction.y};
+  }
+
+  std::vector<float> mesh;
+  for (int i = 0; i < kBoundarySamples; ++i) {
+    const int j = (i + 1) % kBoundarySamples;
+    if (!SamePoint(inner[i], outer[i]) || !SamePoint(inner[j], outer[j])) {
+      AddTriangle(inner[i], outer[i], outer[j], &mesh);
+      AddTriangle(inner[i], outer[j], inner[j], &mesh);
+    }
+    // Fill the corner of the viewport between two rays that exit through
+    // adjacent sides, unless what is shown reaches the edge there.
+    const Side side_i = SideOf(outer[i]);
+    const Side side_j = SideOf(outer[j]);
+    if (IsVertical(side_i) != IsVertical(side_j) &&
+        !SamePoint(inner[i], outer[i]) && !SamePoint(inner[j], outer[j])) {
+      const Side vertical = IsVertical(side_i) ? side_i : side_j;
+      const Side horizontal = IsVertical(side_i) ? side_j : side_i;
+      const gvr::Vec2f corner = {vertical == kSideLeft ? 0.0f : 1.0f,
+                                 horizontal == kSideBottom ? 0.0f : 1.0f};
+      AddTriangle(outer[i], corner, outer[j], &mesh);
+    }
+  }
+  return mesh;
+}
+
+float HiddenAreaMesh::MeshArea(const std::vector<float>& mesh) {
+  float area = 0.0f;
+  for (size_t i = 0; i + 6 <= mesh.size(); i += 6) {
+    const float cross = (mesh[i + 2] - mesh[i]) * (mesh[i + 5] - mesh[i + 1]) -
+                        (mesh[i + 4] - mesh[i]) * (mesh[i + 3] - mesh[i + 1]);
+    area += 0.5f * fabsf(cross);
+  }
+  return area;
+}
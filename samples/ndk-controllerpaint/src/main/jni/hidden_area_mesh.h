@@ -0,0 +1,119 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_HIDDENAREAMESH_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_HIDDENAREAMESH_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr.h"
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * Masks the parts of an eye buffer that the lens distortion never shows,
+ * usually the corners, so that early depth testing rejects the fragments
+ * drawn there.
+ *
+ * The mask is a triangle mesh in eye viewport coordinates, built from
+ * gvr::GvrApi::ComputeDistortedPoint(). It depends on the viewer and on the
+ * field of view of the eye, and is only rebuilt when one of them changes.
+ *
+ * Usage, on the rendering thread:
+ *
+ *   mesh.InitializeGl();                      // Once per GL context.
+ *   ...
+ *   <bind the eye buffer, set the viewport of |eye| and clear depth>
+ *   mesh.Update(gvr_api, eye, viewport.GetSourceFov());
+ *   mesh.Draw(eye);
+ *   <draw the eye with depth testing, GL_LESS or GL_LEQUAL>
+ */
+class HiddenAreaMesh {
+ public:
+  /**
+   * Maps a point of the screen to the point of the eye buffer shown there,
+   * both in eye viewport coordinates, [0, 1]^2.
+   */
+  typedef std::function<gvr::Vec2f(const gvr::Vec2f&)> DistortionFunction;
+
+  /**
+   * Number of points sampled on the boundary of the screen.
+   */
+  static const int kBoundarySamples = 64;
+
+  HiddenAreaMesh();
+
+  /**
+   * Builds the shader. Must be called with a current GL context.
+   */
+  void InitializeGl();
+
+  /**
+   * Forces the masks to be rebuilt, e.g. after the viewer has changed.
+   */
+  void Invalidate();
+
+  /**
+   * Rebuilds the mask of |eye| if the viewer or |fov| changed.
+   */
+  void Update(gvr::GvrApi* gvr_api, gvr::Eye eye, const gvr::Rectf& fov);
+
+  /**
+   * Draws the mask of |eye| at the near plane into the depth buffer, over the
+   * current viewport. Depth testing and depth writes must be enabled. Color
+   * writes are restored afterwards.
+   */
+  void Draw(gvr::Eye eye) const;
+
+  /**
+   * Returns the fraction of the viewport of |eye| covered by its mask.
+   */
+  float GetHiddenFraction(gvr::Eye eye) const;
+
+  /**
+   * Returns the triangles, as (x, y) pairs in eye viewport coordinates, that
+   * cover what |distort| does not show of the viewport. Makes no GL calls.
+   */
+  static std::vector<float> BuildMesh(const DistortionFunction& distort);
+
+  /**
+   * Returns the area covered by the triangles of |mesh|.
+   */
+  static float MeshArea(const std::vector<float>& mesh);
+
+ private:
+  struct EyeMask {
+    bool valid;
+    gvr::Rectf fov;
+    std::vector<float> vertices;
+    float hidden_fraction;
+  };
+
+  EyeMask masks_[2];
+  std::string viewer_model_;
+  int program_;
+  int position_param_;
+
+  // Disallow copy and assign.
+  HiddenAreaMesh(const HiddenAreaMesh& other) = delete;
+  HiddenAreaMesh& operator=(const HiddenAreaMesh& other) = delete;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_HIDDENAREAMESH_H_  // NOLINT
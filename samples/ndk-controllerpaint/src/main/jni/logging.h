@@ -0,0 +1,47 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_LOGGING_H_  // NOLINT
+#define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_LOGGING_H_
+
+// Logging and CHECK() macros. Messages go to logcat on Android, and warnings
+// and errors to stderr elsewhere, so that the app also builds into the host
+// tools. The modules shared with TreasureHunt log through this header.
+
+#include <stdlib.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+
+#define LOG_TAG "ControllerDemoCPP"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <stdio.h>
+
+#define LOG_TAG "ControllerDemoCPP"
+// Debug messages are dropped, but their arguments still count as used.
+#define LOGD(...) ((void)sizeof(fprintf(stderr, __VA_ARGS__)))
+#define LOGW(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif  // #ifdef __ANDROID__
+
+#define CHECK(condition) if (!(condition)) { \
+        LOGE("*** CHECK FAILED at %s:%d: %s", __FILE__, __LINE__, #condition); \
+        abort(); }
+
+#endif  // CONTROLLER_PAINT_APP_SRC_MAIN_JNI_LOGGING_H_  // NOLINT
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "overdraw_analyzer.h"  // NOLINT
+
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "utils.h"  // NOLINT
+
+// Each fragment adds 1/255 to the red channel, i.e. one unit of an 8-bit
+// target. Counts saturate at 255 layers.
+const char* const OverdrawAnalyzer::kCountingFragmentShader =
+    "precision mediump float;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(1.0 / 255.0, 0.0, 0.0, 0.0);\n"
+    "}\n";
+
+const char* const OverdrawAnalyzer::kCountingFragmentShaderEs3 =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "out vec4 o_FragColor;\n"
+    "void main() {\n"
+    "  o_FragColor = vec4(1.0 / 255.0, 0.0, 0.0, 0.0);\n"
+    "}\n";
+
+OverdrawAnalyzer::OverdrawAnalyzer()
+    : size_{0, 0}, framebuffer_(0), texture_(0), depth_renderbuffer_(0) {}
+
+void OverdrawAnalyzer::Init(const gvr::Sizei& size,
+                            GpuMemoryTracker* gpu_memory) {
+  size_ = size;
+  pixels_.resize(static_cast<size_t>(size.width) * size.height * 4);
+  texture_ = gpu_memory->CreateTexture2D(GL_RGBA, GL_UNSIGNED_BYTE, size.width,
+                                         size.height, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenRenderbuffers(1, &depth_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, size.width,
+                        size.height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         texture_, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_);
+  CHECK(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  CHECK(glGetError() == GL_NO_ERROR);
+}
+
+gvr::Sizei OverdrawAnalyzer::GetSize() const { return size_; }
+
+void OverdrawAnalyzer::BeginPass() {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glDisable(GL_SCISSOR_TEST);
+  glViewport(0, 0, size_.width, size_.height);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glDepthMask(GL_TRUE);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+}
+
+OverdrawStats OverdrawAnalyzer::EndPass() {
+  glReadPixels(0, 0, size_.width, size_.height, GL_RGBA, GL_UNSIGNED_BYTE,
+               pixels_.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return ComputeStats(pixels_.data(), pixels_.size() / 4);
+}
+
+OverdrawStats OverdrawAnalyzer::ComputeStats(const uint8_t* rgba,
+                                             size_t pixel_count) {
+  size_t histogram[256] = {0};
+  for (size_t i = 0; i < pixel_count; ++i) {
+    ++histogram[rgba[i * 4]];
+  }
+
+  OverdrawStats stats = {0.0f, 0, 0};
+  if (pixel_count == 0) return stats;
+  uint64_t total_layers = 0;
+  size_t seen = 0;
+  const size_t p95_rank = pixel_count - pixel_count / 20;
+  bool found_p95 = false;
+  for (int layers = 0; layers < 256; ++layers) {
+    if (histogram[layers] == 0) continue;
+    total_layers += static_cast<uint64_t>(layers) * histogram[layers];
+    seen += histogram[layers];
+    if (!found_p95 && seen >= p95_rank) {
+      stats.p95_layers = layers;
+      found_p95 = true;
+    }
+    stats.max_layers = layers;
+  }
+  stats.mean_layers = static_cast<float>(total_layers) / pixel_count;
+  return stats;
+}
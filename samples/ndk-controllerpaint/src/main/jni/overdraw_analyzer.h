@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_OVERDRAW_ANALYZER_H_  // NOLINT
+#define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_OVERDRAW_ANALYZER_H_
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+class GpuMemoryTracker;
+
+// Per-pixel overdraw of one analysis pass, in layers (fragments shaded per
+// pixel).
+struct OverdrawStats {
+  float mean_layers;
+  int p95_layers;
+  int max_layers;
+};
+
+// Measures overdraw by rendering the scene a second time into an offscreen
+// target with an additive counting shader, and building a histogram of the
+// number of layers written to each pixel.
+//
+// Usage, on the rendering thread:
+//
+//   analyzer.Init(size, &gpu_memory);       // After the GL context exists.
+//   ...
+//   analyzer.BeginPass();
+//   <draw the scene with kCountingFragmentShader>
+//   OverdrawStats stats = analyzer.EndPass();
+//
+// EndPass() reads the target back, which stalls the pipeline, so the pass is
+// meant for debugging and should not run every frame.
+class OverdrawAnalyzer {
+ public:
+  // Fragment shader that adds one layer to the red channel of the target.
+  // It is meant to be linked with the paint vertex shader, so that the same
+  // draw code can drive it; the uniforms it lacks have location -1, which GL
+  // ignores.
+  static const char* const kCountingFragmentShader;
+
+  // OpenGL ES 3 version of kCountingFragmentShader.
+  static const char* const kCountingFragmentShaderEs3;
+
+  OverdrawAnalyzer();
+
+  // Creates the offscreen target of |size| pixels, with a 16-bit depth buffer
+  // so that fragments rejected by the depth test are not counted.
+  void Init(const gvr::Sizei& size, GpuMemoryTracker* gpu_memory);
+
+  // Returns the size of the offscreen target.
+  gvr::Sizei GetSize() const;
+
+  // Binds and clears the offscreen target (color and depth) and sets up
+  // additive blending.
+  void BeginPass();
+
+  // Reads back the target, unbinds it and returns the overdraw statistics.
+  // The caller must restore its own framebuffer and blend state.
+  OverdrawStats EndPass();
+
+  // Computes overdraw statistics from |pixel_count| RGBA pixels whose red
+  // channel holds the layer count. Does not need a GL context.
+  static OverdrawStats ComputeStats(const uint8_t* rgba, size_t pixel_count);
+
+ private:
+  gvr::Sizei size_;
+  GLuint framebuffer_;
+  GLuint texture_;
+  GLuint depth_renderbuffer_;
+  std::vector<uint8_t> pixels_;
+
+  // Disallow copy and assign.
+  OverdrawAnalyzer(const OverdrawAnalyzer& other) = delete;
+  OverdrawAnalyzer& operator=(const OverdrawAnalyzer& other) = delete;
+};
+
+#endif  // CONTROLLER_PAINT_APP_SRC_MAIN_JNI_OVERDRAW_ANALYZER_H_  // NOLINT
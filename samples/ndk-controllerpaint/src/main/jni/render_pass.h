@@ -0,0 +1,135 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_RENDERPASS_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_RENDERPASS_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+
+#include <array>
+
+#include "vr/gvr/capi/include/gvr.h"
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * What happens to the content of an attachment when a render pass begins.
+ */
+enum LoadAction {
+  // The previous content is kept.
+  kLoadActionLoad,
+  // The attachment is cleared to the pass's clear value.
+  kLoadActionClear,
+  // The previous content is not needed, and the pass will overwrite every
+  // pixel it reads.
+  kLoadActionDontCare,
+};
+
+/**
+ * What happens to the content of an attachment when a render pass ends.
+ */
+enum StoreAction {
+  // The content is kept, e.g. to be resolved and displayed.
+  kStoreActionStore,
+  // The content is not needed anymore.
+  kStoreActionDiscard,
+};
+
+/**
+ * Load and store actions of the color and depth attachments of a pass.
+ */
+struct RenderPassDesc {
+  LoadAction color_load;
+  StoreAction color_store;
+  LoadAction depth_load;
+  StoreAction depth_store;
+  std::array<float, 4> clear_color;
+  float clear_depth;
+};
+
+/**
+ * Brackets the rendering into a framebuffer, either a buffer of a GVR frame
+ * or an application framebuffer, and tells the driver which attachments it
+ * has to load from memory before the pass and store to memory after it.
+ *
+ * On tile-based GPUs, every attachment that is neither cleared nor
+ * invalidated at the beginning of a pass is read back into the tile memory,
+ * and every attachment that is not invalidated at the end is written out
+ * (and resolved, with MSAA). Depth is rarely needed once a pass is done, so
+ * discarding it saves that bandwidth every frame.
+ *
+ * Clears cover the whole framebuffer, which tilers turn into a fast clear;
+ * the scissor test is disabled and the color and depth write masks are
+ * enabled by Begin().
+ *
+ * Usage, on the rendering thread:
+ *
+ *   RenderPass::InitializeGl();              // Once per GL context.
+ *   ...
+ *   RenderPass pass(desc);
+ *   pass.Begin(&frame, 0, buffer_size);
+ *   <render>
+ *   pass.End();                              // Unbinds the framebuffer.
+ */
+class RenderPass {
+ public:
+  /**
+   * Looks up glInvalidateFramebuffer() on OpenGL ES 3, or
+   * glDiscardFramebufferEXT() where EXT_discard_framebuffer is supported.
+   * Must be called with a current GL context.
+   */
+  static void InitializeGl();
+
+  /**
+   * Returns true if attachments can be invalidated. Otherwise, discarding is
+   * a no-op and kLoadActionDontCare clears the attachment instead.
+   */
+  static bool SupportsInvalidation();
+
+  explicit RenderPass(const RenderPassDesc& desc);
+
+  /**
+   * Binds buffer |buffer_index| of |frame|, which is |size| pixels large,
+   * and applies the load actions.
+   */
+  void Begin(gvr::Frame* frame, int32_t buffer_index, const gvr::Sizei& size);
+
+  /**
+   * Binds |framebuffer|, which is |size| pixels large, and applies the load
+   * actions.
+   */
+  void Begin(GLuint framebuffer, const gvr::Sizei& size);
+
+  /**
+   * Applies the store actions, then unbinds the framebuffer.
+   */
+  void End();
+
+  /**
+   * Returns true between Begin() and End().
+   */
+  bool IsActive() const;
+
+ private:
+  void ApplyLoadActions(const gvr::Sizei& size);
+  void ApplyStoreActions();
+
+  RenderPassDesc desc_;
+  gvr::Frame* frame_;  // Null for application framebuffers.
+  bool active_;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_RENDERPASS_H_  // NOLINT
@@ -0,0 +1,206 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_TRACEFORMAT_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_TRACEFORMAT_H_  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Helpers shared by the on-device trace logger (trace_log.h) and the host-side
+// trace decoder (ndk-controllerpaint/tools/trace_decoder.cc). They have no
+// Android dependencies.
+//
+// Trace messages use a subset of printf syntax: flags, width and precision
+// are supported, '*' width/precision and %n are not. Every argument is carried
+// as a raw 64-bit value; string arguments are carried as pointers in memory
+// and as inline bytes in trace files.
+
+// Binary trace file layout (all values little-endian):
+//   header:  "GVRTRACE" followed by a uint32_t version.
+//   records: a uint8_t record type followed by the record body.
+//     kTraceRecordSite:    uint32_t site_id, int32_t level, uint32_t length,
+//                          |length| bytes of format string.
+//     kTraceRecordEvent:   uint32_t site_id, uint32_t thread_id,
+//                          uint64_t timestamp_nanos, uint32_t num_args, then
+//                          per argument either uint32_t length + bytes (for
+//                          %s) or a uint64_t value.
+//     kTraceRecordDropped: uint64_t number of messages dropped so far.
+static const char kTraceFileMagic[8] = {'G', 'V', 'R', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t kTraceFileVersion = 1;
+enum TraceRecordType {
+  kTraceRecordSite = 1,
+  kTraceRecordEvent = 2,
+  kTraceRecordDropped = 3,
+};
+
+// Maximum number of arguments a single trace message can carry.
+static const int kMaxTraceArgs = 6;
+
+// How an argument is interpreted when the message is formatted.
+enum TraceArgKind {
+  kTraceArgInvalid,
+  kTraceArgSigned,
+  kTraceArgUnsigned,
+  kTraceArgDouble,
+  kTraceArgString,
+  kTraceArgPointer,
+};
+
+// Returns the argument kind for a printf conversion character.
+inline TraceArgKind TraceArgKindForConversion(char conversion) {
+  switch (conversion) {
+    case 'd': case 'i': case 'c':
+      return kTraceArgSigned;
+    case 'u': case 'o': case 'x': case 'X':
+      return kTraceArgUnsigned;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a':
+    case 'A':
+      return kTraceArgDouble;
+    case 's':
+      return kTraceArgString;
+    case 'p':
+      return kTraceArgPointer;
+    default:
+      return kTraceArgInvalid;
+  }
+}
+
+// Scans the conversion specification starting at |spec| (which points at a
+// '%'). Stores the flags/width/precision part in |prefix| (without the '%' and
+// without length modifiers) and the conversion character in |conversion|.
+// Returns a pointer just past the specification, or nullptr if malformed.
+inline const char* ScanTraceConversion(const char* spec, char* prefix,
+                                       size_t prefix_size, char* conversion) {
+  const char* p = spec + 1;
+  size_t prefix_len = 0;
+  while (*p && strchr("-+ #0123456789.", *p)) {
+    if (prefix_len + 1 >= prefix_size) return nullptr;
+    prefix[prefix_len++] = *p++;
+  }
+  prefix[prefix_len] = '\0';
+  // Length modifiers are dropped: values are always widened to 64 bits.
+  while (*p && strchr("hljztL", *p)) ++p;
+  if (!*p) return nullptr;
+  *conversion = *p;
+  return p + 1;
+}
+
+// Parses |format| and stores the kind of each argument in |kinds|. Returns the
+// number of arguments, or -1 if the format is malformed or needs more than
+// |max_kinds| arguments.
+inline int ParseTraceFormat(const char* format, TraceArgKind* kinds,
+                            int max_kinds) {
+  int count = 0;
+  for (const char* p = format; *p;) {
+    if (*p != '%') {
+      ++p;
+      continue;
+    }
+    if (p[1] == '%') {
+      p += 2;
+      continue;
+    }
+    char prefix[16];
+    char conversion;
+    p = ScanTraceConversion(p, prefix, sizeof(prefix), &conversion);
+    if (!p || count >= max_kinds) return -1;
+    const TraceArgKind kind = TraceArgKindForConversion(conversion);
+    if (kind == kTraceArgInvalid) return -1;
+    kinds[count++] = kind;
+  }
+  return count;
+}
+
+// Formats |format| with the raw argument values in |args| into |out|, which
+// is always NUL-terminated. String arguments must be pointers to
+// NUL-terminated strings. Returns the length of the formatted message.
+inline size_t FormatTraceMessage(const char* format, const uint64_t* args,
+                                 int num_args, char* out, size_t out_size) {
+  if (out_size == 0) return 0;
+  size_t len = 0;
+  int arg = 0;
+  const char* p = format;
+  while (*p && len + 1 < out_size) {
+    if (*p != '%') {
+      out[len++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[len++] = '%';
+      p += 2;
+      continue;
+    }
+    char prefix[16];
+    char conversion;
+    p = ScanTraceConversion(p, prefix, sizeof(prefix), &conversion);
+    if (!p || arg >= num_args) break;
+    const uint64_t value = args[arg++];
+    char spec[24];
+    int written = 0;
+    switch (TraceArgKindForConversion(conversion)) {
+      case kTraceArgSigned:
+        snprintf(spec, sizeof(spec), "%%%s%s%c", prefix,
+                 conversion == 'c' ? "" : "ll", conversion);
+        if (conversion == 'c') {
+          written = snprintf(out + len, out_size - len, spec,
+                             static_cast<int>(value));
+        } else {
+          written = snprintf(out + len, out_size - len, spec,
+                             static_cast<long long>(value));  // NOLINT
+        }
+        break;
+      case kTraceArgUnsigned:
+        snprintf(spec, sizeof(spec), "%%%sll%c", prefix, conversion);
+        written = snprintf(out + len, out_size - len, spec,
+                           static_cast<unsigned long long>(value));  // NOLINT
+        break;
+      case kTraceArgDouble: {
+        double d;
+        memcpy(&d, &value, sizeof(d));
+        snprintf(spec, sizeof(spec), "%%%s%c", prefix, conversion);
+        written = snprintf(out + len, out_size - len, spec, d);
+        break;
+      }
+      case kTraceArgString: {
+        const char* str = reinterpret_cast<const char*>(
+            static_cast<uintptr_t>(value));
+        snprintf(spec, sizeof(spec), "%%%ss", prefix);
+        written = snprintf(out + len, out_size - len, spec,
+                           str ? str : "(null)");
+        break;
+      }
+      case kTraceArgPointer:
+        snprintf(spec, sizeof(spec), "%%%sp", prefix);
+        written = snprintf(out + len, out_size - len, spec,
+                           reinterpret_cast<void*>(
+                               static_cast<uintptr_t>(value)));
+        break;
+      default:
+        written = 0;
+        break;
+    }
+    if (written < 0) break;
+    len += static_cast<size_t>(written);
+    if (len >= out_size) len = out_size - 1;
+  }
+  out[len] = '\0';
+  return len;
+}
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_TRACEFORMAT_H_  // NOLINT
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "uniform_ring_buffer.h"  // NOLINT
+
+#include <algorithm>
+
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "utils.h"  // NOLINT
+
+namespace {
+
+// How long BeginFrame() waits for a segment's fence before giving up and
+// overwriting it anyway. Only a hung GPU should take this long.
+static const GLuint64 kFenceTimeoutNanos = 1000000000;
+
+}  // namespace
+
+UniformRingBuffer::UniformRingBuffer()
+    : gpu_memory_(nullptr),
+      buffer_(0),
+      offset_alignment_(1),
+      frame_capacity_(0),
+      frame_(0),
+      frame_used_(0),
+      fences_() {}
+
+void UniformRingBuffer::Init(GLsizeiptr frame_capacity,
+                             GpuMemoryTracker* gpu_memory) {
+  // Objects from a previous GL context are gone, so there is nothing to
+  // delete.
+  gpu_memory_ = gpu_memory;
+  buffer_ = 0;
+  std::fill(fences_, fences_ + kFrameCount, nullptr);
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment_);
+  CHECK(offset_alignment_ > 0);
+  Allocate(frame_capacity);
+  CHECK(glGetError() == GL_NO_ERROR);
+}
+
+GLuint UniformRingBuffer::GetBuffer() const { return buffer_; }
+
+GLsizeiptr UniformRingBuffer::AlignSize(GLsizeiptr size) const {
+  return (size + offset_alignment_ - 1) / offset_alignment_ *
+         offset_alignment_;
+}
+
+void UniformRingBuffer::BeginFrame() {
+  frame_ = (frame_ + 1) % kFrameCount;
+  frame_used_ = 0;
+  GLsync& fence = fences_[frame_];
+  if (fence) {
+    if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                         kFenceTimeoutNanos) == GL_TIMEOUT_EXPIRED) {
+      LOGW("UniformRingBuffer: timed out waiting for frame fence.");
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+}
+
+void* UniformRingBuffer::Map(GLsizeiptr size, GLintptr* offset) {
+  if (frame_used_ + size > frame_capacity_) {
+    Allocate(std::max(frame_capacity_ * 2, frame_used_ + size));
+  }
+  *offset = frame_ * frame_capacity_ + frame_used_;
+  frame_used_ += AlignSize(size);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  // The fence in BeginFrame() already guarantees that the GPU is done with
+  // this range, so the driver does not need to synchronize.
+  void* data = glMapBufferRange(
+      GL_UNIFORM_BUFFER, *offset, size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT);
+  CHECK(data);
+  return data;
+}
+
+void UniformRingBuffer::Unmap() {
+  if (!glUnmapBuffer(GL_UNIFORM_BUFFER)) {
+    LOGW("UniformRingBuffer: buffer contents were lost while mapped.");
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformRingBuffer::EndFrame() {
+  fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformRingBuffer::Allocate(GLsizeiptr frame_capacity) {
+  if (buffer_) {
+    LOGD("UniformRingBuffer: growing to %ld bytes per frame.",
+         static_cast<long>(frame_capacity));  // NOLINT
+    gpu_memory_->DeleteBuffer(buffer_);
+  }
+  // Segments must start at aligned offsets.
+  frame_capacity_ = AlignSize(frame_capacity);
+  buffer_ = gpu_memory_->CreateBuffer(GL_UNIFORM_BUFFER,
+                                      frame_capacity_ * kFrameCount, nullptr,
+                                      GL_DYNAMIC_DRAW);
+  // The new storage is not in use by the GPU, so no segment needs a fence.
+  for (GLsync& fence : fences_) {
+    if (fence) glDeleteSync(fence);
+    fence = nullptr;
+  }
+  frame_used_ = 0;
+}
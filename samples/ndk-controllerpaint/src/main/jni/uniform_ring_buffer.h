@@ -0,0 +1,91 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_UNIFORM_RING_BUFFER_H_  // NOLINT
+#define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_UNIFORM_RING_BUFFER_H_
+
+#include <GLES3/gl3.h>
+
+class GpuMemoryTracker;
+
+// A uniform buffer object split into one segment per frame in flight, used
+// round-robin. Per-draw constants are written into the current frame's
+// segment with unsynchronized mappings, and draws select their slice with
+// glBindBufferRange(). A fence per segment keeps the CPU from overwriting
+// constants that the GPU has not consumed yet.
+//
+// Requires an OpenGL ES 3 context. Usage, on the rendering thread:
+//
+//   ring.Init(frame_capacity, &gpu_memory);  // After the GL context exists.
+//   ...
+//   ring.BeginFrame();
+//   void* data = ring.Map(size, &offset);     // Any number of times.
+//   <write the constants>
+//   ring.Unmap();
+//   <draw, binding ranges that start at |offset|>
+//   ring.EndFrame();
+class UniformRingBuffer {
+ public:
+  // Number of segments, i.e. of frames that may be in flight at once.
+  static const int kFrameCount = 3;
+
+  UniformRingBuffer();
+
+  // Creates the buffer with room for |frame_capacity| bytes per frame. Must
+  // be called again when the GL context is recreated.
+  void Init(GLsizeiptr frame_capacity, GpuMemoryTracker* gpu_memory);
+
+  // Returns the buffer object, or 0 if Init() was not called.
+  GLuint GetBuffer() const;
+
+  // Returns |size| rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT. Ranges
+  // that are bound individually must be this far apart.
+  GLsizeiptr AlignSize(GLsizeiptr size) const;
+
+  // Moves to the next segment, waiting for the GPU to finish the frame that
+  // last used it.
+  void BeginFrame();
+
+  // Maps |size| bytes of the current segment for writing and returns them.
+  // |offset| receives their offset in the buffer. If the segment is full,
+  // the buffer is reallocated with larger segments first.
+  void* Map(GLsizeiptr size, GLintptr* offset);
+
+  // Unmaps the range returned by Map(). Must be called before drawing.
+  void Unmap();
+
+  // Fences the current segment. Call after the frame's last draw.
+  void EndFrame();
+
+ private:
+  // Replaces the buffer with one that has |frame_capacity| bytes per frame.
+  // Draws already issued keep using the old storage.
+  void Allocate(GLsizeiptr frame_capacity);
+
+  GpuMemoryTracker* gpu_memory_;
+  GLuint buffer_;
+  GLint offset_alignment_;
+  GLsizeiptr frame_capacity_;
+  int frame_;  // Current segment.
+  GLsizeiptr frame_used_;  // Bytes used in the current segment.
+  GLsync fences_[kFrameCount];
+
+  // Disallow copy and assign.
+  UniformRingBuffer(const UniformRingBuffer& other) = delete;
+  UniformRingBuffer& operator=(const UniformRingBuffer& other) = delete;
+};
+
+#endif  // CONTROLLER_PAINT_APP_SRC_MAIN_JNI_UNIFORM_RING_BUFFER_H_  // NOLINT
@@ -16,6 +16,11 @@
 
 #include "utils.h"  // NOLINT
 
+#include <stdio.h>
+
+#include "asset_archive.h"  // NOLINT
+#include "gpu_memory_tracker.h"  // NOLINT
+
 void Utils::SetUpViewportAndScissor(const gvr::Sizei& framebuf_size,
                                     const gvr::BufferViewport& params) {
   const gvr::Rectf& rect = params.GetSourceUv();
@@ -27,7 +32,6 @@ void Utils::SetUpViewportAndScissor(const gvr::Sizei& framebuf_size,
   glViewport(left, bottom, width, height);
   glEnable(GL_SCISSOR_TEST);
   glScissor(left, bottom, width, height);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   CHECK(glGetError() == GL_NO_ERROR);
 }
 
@@ -97,6 +101,7 @@ std::array<float, 3> Utils::VecCrossProd(
   return result;
 }
 
+#ifdef __ANDROID__
 jobject Utils::GetClassLoaderFromActivity(JNIEnv* env, jobject activity) {
   jclass activity_class = env->GetObjectClass(activity);
   CHECK(activity_class);
@@ -108,6 +113,7 @@ jobject Utils::GetClassLoaderFromActivity(JNIEnv* env, jobject activity) {
   env->DeleteLocalRef(activity_class);
   return class_loader;
 }
+#endif  // #ifdef __ANDROID__
 
 int Utils::BuildShader(int type, const char* source) {
   int shader = glCreateShader(type);
@@ -120,6 +126,19 @@ int Utils::BuildShader(int type, const char* source) {
   return shader;
 }
 
+int Utils::GetGlesMajorVersion() {
+  // The version string is "OpenGL ES <major>.<minor> <vendor information>".
+  const char* version =
+      reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  int major = 0;
+  int minor = 0;
+  if (!version || sscanf(version, "OpenGL ES %d.%d", &major, &minor) != 2) {
+    LOGW("Unrecognized GL_VERSION: %s", version ? version : "(null)");
+    return 2;
+  }
+  return major;
+}
+
 int Utils::BuildProgram(int vertex_shader, int frag_shader) {
   int program = glCreateProgram();
   CHECK(program);
@@ -178,30 +197,20 @@ std::array<float, 16> Utils::MatrixToGLArray(const gvr::Mat4f& matrix) {
   return result;
 }
 
-int Utils::LoadRawTextureFromAsset(
-    AAssetManager* asset_mgr, const char* asset_path, int width, int height) {
+int Utils::LoadRawTextureFromArchive(
+    const AssetArchive& archive, const char* asset_name, int width,
+    int height, GpuMemoryTracker* gpu_memory) {
   const int bytes_per_pixel = 3;  // RGB
-  AAsset* asset = AAssetManager_open(asset_mgr, asset_path, AASSET_MODE_BUFFER);
-  CHECK(asset);
-
-  int length = static_cast<int>(AAsset_getLength(asset));
-  CHECK(length == width * height * bytes_per_pixel);
+  AssetArchive::View asset;
+  CHECK(archive.Find(asset_name, &asset));
+  CHECK(asset.size == static_cast<size_t>(width * height * bytes_per_pixel));
 
-  const uint8_t* source_buf = reinterpret_cast<const uint8_t*>(
-      AAsset_getBuffer(asset));
-  CHECK(source_buf);
-
-  GLuint tex_id;
-  glGenTextures(1, &tex_id);
-  glBindTexture(GL_TEXTURE_2D, tex_id);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-               GL_UNSIGNED_BYTE, source_buf);
+  GLuint tex_id = gpu_memory->CreateTexture2D(GL_RGB, GL_UNSIGNED_BYTE, width,
+                                              height, asset.data);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glBindTexture(GL_TEXTURE_2D, 0);
   CHECK(glGetError() == GL_NO_ERROR);
-
-  AAsset_close(asset);
   return tex_id;
 }
 
@@ -17,43 +17,34 @@
 #ifndef CONTROLLER_PAINT_APP_SRC_MAIN_JNI_UTILS_H_  // NOLINT
 #define CONTROLLER_PAINT_APP_SRC_MAIN_JNI_UTILS_H_
 
-#include <android/asset_manager.h>
-#include <android/log.h>
+#ifdef __ANDROID__
+#include <jni.h>
+#endif  // #ifdef __ANDROID__
 
 #include <GLES2/gl2.h>
-#include <jni.h>
 #include <math.h>
 #include <stdlib.h>
 #include <sys/types.h>
 
 #include <array>
 
+#include "logging.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
 #include "vr/gvr/capi/include/gvr_controller.h"
 
-#ifdef __ANDROID__
-  #define LOG_TAG "ControllerDemoCPP"
-  #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-  #define LOGW(...) \
-      __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
-  #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#else
-  #define LOGD(...)
-  #define LOGW(...)
-  #define LOGE(...)
-#endif  // #ifdef __ANDROID__
+class AssetArchive;
+class GpuMemoryTracker;
 
-#define CHECK(condition) if (!(condition)) { \
-        LOGE("*** CHECK FAILED at %s:%d: %s", __FILE__, __LINE__, #condition); \
-        abort(); }
 #define CHECK_EQ(a, b) CHECK((a) == (b))
 #define CHECK_NE(a, b) CHECK((a) != (b))
 
 // Assorted utilities and boilerplate code.
 class Utils {
  public:
+#ifdef __ANDROID__
   // Obtains the ClassLoader associated to a given Android Activity.
   static jobject GetClassLoaderFromActivity(JNIEnv* env, jobject activity);
+#endif  // #ifdef __ANDROID__
 
   // Multiplies matrices.
   static gvr::Mat4f MatrixMul(const gvr::Mat4f& m1, const gvr::Mat4f& m2);
@@ -92,6 +83,9 @@ class Utils {
   // Returns the handle of that program.
   static int BuildProgram(int vertex_shader, int frag_shader);
 
+  // Returns the major version of the current OpenGL ES context, e.g. 2 or 3.
+  static int GetGlesMajorVersion();
+
   // Calculates a perspective matrix from the given view parameters.
   static gvr::Mat4f PerspectiveMatrixFromView(const gvr::Rectf& fov,
                                               float near_clip, float far_clip);
@@ -99,10 +93,12 @@ class Utils {
   // Converts a row-major matrix to a column-major, GL-compatible matrix array.
   static std::array<float, 16> MatrixToGLArray(const gvr::Mat4f& matrix);
 
-  // Loads a texture from the given asset file. Returns the handle of the
-  // texture.
-  static int LoadRawTextureFromAsset(
-      AAssetManager* asset_mgr, const char* asset_path, int width, int height);
+  // Loads a texture from the asset called |asset_name| in |archive|,
+  // accounting for its memory in |gpu_memory|. The pixels are uploaded
+  // straight from the archive. Returns the handle of the texture.
+  static int LoadRawTextureFromArchive(
+      const AssetArchive& archive, const char* asset_name, int width,
+      int height, GpuMemoryTracker* gpu_memory);
 
   // Converts a controller quaternion to a rotation matrix.
   static gvr::Mat4f ControllerQuatToMatrix(const gvr::ControllerQuat& quat);
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side benchmark of loading assets at startup, from an archive read by
+// AssetArchive (see src/main/jni/asset_archive.h) against the separate files
+// it was packed from. For each way, it reports the files opened, the bytes
+// copied and the time to load every asset once and read all of its bytes,
+// as uploading a texture does: each separate file is read into memory,
+// while the views of the archive are read in place. The files are in the
+// page cache after the first round, so the times compare the system call
+// and page fault overhead rather than the storage.
+//
+// It also checks that every asset of the archive matches its file.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -o asset_archive_bench asset_archive_bench.cc
+//       $JNI/asset_archive.cc
+//   ./asset_archive_bench ../src/main/assets/textures.pak ../assets-src/*.bin
+//
+// To see how the two scale as content grows, pack many assets first:
+//
+//   mkdir -p /tmp/assets
+//   for i in $(seq 256); do head -c 8192 /dev/urandom > /tmp/assets/$i.bin;
+//   done
+//   ./asset_packer /tmp/assets.pak /tmp/assets/*.bin
+//   ./asset_archive_bench /tmp/assets.pak /tmp/assets/*.bin
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_archive.h"  // NOLINT
+
+namespace {
+
+const int kRounds = 200;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string BaseName(const std::string& path) {
+  const size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+uint64_t Checksum(const uint8_t* data, size_t size) {
+  uint64_t checksum = 0;
+  for (size_t i = 0; i < size; ++i) checksum += data[i];
+  return checksum;
+}
+
+// Reads the file at |path| as AAssetManager_open and AAsset_read would:
+// open, size, read, close.
+bool LoadFile(const char* path, std::vector<uint8_t>* data) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok) {
+    data->resize(static_cast<size_t>(st.st_size));
+    ok = read(fd, data->data(), data->size()) ==
+         static_cast<ssize_t>(data->size());
+  }
+  close(fd);
+  return ok;
+}
+
+// Loads the files at |paths| and returns the checksum of their bytes.
+uint64_t LoadFiles(const std::vector<std::string>& paths) {
+  uint64_t checksum = 0;
+  std::vector<uint8_t> data;
+  for (const std::string& path : paths) {
+    if (LoadFile(path.c_str(), &data)) {
+      checksum += Checksum(data.data(), data.size());
+    }
+  }
+  return checksum;
+}
+
+// Opens the archive at |path| and returns the checksum of the bytes of the
+// assets called |names|.
+uint64_t LoadArchive(const char* path, const std::vector<std::string>& names) {
+  std::unique_ptr<AssetArchive> archive = AssetArchive::OpenFromFile(path);
+  if (!archive) return 0;
+  uint64_t checksum = 0;
+  for (const std::string& name : names) {
+    AssetArchive::View view;
+    if (archive->Find(name.c_str(), &view)) {
+      checksum += Checksum(view.data, view.size);
+    }
+  }
+  return checksum;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <archive> <input>...\n", argv[0]);
+    return 2;
+  }
+  const char* archive_path = argv[1];
+  std::vector<std::string> paths(argv + 2, argv + argc);
+  std::vector<std::string> names;
+  for (const std::string& path : paths) names.push_back(BaseName(path));
+
+  // Every asset must be in the archive, with the contents of its file.
+  std::unique_ptr<AssetArchive> archive =
+      AssetArchive::OpenFromFile(archive_path);
+  if (!archive) return 1;
+  bool ok = archive->GetAssetCount() == static_cast<int>(paths.size());
+  size_t total_bytes = 0;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    std::vector<uint8_t> data;
+    AssetArchive::View view;
+    if (!LoadFile(paths[i].c_str(), &data) ||
+        !archive->Find(names[i].c_str(), &view) || view.size != data.size() ||
+        memcmp(view.data, data.data(), data.size()) != 0) {
+      fprintf(stderr, "%s does not match the archive.\n", paths[i].c_str());
+      ok = false;
+    }
+    total_bytes += data.size();
+  }
+  archive.reset();
+
+  uint64_t files_checksum = 0;
+  double start = NowSeconds();
+  for (int round = 0; round < kRounds; ++round) {
+    files_checksum += LoadFiles(paths);
+  }
+  const double files_seconds = (NowSeconds() - start) / kRounds;
+
+  uint64_t archive_checksum = 0;
+  start = NowSeconds();
+  for (int round = 0; round < kRounds; ++round) {
+    archive_checksum += LoadArchive(archive_path, names);
+  }
+  const double archive_seconds = (NowSeconds() - start) / kRounds;
+  ok &= archive_checksum == files_checksum;
+
+  printf("%zu assets, %zu bytes\n", paths.size(), total_bytes);
+  printf("%-16s %8s %14s %12s\n", "", "opens", "bytes copied", "us/load");
+  printf("%-16s %8zu %14zu %12.1f\n", "separate files", paths.size(),
+         total_bytes, 1e6 * files_seconds);
+  printf("%-16s %8d %14d %12.1f\n", "archive", 1, 0, 1e6 * archive_seconds);
+  printf("%s: every asset of the archive matches its file\n",
+         ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
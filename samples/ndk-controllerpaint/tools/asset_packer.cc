@@ -0,0 +1,163 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side packer for asset archives read by AssetArchive (see
+// src/main/jni/asset_archive.h). Each input file is stored uncompressed under
+// its base name, with its data aligned to the given boundary (16 bytes by
+// default).
+//
+// Build and run on the host with:
+//
+//   g++ -std=c++11 -I../src/main/jni -o asset_packer asset_packer.cc
+//   ./asset_packer ../src/main/assets/textures.pak ../assets-src/*.bin
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "asset_archive_format.h"  // NOLINT
+
+namespace {
+
+struct InputFile {
+  std::string name;
+  std::string data;
+  uint64_t hash;
+};
+
+std::string BaseName(const std::string& path) {
+  const size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool ReadFile(const char* path, std::string* data) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  char buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data->append(buffer, count);
+  }
+  const bool ok = !ferror(file);
+  fclose(file);
+  if (!ok) fprintf(stderr, "Error reading %s.\n", path);
+  return ok;
+}
+
+uint64_t AlignUp(uint64_t value, uint32_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+int Pack(const char* out_path, uint32_t alignment,
+         std::vector<InputFile>* inputs) {
+  std::sort(inputs->begin(), inputs->end(),
+            [](const InputFile& a, const InputFile& b) {
+              return a.hash < b.hash;
+            });
+  for (size_t i = 1; i < inputs->size(); ++i) {
+    if ((*inputs)[i].hash == (*inputs)[i - 1].hash) {
+      fprintf(stderr, "Asset names %s and %s collide.\n",
+              (*inputs)[i - 1].name.c_str(), (*inputs)[i].name.c_str());
+      return 1;
+    }
+  }
+
+  std::string names;
+  std::vector<AssetArchiveEntry> entries(inputs->size());
+  for (size_t i = 0; i < inputs->size(); ++i) {
+    entries[i].name_hash = (*inputs)[i].hash;
+    entries[i].name_offset = static_cast<uint32_t>(names.size());
+    entries[i].name_length = static_cast<uint32_t>((*inputs)[i].name.size());
+    entries[i].alignment = alignment;
+    entries[i].compression = kAssetCompressionNone;
+    names += (*inputs)[i].name;
+  }
+
+  uint64_t offset = sizeof(AssetArchiveHeader) +
+                    entries.size() * sizeof(AssetArchiveEntry) + names.size();
+  for (size_t i = 0; i < inputs->size(); ++i) {
+    offset = AlignUp(offset, alignment);
+    entries[i].offset = offset;
+    entries[i].size = (*inputs)[i].data.size();
+    offset += entries[i].size;
+  }
+
+  AssetArchiveHeader header;
+  memcpy(header.magic, kAssetArchiveMagic, sizeof(header.magic));
+  header.version = kAssetArchiveVersion;
+  header.entry_count = static_cast<uint32_t>(entries.size());
+  header.name_table_size = static_cast<uint32_t>(names.size());
+
+  std::string archive(reinterpret_cast<const char*>(&header), sizeof(header));
+  archive.append(reinterpret_cast<const char*>(entries.data()),
+                 entries.size() * sizeof(AssetArchiveEntry));
+  archive += names;
+  for (size_t i = 0; i < inputs->size(); ++i) {
+    archive.resize(entries[i].offset, '\0');
+    archive += (*inputs)[i].data;
+  }
+
+  FILE* file = fopen(out_path, "wb");
+  if (!file) {
+    perror(out_path);
+    return 1;
+  }
+  const bool ok =
+      fwrite(archive.data(), 1, archive.size(), file) == archive.size();
+  if (fclose(file) != 0 || !ok) {
+    fprintf(stderr, "Error writing %s.\n", out_path);
+    return 1;
+  }
+  printf("Packed %zu assets (%zu bytes) into %s.\n", inputs->size(),
+         archive.size(), out_path);
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t alignment = 16;
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "--align") == 0) {
+    alignment = static_cast<uint32_t>(strtoul(argv[arg + 1], nullptr, 10));
+    arg += 2;
+  }
+  if (argc - arg < 2 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    fprintf(stderr,
+            "Usage: %s [--align <power of two>] <archive> <input>...\n",
+            argv[0]);
+    return 2;
+  }
+
+  const char* out_path = argv[arg++];
+  std::vector<InputFile> inputs;
+  for (; arg < argc; ++arg) {
+    InputFile input;
+    input.name = BaseName(argv[arg]);
+    input.hash = HashAssetName(input.name.data(), input.name.size());
+    if (!ReadFile(argv[arg], &input.data)) return 1;
+    inputs.push_back(input);
+  }
+  return Pack(out_path, alignment, &inputs);
+}
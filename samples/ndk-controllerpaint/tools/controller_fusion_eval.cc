@@ -0,0 +1,330 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side evaluation of ControllerFusion (see
+// src/main/jni/controller_fusion.h) against a controller sensor log.
+//
+// The log is replayed frame by frame at 60 Hz. For each frame, the cursor
+// orientation that ControllerPaint would display is compared with a reference
+// orientation at the display time, |display latency| after the frame starts:
+//
+//  * "fused": the latest fused orientation, as used without the filter.
+//  * "filter": ControllerFusion, predicted to the display time.
+//
+// For a recorded log, the reference is the fused orientation recorded at the
+// display time. For the synthetic log generated when no file is given, it is
+// the true orientation. The report gives the mean, 95th percentile and maximum
+// angular error, and the effective latency of each method: how far behind the
+// display time the reference that best matches its output is. A method that
+// predicts perfectly has an effective latency of zero. The tool also checks
+// that replaying the log in one batch and frame by frame gives bit-identical
+// results.
+//
+// A log is a text file with one controller reading per line (lines starting
+// with '#' are ignored), as logged by ControllerPaint when
+// kLogControllerSensors is true in demoapp.cc:
+//
+//   orientation_ns qx qy qz qw gyro_ns gx gy gz accel_ns ax ay az
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -I../../../libraries/headers
+//       -o controller_fusion_eval controller_fusion_eval.cc
+//       $JNI/controller_fusion.cc
+//   ./controller_fusion_eval [log file] [display latency ms]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "controller_fusion.h"  // NOLINT
+
+namespace {
+
+const int64_t kNanosPerSecond = 1000000000;
+const int64_t kFramePeriodNanos = kNanosPerSecond / 60;
+const double kDefaultDisplayLatencyMs = 33.0;
+// Effective latencies are searched up to this far either way, in 1 ms steps.
+const int kMaxLatencyMs = 100;
+
+// Synthetic log: controller readings at 100 Hz for 20 seconds.
+const int64_t kSyntheticPeriodNanos = kNanosPerSecond / 100;
+const int kSyntheticSampleCount = 2000;
+const double kGyroNoise = 0.01;        // rad/s
+const double kGyroBias = 0.02;         // rad/s
+const double kAccelNoise = 0.05;       // m/s^2
+const double kOrientationNoise = 0.002;  // rad
+
+struct Quat {
+  double x, y, z, w;
+};
+
+Quat Mul(const Quat& a, const Quat& b) {
+  return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+          a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+Quat Normalize(const Quat& q) {
+  const double n = sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  return {q.x / n, q.y / n, q.z / n, q.w / n};
+}
+
+// Rotation about the direction of the vector (x, y, z), by its length in
+// radians.
+Quat FromRotationVector(double x, double y, double z) {
+  const double angle = sqrt(x * x + y * y + z * z);
+  if (angle < 1e-12) return {0.5 * x, 0.5 * y, 0.5 * z, 1.0};
+  const double s = sin(0.5 * angle) / angle;
+  return {x * s, y * s, z * s, cos(0.5 * angle)};
+}
+
+double AngleBetween(const Quat& a, const Quat& b) {
+  const double dot =
+      fabs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+  return 2.0 * acos(std::min(1.0, dot));
+}
+
+Quat Slerp(const Quat& a, Quat b, double t) {
+  double dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+  if (dot < 0.0) {
+    b = {-b.x, -b.y, -b.z, -b.w};
+    dot = -dot;
+  }
+  if (dot > 0.9999) {
+    return Normalize({a.x + t * (b.x - a.x), a.y + t * (b.y - a.y),
+                      a.z + t * (b.z - a.z), a.w + t * (b.w - a.w)});
+  }
+  const double angle = acos(dot);
+  const double wa = sin((1.0 - t) * angle) / sin(angle);
+  const double wb = sin(t * angle) / sin(angle);
+  return {wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z,
+          wa * a.w + wb * b.w};
+}
+
+Quat FromController(const gvr::ControllerQuat& q) {
+  return {q.qx, q.qy, q.qz, q.qw};
+}
+
+// An orientation track that can be sampled at any time.
+struct Track {
+  std::vector<int64_t> times;
+  std::vector<Quat> orientations;
+
+  void Add(int64_t time, const Quat& q) {
+    if (!times.empty() && time <= times.back()) return;
+    times.push_back(time);
+    orientations.push_back(q);
+  }
+
+  bool Covers(int64_t time) const {
+    return !times.empty() && time >= times.front() && time <= times.back();
+  }
+
+  Quat At(int64_t time) const {
+    const size_t after =
+        std::lower_bound(times.begin(), times.end(), time) - times.begin();
+    if (after == 0) return orientations.front();
+    if (after == times.size()) return orientations.back();
+    const double t = static_cast<double>(time - times[after - 1]) /
+                     (times[after] - times[after - 1]);
+    return Slerp(orientations[after - 1], orientations[after], t);
+  }
+};
+
+bool ReadLog(const char* path, std::vector<ControllerSensorSample>* samples) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    ControllerSensorSample s;
+    long long ot, gt, at;  // NOLINT
+    if (sscanf(line, "%lld %f %f %f %f %lld %f %f %f %lld %f %f %f", &ot,
+               &s.orientation.qx, &s.orientation.qy, &s.orientation.qz,
+               &s.orientation.qw, &gt, &s.gyro.x, &s.gyro.y, &s.gyro.z, &at,
+               &s.accel.x, &s.accel.y, &s.accel.z) != 13) {
+      fprintf(stderr, "Skipping malformed line: %s", line);
+      continue;
+    }
+    s.orientation_timestamp = ot;
+    s.gyro_timestamp = gt;
+    s.accel_timestamp = at;
+    samples->push_back(s);
+  }
+  fclose(file);
+  return !samples->empty();
+}
+
+// Generates readings of a controller swept around by hand: the angular
+// velocity is a sum of sinusoids, up to a few rad/s. The gyro has noise and a
+// constant bias, and the fused orientation has noise.
+void GenerateLog(std::vector<ControllerSensorSample>* samples, Track* truth) {
+  std::mt19937 rng(1);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  Quat q = {0.0, 0.0, 0.0, 1.0};
+  const int kSubsteps = 10;
+  const int64_t step_nanos = kSyntheticPeriodNanos / kSubsteps;
+  int64_t time = kNanosPerSecond;
+  double omega[3] = {0.0, 0.0, 0.0};
+  truth->Add(time, q);
+  for (int i = 0; i < kSyntheticSampleCount; ++i) {
+    for (int step = 0; step < kSubsteps; ++step) {
+      time += step_nanos;
+      const double t = static_cast<double>(time) / kNanosPerSecond;
+      omega[0] = 1.5 * sin(2.1 * t) + 0.8 * sin(5.3 * t + 1.0);
+      omega[1] = 2.5 * sin(1.3 * t + 0.5) + 1.0 * sin(7.1 * t);
+      omega[2] = 0.7 * sin(3.7 * t + 2.0);
+      const double dt = static_cast<double>(step_nanos) / kNanosPerSecond;
+      q = Normalize(Mul(q, FromRotationVector(omega[0] * dt, omega[1] * dt,
+                                              omega[2] * dt)));
+      truth->Add(time, q);
+    }
+    ControllerSensorSample s;
+    s.orientation_timestamp = s.gyro_timestamp = s.accel_timestamp = time;
+    const Quat noisy = Normalize(Mul(
+        q, FromRotationVector(kOrientationNoise * normal(rng),
+                              kOrientationNoise * normal(rng),
+                              kOrientationNoise * normal(rng))));
+    s.orientation = {static_cast<float>(noisy.x), static_cast<float>(noisy.y),
+                     static_cast<float>(noisy.z), static_cast<float>(noisy.w)};
+    s.gyro.x = static_cast<float>(omega[0] + kGyroBias +
+                                  kGyroNoise * normal(rng));
+    s.gyro.y = static_cast<float>(omega[1] - kGyroBias +
+                                  kGyroNoise * normal(rng));
+    s.gyro.z = static_cast<float>(omega[2] + kGyroNoise * normal(rng));
+    // Gravity in controller space: the start space up vector, rotated by the
+    // inverse of |q|.
+    const Quat up = Mul(Mul({-q.x, -q.y, -q.z, q.w}, {0.0, 1.0, 0.0, 0.0}), q);
+    s.accel.x = static_cast<float>(9.80665 * up.x + kAccelNoise * normal(rng));
+    s.accel.y = static_cast<float>(9.80665 * up.y + kAccelNoise * normal(rng));
+    s.accel.z = static_cast<float>(9.80665 * up.z + kAccelNoise * normal(rng));
+    samples->push_back(s);
+  }
+}
+
+struct Method {
+  const char* name;
+  std::vector<int64_t> display_times;
+  std::vector<Quat> outputs;
+};
+
+void Report(const Method& method, const Track& reference) {
+  std::vector<double> errors;
+  for (size_t i = 0; i < method.outputs.size(); ++i) {
+    if (!reference.Covers(method.display_times[i])) continue;
+    errors.push_back(
+        AngleBetween(method.outputs[i], reference.At(method.display_times[i])));
+  }
+  if (errors.empty()) {
+    printf("%-8s no frames with a reference\n", method.name);
+    return;
+  }
+  double sum = 0.0;
+  for (double e : errors) sum += e;
+  std::sort(errors.begin(), errors.end());
+  const double kDegrees = 180.0 / M_PI;
+
+  int best_ms = 0;
+  double best_error = 1e9;
+  for (int ms = -kMaxLatencyMs; ms <= kMaxLatencyMs; ++ms) {
+    double total = 0.0;
+    int count = 0;
+    for (size_t i = 0; i < method.outputs.size(); ++i) {
+      const int64_t time = method.display_times[i] - ms * 1000000LL;
+      if (!reference.Covers(time)) continue;
+      total += AngleBetween(method.outputs[i], reference.At(time));
+      ++count;
+    }
+    if (count > 0 && total / count < best_error) {
+      best_error = total / count;
+      best_ms = ms;
+    }
+  }
+  printf("%-8s mean %.3f deg, p95 %.3f deg, max %.3f deg; "
+         "effective latency %d ms\n",
+         method.name, sum / errors.size() * kDegrees,
+         errors[errors.size() * 95 / 100] * kDegrees,
+         errors.back() * kDegrees, best_ms);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<ControllerSensorSample> samples;
+  Track reference;
+  const bool recorded = argc > 1 && strcmp(argv[1], "-") != 0;
+  if (recorded) {
+    if (!ReadLog(argv[1], &samples)) return 1;
+    for (const ControllerSensorSample& s : samples) {
+      reference.Add(s.orientation_timestamp, FromController(s.orientation));
+    }
+  } else {
+    GenerateLog(&samples, &reference);
+  }
+  const double latency_ms =
+      argc > 2 ? atof(argv[2]) : kDefaultDisplayLatencyMs;
+  const int64_t display_latency_nanos =
+      static_cast<int64_t>(latency_ms * 1000000.0);
+  printf("%s log: %zu readings; display latency %.1f ms\n",
+         recorded ? "Recorded" : "Synthetic", samples.size(), latency_ms);
+
+  // Replay the log frame by frame: each frame sees the readings up to its
+  // start, like ControllerState::Update() does.
+  Method fused = {"fused", {}, {}};
+  Method filter = {"filter", {}, {}};
+  ControllerFusion fusion;
+  size_t next = 0;
+  Quat latest_fused = {0.0, 0.0, 0.0, 1.0};
+  for (int64_t frame = samples.front().gyro_timestamp;
+       frame <= samples.back().gyro_timestamp; frame += kFramePeriodNanos) {
+    while (next < samples.size() && samples[next].gyro_timestamp <= frame) {
+      fusion.AddSample(samples[next]);
+      latest_fused = FromController(samples[next].orientation);
+      ++next;
+    }
+    if (!fusion.IsInitialized()) continue;
+    const int64_t display_time = frame + display_latency_nanos;
+    fused.display_times.push_back(display_time);
+    fused.outputs.push_back(latest_fused);
+    filter.display_times.push_back(display_time);
+    filter.outputs.push_back(
+        FromController(fusion.GetPredictedOrientation(display_time)));
+  }
+  Report(fused, reference);
+  Report(filter, reference);
+
+  // The filter must not depend on how the readings are batched.
+  for (; next < samples.size(); ++next) fusion.AddSample(samples[next]);
+  ControllerFusion batched;
+  batched.AddSamples(samples.data(), samples.size());
+  const gvr::ControllerQuat a = batched.GetOrientation();
+  const gvr::ControllerQuat b = fusion.GetOrientation();
+  const bool identical = memcmp(&a, &b, sizeof(a)) == 0;
+  printf("Batched replay %s\n",
+         identical ? "is bit-identical" : "DIFFERS from frame by frame replay");
+  return identical ? 0 : 1;
+}
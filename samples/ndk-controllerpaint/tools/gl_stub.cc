@@ -0,0 +1,913 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side stand-in for OpenGL ES 2, EGL and GVR buffers, see gl_stub.h.
+
+#include "gl_stub.h"  // NOLINT
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>  // NOLINT
+
+#include "vr/gvr/capi/include/gvr.h"
+#include "vr/gvr/capi/include/gvr_controller.h"
+
+struct gvr_buffer_viewport_ {
+  gvr_rectf source_uv;
+  gvr_rectf source_fov;
+  gvr_mat4f transform;
+  int32_t target_eye;
+  int32_t source_buffer_index;
+  int32_t reprojection;
+};
+
+struct gvr_buffer_viewport_list_ {
+  std::vector<gvr_buffer_viewport_> viewports;
+};
+
+struct gvr_controller_state_ {
+  GlStubController current;
+  GlStubController previous;
+  int64_t timestamp_nanos;
+};
+
+namespace {
+const gvr_mat4f kIdentity = {{{1.0f, 0.0f, 0.0f, 0.0f},
+                              {0.0f, 1.0f, 0.0f, 0.0f},
+                              {0.0f, 0.0f, 1.0f, 0.0f},
+                              {0.0f, 0.0f, 0.0f, 1.0f}}};
+// Half of the distance between the eyes, in meters.
+const float kHalfIpd = 0.032f;
+const float kFieldOfView = 40.0f;
+const gvr_sizei kRenderTargetSize = {2048, 1024};
+
+std::vector<std::string> calls;
+bool recording = true;
+std::string version = "OpenGL ES 2.0";
+std::string extensions;
+GLuint next_name = 1;
+int next_object = 1;
+std::string viewer_model = "Stub viewer";
+GlStubDistortion distortion;
+int32_t viewer_type = GVR_VIEWER_TYPE_CARDBOARD;
+gvr_mat4f head_pose = kIdentity;
+GlStubController controller = {{0.0f, 0.0f, 0.0f, 1.0f}, false, {0.0f, 0.0f},
+                               {false}};
+// Backs the buffers mapped with glMapBufferRange().
+std::vector<uint8_t> mapped_buffer;
+
+void Record(const char* format, ...) {
+  if (!recording) return;
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  calls.push_back(text);
+}
+
+void RecordInvalidate(const char* name, GLenum target, GLsizei count,
+                      const GLenum* attachments) {
+  if (!recording) return;
+  std::string text = name;
+  char number[32];
+  snprintf(number, sizeof(number), "(%#x, %d, {", target, count);
+  text += number;
+  for (GLsizei i = 0; i < count; ++i) {
+    snprintf(number, sizeof(number), "%s%#x", i > 0 ? ", " : "",
+             attachments[i]);
+    text += number;
+  }
+  text += "})";
+  calls.push_back(text);
+}
+
+void GenNames(const char* function, GLsizei count, GLuint* names) {
+  for (GLsizei i = 0; i < count; ++i) names[i] = next_name++;
+  Record("%s(%d) = %u", function, count, count > 0 ? names[0] : 0);
+}
+
+void DeleteNames(const char* function, GLsizei count, const GLuint* names) {
+  Record("%s(%d, %u)", function, count, count > 0 ? names[0] : 0);
+}
+
+// Opaque GVR objects are never dereferenced, so any distinct address works.
+template <typename T>
+T* NewObject() {
+  return reinterpret_cast<T*>(static_cast<uintptr_t>(next_object++) * 16);
+}
+
+void GL_APIENTRY InvalidateFramebuffer(GLenum target, GLsizei count,
+                                       const GLenum* attachments) {
+  RecordInvalidate("glInvalidateFramebuffer", target, count, attachments);
+}
+
+void GL_APIENTRY DiscardFramebufferEXT(GLenum target, GLsizei count,
+                                       const GLenum* attachments) {
+  RecordInvalidate("glDiscardFramebufferEXT", target, count, attachments);
+}
+}  // namespace
+
+void GlStubReset(const char* new_version, const char* new_extensions) {
+  calls.clear();
+  next_name = 1;
+  version = new_version;
+  extensions = new_extensions;
+}
+
+void GlStubSetViewer(const char* model, const GlStubDistortion& function) {
+  viewer_model = model;
+  distortion = function;
+}
+
+void GlStubSetViewerType(int32_t type) { viewer_type = type; }
+
+void GlStubSetHeadPose(const gvr_mat4f& head_from_start) {
+  head_pose = head_from_start;
+}
+
+void GlStubSetController(const GlStubController& state) {
+  controller = state;
+}
+
+gvr_context* GlStubContext() {
+  static gvr_context* const context = NewObject<gvr_context>();
+  return context;
+}
+
+void GlStubSetRecording(bool enabled) { recording = enabled; }
+
+const std::vector<std::string>& GlStubCalls() { return calls; }
+
+void GlStubClearCalls() { calls.clear(); }
+
+int GlStubFind(const std::string& prefix, int from) {
+  for (int i = from; i < static_cast<int>(calls.size()); ++i) {
+    if (calls[i].compare(0, prefix.size(), prefix) == 0) return i;
+  }
+  return -1;
+}
+
+int GlStubCount(const std::string& prefix) {
+  int count = 0;
+  for (int i = GlStubFind(prefix); i >= 0; i = GlStubFind(prefix, i + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+extern "C" {
+
+EGLDisplay eglGetCurrentDisplay() { return EGL_NO_DISPLAY; }
+
+__eglMustCastToProperFunctionPointerType eglGetProcAddress(
+    const char* name) {
+  Record("eglGetProcAddress(%s)", name);
+  if (strcmp(name, "glInvalidateFramebuffer") == 0) {
+    return reinterpret_cast<__eglMustCastToProperFunctionPointerType>(
+        InvalidateFramebuffer);
+  }
+  if (strcmp(name, "glDiscardFramebufferEXT") == 0) {
+    return reinterpret_cast<__eglMustCastToProperFunctionPointerType>(
+        DiscardFramebufferEXT);
+  }
+  return nullptr;
+}
+
+const char* eglQueryString(EGLDisplay /* display */, EGLint /* name */) {
+  return "";
+}
+
+const GLubyte* GL_APIENTRY glGetString(GLenum name) {
+  Record("glGetString(%#x)", name);
+  if (name == GL_VERSION) {
+    return reinterpret_cast<const GLubyte*>(version.c_str());
+  }
+  if (name == GL_EXTENSIONS) {
+    return reinterpret_cast<const GLubyte*>(extensions.c_str());
+  }
+  return reinterpret_cast<const GLubyte*>("");
+}
+
+void GL_APIENTRY glActiveTexture(GLenum texture) {
+  Record("glActiveTexture(%#x)", texture);
+}
+
+void GL_APIENTRY glAttachShader(GLuint program, GLuint shader) {
+  Record("glAttachShader(%u, %u)", program, shader);
+}
+
+void GL_APIENTRY glBindBuffer(GLenum target, GLuint buffer) {
+  Record("glBindBuffer(%#x, %u)", target, buffer);
+}
+
+void GL_APIENTRY glBindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                                   GLintptr offset, GLsizeiptr size) {
+  Record("glBindBufferRange(%#x, %u, %u, %ld, %ld)", target, index, buffer,
+         static_cast<long>(offset), static_cast<long>(size));
+}
+
+void GL_APIENTRY glBindFramebuffer(GLenum target, GLuint framebuffer) {
+  Record("glBindFramebuffer(%#x, %u)", target, framebuffer);
+}
+
+void GL_APIENTRY glBindRenderbuffer(GLenum target, GLuint renderbuffer) {
+  Record("glBindRenderbuffer(%#x, %u)", target, renderbuffer);
+}
+
+void GL_APIENTRY glBindTexture(GLenum target, GLuint texture) {
+  Record("glBindTexture(%#x, %u)", target, texture);
+}
+
+void GL_APIENTRY glBlendFunc(GLenum source, GLenum destination) {
+  Record("glBlendFunc(%#x, %#x)", source, destination);
+}
+
+void GL_APIENTRY glBlendFuncSeparate(GLenum source_rgb, GLenum destination_rgb,
+                                     GLenum source_alpha,
+                                     GLenum destination_alpha) {
+  Record("glBlendFuncSeparate(%#x, %#x, %#x, %#x)", source_rgb,
+         destination_rgb, source_alpha, destination_alpha);
+}
+
+void GL_APIENTRY glBufferData(GLenum target, GLsizeiptr size,
+                              const void* /* data */, GLenum usage) {
+  Record("glBufferData(%#x, %ld, %#x)", target, static_cast<long>(size),
+         usage);
+}
+
+GLenum GL_APIENTRY glClientWaitSync(GLsync sync, GLbitfield flags,
+                                   GLuint64 /* timeout */) {
+  Record("glClientWaitSync(%p, %#x)", static_cast<void*>(sync), flags);
+  return GL_ALREADY_SIGNALED;
+}
+
+void GL_APIENTRY glCompileShader(GLuint shader) {
+  Record("glCompileShader(%u)", shader);
+}
+
+GLuint GL_APIENTRY glCreateProgram() {
+  Record("glCreateProgram() = %u", next_name);
+  return next_name++;
+}
+
+GLuint GL_APIENTRY glCreateShader(GLenum type) {
+  Record("glCreateShader(%#x) = %u", type, next_name);
+  return next_name++;
+}
+
+GLenum GL_APIENTRY glCheckFramebufferStatus(GLenum target) {
+  Record("glCheckFramebufferStatus(%#x)", target);
+  return GL_FRAMEBUFFER_COMPLETE;
+}
+
+void GL_APIENTRY glClear(GLbitfield mask) { Record("glClear(%#x)", mask); }
+
+void GL_APIENTRY glClearColor(GLfloat red, GLfloat green, GLfloat blue,
+                              GLfloat alpha) {
+  Record("glClearColor(%g, %g, %g, %g)", red, green, blue, alpha);
+}
+
+void GL_APIENTRY glClearDepthf(GLfloat depth) {
+  Record("glClearDepthf(%g)", depth);
+}
+
+void GL_APIENTRY glColorMask(GLboolean red, GLboolean green, GLboolean blue,
+                             GLboolean alpha) {
+  Record("glColorMask(%d, %d, %d, %d)", red, green, blue, alpha);
+}
+
+void GL_APIENTRY glDeleteBuffers(GLsizei count, const GLuint* buffers) {
+  DeleteNames("glDeleteBuffers", count, buffers);
+}
+
+void GL_APIENTRY glDeleteFramebuffers(GLsizei count,
+                                      const GLuint* framebuffers) {
+  DeleteNames("glDeleteFramebuffers", count, framebuffers);
+}
+
+void GL_APIENTRY glDeleteRenderbuffers(GLsizei count,
+                                       const GLuint* renderbuffers) {
+  DeleteNames("glDeleteRenderbuffers", count, renderbuffers);
+}
+
+void GL_APIENTRY glDeleteShader(GLuint shader) {
+  Record("glDeleteShader(%u)", shader);
+}
+
+void GL_APIENTRY glDeleteSync(GLsync sync) {
+  Record("glDeleteSync(%p)", static_cast<void*>(sync));
+}
+
+void GL_APIENTRY glDeleteTextures(GLsizei count, const GLuint* textures) {
+  DeleteNames("glDeleteTextures", count, textures);
+}
+
+void GL_APIENTRY glDepthMask(GLboolean flag) {
+  Record("glDepthMask(%d)", flag);
+}
+
+void GL_APIENTRY glDetachShader(GLuint program, GLuint shader) {
+  Record("glDetachShader(%u, %u)", program, shader);
+}
+
+void GL_APIENTRY glDisable(GLenum capability) {
+  Record("glDisable(%#x)", capability);
+}
+
+void GL_APIENTRY glDisableVertexAttribArray(GLuint index) {
+  Record("glDisableVertexAttribArray(%u)", index);
+}
+
+void GL_APIENTRY glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  Record("glDrawArrays(%#x, %d, %d)", mode, first, count);
+}
+
+void GL_APIENTRY glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                const void* /* indices */) {
+  Record("glDrawElements(%#x, %d, %#x)", mode, count, type);
+}
+
+void GL_APIENTRY glEnable(GLenum capability) {
+  Record("glEnable(%#x)", capability);
+}
+
+void GL_APIENTRY glEnableVertexAttribArray(GLuint index) {
+  Record("glEnableVertexAttribArray(%u)", index);
+}
+
+GLsync GL_APIENTRY glFenceSync(GLenum condition, GLbitfield flags) {
+  GLsync sync = NewObject<__GLsync>();
+  Record("glFenceSync(%#x, %#x) = %p", condition, flags,
+         static_cast<void*>(sync));
+  return sync;
+}
+
+void GL_APIENTRY glFramebufferRenderbuffer(GLenum target, GLenum attachment,
+                                           GLenum renderbuffer_target,
+                                           GLuint renderbuffer) {
+  Record("glFramebufferRenderbuffer(%#x, %#x, %#x, %u)", target, attachment,
+         renderbuffer_target, renderbuffer);
+}
+
+void GL_APIENTRY glFramebufferTexture2D(GLenum target, GLenum attachment,
+                                        GLenum texture_target, GLuint texture,
+                                        GLint level) {
+  Record("glFramebufferTexture2D(%#x, %#x, %#x, %u, %d)", target, attachment,
+         texture_target, texture, level);
+}
+
+void GL_APIENTRY glGenBuffers(GLsizei count, GLuint* buffers) {
+  GenNames("glGenBuffers", count, buffers);
+}
+
+void GL_APIENTRY glGenerateMipmap(GLenum target) {
+  Record("glGenerateMipmap(%#x)", target);
+}
+
+void GL_APIENTRY glGenFramebuffers(GLsizei count, GLuint* framebuffers) {
+  GenNames("glGenFramebuffers", count, framebuffers);
+}
+
+void GL_APIENTRY glGenRenderbuffers(GLsizei count, GLuint* renderbuffers) {
+  GenNames("glGenRenderbuffers", count, renderbuffers);
+}
+
+void GL_APIENTRY glGenTextures(GLsizei count, GLuint* textures) {
+  GenNames("glGenTextures", count, textures);
+}
+
+GLint GL_APIENTRY glGetAttribLocation(GLuint program, const GLchar* name) {
+  Record("glGetAttribLocation(%u, %s)", program, name);
+  return 0;
+}
+
+GLenum GL_APIENTRY glGetError() { return GL_NO_ERROR; }
+
+void GL_APIENTRY glGetIntegerv(GLenum name, GLint* value) {
+  *value = name == GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT ? 256 : 0;
+}
+
+void GL_APIENTRY glGetProgramiv(GLuint /* program */, GLenum /* name */,
+                                GLint* value) {
+  *value = GL_TRUE;
+}
+
+void GL_APIENTRY glGetShaderiv(GLuint /* shader */, GLenum /* name */,
+                               GLint* value) {
+  *value = GL_TRUE;
+}
+
+void GL_APIENTRY glGetShaderPrecisionFormat(GLenum /* shader_type */,
+                                            GLenum /* precision_type */,
+                                            GLint* range, GLint* precision) {
+  // Single precision floats, as on most GPUs.
+  range[0] = range[1] = 127;
+  *precision = 23;
+}
+
+GLuint GL_APIENTRY glGetUniformBlockIndex(GLuint program,
+                                         const GLchar* name) {
+  Record("glGetUniformBlockIndex(%u, %s)", program, name);
+  return 0;
+}
+
+GLint GL_APIENTRY glGetUniformLocation(GLuint program, const GLchar* name) {
+  Record("glGetUniformLocation(%u, %s)", program, name);
+  return 0;
+}
+
+void GL_APIENTRY glLinkProgram(GLuint program) {
+  Record("glLinkProgram(%u)", program);
+}
+
+void* GL_APIENTRY glMapBufferRange(GLenum target, GLintptr offset,
+                                   GLsizeiptr length, GLbitfield access) {
+  Record("glMapBufferRange(%#x, %ld, %ld, %#x)", target,
+         static_cast<long>(offset), static_cast<long>(length), access);
+  if (mapped_buffer.size() < static_cast<size_t>(length)) {
+    mapped_buffer.resize(length);
+  }
+  return mapped_buffer.data();
+}
+
+void GL_APIENTRY glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                              GLenum format, GLenum type, void* pixels) {
+  Record("glReadPixels(%d, %d, %d, %d, %#x, %#x)", x, y, width, height,
+         format, type);
+  // Only the RGBA, unsigned byte format is read back by the samples.
+  memset(pixels, 0, static_cast<size_t>(width) * height * 4);
+}
+
+void GL_APIENTRY glRenderbufferStorage(GLenum target, GLenum format,
+                                       GLsizei width, GLsizei height) {
+  Record("glRenderbufferStorage(%#x, %#x, %d, %d)", target, format, width,
+         height);
+}
+
+void GL_APIENTRY glShaderSource(GLuint shader, GLsizei count,
+                                const GLchar* const* /* source */,
+                                const GLint* /* length */) {
+  Record("glShaderSource(%u, %d)", shader, count);
+}
+
+void GL_APIENTRY glScissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+  Record("glScissor(%d, %d, %d, %d)", x, y, width, height);
+}
+
+void GL_APIENTRY glTexImage2D(GLenum target, GLint level,
+                              GLint internal_format, GLsizei width,
+                              GLsizei height, GLint /* border */,
+                              GLenum format, GLenum type,
+                              const void* /* pixels */) {
+  Record("glTexImage2D(%#x, %d, %#x, %d, %d, %#x, %#x)", target, level,
+         internal_format, width, height, format, type);
+}
+
+void GL_APIENTRY glTexParameteri(GLenum target, GLenum name, GLint value) {
+  Record("glTexParameteri(%#x, %#x, %#x)", target, name, value);
+}
+
+void GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint x,
+                                 GLint y, GLsizei width, GLsizei height,
+                                 GLenum format, GLenum type,
+                                 const void* /* pixels */) {
+  Record("glTexSubImage2D(%#x, %d, %d, %d, %d, %d, %#x, %#x)", target, level,
+         x, y, width, height, format, type);
+}
+
+void GL_APIENTRY glUniform1i(GLint location, GLint value) {
+  Record("glUniform1i(%d, %d)", location, value);
+}
+
+void GL_APIENTRY glUniform2fv(GLint location, GLsizei count,
+                              const GLfloat* /* value */) {
+  Record("glUniform2fv(%d, %d)", location, count);
+}
+
+void GL_APIENTRY glUniform3fv(GLint location, GLsizei count,
+                              const GLfloat* /* value */) {
+  Record("glUniform3fv(%d, %d)", location, count);
+}
+
+void GL_APIENTRY glUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z,
+                             GLfloat w) {
+  Record("glUniform4f(%d, %g, %g, %g, %g)", location, x, y, z, w);
+}
+
+void GL_APIENTRY glUniform4fv(GLint location, GLsizei count,
+                              const GLfloat* /* value */) {
+  Record("glUniform4fv(%d, %d)", location, count);
+}
+
+void GL_APIENTRY glUniformBlockBinding(GLuint program, GLuint block,
+                                       GLuint binding) {
+  Record("glUniformBlockBinding(%u, %u, %u)", program, block, binding);
+}
+
+void GL_APIENTRY glUniformMatrix4fv(GLint location, GLsizei count,
+                                    GLboolean transpose,
+                                    const GLfloat* /* value */) {
+  Record("glUniformMatrix4fv(%d, %d, %d)", location, count, transpose);
+}
+
+GLboolean GL_APIENTRY glUnmapBuffer(GLenum target) {
+  Record("glUnmapBuffer(%#x)", target);
+  return GL_TRUE;
+}
+
+void GL_APIENTRY glUseProgram(GLuint program) {
+  Record("glUseProgram(%u)", program);
+}
+
+void GL_APIENTRY glVertexAttrib3f(GLuint index, GLfloat x, GLfloat y,
+                                  GLfloat z) {
+  Record("glVertexAttrib3f(%u, %g, %g, %g)", index, x, y, z);
+}
+
+void GL_APIENTRY glVertexAttrib4f(GLuint index, GLfloat x, GLfloat y,
+                                  GLfloat z, GLfloat w) {
+  Record("glVertexAttrib4f(%u, %g, %g, %g, %g)", index, x, y, z, w);
+}
+
+void GL_APIENTRY glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                       GLboolean normalized, GLsizei stride,
+                                       const void* /* pointer */) {
+  Record("glVertexAttribPointer(%u, %d, %#x, %d, %d)", index, size, type,
+         normalized, stride);
+}
+
+void GL_APIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  Record("glViewport(%d, %d, %d, %d)", x, y, width, height);
+}
+
+void gvr_destroy(gvr_context** gvr) { *gvr = nullptr; }
+
+const char* gvr_get_viewer_model(const gvr_context* /* gvr */) {
+  return viewer_model.c_str();
+}
+
+void gvr_compute_distorted_point(const gvr_context* /* gvr */,
+                                 const int32_t eye, const gvr_vec2f uv_in,
+                                 gvr_vec2f uv_out[3]) {
+  if (distortion) {
+    distortion(eye, uv_in, uv_out);
+  } else {
+    uv_out[0] = uv_out[1] = uv_out[2] = uv_in;
+  }
+}
+
+gvr_buffer_spec* gvr_buffer_spec_create(gvr_context* /* gvr */) {
+  return NewObject<gvr_buffer_spec>();
+}
+
+void gvr_buffer_spec_destroy(gvr_buffer_spec** spec) { *spec = nullptr; }
+
+void gvr_buffer_spec_set_size(gvr_buffer_spec* /* spec */,
+                              gvr_sizei /* size */) {}
+
+void gvr_buffer_spec_set_samples(gvr_buffer_spec* /* spec */,
+                                 int32_t /* num_samples */) {}
+
+void gvr_buffer_spec_set_color_format(gvr_buffer_spec* /* spec */,
+                                      int32_t /* color_format */) {}
+
+void gvr_buffer_spec_set_depth_stencil_format(
+    gvr_buffer_spec* /* spec */, int32_t /* depth_stencil_format */) {}
+
+gvr_swap_chain* gvr_swap_chain_create(gvr_context* /* gvr */,
+                                      const gvr_buffer_spec** /* buffers */,
+                                      int32_t count) {
+  Record("gvr_swap_chain_create(%d)", count);
+  return NewObject<gvr_swap_chain>();
+}
+
+void gvr_swap_chain_destroy(gvr_swap_chain** swap_chain) {
+  Record("gvr_swap_chain_destroy()");
+  *swap_chain = nullptr;
+}
+
+void gvr_swap_chain_resize_buffer(gvr_swap_chain* /* swap_chain */,
+                                  int32_t index, gvr_sizei size) {
+  Record("gvr_swap_chain_resize_buffer(%d, %d, %d)", index, size.width,
+         size.height);
+}
+
+void gvr_frame_bind_buffer(gvr_frame* /* frame */, int32_t index) {
+  Record("gvr_frame_bind_buffer(%d)", index);
+}
+
+void gvr_frame_unbind(gvr_frame* /* frame */) {
+  Record("gvr_frame_unbind()");
+}
+
+gvr_clock_time_point gvr_get_time_point_now() {
+  gvr_clock_time_point time;
+  time.monotonic_system_time_nanos = static_cast<int64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+  return time;
+}
+
+void gvr_initialize_gl(gvr_context* /* gvr */) {
+  Record("gvr_initialize_gl()");
+}
+
+int32_t gvr_get_error(gvr_context* /* gvr */) { return GVR_ERROR_NONE; }
+
+int32_t gvr_clear_error(gvr_context* /* gvr */) { return GVR_ERROR_NONE; }
+
+int32_t gvr_get_viewer_type(const gvr_context* /* gvr */) {
+  return viewer_type;
+}
+
+void gvr_pause_tracking(gvr_context* /* gvr */) {
+  Record("gvr_pause_tracking()");
+}
+
+void gvr_resume_tracking(gvr_context* /* gvr */) {
+  Record("gvr_resume_tracking()");
+}
+
+gvr_mat4f gvr_get_head_space_from_start_space_rotation(
+    const gvr_context* /* gvr */, const gvr_clock_time_point /* time */) {
+  return head_pose;
+}
+
+gvr_mat4f gvr_get_eye_from_head_matrix(const gvr_context* /* gvr */,
+                                       const int32_t eye) {
+  gvr_mat4f eye_from_head = kIdentity;
+  eye_from_head.m[0][3] = eye == GVR_LEFT_EYE ? kHalfIpd : -kHalfIpd;
+  return eye_from_head;
+}
+
+gvr_sizei gvr_get_maximum_effective_render_target_size(
+    const gvr_context* /* gvr */) {
+  return kRenderTargetSize;
+}
+
+gvr_buffer_viewport* gvr_buffer_viewport_create(gvr_context* /* gvr */) {
+  gvr_buffer_viewport* viewport = new gvr_buffer_viewport;
+  viewport->source_uv = {0.0f, 1.0f, 0.0f, 1.0f};
+  viewport->source_fov = {kFieldOfView, kFieldOfView, kFieldOfView,
+                          kFieldOfView};
+  viewport->transform = kIdentity;
+  viewport->target_eye = GVR_LEFT_EYE;
+  viewport->source_buffer_index = 0;
+  viewport->reprojection = GVR_REPROJECTION_FULL;
+  return viewport;
+}
+
+void gvr_buffer_viewport_destroy(gvr_buffer_viewport** viewport) {
+  delete *viewport;
+  *viewport = nullptr;
+}
+
+gvr_rectf gvr_buffer_viewport_get_source_uv(
+    const gvr_buffer_viewport* viewport) {
+  return viewport->source_uv;
+}
+
+void gvr_buffer_viewport_set_source_uv(gvr_buffer_viewport* viewport,
+                                       gvr_rectf uv) {
+  viewport->source_uv = uv;
+}
+
+gvr_rectf gvr_buffer_viewport_get_source_fov(
+    const gvr_buffer_viewport* viewport) {
+  return viewport->source_fov;
+}
+
+void gvr_buffer_viewport_set_transform(gvr_buffer_viewport* viewport,
+                                       gvr_mat4f transform) {
+  viewport->transform = transform;
+}
+
+int32_t gvr_buffer_viewport_get_target_eye(
+    const gvr_buffer_viewport* viewport) {
+  return viewport->target_eye;
+}
+
+void gvr_buffer_viewport_set_target_eye(gvr_buffer_viewport* viewport,
+                                        int32_t index) {
+  viewport->target_eye = index;
+}
+
+void gvr_buffer_viewport_set_source_buffer_index(
+    gvr_buffer_viewport* viewport, int32_t buffer_index) {
+  viewport->source_buffer_index = buffer_index;
+}
+
+void gvr_buffer_viewport_set_reprojection(gvr_buffer_viewport* viewport,
+                                          int32_t reprojection) {
+  viewport->reprojection = reprojection;
+}
+
+gvr_buffer_viewport_list* gvr_buffer_viewport_list_create(
+    const gvr_context* /* gvr */) {
+  return new gvr_buffer_viewport_list;
+}
+
+void gvr_buffer_viewport_list_destroy(
+    gvr_buffer_viewport_list** viewport_list) {
+  delete *viewport_list;
+  *viewport_list = nullptr;
+}
+
+size_t gvr_buffer_viewport_list_get_size(
+    const gvr_buffer_viewport_list* viewport_list) {
+  return viewport_list->viewports.size();
+}
+
+void gvr_buffer_viewport_list_get_item(
+    const gvr_buffer_viewport_list* viewport_list, size_t index,
+    gvr_buffer_viewport* viewport) {
+  *viewport = viewport_list->viewports[index];
+}
+
+void gvr_buffer_viewport_list_set_item(
+    gvr_buffer_viewport_list* viewport_list, size_t index,
+    const gvr_buffer_viewport* viewport) {
+  if (index == viewport_list->viewports.size()) {
+    viewport_list->viewports.push_back(*viewport);
+  } else {
+    viewport_list->viewports[index] = *viewport;
+  }
+}
+
+void gvr_get_recommended_buffer_viewports(
+    const gvr_context* gvr, gvr_buffer_viewport_list* viewport_list) {
+  viewport_list->viewports.clear();
+  for (int32_t eye = GVR_LEFT_EYE; eye <= GVR_RIGHT_EYE; ++eye) {
+    gvr_buffer_viewport* viewport =
+        gvr_buffer_viewport_create(const_cast<gvr_context*>(gvr));
+    viewport->target_eye = eye;
+    viewport->source_uv = {eye == GVR_LEFT_EYE ? 0.0f : 0.5f,
+                           eye == GVR_LEFT_EYE ? 0.5f : 1.0f, 0.0f, 1.0f};
+    viewport_list->viewports.push_back(*viewport);
+    gvr_buffer_viewport_destroy(&viewport);
+  }
+}
+
+gvr_frame* gvr_swap_chain_acquire_frame(gvr_swap_chain* /* swap_chain */) {
+  Record("gvr_swap_chain_acquire_frame()");
+  return NewObject<gvr_frame>();
+}
+
+void gvr_frame_submit(gvr_frame** frame,
+                      const gvr_buffer_viewport_list* viewport_list,
+                      gvr_mat4f /* head_space_from_start_space */) {
+  Record("gvr_frame_submit(%zu)", viewport_list->viewports.size());
+  *frame = nullptr;
+}
+
+int32_t gvr_controller_get_default_options() {
+  return GVR_CONTROLLER_ENABLE_ORIENTATION | GVR_CONTROLLER_ENABLE_TOUCH;
+}
+
+gvr_controller_context* gvr_controller_create_and_init(
+    int32_t options, gvr_context* /* context */) {
+  Record("gvr_controller_create_and_init(%#x)", options);
+  return NewObject<gvr_controller_context>();
+}
+
+void gvr_controller_destroy(gvr_controller_context** api) { *api = nullptr; }
+
+void gvr_controller_pause(gvr_controller_context* /* api */) {
+  Record("gvr_controller_pause()");
+}
+
+void gvr_controller_resume(gvr_controller_context* /* api */) {
+  Record("gvr_controller_resume()");
+}
+
+const char* gvr_controller_api_status_to_string(int32_t /* status */) {
+  return "OK";
+}
+
+const char* gvr_controller_connection_state_to_string(int32_t /* state */) {
+  return "CONNECTED";
+}
+
+const char* gvr_controller_battery_level_to_string(int32_t /* level */) {
+  return "FULL";
+}
+
+gvr_controller_state* gvr_controller_state_create() {
+  gvr_controller_state* state = new gvr_controller_state;
+  state->current = state->previous = controller;
+  state->timestamp_nanos = 0;
+  return state;
+}
+
+void gvr_controller_state_destroy(gvr_controller_state** state) {
+  delete *state;
+  *state = nullptr;
+}
+
+void gvr_controller_state_update(gvr_controller_context* /* api */,
+                                 int32_t /* flags */,
+                                 gvr_controller_state* out_state) {
+  out_state->previous = out_state->current;
+  out_state->current = controller;
+  out_state->timestamp_nanos =
+      gvr_get_time_point_now().monotonic_system_time_nanos;
+}
+
+int32_t gvr_controller_state_get_api_status(
+    const gvr_controller_state* /* state */) {
+  return GVR_CONTROLLER_API_OK;
+}
+
+int32_t gvr_controller_state_get_connection_state(
+    const gvr_controller_state* /* state */) {
+  return GVR_CONTROLLER_CONNECTED;
+}
+
+gvr_quatf gvr_controller_state_get_orientation(
+    const gvr_controller_state* state) {
+  return state->current.orientation;
+}
+
+gvr_vec3f gvr_controller_state_get_gyro(
+    const gvr_controller_state* /* state */) {
+  return {0.0f, 0.0f, 0.0f};
+}
+
+gvr_vec3f gvr_controller_state_get_accel(
+    const gvr_controller_state* /* state */) {
+  // At rest, the accelerometer measures gravity.
+  return {0.0f, 9.8f, 0.0f};
+}
+
+bool gvr_controller_state_is_touching(const gvr_controller_state* state) {
+  return state->current.touching;
+}
+
+gvr_vec2f gvr_controller_state_get_touch_pos(
+    const gvr_controller_state* state) {
+  return state->current.touch_pos;
+}
+
+bool gvr_controller_state_get_touch_down(const gvr_controller_state* state) {
+  return state->current.touching && !state->previous.touching;
+}
+
+bool gvr_controller_state_get_touch_up(const gvr_controller_state* state) {
+  return !state->current.touching && state->previous.touching;
+}
+
+bool gvr_controller_state_get_button_down(const gvr_controller_state* state,
+                                          int32_t button) {
+  return state->current.buttons[button] && !state->previous.buttons[button];
+}
+
+bool gvr_controller_state_get_button_up(const gvr_controller_state* state,
+                                        int32_t button) {
+  return !state->current.buttons[button] && state->previous.buttons[button];
+}
+
+int64_t gvr_controller_state_get_last_orientation_timestamp(
+    const gvr_controller_state* state) {
+  return state->timestamp_nanos;
+}
+
+int64_t gvr_controller_state_get_last_gyro_timestamp(
+    const gvr_controller_state* state) {
+  return state->timestamp_nanos;
+}
+
+int64_t gvr_controller_state_get_last_accel_timestamp(
+    const gvr_controller_state* state) {
+  return state->timestamp_nanos;
+}
+
+bool gvr_controller_state_get_battery_charging(
+    const gvr_controller_state* /* state */) {
+  return false;
+}
+
+int32_t gvr_controller_state_get_battery_level(
+    const gvr_controller_state* /* state */) {
+  return GVR_CONTROLLER_BATTERY_LEVEL_FULL;
+}
+
+}  // extern "C"
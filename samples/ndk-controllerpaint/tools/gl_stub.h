@@ -0,0 +1,129 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_TOOLS_GLSTUB_H_  // NOLINT
+#define NDK_SAMPLES_TOOLS_GLSTUB_H_  // NOLINT
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * Host-side stand-in for the OpenGL ES 3 and EGL entry points that the
+ * rendering modules in src/main/jni call, and for the GVR functions behind
+ * gvr::GvrApi, gvr::Frame, gvr::BufferSpec, gvr::SwapChain, the buffer
+ * viewports and gvr::ControllerApi, implemented in gl_stub.cc.
+ * It lets host tools link those modules, and whole sample apps, and check
+ * what they ask of the driver, without a GPU or a headset.
+ *
+ * Every call is recorded as a line of text with its arguments, in the order
+ * it is made, e.g. "glClear(0x4100)". Enums and bitfields are printed in
+ * hexadecimal, other integers in decimal. Object names are handed out in
+ * sequence from 1, and shaders, programs and framebuffers always succeed.
+ * EGL fences are not supported, and GL sync objects are always signaled.
+ *
+ * The viewer renders each eye into half of one buffer, with a 40 degree
+ * field of view on every side. The head pose and the controller state are
+ * whatever was last set with GlStubSetHeadPose() and GlStubSetController().
+ */
+
+/**
+ * Computes gvr_compute_distorted_point(): fills |uv_out| with the positions
+ * in the eye buffer of |eye| shown at |uv_in| on the screen, for the red,
+ * green and blue channels.
+ */
+typedef std::function<void(int32_t eye, const gvr_vec2f& uv_in,
+                           gvr_vec2f uv_out[3])>
+    GlStubDistortion;
+
+/**
+ * State of the stub Daydream controller. Button and touch events are
+ * reported when the state changes between two gvr_controller_state_update()
+ * calls.
+ */
+struct GlStubController {
+  gvr_quatf orientation;
+  bool touching;
+  gvr_vec2f touch_pos;
+  bool buttons[GVR_CONTROLLER_BUTTON_COUNT];
+};
+
+/**
+ * Forget the recorded calls, and make glGetString() return |version| and
+ * |extensions|, e.g. "OpenGL ES 3.0" and "".
+ */
+void GlStubReset(const char* version, const char* extensions);
+
+/**
+ * Make gvr_get_viewer_model() return |model|, and
+ * gvr_compute_distorted_point() call |distortion|. Without a distortion,
+ * every point maps to itself.
+ */
+void GlStubSetViewer(const char* model, const GlStubDistortion& distortion);
+
+/**
+ * Make gvr_get_viewer_type() return |type|, e.g. GVR_VIEWER_TYPE_DAYDREAM.
+ */
+void GlStubSetViewerType(int32_t type);
+
+/**
+ * Make gvr_get_head_space_from_start_space_rotation() return
+ * |head_from_start|, whatever the time asked for.
+ */
+void GlStubSetHeadPose(const gvr_mat4f& head_from_start);
+
+/**
+ * Make the next gvr_controller_state_update() report |controller|.
+ */
+void GlStubSetController(const GlStubController& controller);
+
+/**
+ * Return a GVR context to create the apps with. It is only ever passed back
+ * to the stub.
+ */
+gvr_context* GlStubContext();
+
+/**
+ * Stop or resume recording calls. Benchmarks turn recording off, so that the
+ * stub costs next to nothing.
+ */
+void GlStubSetRecording(bool enabled);
+
+/**
+ * Return the calls recorded since GlStubReset() or GlStubClearCalls().
+ */
+const std::vector<std::string>& GlStubCalls();
+
+/**
+ * Forget the recorded calls.
+ */
+void GlStubClearCalls();
+
+/**
+ * Return the index of the first recorded call at or after |from| that starts
+ * with |prefix|, or -1.
+ */
+int GlStubFind(const std::string& prefix, int from = 0);
+
+/**
+ * Return the number of recorded calls that start with |prefix|.
+ */
+int GlStubCount(const std::string& prefix);
+
+#endif  // NDK_SAMPLES_TOOLS_GLSTUB_H_  // NOLINT
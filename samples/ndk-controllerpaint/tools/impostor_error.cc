@@ -0,0 +1,144 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side estimate of the error of ControllerPaint's stroke cache (see
+// CubemapImpostor in src/main/jni/cubemap_impostor.h) against drawing the
+// strokes directly, in eye buffer pixels.
+//
+// The cache is rendered from the origin, but each eye sits at an offset from
+// the head that rotates with it. For stroke points at the paint distance in
+// all directions and for head orientations over the whole sphere, this
+// measures the angle between the direction of the point from the eye (where
+// direct rendering puts it) and its direction from the origin (where the
+// cache puts it). The stereo disparity that the cache loses is reported too.
+// The cube map also resamples the strokes: the largest angle of a cube map
+// texel, at the center of a face, is compared with the angle of an eye
+// buffer pixel for several face sizes.
+//
+// Build and run on the host with:
+//
+//   g++ -std=c++11 -O2 -o impostor_error impostor_error.cc
+//   ./impostor_error [eye buffer pixels per degree] [paint distance]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+namespace {
+
+// Mirrors kDefaultPaintDistance in demoapp.cc.
+const double kDefaultPaintDistance = 200.0;
+
+// Half of a typical interpupillary distance, in the same units (meters).
+const double kEyeOffset = 0.032;
+
+// A typical Daydream eye buffer: about 1300 pixels across 90 degrees.
+const double kDefaultPixelsPerDegree = 14.0;
+
+const int kFaceSizes[] = {256, 512, 1024, 2048};
+
+const double kPi = 3.14159265358979323846;
+
+struct Vec3 {
+  double x, y, z;
+};
+
+Vec3 Sub(const Vec3& a, const Vec3& b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+double Dot(const Vec3& a, const Vec3& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+double Norm(const Vec3& a) { return sqrt(Dot(a, a)); }
+
+double AngleBetween(const Vec3& a, const Vec3& b) {
+  const double cosine = Dot(a, b) / (Norm(a) * Norm(b));
+  return acos(std::max(-1.0, std::min(1.0, cosine)));
+}
+
+// Returns a unit vector from spherical coordinates, in radians.
+Vec3 Direction(double yaw, double pitch) {
+  return {cos(pitch) * sin(yaw), sin(pitch), -cos(pitch) * cos(yaw)};
+}
+
+double Degrees(double radians) { return radians * 180.0 / kPi; }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const double pixels_per_degree =
+      argc > 1 ? strtod(argv[1], nullptr) : kDefaultPixelsPerDegree;
+  const double distance =
+      argc > 2 ? strtod(argv[2], nullptr) : kDefaultPaintDistance;
+  if (pixels_per_degree <= 0.0 || distance <= kEyeOffset) {
+    fprintf(stderr, "Usage: %s [pixels per degree] [paint distance > %g]\n",
+            argv[0], kEyeOffset);
+    return 2;
+  }
+  printf("Paint distance %g, eye offset %g, %g eye buffer pixels/degree.\n\n",
+         distance, kEyeOffset, pixels_per_degree);
+
+  // Parallax: the eye lies on a sphere of radius kEyeOffset around the
+  // origin, in whatever direction the head's rotation puts it.
+  const int kSteps = 90;
+  double max_error = 0.0;
+  double sum_error = 0.0;
+  int samples = 0;
+  for (int i = 0; i <= kSteps; ++i) {
+    const double point_pitch = -kPi / 2 + kPi * i / kSteps;
+    for (int j = 0; j < 2 * kSteps; ++j) {
+      const double point_yaw = kPi * j / kSteps;
+      const Vec3 d = Direction(point_yaw, point_pitch);
+      const Vec3 point = {d.x * distance, d.y * distance, d.z * distance};
+      for (int k = 0; k <= kSteps / 6; ++k) {
+        const double eye_pitch = -kPi / 2 + kPi * k / (kSteps / 6);
+        for (int l = 0; l < kSteps / 3; ++l) {
+          const Vec3 e = Direction(2 * kPi * l / (kSteps / 3), eye_pitch);
+          const Vec3 eye = {e.x * kEyeOffset, e.y * kEyeOffset,
+                            e.z * kEyeOffset};
+          const double error = AngleBetween(Sub(point, eye), point);
+          max_error = std::max(max_error, error);
+          sum_error += error;
+          ++samples;
+        }
+      }
+    }
+  }
+  const double disparity = 2.0 * asin(kEyeOffset / distance);
+  printf("Parallax error:    mean %.4f px, max %.4f px (%.5f degrees)\n",
+         Degrees(sum_error / samples) * pixels_per_degree,
+         Degrees(max_error) * pixels_per_degree, Degrees(max_error));
+  printf("Disparity lost:    %.4f px (%.5f degrees)\n\n",
+         Degrees(disparity) * pixels_per_degree, Degrees(disparity));
+
+  // Resampling: a texel at the center of a face spans atan(2 / size).
+  printf("%9s %12s %16s %10s\n", "face size", "texel (px)", "max error (px)",
+         "memory");
+  for (int size : kFaceSizes) {
+    const double texel = atan(2.0 / size);
+    // Bilinear filtering moves an edge by at most half a texel.
+    const double error = max_error + texel / 2.0;
+    printf("%9d %12.3f %16.3f %7.1f MB\n", size,
+           Degrees(texel) * pixels_per_degree,
+           Degrees(error) * pixels_per_degree,
+           size * size * 6 * 4 / (1024.0 * 1024.0));
+  }
+  return 0;
+}
@@ -0,0 +1,335 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "perf_harness.h"  // NOLINT
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <sstream>
+
+namespace {
+// Calibration grows the iteration count until a sample lasts this long.
+const double kMinSampleNanos = 5e6;
+const int kMaxIterations = 1 << 30;
+const int kSamples = 15;
+// Then it runs for this long before the samples are taken, so that the
+// first benchmark of a suite is not slower because the process just started.
+const double kWarmUpNanos = 5e7;
+
+// Significance level of the regression test.
+const double kMaxPValue = 0.01;
+
+double NowNanos() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double TimeNanos(const PerfSuite::Body& body, int iterations) {
+  const double start = NowNanos();
+  body(iterations);
+  return NowNanos() - start;
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  const size_t n = values.size();
+  return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+// Makes |path| absolute, so that it still names the same file if the suite
+// changes directory to find the assets of the app.
+std::string Absolute(const std::string& path) {
+  char directory[4096];
+  if (path.empty() || path[0] == '/' ||
+      !getcwd(directory, sizeof(directory))) {
+    return path;
+  }
+  return std::string(directory) + "/" + path;
+}
+
+const PerfBaseline* FindBaseline(const std::vector<PerfBaseline>& baselines,
+                                 const std::string& name) {
+  for (const PerfBaseline& baseline : baselines) {
+    if (baseline.name == name) return &baseline;
+  }
+  return nullptr;
+}
+
+// Reads the numbers of the array |key| of |json|, looking from |position|
+// on. Returns the position after the array, or npos if there is none.
+size_t ReadArray(const std::string& json, const char* key, size_t position,
+                 std::vector<double>* values) {
+  if (position == std::string::npos) return position;
+  position = json.find(key, position);
+  if (position == std::string::npos) return position;
+  position = json.find('[', position);
+  if (position == std::string::npos) return position;
+  const char* cursor = json.c_str() + position + 1;
+  for (;;) {
+    char* end;
+    const double value = strtod(cursor, &end);
+    if (end == cursor) break;
+    values->push_back(value);
+    cursor = end + strspn(end, ", \n");
+  }
+  return cursor - json.c_str();
+}
+
+void PrintUsage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [--baseline FILE] [--json FILE [--append]]"
+          " [--filter TEXT] [--threshold PCT]\n",
+          program);
+}
+}  // namespace
+
+PerfSuite::PerfSuite(const std::string& name)
+    : name_(name), append_(false), threshold_(20.0) {}
+
+bool PerfSuite::ParseArgs(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--append") == 0) {
+      append_ = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      PrintUsage(argv[0]);
+      return false;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--baseline") == 0) {
+      baseline_path_ = Absolute(value);
+    } else if (strcmp(arg, "--json") == 0) {
+      json_path_ = Absolute(value);
+    } else if (strcmp(arg, "--filter") == 0) {
+      filter_ = value;
+    } else if (strcmp(arg, "--threshold") == 0) {
+      threshold_ = atof(value);
+    } else {
+      PrintUsage(argv[0]);
+      return false;
+    }
+  }
+  if (append_ && json_path_.empty()) {
+    PrintUsage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+void PerfSuite::Run(const std::string& name, const Body& body) {
+  if (name.find(filter_) == std::string::npos) return;
+
+  int iterations = 1;
+  double nanos = TimeNanos(body, iterations);
+  while (nanos < kMinSampleNanos && iterations < kMaxIterations) {
+    const double scale =
+        nanos > 0.0 ? std::min(1.2 * kMinSampleNanos / nanos, 16.0) : 16.0;
+    iterations = static_cast<int>(
+        std::min(std::max(iterations * scale, iterations + 1.0),
+                 static_cast<double>(kMaxIterations)));
+    nanos = TimeNanos(body, iterations);
+  }
+
+  const double warm_up_end = NowNanos() + kWarmUpNanos;
+  while (NowNanos() < warm_up_end) body(iterations);
+
+  Result result;
+  result.name = name;
+  result.iterations = iterations;
+  for (int s = 0; s < kSamples; ++s) {
+    result.samples.push_back(TimeNanos(body, iterations) / iterations);
+  }
+  Summarize(&result);
+  result.runs.push_back(result.median);
+  results_.push_back(result);
+}
+
+void PerfSuite::Summarize(Result* result) {
+  result->median = Median(result->samples);
+  std::vector<double> deviations;
+  for (double sample : result->samples) {
+    deviations.push_back(fabs(sample - result->median));
+  }
+  result->mad = Median(deviations);
+}
+
+bool PerfSuite::AppendTo(const std::string& path) {
+  if (access(path.c_str(), F_OK) != 0) return true;
+  std::vector<PerfBaseline> previous;
+  if (!ReadPerfBaseline(path, &previous)) return false;
+  for (Result& result : results_) {
+    const PerfBaseline* baseline = FindBaseline(previous, result.name);
+    if (!baseline) continue;
+    result.runs.insert(result.runs.begin(), baseline->runs.begin(),
+                       baseline->runs.end());
+    result.samples.insert(result.samples.begin(), baseline->samples.begin(),
+                          baseline->samples.end());
+    Summarize(&result);
+  }
+  return true;
+}
+
+bool PerfSuite::WriteJson(const std::string& path) const {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  fprintf(file, "{\"suite\": \"%s\", \"benchmarks\": [", name_.c_str());
+  for (size_t i = 0; i < results_.size(); ++i) {
+    const Result& result = results_[i];
+    fprintf(file,
+            "%s\n  {\"name\": \"%s\", \"unit\": \"ns\", \"median\": %.6g, "
+            "\"mad\": %.6g, \"iterations\": %d,\n   \"runs\": [",
+            i ? "," : "", result.name.c_str(), result.median, result.mad,
+            result.iterations);
+    for (size_t r = 0; r < result.runs.size(); ++r) {
+      fprintf(file, "%s%.6g", r ? ", " : "", result.runs[r]);
+    }
+    fprintf(file, "],\n   \"samples\": [");
+    for (size_t s = 0; s < result.samples.size(); ++s) {
+      fprintf(file, "%s%.6g", s ? ", " : "", result.samples[s]);
+    }
+    fprintf(file, "]}");
+  }
+  fprintf(file, "\n]}\n");
+  return fclose(file) == 0;
+}
+
+int PerfSuite::Finish() {
+  bool ok = true;
+  std::vector<PerfBaseline> baselines;
+  if (!baseline_path_.empty() &&
+      !ReadPerfBaseline(baseline_path_, &baselines)) {
+    printf("FAIL: cannot read the baseline %s\n", baseline_path_.c_str());
+    ok = false;
+  }
+
+  std::vector<std::string> regressions;
+  printf("%-36s %12s %10s %12s %8s\n", "benchmark", "median ns", "mad",
+         "baseline", "change");
+  for (const Result& result : results_) {
+    const PerfBaseline* baseline = FindBaseline(baselines, result.name);
+    if (!baseline || baseline->runs.empty()) {
+      printf("%-36s %12.1f %10.2f %12s %8s\n", result.name.c_str(),
+             result.median, result.mad, "-", "-");
+      continue;
+    }
+    const double baseline_median = Median(baseline->samples);
+    const double change = 100.0 * (result.median / baseline_median - 1.0);
+    const char* verdict = "";
+    if (change > threshold_ &&
+        result.median > *std::max_element(baseline->runs.begin(),
+                                          baseline->runs.end()) &&
+        MannWhitneyPValue(baseline->samples, result.samples) < kMaxPValue) {
+      verdict = "  REGRESSION";
+      regressions.push_back(result.name);
+    } else if (change < -threshold_ &&
+               result.median < *std::min_element(baseline->runs.begin(),
+                                                 baseline->runs.end()) &&
+               MannWhitneyPValue(result.samples, baseline->samples) <
+                   kMaxPValue) {
+      verdict = "  improved";
+    }
+    printf("%-36s %12.1f %10.2f %12.1f %+7.1f%%%s\n", result.name.c_str(),
+           result.median, result.mad, baseline_median, change, verdict);
+  }
+
+  // After the comparison, which only uses the samples of this run.
+  if (append_ && !AppendTo(json_path_)) {
+    printf("FAIL: cannot read %s\n", json_path_.c_str());
+    ok = false;
+  } else if (!json_path_.empty() && !WriteJson(json_path_)) {
+    printf("FAIL: cannot write %s\n", json_path_.c_str());
+    ok = false;
+  }
+  for (const std::string& name : regressions) {
+    printf("FAIL: %s is more than %.0f%% slower than the baseline\n",
+           name.c_str(), threshold_);
+    ok = false;
+  }
+  if (ok && !baseline_path_.empty()) {
+    printf("PASS: no benchmark regressed against the baseline\n");
+  }
+  return ok ? 0 : 1;
+}
+
+bool ReadPerfBaseline(const std::string& path,
+                      std::vector<PerfBaseline>* benchmarks) {
+  std::ifstream file(path.c_str());
+  if (!file) return false;
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const std::string json = contents.str();
+
+  // Each benchmark is an object whose "name" comes before its "runs" and
+  // "samples".
+  static const char kName[] = "\"name\"";
+  size_t position = 0;
+  while ((position = json.find(kName, position)) != std::string::npos) {
+    const size_t name_start = json.find('"', position + strlen(kName) + 1);
+    const size_t name_end = json.find('"', name_start + 1);
+    if (name_end == std::string::npos) break;
+    PerfBaseline benchmark;
+    benchmark.name = json.substr(name_start + 1, name_end - name_start - 1);
+    position = ReadArray(json, "\"runs\"", name_end, &benchmark.runs);
+    position = ReadArray(json, "\"samples\"", position, &benchmark.samples);
+    if (position == std::string::npos) break;
+    benchmarks->push_back(benchmark);
+  }
+  return true;
+}
+
+double MannWhitneyPValue(const std::vector<double>& faster,
+                         const std::vector<double>& slower) {
+  // Rank both sets together, giving tied values the mean of their ranks.
+  std::vector<std::pair<double, bool>> values;
+  for (double value : faster) values.push_back(std::make_pair(value, false));
+  for (double value : slower) values.push_back(std::make_pair(value, true));
+  std::sort(values.begin(), values.end());
+  const double n = static_cast<double>(values.size());
+  double slower_rank_sum = 0.0, tie_correction = 0.0;
+  for (size_t first = 0; first < values.size();) {
+    size_t last = first;
+    while (last + 1 < values.size() &&
+           values[last + 1].first == values[first].first) {
+      ++last;
+    }
+    const double rank = 0.5 * (first + last) + 1.0;
+    const double ties = static_cast<double>(last - first + 1);
+    tie_correction += ties * ties * ties - ties;
+    for (size_t i = first; i <= last; ++i) {
+      if (values[i].second) slower_rank_sum += rank;
+    }
+    first = last + 1;
+  }
+
+  const double n1 = static_cast<double>(slower.size());
+  const double n2 = static_cast<double>(faster.size());
+  const double u = slower_rank_sum - 0.5 * n1 * (n1 + 1.0);
+  const double variance =
+      n1 * n2 / 12.0 * ((n + 1.0) - tie_correction / (n * (n - 1.0)));
+  if (n1 == 0.0 || n2 == 0.0 || variance <= 0.0) return 1.0;
+  // With the continuity correction.
+  const double z = (u - 0.5 * n1 * n2 - 0.5) / sqrt(variance);
+  return 0.5 * erfc(z / sqrt(2.0));
+}
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side performance suite of ControllerPaint, run against the GL stub in
+// gl_stub.h, with the runner in perf_harness.h.
+//
+// The microbenchmarks time the math helpers of Utils, and the painting
+// functions of DemoApp: AddPaintSegment(), for strokes of kStrokeSegments
+// segments, and CommitToVbo(), for the geometry that AddPaintSegment()
+// gathers between two commits. The macro benchmarks replay kReplayFrames
+// frames of the whole app with the head turning back and forth: idle, and
+// painting strokes that sweep the controller across the view. Each replay
+// starts by clearing the drawing, so that every replay draws the same. They
+// time OnDrawFrame(), which on the host is the CPU cost of a frame: the stub
+// GL records nothing and draws nothing, and without vsync the frame
+// scheduler does not wait.
+//
+// The results are compared with perf_baselines/controllerpaint.json, 20 runs
+// recorded on the machine that last updated it. Record it again, as
+// perf_harness.h describes, after a change of machine, compiler or flags.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -I../../../libraries/headers
+//       -o perf_suite perf_suite.cc perf_harness.cc gl_stub.cc
+//       $JNI/asset_archive.cc $JNI/choreographer_vsync.cc
+//       $JNI/controller_fusion.cc $JNI/cubemap_impostor.cc $JNI/demoapp.cc
+//       $JNI/egl_fence.cc $JNI/frame_acquirer.cc $JNI/frame_limiter.cc
+//       $JNI/frame_scheduler.cc $JNI/gpu_memory_tracker.cc
+//       $JNI/hidden_area_mesh.cc $JNI/overdraw_analyzer.cc
+//       $JNI/render_pass.cc $JNI/trace_log.cc $JNI/uniform_ring_buffer.cc
+//       $JNI/utils.cc -lpthread
+//   ./perf_suite --baseline perf_baselines/controllerpaint.json
+//
+// See perf_harness.h for the other options.
+
+#include <math.h>
+#include <stdio.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_archive.h"  // NOLINT
+#include "demoapp.h"        // NOLINT
+#include "gl_stub.h"        // NOLINT
+#include "perf_harness.h"   // NOLINT
+#include "utils.h"          // NOLINT
+
+// Runs the private painting functions of an app.
+class DemoAppPeer {
+ public:
+  explicit DemoAppPeer(DemoApp* app) : app_(app) {}
+
+  void AddPaintSegment(const std::array<float, 3>& start_point,
+                       const std::array<float, 3>& end_point) {
+    app_->AddPaintSegment(start_point, end_point);
+  }
+  void StartPainting(const std::array<float, 3>& start_point) {
+    app_->StartPainting(start_point);
+  }
+  void StopPainting() { app_->StopPainting(true); }
+  void CommitToVbo() { app_->CommitToVbo(); }
+  void ClearDrawing() { app_->ClearDrawing(); }
+
+  // Saves the geometry that is not committed yet, and restores it.
+  void SaveRecentGeometry() {
+    saved_geom_ = app_->recent_geom_;
+    saved_indices_ = app_->recent_indices_;
+    saved_vertex_count_ = app_->recent_geom_vertex_count_;
+  }
+  void RestoreRecentGeometry() {
+    app_->recent_geom_ = saved_geom_;
+    app_->recent_indices_ = saved_indices_;
+    app_->recent_geom_vertex_count_ = saved_vertex_count_;
+  }
+
+ private:
+  DemoApp* app_;
+  std::vector<float> saved_geom_;
+  std::vector<uint16_t> saved_indices_;
+  int saved_vertex_count_ = 0;
+};
+
+namespace {
+const char* kTextureArchive = "../src/main/assets/textures.pak";
+
+const int kReplayFrames = 600;
+const float kFrameSeconds = 1.0f / 60.0f;
+// Painting replays paint a stroke of kStrokeFrames frames, then rest for
+// kRestFrames frames.
+const int kStrokeFrames = 90;
+const int kRestFrames = 30;
+
+const int kStrokeSegments = 250;
+// Segments that AddPaintSegment() adds before it commits them itself.
+const int kSegmentsPerCommit = 24;
+const int kCommitsPerClear = 64;
+const float kPaintDistance = 200.0f;
+
+// Inputs of the microbenchmarks, cycled through so that no result is known
+// at compile time. They are aligned to cache lines, so that the timings do
+// not change between runs with where the inputs are placed.
+const int kInputs = 64;
+struct UtilsInputs {
+  alignas(64) gvr::Mat4f matrices[kInputs];
+  alignas(64) std::array<float, 3> vectors[kInputs];
+  alignas(64) gvr::Rectf fovs[kInputs];
+  alignas(64) gvr::ControllerQuat quats[kInputs];
+} inputs;
+
+// Returns the head pose of frame |frame| of the replay: the head turns from
+// side to side with a period of 4 s.
+gvr_mat4f HeadPose(int frame) {
+  const float t = (frame % kReplayFrames) * kFrameSeconds;
+  const float yaw = 0.4f * sinf(2.0f * 3.14159265f * t / 4.0f);
+  return {{{cosf(yaw), 0.0f, sinf(yaw), 0.0f},
+           {0.0f, 1.0f, 0.0f, 0.0f},
+           {-sinf(yaw), 0.0f, cosf(yaw), 0.0f},
+           {0.0f, 0.0f, 0.0f, 1.0f}}};
+}
+
+// Returns the controller of frame |frame| of the replay. It sweeps in a
+// figure of eight, and if |painting|, holds the click button during the
+// strokes. The first frame presses the app button, which clears the
+// drawing.
+GlStubController Controller(int frame, bool painting) {
+  const int replay_frame = frame % kReplayFrames;
+  const float t = replay_frame * kFrameSeconds;
+  const float yaw = 0.5f * sinf(2.0f * 3.14159265f * t / 2.0f);
+  const float pitch = 0.25f * sinf(2.0f * 3.14159265f * t);
+  GlStubController controller = {};
+  const float cy = cosf(0.5f * yaw), sy = sinf(0.5f * yaw);
+  const float cp = cosf(0.5f * pitch), sp = sinf(0.5f * pitch);
+  controller.orientation = {sp * cy, cp * sy, -sp * sy, cp * cy};
+  controller.buttons[GVR_CONTROLLER_BUTTON_APP] = replay_frame == 0;
+  controller.buttons[GVR_CONTROLLER_BUTTON_CLICK] =
+      painting && replay_frame > 0 &&
+      replay_frame % (kStrokeFrames + kRestFrames) < kStrokeFrames;
+  return controller;
+}
+
+// Returns the point of a stroke at |segment|, on a circle around the viewer
+// at the distance where the app paints.
+std::array<float, 3> StrokePoint(int segment) {
+  const float angle = 0.03f * segment;
+  return {kPaintDistance * sinf(angle),
+          0.2f * kPaintDistance * sinf(7.0f * angle),
+          -kPaintDistance * cosf(angle)};
+}
+
+void RunUtilsBenchmarks(PerfSuite* suite) {
+  for (int i = 0; i < kInputs; ++i) {
+    inputs.matrices[i] = HeadPose(7 * i);
+    inputs.matrices[i].m[0][3] = 0.1f * i;
+    inputs.vectors[i] = {0.1f * i, 1.0f, -3.0f + 0.02f * i};
+    const float angle = 30.0f + 0.25f * i;
+    inputs.fovs[i] = {angle, angle + 1.0f, angle - 1.0f, angle + 2.0f};
+    inputs.quats[i] = Controller(i, false).orientation;
+  }
+  const gvr::Mat4f* matrices = inputs.matrices;
+  const std::array<float, 3>* vectors = inputs.vectors;
+  const gvr::Rectf* fovs = inputs.fovs;
+  const gvr::ControllerQuat* quats = inputs.quats;
+
+  suite->Run("utils/MatrixMul", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::MatrixMul(matrices[i % kInputs],
+                                     matrices[(i + 1) % kInputs]));
+    }
+  });
+  suite->Run("utils/MatrixVectorMul", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::MatrixVectorMul(matrices[i % kInputs],
+                                           vectors[(i + 1) % kInputs]));
+    }
+  });
+  suite->Run("utils/VecAdd", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::VecAdd(1.0f, vectors[i % kInputs], -0.5f,
+                                  vectors[(i + 1) % kInputs]));
+    }
+  });
+  suite->Run("utils/VecNorm", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::VecNorm(vectors[i % kInputs]));
+    }
+  });
+  suite->Run("utils/VecNormalize", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::VecNormalize(vectors[i % kInputs]));
+    }
+  });
+  suite->Run("utils/VecCrossProd", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::VecCrossProd(vectors[i % kInputs],
+                                        vectors[(i + 1) % kInputs]));
+    }
+  });
+  suite->Run("utils/PerspectiveMatrixFromView", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(
+          Utils::PerspectiveMatrixFromView(fovs[i % kInputs], 0.1f, 300.0f));
+    }
+  });
+  suite->Run("utils/MatrixToGLArray", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::MatrixToGLArray(matrices[i % kInputs]));
+    }
+  });
+  suite->Run("utils/ControllerQuatToMatrix", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::ControllerQuatToMatrix(quats[i % kInputs]));
+    }
+  });
+  suite->Run("utils/ColorFromHex", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(Utils::ColorFromHex(0x10203 * (i % kInputs)));
+    }
+  });
+}
+
+void RunPaintBenchmarks(PerfSuite* suite, DemoApp* app) {
+  DemoAppPeer peer(app);
+  suite->Run("paint/AddPaintSegment", [&](int iterations) {
+    for (int i = 0; i < iterations;) {
+      peer.StartPainting(StrokePoint(0));
+      for (int s = 0; s < kStrokeSegments && i < iterations; ++s, ++i) {
+        peer.AddPaintSegment(StrokePoint(s), StrokePoint(s + 1));
+      }
+      peer.StopPainting();
+      peer.ClearDrawing();
+    }
+  });
+
+  peer.StartPainting(StrokePoint(0));
+  for (int s = 0; s < kSegmentsPerCommit; ++s) {
+    peer.AddPaintSegment(StrokePoint(s), StrokePoint(s + 1));
+  }
+  peer.SaveRecentGeometry();
+  suite->Run("paint/CommitToVbo", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      peer.RestoreRecentGeometry();
+      peer.CommitToVbo();
+      if (i % kCommitsPerClear == kCommitsPerClear - 1) peer.ClearDrawing();
+    }
+  });
+  peer.StopPainting();
+  peer.ClearDrawing();
+}
+
+// Replays frames of |app| from |*frame| on.
+void ReplayFrames(DemoApp* app, bool painting, int frames, int* frame) {
+  for (int i = 0; i < frames; ++i, ++*frame) {
+    GlStubSetHeadPose(HeadPose(*frame));
+    GlStubSetController(Controller(*frame, painting));
+    app->OnDrawFrame();
+  }
+}
+
+void RunAppBenchmarks(PerfSuite* suite, DemoApp* app) {
+  const struct {
+    const char* name;
+    bool painting;
+  } kReplays[] = {{"frame/idle", false}, {"frame/painting", true}};
+  for (const auto& replay : kReplays) {
+    int frame = 0;
+    // One full replay first, to settle the caches and the drawing.
+    ReplayFrames(app, replay.painting, kReplayFrames, &frame);
+    suite->Run(replay.name, [&](int iterations) {
+      ReplayFrames(app, replay.painting, iterations, &frame);
+    });
+  }
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  PerfSuite suite("controllerpaint");
+  if (!suite.ParseArgs(argc, argv)) return 2;
+
+  // The stub only records calls for the tests.
+  GlStubSetRecording(false);
+  std::unique_ptr<AssetArchive> archive =
+      AssetArchive::OpenFromFile(kTextureArchive);
+  if (!archive) {
+    fprintf(stderr, "perf_suite: cannot open %s; run from the tools "
+            "directory\n", kTextureArchive);
+    return 2;
+  }
+  GlStubReset("OpenGL ES 3.0", "");
+  GlStubSetViewerType(GVR_VIEWER_TYPE_DAYDREAM);
+  GlStubSetHeadPose(HeadPose(0));
+  GlStubSetController(Controller(1, false));
+  DemoApp app(GlStubContext(), std::move(archive));
+  app.OnSurfaceCreated();
+  app.OnResume();
+  app.OnDrawFrame();
+
+  RunUtilsBenchmarks(&suite);
+  RunPaintBenchmarks(&suite, &app);
+  RunAppBenchmarks(&suite, &app);
+  app.OnPause();
+  return suite.Finish();
+}
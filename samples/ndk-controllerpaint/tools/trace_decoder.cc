@@ -0,0 +1,162 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side decoder for binary trace files written by TraceLog (see
+// src/main/jni/trace_log.h). Prints one line per message:
+//
+//   <seconds>.<microseconds> <thread id> <level> <message>
+//
+// Build and run on the host with:
+//
+//   g++ -std=c++11 -I../src/main/jni -o trace_decoder trace_decoder.cc
+//   adb pull <trace file> trace.bin && ./trace_decoder trace.bin
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "trace_format.h"  // NOLINT
+
+namespace {
+
+// Android log priorities, as stored in site records.
+char LevelToChar(int level) {
+  switch (level) {
+    case 3: return 'D';
+    case 4: return 'I';
+    case 5: return 'W';
+    case 6: return 'E';
+    default: return '?';
+  }
+}
+
+struct Site {
+  int level;
+  std::string format;
+};
+
+template <typename T>
+bool ReadValue(FILE* file, T* value) {
+  return fread(value, sizeof(*value), 1, file) == 1;
+}
+
+bool ReadBytes(FILE* file, std::string* bytes) {
+  uint32_t length;
+  if (!ReadValue(file, &length)) return false;
+  bytes->resize(length);
+  return length == 0 || fread(&(*bytes)[0], 1, length, file) == length;
+}
+
+int ReportTruncated() {
+  fprintf(stderr, "Truncated trace file.\n");
+  return 1;
+}
+
+int Decode(FILE* file) {
+  char magic[sizeof(kTraceFileMagic)];
+  uint32_t version;
+  if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+      memcmp(magic, kTraceFileMagic, sizeof(magic)) != 0 ||
+      !ReadValue(file, &version) || version != kTraceFileVersion) {
+    fprintf(stderr, "Not a trace file, or unsupported version.\n");
+    return 1;
+  }
+
+  std::unordered_map<uint32_t, Site> sites;
+  uint8_t type;
+  while (ReadValue(file, &type)) {
+    if (type == kTraceRecordSite) {
+      uint32_t id;
+      int32_t level;
+      Site site;
+      if (!ReadValue(file, &id) || !ReadValue(file, &level) ||
+          !ReadBytes(file, &site.format)) {
+        return ReportTruncated();
+      }
+      site.level = level;
+      sites[id] = site;
+    } else if (type == kTraceRecordEvent) {
+      uint32_t site_id;
+      uint32_t thread_id;
+      uint64_t timestamp_nanos;
+      uint32_t num_args;
+      if (!ReadValue(file, &site_id) || !ReadValue(file, &thread_id) ||
+          !ReadValue(file, &timestamp_nanos) || !ReadValue(file, &num_args) ||
+          num_args > static_cast<uint32_t>(kMaxTraceArgs)) {
+        return ReportTruncated();
+      }
+      auto it = sites.find(site_id);
+      if (it == sites.end()) {
+        fprintf(stderr, "Event refers to unknown site %u.\n", site_id);
+        return 1;
+      }
+      TraceArgKind kinds[kMaxTraceArgs];
+      const int num_kinds =
+          ParseTraceFormat(it->second.format.c_str(), kinds, kMaxTraceArgs);
+      std::string strings[kMaxTraceArgs];
+      uint64_t args[kMaxTraceArgs];
+      bool ok = true;
+      for (uint32_t i = 0; i < num_args && ok; ++i) {
+        if (static_cast<int>(i) < num_kinds && kinds[i] == kTraceArgString) {
+          ok = ReadBytes(file, &strings[i]);
+          args[i] = static_cast<uint64_t>(
+              reinterpret_cast<uintptr_t>(strings[i].c_str()));
+        } else {
+          ok = ReadValue(file, &args[i]);
+        }
+      }
+      if (!ok) return ReportTruncated();
+      char message[1024];
+      FormatTraceMessage(it->second.format.c_str(), args,
+                         static_cast<int>(num_args), message,
+                         sizeof(message));
+      printf("%llu.%06llu %u %c %s\n",
+             static_cast<unsigned long long>(timestamp_nanos / 1000000000),
+             static_cast<unsigned long long>(
+                 (timestamp_nanos % 1000000000) / 1000),
+             thread_id, LevelToChar(it->second.level), message);
+    } else if (type == kTraceRecordDropped) {
+      uint64_t dropped;
+      if (!ReadValue(file, &dropped)) return ReportTruncated();
+      printf("-- %llu messages dropped so far --\n",
+             static_cast<unsigned long long>(dropped));
+    } else {
+      fprintf(stderr, "Unknown record type %u.\n", type);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+    return 2;
+  }
+  FILE* file = fopen(argv[1], "rb");
+  if (!file) {
+    perror(argv[1]);
+    return 1;
+  }
+  const int result = Decode(file);
+  fclose(file);
+  return result;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side benchmark of the logging overhead of TraceLog (see
+// src/main/jni/trace_log.h). Reports the cost per message on the calling
+// thread of:
+//
+//  * TRACE_LOGD while the logger is stopped;
+//  * TRACE_LOGD while the logger is running and writing a trace file, in
+//    bursts that fit the per-thread buffer, as the frame loop logs;
+//  * TRACE_LOGD while the buffer is full and messages are dropped;
+//  * formatting the message and writing it under a lock, as LOGD does.
+//
+// It checks that no message of the bursts was dropped, and that messages
+// logged while the logger is stopped are not queued.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -pthread -I$JNI -o trace_log_bench
+//       trace_log_bench.cc $JNI/trace_log.cc
+//   ./trace_log_bench
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>  // NOLINT
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+
+#include "trace_log.h"  // NOLINT
+
+namespace {
+
+const int kStoppedMessages = 10000000;
+const int kDroppedMessages = 10000000;
+const int kSyncMessages = 1000000;
+
+// The per-thread buffer holds 1024 messages, and is drained every 20ms.
+const int kBurstMessages = 512;
+const int kBursts = 100;
+const std::chrono::milliseconds kDrainWait(50);
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void LogMessage(int i) {
+  TRACE_LOGD("Frame %d: controller %s, battery %d%%", i, "connected", 42);
+}
+
+// Stands in for __android_log_print: formats the message, then writes it
+// under a lock.
+void LogSynchronously(FILE* file, std::mutex* mutex, int i) {
+  char message[512];
+  snprintf(message, sizeof(message),
+           "Frame %d: controller %s, battery %d%%", i, "connected", 42);
+  std::lock_guard<std::mutex> lock(*mutex);
+  fputs(message, file);
+}
+
+}  // namespace
+
+int main() {
+  bool ok = true;
+
+  // Stopped: every message is discarded before touching a buffer.
+  double start = NowSeconds();
+  for (int i = 0; i < kStoppedMessages; ++i) LogMessage(i);
+  const double stopped_ns = 1e9 * (NowSeconds() - start) / kStoppedMessages;
+  ok &= TraceLog::GetDroppedCount() == 0;
+
+  if (!TraceLog::Start("trace_log_bench", "/dev/null")) {
+    fprintf(stderr, "Cannot start the trace log.\n");
+    return 1;
+  }
+
+  // Running: bursts that the flush thread drains in between.
+  LogMessage(0);
+  std::this_thread::sleep_for(kDrainWait);
+  double burst_seconds = 0.0;
+  for (int burst = 0; burst < kBursts; ++burst) {
+    start = NowSeconds();
+    for (int i = 0; i < kBurstMessages; ++i) LogMessage(i);
+    burst_seconds += NowSeconds() - start;
+    std::this_thread::sleep_for(kDrainWait);
+  }
+  const double running_ns = 1e9 * burst_seconds / (kBursts * kBurstMessages);
+  ok &= TraceLog::GetDroppedCount() == 0;
+
+  // Full: the buffer fills within the first few thousand messages, and the
+  // rest are dropped.
+  start = NowSeconds();
+  for (int i = 0; i < kDroppedMessages; ++i) LogMessage(i);
+  const double dropped_ns = 1e9 * (NowSeconds() - start) / kDroppedMessages;
+  TraceLog::Stop();
+
+  FILE* file = fopen("/dev/null", "w");
+  std::mutex mutex;
+  start = NowSeconds();
+  for (int i = 0; i < kSyncMessages; ++i) LogSynchronously(file, &mutex, i);
+  const double sync_ns = 1e9 * (NowSeconds() - start) / kSyncMessages;
+  fclose(file);
+
+  printf("%-32s %10s\n", "", "ns/message");
+  printf("%-32s %10.1f\n", "TRACE_LOGD, logger stopped", stopped_ns);
+  printf("%-32s %10.1f\n", "TRACE_LOGD, logger running", running_ns);
+  printf("%-32s %10.1f\n", "TRACE_LOGD, buffer full", dropped_ns);
+  printf("%-32s %10.1f\n", "format and write under a lock", sync_ns);
+  printf("%s: no message of the bursts was dropped, none queued while "
+         "stopped\n",
+         ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
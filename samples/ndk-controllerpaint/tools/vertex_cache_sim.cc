@@ -0,0 +1,237 @@
+/*
+ * Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side post-transform vertex cache simulator for the meshes of both NDK
+// samples. For each mesh, prints the average cache miss ratio (ACMR, vertex
+// shader invocations per triangle) and the cache hit rate of a FIFO cache,
+// for the index order checked into the tree and for the order produced by
+// the Tipsify optimizer (Sander et al., "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw", 2007). If the optimized order is better,
+// it is printed so that it can be copied back into the source.
+//
+// Build and run on the host with:
+//
+//   TH=../../ndk-treasurehunt/src/main/jni
+//   g++ -std=c++11 -I../src/main/jni -I$TH -o cache_sim vertex_cache_sim.cc
+//   ./cache_sim [cache size]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "world_layout_data.h"  // NOLINT
+
+namespace {
+
+typedef std::vector<uint16_t> Indices;
+
+struct CacheStats {
+  double acmr;
+  double hit_rate;
+};
+
+// Simulates a FIFO post-transform cache with |cache_size| entries.
+CacheStats SimulateFifoCache(const Indices& indices, size_t cache_size) {
+  std::deque<uint16_t> cache;
+  size_t misses = 0;
+  for (uint16_t index : indices) {
+    if (std::find(cache.begin(), cache.end(), index) != cache.end()) continue;
+    ++misses;
+    cache.push_back(index);
+    if (cache.size() > cache_size) cache.pop_front();
+  }
+  CacheStats stats;
+  stats.acmr = static_cast<double>(misses) / (indices.size() / 3);
+  stats.hit_rate = 1.0 - static_cast<double>(misses) / indices.size();
+  return stats;
+}
+
+// Returns the index of the vertex with live triangles that was most recently
+// put on the dead-end stack, or failing that the next vertex in order.
+int SkipDeadEnd(const std::vector<int>& live_triangles,
+                std::vector<int>* dead_end, int* cursor) {
+  while (!dead_end->empty()) {
+    const int vertex = dead_end->back();
+    dead_end->pop_back();
+    if (live_triangles[vertex] > 0) return vertex;
+  }
+  while (*cursor < static_cast<int>(live_triangles.size())) {
+    if (live_triangles[*cursor] > 0) return (*cursor)++;
+    ++(*cursor);
+  }
+  return -1;
+}
+
+// Reorders the triangles of |indices| for a cache of |cache_size| entries.
+Indices Tipsify(const Indices& indices, size_t vertex_count,
+                size_t cache_size) {
+  const size_t triangle_count = indices.size() / 3;
+  std::vector<std::vector<int>> adjacency(vertex_count);
+  std::vector<int> live_triangles(vertex_count, 0);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    for (int corner = 0; corner < 3; ++corner) {
+      adjacency[indices[t * 3 + corner]].push_back(static_cast<int>(t));
+      ++live_triangles[indices[t * 3 + corner]];
+    }
+  }
+
+  const int k = static_cast<int>(cache_size);
+  std::vector<int> cache_time(vertex_count, 0);
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<int> dead_end;
+  Indices output;
+  int time = k + 1;
+  int cursor = 1;
+  int fanning = 0;
+  while (fanning >= 0) {
+    std::vector<int> candidates;
+    for (int t : adjacency[fanning]) {
+      if (emitted[t]) continue;
+      for (int corner = 0; corner < 3; ++corner) {
+        const int vertex = indices[t * 3 + corner];
+        output.push_back(static_cast<uint16_t>(vertex));
+        dead_end.push_back(vertex);
+        candidates.push_back(vertex);
+        --live_triangles[vertex];
+        if (time - cache_time[vertex] > k) cache_time[vertex] = time++;
+      }
+      emitted[t] = true;
+    }
+
+    // Pick the candidate that is still in the cache and has the oldest entry,
+    // as long as its remaining triangles will not push it out.
+    int next = -1;
+    int best_priority = -1;
+    for (int vertex : candidates) {
+      if (live_triangles[vertex] <= 0) continue;
+      int priority = 0;
+      if (time - cache_time[vertex] + 2 * live_triangles[vertex] <= k) {
+        priority = time - cache_time[vertex];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        next = vertex;
+      }
+    }
+    if (next == -1) next = SkipDeadEnd(live_triangles, &dead_end, &cursor);
+    fanning = next;
+  }
+  return output;
+}
+
+// Generates the indices of a painted stroke of |segment_count| segments the
+// way DemoApp::AddPaintSegment() does, including the restarts caused by the
+// texture coordinate limit and by commits to VBOs. Each VBO is appended with
+// its own index base. If |shared| is false, generates the non-indexed layout
+// that the sample used before, where each segment has 6 vertices.
+Indices MakeStroke(int segment_count, bool shared, size_t* vertex_count) {
+  const int kVboCommitThreshold = 50;
+  const int kMaxStrokeTexU = 8;
+  Indices indices;
+  int base = 0;
+  int buffer_vertices = 0;
+  int tex_u = 0;
+  for (int i = 0; i < segment_count; ++i) {
+    if (!shared) {
+      for (int corner = 0; corner < 6; ++corner) {
+        indices.push_back(static_cast<uint16_t>(base + buffer_vertices++));
+      }
+    } else {
+      int start_top;
+      if (i > 0 && buffer_vertices > 0 && tex_u < kMaxStrokeTexU) {
+        start_top = buffer_vertices - 2;
+      } else {
+        tex_u = 0;
+        start_top = buffer_vertices;
+        buffer_vertices += 2;
+      }
+      ++tex_u;
+      const int end_top = buffer_vertices;
+      buffer_vertices += 2;
+      const int corners[] = {start_top, start_top + 1, end_top,
+                             start_top + 1, end_top + 1, end_top};
+      for (int corner : corners) {
+        indices.push_back(static_cast<uint16_t>(base + corner));
+      }
+    }
+    if (buffer_vertices > kVboCommitThreshold) {
+      base += buffer_vertices;
+      buffer_vertices = 0;
+    }
+  }
+  *vertex_count = base + buffer_vertices;
+  return indices;
+}
+
+template <typename Mesh>
+Indices MeshIndices(const Mesh& mesh) {
+  return Indices(mesh.indices, mesh.indices + Mesh::kIndexCount);
+}
+
+void Report(const char* name, const Indices& indices, size_t vertex_count,
+            size_t cache_size, bool print_optimized) {
+  const CacheStats stats = SimulateFifoCache(indices, cache_size);
+  const Indices optimized = Tipsify(indices, vertex_count, cache_size);
+  const CacheStats optimized_stats = SimulateFifoCache(optimized, cache_size);
+  printf("%-28s %6zu %6zu %7.3f %6.1f%% %7.3f %6.1f%%\n", name,
+         indices.size() / 3, vertex_count, stats.acmr, stats.hit_rate * 100.0,
+         optimized_stats.acmr, optimized_stats.hit_rate * 100.0);
+  if (print_optimized && optimized_stats.acmr < stats.acmr - 1e-9) {
+    printf("  optimized order:");
+    for (uint16_t index : optimized) printf(" %u", index);
+    printf("\n");
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t cache_size = argc > 1 ? strtoul(argv[1], nullptr, 10) : 16;
+  if (cache_size < 3) {
+    fprintf(stderr, "Usage: %s [cache size >= 3]\n", argv[0]);
+    return 2;
+  }
+  printf("FIFO cache of %zu vertices.\n", cache_size);
+  printf("%-28s %6s %6s %7s %7s %7s %7s\n", "mesh", "tris", "verts", "acmr",
+         "hits", "tipsify", "hits");
+
+  const Indices quad = {0, 1, 2, 0, 2, 3};
+  Report("controllerpaint ground/cursor", quad, 4, cache_size, true);
+  Report("treasurehunt cube", MeshIndices(kCubeMesh), kCubeMesh.kVertexCount,
+         cache_size, true);
+  Report("treasurehunt floor", MeshIndices(kFloorMesh),
+         kFloorMesh.kVertexCount, cache_size, true);
+  Report("treasurehunt reticle", MeshIndices(kReticleMesh),
+         kReticleMesh.kVertexCount, cache_size, true);
+
+  const int kStrokeSegments[] = {10, 100, 1000};
+  for (int segments : kStrokeSegments) {
+    size_t vertex_count;
+    std::string name = "stroke x" + std::to_string(segments);
+    Indices stroke = MakeStroke(segments, false, &vertex_count);
+    Report((name + " (unshared)").c_str(), stroke, vertex_count, cache_size,
+           false);
+    stroke = MakeStroke(segments, true, &vertex_count);
+    Report((name + " (shared)").c_str(), stroke, vertex_count, cache_size,
+           false);
+  }
+  return 0;
+}
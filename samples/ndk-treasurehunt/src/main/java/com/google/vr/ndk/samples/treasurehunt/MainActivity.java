@@ -20,6 +20,7 @@ import android.content.Context;
 import android.opengl.GLSurfaceView;
 import android.os.Bundle;
 import android.os.Vibrator;
+import android.view.Choreographer;
 import android.view.KeyEvent;
 import android.view.MotionEvent;
 import android.view.View;
@@ -34,6 +35,17 @@ public class MainActivity extends Activity {
   private GvrLayout gvrLayout;
   private long nativeTreasureHuntRenderer;
   private GLSurfaceView surfaceView;
+  private long vsyncPeriodNanos;
+
+  // Forwards the vsync timestamps of the display to the native frame scheduler.
+  private final Choreographer.FrameCallback vsyncCallback =
+      new Choreographer.FrameCallback() {
+        @Override
+        public void doFrame(long frameTimeNanos) {
+          nativeOnVsync(nativeTreasureHuntRenderer, frameTimeNanos, vsyncPeriodNanos);
+          Choreographer.getInstance().postFrameCallback(this);
+        }
+      };
 
   // This is done on the GL thread because refreshViewerProfile isn't thread-safe.
   private final Runnable refreshViewerProfileRunnable =
@@ -74,7 +86,8 @@ public class MainActivity extends Activity {
         nativeCreateRenderer(
             getClass().getClassLoader(),
             this.getApplicationContext(),
-            gvrLayout.getGvrApi().getNativeGvrContext());
+            gvrLayout.getGvrApi().getNativeGvrContext(),
+            getCacheDir().getAbsolutePath());
 
     // Add the GLSurfaceView to the GvrLayout.
     surfaceView = new GLSurfaceView(this);
@@ -127,11 +140,15 @@ public class MainActivity extends Activity {
 
     // Prevent screen from dimming/locking.
     getWindow().addFlags(WindowManager.LayoutParams.FLAG_KEEP_SCREEN_ON);
+
+    float refreshRate = getWindowManager().getDefaultDisplay().getRefreshRate();
+    vsyncPeriodNanos = (long) (1e9 / refreshRate);
   }
 
   @Override
   protected void onPause() {
     super.onPause();
+    Choreographer.getInstance().removeFrameCallback(vsyncCallback);
     nativeOnPause(nativeTreasureHuntRenderer);
     gvrLayout.onPause();
     surfaceView.onPause();
@@ -144,6 +161,7 @@ public class MainActivity extends Activity {
     gvrLayout.onResume();
     surfaceView.onResume();
     surfaceView.queueEvent(refreshViewerProfileRunnable);
+    Choreographer.getInstance().postFrameCallback(vsyncCallback);
   }
 
   @Override
@@ -187,7 +205,8 @@ public class MainActivity extends Activity {
   }
 
   private native long nativeCreateRenderer(
-      ClassLoader appClassLoader, Context context, long nativeGvrContext);
+      ClassLoader appClassLoader, Context context, long nativeGvrContext,
+      String cacheDirectory);
 
   private native void nativeDestroyRenderer(long nativeTreasureHuntRenderer);
 
@@ -200,4 +219,7 @@ public class MainActivity extends Activity {
   private native void nativeOnPause(long nativeTreasureHuntRenderer);
 
   private native void nativeOnResume(long nativeTreasureHuntRenderer);
+
+  private native void nativeOnVsync(
+      long nativeTreasureHuntRenderer, long frameTimeNanos, long vsyncPeriodNanos);
 }
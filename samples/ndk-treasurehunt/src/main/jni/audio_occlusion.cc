@@ -0,0 +1,434 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_occlusion.h"  // NOLINT
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+
+namespace {
+// Triangles per leaf of the hierarchy.
+static const size_t kLeafSize = 4;
+
+// Deepest hierarchy that IsOccluded() can traverse. Median splits keep the
+// depth near log2(triangles / kLeafSize), far below this.
+static const int kMaxDepth = 64;
+
+// Rays are cast to the source and to four points this far from it, across
+// the line of sight, so that the occlusion fades in as an edge covers the
+// source instead of switching at once.
+static const int kRaysPerSource = 5;
+static const float kSourceRadius = 0.25f;
+
+// Sources per group of work taken by a worker at a time.
+static const size_t kSourcesPerGroup = 64;
+
+// Time constant of the smoothing of the occlusion.
+static const float kSmoothingNanos = 100000000.0f;
+
+// A fully occluded source is attenuated by about 10 dB and low pass filtered
+// at 1 kHz.
+static const float kMaxAttenuation = 0.7f;
+static const float kOpenLowpassHz = 20000.0f;
+static const float kOccludedLowpassHz = 1000.0f;
+
+static uint64_t SteadyNowNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+static void Cross(const float a[3], const float b[3], float result[3]) {
+  result[0] = a[1] * b[2] - a[2] * b[1];
+  result[1] = a[2] * b[0] - a[0] * b[2];
+  result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float Dot(const float a[3], const float b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+}  // anonymous namespace
+
+const AudioOcclusion::SourceId AudioOcclusion::kInvalidSource;
+
+OcclusionBvh::OcclusionBvh() {}
+
+void OcclusionBvh::AddMesh(const float* positions, size_t stride,
+                           const uint16_t* indices, size_t index_count,
+                           const float transform[4][4]) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(positions);
+  for (size_t i = 0; i + 2 < index_count; i += 3) {
+    float vertices[3][3];
+    for (int k = 0; k < 3; ++k) {
+      const float* p =
+          reinterpret_cast<const float*>(bytes + indices[i + k] * stride);
+      for (int row = 0; row < 3; ++row) {
+        vertices[k][row] = transform[row][0] * p[0] +
+                           transform[row][1] * p[1] +
+                           transform[row][2] * p[2] + transform[row][3];
+      }
+    }
+    Triangle triangle;
+    for (int axis = 0; axis < 3; ++axis) {
+      triangle.vertex[axis] = vertices[0][axis];
+      triangle.edge1[axis] = vertices[1][axis] - vertices[0][axis];
+      triangle.edge2[axis] = vertices[2][axis] - vertices[0][axis];
+    }
+    triangles_.push_back(triangle);
+  }
+}
+
+void OcclusionBvh::Build() {
+  const size_t count = triangles_.size();
+  nodes_.clear();
+  if (count == 0) return;
+  centroids_.resize(3 * count);
+  order_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    const Triangle& triangle = triangles_[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      centroids_[3 * i + axis] =
+          triangle.vertex[axis] +
+          (triangle.edge1[axis] + triangle.edge2[axis]) / 3.0f;
+    }
+    order_[i] = static_cast<uint32_t>(i);
+  }
+  nodes_.reserve(2 * count / kLeafSize + 1);
+  BuildNode(0, count);
+
+  // Store the triangles in leaf order, so that each leaf is contiguous.
+  std::vector<Triangle> sorted(count);
+  for (size_t i = 0; i < count; ++i) sorted[i] = triangles_[order_[i]];
+  triangles_.swap(sorted);
+  std::vector<float>().swap(centroids_);
+  std::vector<uint32_t>().swap(order_);
+}
+
+uint32_t OcclusionBvh::BuildNode(size_t begin, size_t end) {
+  Node node;
+  float centroid_min[3], centroid_max[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    node.min[axis] = centroid_min[axis] = INFINITY;
+    node.max[axis] = centroid_max[axis] = -INFINITY;
+  }
+  for (size_t i = begin; i < end; ++i) {
+    const Triangle& triangle = triangles_[order_[i]];
+    for (int axis = 0; axis < 3; ++axis) {
+      const float v0 = triangle.vertex[axis];
+      const float v1 = v0 + triangle.edge1[axis];
+      const float v2 = v0 + triangle.edge2[axis];
+      node.min[axis] = std::min(node.min[axis], std::min(v0, std::min(v1, v2)));
+      node.max[axis] = std::max(node.max[axis], std::max(v0, std::max(v1, v2)));
+      const float centroid = centroids_[3 * order_[i] + axis];
+      centroid_min[axis] = std::min(centroid_min[axis], centroid);
+      centroid_max[axis] = std::max(centroid_max[axis], centroid);
+    }
+  }
+  const uint32_t index = static_cast<uint32_t>(nodes_.size());
+  node.index = static_cast<uint32_t>(begin);
+  node.count = static_cast<uint32_t>(end - begin);
+  nodes_.push_back(node);
+  if (end - begin <= kLeafSize) return index;
+
+  // Split at the median centroid along the longest axis.
+  int axis = 0;
+  for (int i = 1; i < 3; ++i) {
+    if (centroid_max[i] - centroid_min[i] >
+        centroid_max[axis] - centroid_min[axis]) {
+      axis = i;
+    }
+  }
+  const size_t middle = (begin + end) / 2;
+  const float* centroids = centroids_.data();
+  std::nth_element(order_.begin() + begin, order_.begin() + middle,
+                   order_.begin() + end,
+                   [centroids, axis](uint32_t a, uint32_t b) {
+                     return centroids[3 * a + axis] < centroids[3 * b + axis];
+                   });
+  BuildNode(begin, middle);
+  const uint32_t second = BuildNode(middle, end);
+  nodes_[index].index = second;
+  nodes_[index].count = 0;
+  return index;
+}
+
+bool OcclusionBvh::IsOccluded(const float from[3], const float to[3]) const {
+  if (nodes_.empty()) return false;
+  // The segment is from + t * direction, for t from 0 to 1.
+  float direction[3], inverse[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    direction[axis] = to[axis] - from[axis];
+    inverse[axis] = 1.0f / direction[axis];
+  }
+
+  uint32_t stack[kMaxDepth];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const uint32_t index = stack[--top];
+    const Node& node = nodes_[index];
+    float near = 0.0f, far = 1.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+      float t0 = (node.min[axis] - from[axis]) * inverse[axis];
+      float t1 = (node.max[axis] - from[axis]) * inverse[axis];
+      if (t0 > t1) std::swap(t0, t1);
+      near = std::max(near, t0);
+      far = std::min(far, t1);
+    }
+    if (near > far) continue;
+
+    if (node.count == 0) {
+      if (top + 2 > kMaxDepth) return false;
+      stack[top++] = node.index;
+      stack[top++] = index + 1;
+      continue;
+    }
+    for (uint32_t i = node.index; i < node.index + node.count; ++i) {
+      // Moller-Trumbore, with t along the segment.
+      const Triangle& triangle = triangles_[i];
+      float p[3];
+      Cross(direction, triangle.edge2, p);
+      const float determinant = Dot(triangle.edge1, p);
+      if (std::fabs(determinant) < 1e-12f) continue;
+      const float inverse_determinant = 1.0f / determinant;
+      float s[3];
+      for (int axis = 0; axis < 3; ++axis) {
+        s[axis] = from[axis] - triangle.vertex[axis];
+      }
+      const float u = Dot(s, p) * inverse_determinant;
+      if (u < 0.0f || u > 1.0f) continue;
+      float q[3];
+      Cross(s, triangle.edge1, q);
+      const float v = Dot(direction, q) * inverse_determinant;
+      if (v < 0.0f || u + v > 1.0f) continue;
+      const float t = Dot(triangle.edge2, q) * inverse_determinant;
+      // Surfaces touching either end, such as the source's own, do not
+      // count.
+      if (t > 1e-4f && t < 1.0f - 1e-4f) return true;
+    }
+  }
+  return false;
+}
+
+size_t OcclusionBvh::GetTriangleCount() const { return triangles_.size(); }
+
+uint64_t OcclusionBvh::GetContentHash() const {
+  // FNV-1a.
+  uint64_t hash = 14695981039346656037ULL;
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(triangles_.data());
+  for (size_t i = 0; i < triangles_.size() * sizeof(Triangle); ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+AudioOcclusion::AudioOcclusion(const OcclusionBvh* bvh, int worker_count)
+    : bvh_(bvh),
+      last_update_nanos_(0),
+      stats_(),
+      group_count_(0),
+      cast_nanos_(0),
+      next_group_(0),
+      remaining_groups_(0),
+      active_workers_(0),
+      generation_(0),
+      stopping_(false) {
+  for (int i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(&AudioOcclusion::WorkerLoop, this);
+  }
+}
+
+AudioOcclusion::~AudioOcclusion() {
+  {
+    std::lock_guard<std::mutex> lock(work_mutex_);
+    stopping_ = true;
+  }
+  work_condition_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+AudioOcclusion::SourceId AudioOcclusion::AddSource(float x, float y,
+                                                   float z) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Source source = {{x, y, z}, true, 0.0f};
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    if (!sources_[i].active) {
+      sources_[i] = source;
+      return static_cast<SourceId>(i);
+    }
+  }
+  sources_.push_back(source);
+  return static_cast<SourceId>(sources_.size() - 1);
+}
+
+void AudioOcclusion::RemoveSource(SourceId source) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (source >= 0 && source < static_cast<SourceId>(sources_.size())) {
+    sources_[source].active = false;
+  }
+}
+
+void AudioOcclusion::SetSourcePosition(SourceId source, float x, float y,
+                                       float z) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (source < 0 || source >= static_cast<SourceId>(sources_.size())) return;
+  float* position = sources_[source].position;
+  position[0] = x;
+  position[1] = y;
+  position[2] = z;
+}
+
+void AudioOcclusion::Update(float x, float y, float z, uint64_t now_nanos) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_lock<std::mutex> work_lock(work_mutex_);
+  ++stats_.ticks;
+  if (remaining_groups_.load() != 0 || active_workers_ != 0) {
+    ++stats_.ticks_skipped;
+    return;
+  }
+
+  // Smooth in the results of the batch that just completed.
+  const float elapsed_nanos =
+      last_update_nanos_ ? static_cast<float>(now_nanos - last_update_nanos_)
+                         : 0.0f;
+  last_update_nanos_ = now_nanos;
+  const float blend = 1.0f - std::exp(-elapsed_nanos / kSmoothingNanos);
+  for (size_t i = 0; i < batch_sources_.size(); ++i) {
+    Source& source = sources_[batch_sources_[i]];
+    if (source.active) {
+      source.occlusion += blend * (batch_results_[i] - source.occlusion);
+    }
+  }
+  stats_.rays += batch_sources_.size() * kRaysPerSource;
+
+  // Start the next batch.
+  batch_sources_.clear();
+  batch_positions_.clear();
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    if (!sources_[i].active) continue;
+    batch_sources_.push_back(static_cast<int>(i));
+    batch_positions_.insert(batch_positions_.end(), sources_[i].position,
+                            sources_[i].position + 3);
+  }
+  batch_results_.assign(batch_sources_.size(), 0.0f);
+  if (batch_sources_.empty()) return;
+  listener_[0] = x;
+  listener_[1] = y;
+  listener_[2] = z;
+  group_count_ =
+      (batch_sources_.size() + kSourcesPerGroup - 1) / kSourcesPerGroup;
+  next_group_.store(0);
+  remaining_groups_.store(group_count_);
+  ++generation_;
+  work_lock.unlock();
+  work_condition_.notify_all();
+}
+
+void AudioOcclusion::Flush() {
+  std::unique_lock<std::mutex> lock(work_mutex_);
+  done_condition_.wait(lock, [this]() {
+    return remaining_groups_.load() == 0 && active_workers_ == 0;
+  });
+}
+
+float AudioOcclusion::GetOcclusion(SourceId source) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (source < 0 || source >= static_cast<SourceId>(sources_.size())) {
+    return 0.0f;
+  }
+  return sources_[source].occlusion;
+}
+
+OcclusionParams AudioOcclusion::GetParams(SourceId source) const {
+  const float occlusion = GetOcclusion(source);
+  OcclusionParams params;
+  params.volume = 1.0f - kMaxAttenuation * occlusion;
+  params.lowpass_hz =
+      kOpenLowpassHz *
+      std::pow(kOccludedLowpassHz / kOpenLowpassHz, occlusion);
+  return params;
+}
+
+AudioOcclusionStats AudioOcclusion::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AudioOcclusionStats stats = stats_;
+  stats.total_cast_nanos = cast_nanos_.load();
+  return stats;
+}
+
+void AudioOcclusion::WorkerLoop() {
+  uint64_t generation = 0;
+  std::unique_lock<std::mutex> lock(work_mutex_);
+  while (true) {
+    work_condition_.wait(lock, [this, generation]() {
+      return stopping_ || generation_ != generation;
+    });
+    if (stopping_) return;
+    generation = generation_;
+    ++active_workers_;
+    lock.unlock();
+
+    size_t group;
+    while ((group = next_group_.fetch_add(1)) < group_count_) {
+      CastGroup(group);
+      remaining_groups_.fetch_sub(1);
+    }
+
+    lock.lock();
+    --active_workers_;
+    done_condition_.notify_all();
+  }
+}
+
+void AudioOcclusion::CastGroup(size_t group) {
+  const uint64_t start_nanos = SteadyNowNanos();
+  const size_t begin = group * kSourcesPerGroup;
+  const size_t end =
+      std::min(begin + kSourcesPerGroup, batch_sources_.size());
+  for (size_t i = begin; i < end; ++i) {
+    const float* position = &batch_positions_[3 * i];
+    float direction[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      direction[axis] = position[axis] - listener_[axis];
+    }
+    // Two directions across the line of sight.
+    const float up[3] = {0.0f, 1.0f, 0.0f};
+    const float side[3] = {1.0f, 0.0f, 0.0f};
+    float across1[3], across2[3];
+    Cross(direction, up, across1);
+    if (Dot(across1, across1) < 1e-6f * Dot(direction, direction)) {
+      Cross(direction, side, across1);
+    }
+    Cross(direction, across1, across2);
+    const float scale1 = kSourceRadius / std::sqrt(Dot(across1, across1));
+    const float scale2 = kSourceRadius / std::sqrt(Dot(across2, across2));
+
+    int blocked = bvh_->IsOccluded(listener_, position) ? 1 : 0;
+    for (int ray = 1; ray < kRaysPerSource; ++ray) {
+      const float sign = ray & 1 ? 1.0f : -1.0f;
+      const float* across = ray <= 2 ? across1 : across2;
+      const float scale = sign * (ray <= 2 ? scale1 : scale2);
+      float target[3];
+      for (int axis = 0; axis < 3; ++axis) {
+        target[axis] = position[axis] + scale * across[axis];
+      }
+      if (bvh_->IsOccluded(listener_, target)) ++blocked;
+    }
+    batch_results_[i] = static_cast<float>(blocked) / kRaysPerSource;
+  }
+  cast_nanos_.fetch_add(SteadyNowNanos() - start_nanos);
+}
@@ -0,0 +1,222 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_AUDIOOCCLUSION_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_AUDIOOCCLUSION_H_  // NOLINT
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+/**
+ * A bounding volume hierarchy over the triangles of the scene, for testing
+ * whether anything lies between a listener and a sound source.
+ */
+class OcclusionBvh {
+ public:
+  OcclusionBvh();
+
+  /**
+   * Add the triangles of an indexed mesh.
+   *
+   * @param positions The position of the first vertex; the positions of the
+   *     following vertices are |stride| bytes apart.
+   * @param indices Three vertex indices per triangle.
+   * @param transform Row-major model matrix, as in gvr::Mat4f.
+   */
+  void AddMesh(const float* positions, size_t stride, const uint16_t* indices,
+               size_t index_count, const float transform[4][4]);
+
+  /**
+   * Build the hierarchy over the meshes added so far. Meshes must not be
+   * added while IsOccluded() may be called.
+   */
+  void Build();
+
+  /**
+   * Return true if a triangle crosses the segment from |from| to |to|. May
+   * be called from any number of threads at once.
+   */
+  bool IsOccluded(const float from[3], const float to[3]) const;
+
+  size_t GetTriangleCount() const;
+
+  /**
+   * Return a hash of the triangles, e.g. to key caches of results that
+   * depend on the scene.
+   */
+  uint64_t GetContentHash() const;
+
+ private:
+  struct Triangle {
+    // A vertex and the two edges from it, as the intersection test uses
+    // them.
+    float vertex[3];
+    float edge1[3];
+    float edge2[3];
+  };
+
+  struct Node {
+    float min[3];
+    float max[3];
+    // For leaves, the first of |count| triangles. For interior nodes, whose
+    // count is zero, the index of the second child; the first child follows
+    // the node.
+    uint32_t index;
+    uint32_t count;
+  };
+
+  uint32_t BuildNode(size_t begin, size_t end);
+
+  std::vector<Triangle> triangles_;
+  std::vector<Node> nodes_;
+  // Scratch space for Build().
+  std::vector<float> centroids_;
+  std::vector<uint32_t> order_;
+};
+
+/**
+ * Counters describing the work of AudioOcclusion. A tick is skipped when
+ * the rays of the previous tick are still being cast.
+ */
+struct AudioOcclusionStats {
+  uint64_t ticks;
+  uint64_t ticks_skipped;
+  uint64_t rays;
+  uint64_t total_cast_nanos;
+};
+
+/**
+ * How to render an occluded source.
+ */
+struct OcclusionParams {
+  // Factor to apply to the volume of the source.
+  float volume;
+  // Cutoff of the low pass filter to apply to the source, for audio engines
+  // that can filter individual sources.
+  float lowpass_hz;
+};
+
+/**
+ * Estimates how much of each sound source is hidden from the listener by the
+ * scene, without blocking the thread that drives it.
+ *
+ * Each Update() harvests the rays cast since the previous one, smooths the
+ * fraction of blocked rays of each source over time, and hands the worker
+ * threads a new batch: a few rays from the listener to points around every
+ * source, split into groups of sources that the workers take in turn. If the
+ * previous batch is not done yet, the tick is skipped rather than waited
+ * for, and the results simply lag by a tick.
+ *
+ * All methods may be called from any thread.
+ */
+class AudioOcclusion {
+ public:
+  typedef int SourceId;
+  static const SourceId kInvalidSource = -1;
+
+  /**
+   * Create an AudioOcclusion.
+   *
+   * @param bvh The (non-owned) scene, which must be built before the first
+   *     Update().
+   * @param worker_count Number of threads casting rays.
+   */
+  AudioOcclusion(const OcclusionBvh* bvh, int worker_count);
+
+  /**
+   * Destructor. Waits for the workers to exit.
+   */
+  ~AudioOcclusion();
+
+  SourceId AddSource(float x, float y, float z);
+  void RemoveSource(SourceId source);
+  void SetSourcePosition(SourceId source, float x, float y, float z);
+
+  /**
+   * Apply the results of the previous batch and start casting rays from a
+   * listener at (x, y, z). Call once per audio tick.
+   */
+  void Update(float x, float y, float z, uint64_t now_nanos);
+
+  /**
+   * Wait until the batch in flight is done, e.g. to make a replay
+   * deterministic.
+   */
+  void Flush();
+
+  /**
+   * Return the smoothed fraction of |source| that is hidden, from 0 to 1.
+   */
+  float GetOcclusion(SourceId source) const;
+
+  /**
+   * Return how to render |source| for its current occlusion.
+   */
+  OcclusionParams GetParams(SourceId source) const;
+
+  AudioOcclusionStats GetStats() const;
+
+ private:
+  struct Source {
+    float position[3];
+    bool active;
+    float occlusion;
+  };
+
+  void WorkerLoop();
+  void CastGroup(size_t group);
+
+  const OcclusionBvh* const bvh_;
+
+  // Guards the sources and the counters.
+  mutable std::mutex mutex_;
+  std::vector<Source> sources_;
+  uint64_t last_update_nanos_;
+  AudioOcclusionStats stats_;
+
+  // The batch in flight: the listener, the sources it covers, and the
+  // fraction of blocked rays of each, written by the workers. Update() only
+  // touches these once no group remains and no worker is active.
+  float listener_[3];
+  std::vector<int> batch_sources_;
+  std::vector<float> batch_positions_;
+  std::vector<float> batch_results_;
+  size_t group_count_;
+  std::atomic<uint64_t> cast_nanos_;
+  std::atomic<size_t> next_group_;
+  std::atomic<size_t> remaining_groups_;
+
+  // Guards |active_workers_|, |generation_| and |stopping_|, which wake the
+  // workers for each batch.
+  std::mutex work_mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+  int active_workers_;
+  uint64_t generation_;
+  bool stopping_;
+  std::vector<std::thread> workers_;
+
+  // Disallow copy and assign.
+  AudioOcclusion(const AudioOcclusion& other) = delete;
+  AudioOcclusion& operator=(const AudioOcclusion& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_AUDIOOCCLUSION_H_  // NOLINT
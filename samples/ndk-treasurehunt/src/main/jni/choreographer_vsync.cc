@@ -0,0 +1,38 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "choreographer_vsync.h"  // NOLINT
+
+ChoreographerVsync::ChoreographerVsync() : vsync_nanos_(0), period_nanos_(0) {}
+
+void ChoreographerVsync::OnVsync(uint64_t frame_time_nanos,
+                                 uint64_t period_nanos) {
+  // The period only changes with the display mode, so a reader that sees a
+  // new period with an old timestamp still extrapolates correctly.
+  period_nanos_ = period_nanos;
+  vsync_nanos_ = frame_time_nanos;
+}
+
+void ChoreographerVsync::Reset() {
+  vsync_nanos_ = 0;
+  period_nanos_ = 0;
+}
+
+bool ChoreographerVsync::GetVsync(uint64_t* vsync_nanos,
+                                  uint64_t* period_nanos) const {
+  *vsync_nanos = vsync_nanos_.load();
+  *period_nanos = period_nanos_.load();
+  return *vsync_nanos != 0 && *period_nanos != 0;
+}
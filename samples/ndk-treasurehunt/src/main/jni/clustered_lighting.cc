@@ -0,0 +1,207 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "clustered_lighting.h"  // NOLINT
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+static const char* kShaderCode = R"glsl(
+    precision highp float;
+
+    uniform sampler2D u_LightTexture;
+    uniform sampler2D u_ClusterTexture;
+    uniform sampler2D u_LightIndexTexture;
+    uniform vec4 u_ClusterTiles;
+    uniform vec2 u_ClusterSlices;
+
+    vec3 ClusteredLight(vec3 position, vec3 normal) {
+      float depth = -position.z;
+      vec3 cluster = floor(vec3(
+          position.xy / depth * u_ClusterTiles.xz + u_ClusterTiles.yw,
+          log(depth) * u_ClusterSlices.x + u_ClusterSlices.y));
+      cluster = clamp(cluster, vec3(0.0), vec3(CLUSTER_TILES_X - 1.0,
+                                               CLUSTER_TILES_Y - 1.0,
+                                               CLUSTER_SLICES - 1.0));
+      vec4 entry = texture2D(
+          u_ClusterTexture,
+          vec2((cluster.x + cluster.y * CLUSTER_TILES_X + 0.5) /
+                   (CLUSTER_TILES_X * CLUSTER_TILES_Y),
+               (cluster.z + 0.5) / CLUSTER_SLICES));
+      vec3 light = vec3(0.0);
+      for (int i = 0; i < CLUSTER_MAX_LIGHTS; ++i) {
+        if (float(i) >= entry.a) break;
+        float index = entry.r + float(i);
+        float row = floor((index + 0.5) / CLUSTER_INDEX_ROW_LENGTH);
+        float slot = texture2D(
+            u_LightIndexTexture,
+            vec2((index - row * CLUSTER_INDEX_ROW_LENGTH + 0.5) /
+                     CLUSTER_INDEX_ROW_LENGTH,
+                 (row + 0.5) / CLUSTER_INDEX_ROWS)).r;
+        float u = (slot + 0.5) / CLUSTER_LIGHT_SLOTS;
+        vec4 sphere = texture2D(u_LightTexture, vec2(u, 0.25));
+        vec3 color = texture2D(u_LightTexture, vec2(u, 0.75)).rgb;
+        vec3 to_light = sphere.xyz - position;
+        float distance_squared = dot(to_light, to_light);
+        float falloff =
+            max(1.0 - distance_squared / (sphere.w * sphere.w), 0.0);
+        float lambert = max(dot(normal, to_light), 0.0) *
+                        inversesqrt(distance_squared + 0.0001);
+        light += color * (falloff * falloff * lambert);
+      }
+      return light;
+    }
+)glsl";
+
+// Creates a float texture sampled without filtering, as a lookup table.
+static GLuint CreateTable(GpuMemoryTracker* gpu_memory, GLenum format,
+                          int width, int height) {
+  const GLuint texture =
+      gpu_memory->CreateTexture2D(format, GL_FLOAT, width, height, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  return texture;
+}
+
+static bool HasExtension(const char* name) {
+  const char* extensions =
+      reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  if (extensions == nullptr) return false;
+  const size_t length = strlen(name);
+  for (const char* found = strstr(extensions, name); found != nullptr;
+       found = strstr(found + length, name)) {
+    const char end = found[length];
+    if ((found == extensions || found[-1] == ' ') &&
+        (end == ' ' || end == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // anonymous namespace
+
+const int ClusteredLighting::kFirstTextureUnit;
+const int ClusteredLighting::kTextureUnitCount;
+
+ClusteredLighting::ClusteredLighting(GpuMemoryTracker* gpu_memory)
+    : gpu_memory_(gpu_memory),
+      light_texture_(0),
+      cluster_texture_(0),
+      index_texture_(0),
+      tiles_{0.0f, 0.0f, 0.0f, 0.0f},
+      slices_{0.0f, 0.0f} {}
+
+bool ClusteredLighting::InitializeGl() {
+  if (!HasExtension("GL_OES_texture_float")) return false;
+  GLint range[2];
+  GLint precision = 0;
+  glGetShaderPrecisionFormat(GL_FRAGMENT_SHADER, GL_HIGH_FLOAT, range,
+                             &precision);
+  if (precision == 0) return false;
+
+  // The textures of a previous context are gone; only the accounting is
+  // left.
+  if (light_texture_ != 0) {
+    gpu_memory_->DeleteTexture(light_texture_);
+    gpu_memory_->DeleteTexture(cluster_texture_);
+    gpu_memory_->DeleteTexture(index_texture_);
+  }
+  light_texture_ =
+      CreateTable(gpu_memory_, GL_RGBA, LightClusters::kMaxLights, 2);
+  cluster_texture_ = CreateTable(
+      gpu_memory_, GL_LUMINANCE_ALPHA,
+      LightClusters::kTilesX * LightClusters::kTilesY, LightClusters::kSlices);
+  index_texture_ =
+      CreateTable(gpu_memory_, GL_LUMINANCE, LightClusters::kIndexRowLength,
+                  LightClusters::kIndexRows);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return glGetError() == GL_NO_ERROR;
+}
+
+std::string ClusteredLighting::GetShaderCode() {
+  char defines[512];
+  snprintf(defines, sizeof(defines),
+           "#define CLUSTER_TILES_X %d.0\n"
+           "#define CLUSTER_TILES_Y %d.0\n"
+           "#define CLUSTER_SLICES %d.0\n"
+           "#define CLUSTER_MAX_LIGHTS %d\n"
+           "#define CLUSTER_LIGHT_SLOTS %d.0\n"
+           "#define CLUSTER_INDEX_ROW_LENGTH %d.0\n"
+           "#define CLUSTER_INDEX_ROWS %d.0\n",
+           LightClusters::kTilesX, LightClusters::kTilesY,
+           LightClusters::kSlices, LightClusters::kMaxLightsPerCluster,
+           LightClusters::kMaxLights, LightClusters::kIndexRowLength,
+           LightClusters::kIndexRows);
+  return std::string(defines) + kShaderCode;
+}
+
+ClusteredLighting::Uniforms ClusteredLighting::GetUniforms(int program) {
+  Uniforms uniforms;
+  uniforms.light_texture = glGetUniformLocation(program, "u_LightTexture");
+  uniforms.cluster_texture = glGetUniformLocation(program, "u_ClusterTexture");
+  uniforms.index_texture =
+      glGetUniformLocation(program, "u_LightIndexTexture");
+  uniforms.tiles = glGetUniformLocation(program, "u_ClusterTiles");
+  uniforms.slices = glGetUniformLocation(program, "u_ClusterSlices");
+  return uniforms;
+}
+
+void ClusteredLighting::Upload(const LightClusters& clusters) {
+  // Only upload the lights and the rows of indices in use.
+  const int lights = clusters.GetVisibleLightCount();
+  glBindTexture(GL_TEXTURE_2D, light_texture_);
+  if (lights > 0) {
+    const float* data = clusters.GetLightData();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, lights, 1, GL_RGBA, GL_FLOAT,
+                    data);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 1, lights, 1, GL_RGBA, GL_FLOAT,
+                    data + 4 * LightClusters::kMaxLights);
+  }
+  glBindTexture(GL_TEXTURE_2D, cluster_texture_);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                  LightClusters::kTilesX * LightClusters::kTilesY,
+                  LightClusters::kSlices, GL_LUMINANCE_ALPHA, GL_FLOAT,
+                  clusters.GetClusterData());
+  const int rows =
+      (clusters.GetIndexCount() + LightClusters::kIndexRowLength - 1) /
+      LightClusters::kIndexRowLength;
+  if (rows > 0) {
+    glBindTexture(GL_TEXTURE_2D, index_texture_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LightClusters::kIndexRowLength,
+                    rows, GL_LUMINANCE, GL_FLOAT, clusters.GetIndexData());
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  clusters.GetTileTransform(tiles_);
+  clusters.GetSliceTransform(slices_);
+}
+
+void ClusteredLighting::Bind(const Uniforms& uniforms) const {
+  const GLuint textures[kTextureUnitCount] = {light_texture_, cluster_texture_,
+                                              index_texture_};
+  const int samplers[kTextureUnitCount] = {uniforms.light_texture,
+                                           uniforms.cluster_texture,
+                                           uniforms.index_texture};
+  for (int i = 0; i < kTextureUnitCount; ++i) {
+    glActiveTexture(GL_TEXTURE0 + kFirstTextureUnit + i);
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glUniform1i(samplers[i], kFirstTextureUnit + i);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glUniform4fv(uniforms.tiles, 1, tiles_);
+  glUniform2fv(uniforms.slices, 1, slices_);
+}
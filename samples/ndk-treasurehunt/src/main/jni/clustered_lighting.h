@@ -0,0 +1,118 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_CLUSTEREDLIGHTING_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_CLUSTEREDLIGHTING_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+
+#include <string>
+
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "light_clusters.h"  // NOLINT
+
+/**
+ * Uploads the clusters of LightClusters as textures, and provides the
+ * fragment shader code that shades with them, so that a scene can carry
+ * hundreds of point lights while each fragment only evaluates the few of its
+ * cluster.
+ *
+ * The textures hold positions and light indices as floats, so the lights
+ * need OES_texture_float and high precision fragment shaders, both of which
+ * Daydream-ready GPUs have.
+ *
+ * Usage, on the rendering thread:
+ *
+ *   lighting.InitializeGl();                    // Once per GL context.
+ *   <link a program whose fragment shader starts with GetShaderCode()>
+ *   uniforms = ClusteredLighting::GetUniforms(program);
+ *   ...
+ *   clusters.SetFrustum(...);                   // For each eye.
+ *   clusters.Bin(lights, count, view);
+ *   lighting.Upload(clusters);
+ *   glUseProgram(program);
+ *   lighting.Bind(uniforms);
+ *   <draw>
+ */
+class ClusteredLighting {
+ public:
+  /**
+   * Locations of the uniforms of GetShaderCode() in a program.
+   */
+  struct Uniforms {
+    int light_texture;
+    int cluster_texture;
+    int index_texture;
+    int tiles;
+    int slices;
+  };
+
+  /**
+   * The textures are bound to this texture unit and the two after it.
+   */
+  static const int kFirstTextureUnit = 1;
+  static const int kTextureUnitCount = 3;
+
+  /**
+   * Create a ClusteredLighting.
+   *
+   * @param gpu_memory The (non-owned) tracker to create the textures with.
+   */
+  explicit ClusteredLighting(GpuMemoryTracker* gpu_memory);
+
+  /**
+   * Create the textures. Must be called with a current GL context. Returns
+   * false if float textures or high precision fragment shaders are not
+   * supported, in which case nothing else may be called.
+   */
+  bool InitializeGl();
+
+  /**
+   * Return the GLSL code to start a fragment shader with. It sets the
+   * default precision and declares
+   *
+   *   vec3 ClusteredLight(vec3 position, vec3 normal);
+   *
+   * which returns the diffuse light of the lights of the cluster at
+   * |position|, with the unit |normal|, both in view space.
+   */
+  static std::string GetShaderCode();
+
+  static Uniforms GetUniforms(int program);
+
+  /**
+   * Upload the clusters of the eye about to be drawn.
+   */
+  void Upload(const LightClusters& clusters);
+
+  /**
+   * Bind the textures and set the uniforms of the current program.
+   */
+  void Bind(const Uniforms& uniforms) const;
+
+ private:
+  GpuMemoryTracker* const gpu_memory_;
+  GLuint light_texture_;
+  GLuint cluster_texture_;
+  GLuint index_texture_;
+  float tiles_[4];
+  float slices_[2];
+
+  // Disallow copy and assign.
+  ClusteredLighting(const ClusteredLighting& other) = delete;
+  ClusteredLighting& operator=(const ClusteredLighting& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_CLUSTEREDLIGHTING_H_  // NOLINT
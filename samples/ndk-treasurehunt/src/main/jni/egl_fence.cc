@@ -0,0 +1,67 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "egl_fence.h"  // NOLINT
+
+#include <string.h>
+
+EglFence::EglFence()
+    : display_(EGL_NO_DISPLAY),
+      create_sync_(nullptr),
+      client_wait_sync_(nullptr),
+      destroy_sync_(nullptr) {}
+
+bool EglFence::InitializeGl() {
+  display_ = eglGetCurrentDisplay();
+  create_sync_ = nullptr;
+  client_wait_sync_ = nullptr;
+  destroy_sync_ = nullptr;
+  const char* extensions = eglQueryString(display_, EGL_EXTENSIONS);
+  if (display_ == EGL_NO_DISPLAY || extensions == nullptr ||
+      strstr(extensions, "EGL_KHR_fence_sync") == nullptr) {
+    return false;
+  }
+  create_sync_ = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(
+      eglGetProcAddress("eglCreateSyncKHR"));
+  client_wait_sync_ = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(
+      eglGetProcAddress("eglClientWaitSyncKHR"));
+  destroy_sync_ = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(
+      eglGetProcAddress("eglDestroySyncKHR"));
+  if (!create_sync_ || !client_wait_sync_ || !destroy_sync_) {
+    create_sync_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+GpuFence::Handle EglFence::Insert() {
+  if (!create_sync_) return nullptr;
+  const EGLSyncKHR sync = create_sync_(display_, EGL_SYNC_FENCE_KHR, nullptr);
+  return sync == EGL_NO_SYNC_KHR ? nullptr : sync;
+}
+
+bool EglFence::Wait(Handle fence, uint64_t timeout_nanos) {
+  // Flushing makes sure the fence reaches the GPU, otherwise a wait could
+  // never end.
+  const EGLint result =
+      client_wait_sync_(display_, static_cast<EGLSyncKHR>(fence),
+                        EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, timeout_nanos);
+  // Treat errors as signaled, so that a broken fence cannot stall frames.
+  return result != EGL_TIMEOUT_EXPIRED_KHR;
+}
+
+void EglFence::Delete(Handle fence) {
+  destroy_sync_(display_, static_cast<EGLSyncKHR>(fence));
+}
@@ -0,0 +1,269 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_graph.h"  // NOLINT
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "logging.h"  // NOLINT
+
+namespace {
+static bool IsCompatible(const RenderTargetDesc& a, const RenderTargetDesc& b) {
+  return a.size.width == b.size.width && a.size.height == b.size.height &&
+         a.color_format == b.color_format && a.color_type == b.color_type &&
+         a.has_depth == b.has_depth;
+}
+}  // anonymous namespace
+
+FrameGraph::FrameGraph(GpuMemoryTracker* gpu_memory)
+    : gpu_memory_(gpu_memory), compiled_(false) {}
+
+int FrameGraph::CreateRenderTarget(const std::string& name,
+                                   const RenderTargetDesc& desc) {
+  CHECK(!compiled_);
+  Resource resource;
+  resource.name = name;
+  resource.is_output = false;
+  resource.desc = desc;
+  resource.physical = -1;
+  resources_.push_back(resource);
+  return static_cast<int>(resources_.size()) - 1;
+}
+
+int FrameGraph::AddOutput(const std::string& name) {
+  CHECK(!compiled_);
+  Resource resource;
+  resource.name = name;
+  resource.is_output = true;
+  resource.desc = {{0, 0}, GL_NONE, GL_NONE, false};
+  resource.physical = -1;
+  resources_.push_back(resource);
+  return static_cast<int>(resources_.size()) - 1;
+}
+
+void FrameGraph::AddPass(const std::string& name,
+                         const std::vector<int>& reads,
+                         const std::vector<int>& writes,
+                         PassFunction function) {
+  CHECK(!compiled_);
+  const int index = static_cast<int>(passes_.size());
+  for (int resource : reads) {
+    CHECK(resource >= 0 && resource < static_cast<int>(resources_.size()));
+    resources_[resource].readers.push_back(index);
+  }
+  for (int resource : writes) {
+    CHECK(resource >= 0 && resource < static_cast<int>(resources_.size()));
+    resources_[resource].writers.push_back(index);
+  }
+  Pass pass;
+  pass.name = name;
+  pass.reads = reads;
+  pass.writes = writes;
+  pass.function = std::move(function);
+  passes_.push_back(std::move(pass));
+}
+
+void FrameGraph::Compile() {
+  CHECK(!compiled_);
+  const std::vector<bool> live = FindLivePasses();
+  SchedulePasses(live);
+  AssignPhysicalTargets();
+  compiled_ = true;
+  LOGD("Frame graph: %zu of %zu passes, %d render targets for %zu resources.",
+       schedule_.size(), passes_.size(), GetPhysicalTargetCount(),
+       resources_.size());
+}
+
+std::vector<bool> FrameGraph::FindLivePasses() const {
+  // Walk back from the outputs, through the writers of every resource that a
+  // live pass reads.
+  std::vector<bool> live(passes_.size(), false);
+  std::vector<int> pending;
+  for (const Resource& resource : resources_) {
+    if (!resource.is_output) continue;
+    for (int writer : resource.writers) pending.push_back(writer);
+  }
+  while (!pending.empty()) {
+    const int pass = pending.back();
+    pending.pop_back();
+    if (live[pass]) continue;
+    live[pass] = true;
+    for (int resource : passes_[pass].reads) {
+      for (int writer : resources_[resource].writers) {
+        if (!live[writer]) pending.push_back(writer);
+      }
+    }
+  }
+  return live;
+}
+
+void FrameGraph::SchedulePasses(const std::vector<bool>& live) {
+  // A pass runs after the passes that write what it reads, and after the
+  // passes declared before it that write the same resources.
+  const size_t pass_count = passes_.size();
+  std::vector<std::vector<int>> successors(pass_count);
+  std::vector<int> predecessor_count(pass_count, 0);
+  auto add_edge = [&](int from, int to) {
+    if (from == to || !live[from] || !live[to]) return;
+    successors[from].push_back(to);
+    ++predecessor_count[to];
+  };
+  for (const Resource& resource : resources_) {
+    for (size_t i = 0; i < resource.writers.size(); ++i) {
+      if (i > 0) add_edge(resource.writers[i - 1], resource.writers[i]);
+      for (int reader : resource.readers) {
+        add_edge(resource.writers[i], reader);
+      }
+    }
+  }
+
+  // Among the passes that are ready, the one declared first runs first.
+  schedule_.clear();
+  std::vector<int> ready;
+  for (size_t pass = 0; pass < pass_count; ++pass) {
+    if (live[pass] && predecessor_count[pass] == 0) ready.push_back(pass);
+  }
+  while (!ready.empty()) {
+    const auto first = std::min_element(ready.begin(), ready.end());
+    const int pass = *first;
+    ready.erase(first);
+    schedule_.push_back(pass);
+    for (int successor : successors[pass]) {
+      if (--predecessor_count[successor] == 0) ready.push_back(successor);
+    }
+  }
+  // A pass left out is part of a cycle.
+  CHECK(schedule_.size() ==
+        static_cast<size_t>(std::count(live.begin(), live.end(), true)));
+}
+
+void FrameGraph::AssignPhysicalTargets() {
+  // Lifetime of each transient target, in positions in the schedule.
+  const int resource_count = static_cast<int>(resources_.size());
+  std::vector<int> first_use(resource_count, -1);
+  std::vector<int> last_use(resource_count, -1);
+  for (size_t position = 0; position < schedule_.size(); ++position) {
+    const Pass& pass = passes_[schedule_[position]];
+    for (const std::vector<int>* list : {&pass.reads, &pass.writes}) {
+      for (int resource : *list) {
+        if (first_use[resource] < 0) first_use[resource] = position;
+        last_use[resource] = position;
+      }
+    }
+  }
+
+  std::vector<int> targets_by_first_use;
+  for (int resource = 0; resource < resource_count; ++resource) {
+    resources_[resource].physical = -1;
+    if (!resources_[resource].is_output && first_use[resource] >= 0) {
+      targets_by_first_use.push_back(resource);
+    }
+  }
+  std::stable_sort(targets_by_first_use.begin(), targets_by_first_use.end(),
+                   [&first_use](int a, int b) {
+                     return first_use[a] < first_use[b];
+                   });
+
+  // Greedily reuse a compatible target whose last user has already run.
+  physical_targets_.clear();
+  std::vector<int> physical_last_use;
+  for (int resource : targets_by_first_use) {
+    const RenderTargetDesc& desc = resources_[resource].desc;
+    int physical = -1;
+    for (size_t i = 0; i < physical_targets_.size(); ++i) {
+      if (physical_last_use[i] < first_use[resource] &&
+          IsCompatible(physical_targets_[i].desc, desc)) {
+        physical = i;
+        break;
+      }
+    }
+    if (physical < 0) {
+      physical = physical_targets_.size();
+      physical_targets_.push_back({desc, 0, 0, 0});
+      physical_last_use.push_back(-1);
+    }
+    physical_last_use[physical] = last_use[resource];
+    resources_[resource].physical = physical;
+  }
+}
+
+void FrameGraph::InitializeGl() {
+  CHECK(compiled_);
+  // Objects from a previous GL context are gone, so there is nothing to
+  // delete.
+  for (PhysicalTarget& target : physical_targets_) {
+    const gvr::Sizei& size = target.desc.size;
+    target.texture =
+        gpu_memory_->CreateTexture2D(target.desc.color_format,
+                                     target.desc.color_type, size.width,
+                                     size.height, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, target.texture, 0);
+    target.depth_renderbuffer = 0;
+    if (target.desc.has_depth) {
+      glGenRenderbuffers(1, &target.depth_renderbuffer);
+      glBindRenderbuffer(GL_RENDERBUFFER, target.depth_renderbuffer);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16,
+                            size.width, size.height);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                GL_RENDERBUFFER, target.depth_renderbuffer);
+    }
+    CHECK(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+          GL_FRAMEBUFFER_COMPLETE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+  CHECK(glGetError() == GL_NO_ERROR);
+}
+
+void FrameGraph::Execute(gvr::Frame* frame) const {
+  CHECK(compiled_);
+  for (int pass : schedule_) {
+    passes_[pass].function(frame, *this);
+  }
+}
+
+GLuint FrameGraph::GetFramebuffer(int resource) const {
+  const int physical = resources_[resource].physical;
+  CHECK(physical >= 0);
+  return physical_targets_[physical].framebuffer;
+}
+
+GLuint FrameGraph::GetTexture(int resource) const {
+  const int physical = resources_[resource].physical;
+  CHECK(physical >= 0);
+  return physical_targets_[physical].texture;
+}
+
+const std::vector<int>& FrameGraph::GetSchedule() const { return schedule_; }
+
+int FrameGraph::GetPhysicalTarget(int resource) const {
+  return resources_[resource].physical;
+}
+
+int FrameGraph::GetPhysicalTargetCount() const {
+  return static_cast<int>(physical_targets_.size());
+}
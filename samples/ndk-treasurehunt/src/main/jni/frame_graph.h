@@ -0,0 +1,190 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_FRAMEGRAPH_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_FRAMEGRAPH_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "vr/gvr/capi/include/gvr.h"
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * Description of a transient render target: a color texture, and optionally
+ * a depth renderbuffer.
+ */
+struct RenderTargetDesc {
+  gvr::Sizei size;
+  GLenum color_format;  // E.g. GL_RGBA.
+  GLenum color_type;    // E.g. GL_UNSIGNED_BYTE.
+  bool has_depth;
+};
+
+/**
+ * Describes the passes of a frame and the resources they read and write,
+ * and runs them.
+ *
+ * Resources are either transient render targets, which only live within a
+ * frame and are owned by the graph, or outputs, which stand for something
+ * outside of the graph, such as a swap chain buffer. Compile() keeps the
+ * passes that contribute to an output, orders them so that every resource
+ * is written before it is read, and lets transient targets whose lifetimes
+ * do not overlap share the same GL objects. Compile() makes no GL calls, so
+ * the scheduling and aliasing can be exercised without a GL context.
+ *
+ * Since targets are shared, a pass must not expect a transient target to
+ * keep its content from one frame to the next: the first pass that writes it
+ * in a frame should clear it or overwrite it entirely.
+ *
+ * Usage:
+ *
+ *   int blur = graph.CreateRenderTarget("blur", blur_desc);
+ *   int eyes = graph.AddOutput("eyes");
+ *   graph.AddPass("blur", {}, {blur}, draw_blur);
+ *   graph.AddPass("world", {blur}, {eyes}, draw_world);
+ *   graph.Compile();
+ *   graph.InitializeGl();   // On the rendering thread, with a GL context.
+ *   ...
+ *   graph.Execute(&frame);  // Every frame.
+ */
+class FrameGraph {
+ public:
+  /**
+   * Runs a pass. The pass binds the framebuffers it renders into, see
+   * GetFramebuffer().
+   */
+  typedef std::function<void(gvr::Frame* frame, const FrameGraph& graph)>
+      PassFunction;
+
+  /**
+   * Create a FrameGraph.
+   *
+   * @param gpu_memory The (non-owned) tracker that accounts for the render
+   *     targets.
+   */
+  explicit FrameGraph(GpuMemoryTracker* gpu_memory);
+
+  /**
+   * Declare a transient render target and return its id.
+   */
+  int CreateRenderTarget(const std::string& name,
+                         const RenderTargetDesc& desc);
+
+  /**
+   * Declare an output of the frame and return its id. Passes that write an
+   * output are never culled.
+   */
+  int AddOutput(const std::string& name);
+
+  /**
+   * Declare a pass that reads |reads| and writes |writes|. A pass runs after
+   * every pass that writes a resource it reads, and passes that write the
+   * same resource run in the order they are declared.
+   */
+  void AddPass(const std::string& name, const std::vector<int>& reads,
+               const std::vector<int>& writes, PassFunction function);
+
+  /**
+   * Cull, order and alias. Must be called after all resources and passes
+   * have been declared, and before InitializeGl().
+   */
+  void Compile();
+
+  /**
+   * Create the GL objects of the shared render targets. Must be called on the
+   * rendering thread with a valid GL context, and again when the context is
+   * recreated.
+   */
+  void InitializeGl();
+
+  /**
+   * Run the scheduled passes, in order.
+   */
+  void Execute(gvr::Frame* frame) const;
+
+  /**
+   * Return the framebuffer to render into transient target |resource|.
+   */
+  GLuint GetFramebuffer(int resource) const;
+
+  /**
+   * Return the color texture of transient target |resource|.
+   */
+  GLuint GetTexture(int resource) const;
+
+  /**
+   * Return the indices of the passes that run, in the order they run, in
+   * declaration order numbering.
+   */
+  const std::vector<int>& GetSchedule() const;
+
+  /**
+   * Return the index of the shared target that backs transient target
+   * |resource|, or -1 if no scheduled pass uses it.
+   */
+  int GetPhysicalTarget(int resource) const;
+
+  /**
+   * Return the number of shared targets, which is at most the number of
+   * transient targets.
+   */
+  int GetPhysicalTargetCount() const;
+
+ private:
+  struct Resource {
+    std::string name;
+    bool is_output;
+    RenderTargetDesc desc;  // Only for transient targets.
+    std::vector<int> writers;
+    std::vector<int> readers;
+    int physical;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<int> reads;
+    std::vector<int> writes;
+    PassFunction function;
+  };
+
+  struct PhysicalTarget {
+    RenderTargetDesc desc;
+    GLuint texture;
+    GLuint depth_renderbuffer;
+    GLuint framebuffer;
+  };
+
+  std::vector<bool> FindLivePasses() const;
+  void SchedulePasses(const std::vector<bool>& live);
+  void AssignPhysicalTargets();
+
+  GpuMemoryTracker* gpu_memory_;
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  std::vector<int> schedule_;
+  std::vector<PhysicalTarget> physical_targets_;
+  bool compiled_;
+
+  // Disallow copy and assign.
+  FrameGraph(const FrameGraph& other) = delete;
+  FrameGraph& operator=(const FrameGraph& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_FRAMEGRAPH_H_  // NOLINT
@@ -0,0 +1,206 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_scheduler.h"  // NOLINT
+
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+
+namespace {
+static uint64_t SteadyNowNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+static void SleepNanos(uint64_t nanos) {
+  std::this_thread::sleep_for(std::chrono::nanoseconds(nanos));
+}
+}  // anonymous namespace
+
+FrameScheduler::FrameScheduler(uint64_t safety_margin_nanos,
+                               uint64_t fallback_prediction_nanos)
+    : safety_margin_nanos_(safety_margin_nanos),
+      fallback_prediction_nanos_(fallback_prediction_nanos),
+      vsync_(nullptr),
+      fence_(nullptr),
+      clock_(SteadyNowNanos),
+      sleep_(SleepNanos),
+      next_cost_sample_(0),
+      cost_estimate_nanos_(0),
+      start_nanos_(0),
+      deadline_nanos_(0),
+      delay_nanos_(0),
+      latency_nanos_(0),
+      frames_scheduled_(0),
+      deadlines_missed_(0),
+      total_delay_nanos_(0),
+      total_latency_nanos_(0),
+      max_latency_nanos_(0) {
+  for (int i = 0; i < kCostWindow; ++i) cost_samples_[i] = 0;
+}
+
+void FrameScheduler::SetVsyncProvider(VsyncProvider* vsync) {
+  vsync_ = vsync;
+}
+
+void FrameScheduler::SetFence(GpuFence* fence) {
+  fence_ = fence;
+  pending_.clear();
+}
+
+uint64_t FrameScheduler::BeginFrame() {
+  PollPendingFrames(0);
+  const uint64_t now_nanos = clock_();
+  uint64_t vsync_nanos = 0;
+  uint64_t period_nanos = 0;
+  deadline_nanos_ = 0;
+  if (!vsync_ || !vsync_->GetVsync(&vsync_nanos, &period_nanos) ||
+      period_nanos == 0) {
+    start_nanos_ = now_nanos;
+    return now_nanos + fallback_prediction_nanos_;
+  }
+
+  // The deadline is the first vsync at which the frame can be complete if
+  // its work starts now. It is extrapolated from the known vsync, which may
+  // be several periods old.
+  const uint64_t budget_nanos = cost_estimate_nanos_ + safety_margin_nanos_;
+  const uint64_t finish_nanos = now_nanos + budget_nanos;
+  uint64_t deadline_nanos = vsync_nanos;
+  if (finish_nanos > vsync_nanos) {
+    deadline_nanos +=
+        (finish_nanos - vsync_nanos + period_nanos - 1) / period_nanos *
+        period_nanos;
+  } else {
+    deadline_nanos -= (vsync_nanos - finish_nanos) / period_nanos *
+                      period_nanos;
+  }
+
+  // Start as late as the deadline allows. Spend the first part of the wait
+  // on the fences of the previous frames, so that their cost is measured
+  // without holding up the rendering thread any longer.
+  const uint64_t start_nanos = deadline_nanos - budget_nanos;
+  if (start_nanos > now_nanos) {
+    PollPendingFrames(start_nanos - now_nanos);
+    const uint64_t polled_nanos = clock_();
+    if (start_nanos > polled_nanos) sleep_(start_nanos - polled_nanos);
+  }
+  start_nanos_ = clock_();
+  deadline_nanos_ = deadline_nanos;
+
+  // The compositor latches the frame at the deadline, and it is scanned out
+  // during the following refresh period.
+  const uint64_t display_nanos = deadline_nanos + period_nanos;
+  delay_nanos_ = start_nanos_ - now_nanos;
+  latency_nanos_ =
+      display_nanos > start_nanos_ ? display_nanos - start_nanos_ : 0;
+  return display_nanos;
+}
+
+void FrameScheduler::EndFrame() {
+  const uint64_t end_nanos = clock_();
+  if (deadline_nanos_ != 0) {
+    ++frames_scheduled_;
+    total_delay_nanos_ += delay_nanos_;
+    total_latency_nanos_ += latency_nanos_;
+    if (latency_nanos_ > max_latency_nanos_.load()) {
+      max_latency_nanos_ = latency_nanos_;
+    }
+  }
+  // The GPU is several frames behind: the oldest frame is still running, so
+  // it cost at least this much.
+  if (static_cast<int>(pending_.size()) >= kMaxPendingFrames) {
+    const PendingFrame& oldest = pending_.front();
+    fence_->Delete(oldest.fence);
+    RetireFrame(oldest.start_nanos, end_nanos, oldest.deadline_nanos);
+    pending_.pop_front();
+  }
+  const GpuFence::Handle fence = fence_ ? fence_->Insert() : nullptr;
+  if (fence) {
+    pending_.push_back({fence, start_nanos_, deadline_nanos_});
+  } else {
+    RetireFrame(start_nanos_, end_nanos, deadline_nanos_);
+  }
+  deadline_nanos_ = 0;
+}
+
+void FrameScheduler::AbortFrame() { deadline_nanos_ = 0; }
+
+uint64_t FrameScheduler::GetFrameCostEstimate() const {
+  return cost_estimate_nanos_;
+}
+
+FrameScheduleStats FrameScheduler::GetStats() const {
+  FrameScheduleStats stats;
+  stats.frames_scheduled = frames_scheduled_.load();
+  stats.deadlines_missed = deadlines_missed_.load();
+  stats.total_delay_nanos = total_delay_nanos_.load();
+  stats.total_latency_nanos = total_latency_nanos_.load();
+  stats.max_latency_nanos = max_latency_nanos_.load();
+  return stats;
+}
+
+void FrameScheduler::ResetStats() {
+  frames_scheduled_ = 0;
+  deadlines_missed_ = 0;
+  total_delay_nanos_ = 0;
+  total_latency_nanos_ = 0;
+  max_latency_nanos_ = 0;
+}
+
+void FrameScheduler::SetClock(std::function<uint64_t()> clock,
+                              std::function<void(uint64_t)> sleep) {
+  clock_ = std::move(clock);
+  sleep_ = std::move(sleep);
+}
+
+void FrameScheduler::RetireFrame(uint64_t start_nanos, uint64_t end_nanos,
+                                 uint64_t deadline_nanos) {
+  AddCostSample(end_nanos > start_nanos ? end_nanos - start_nanos : 0);
+  if (deadline_nanos != 0 && end_nanos > deadline_nanos) ++deadlines_missed_;
+}
+
+void FrameScheduler::PollPendingFrames(uint64_t timeout_nanos) {
+  // The GPU finishes frames in order, so the oldest is waited on first.
+  const uint64_t poll_nanos = clock_();
+  while (!pending_.empty()) {
+    const uint64_t now_nanos = clock_();
+    const uint64_t waited_nanos = now_nanos - poll_nanos;
+    const PendingFrame& frame = pending_.front();
+    if (!fence_->Wait(frame.fence, timeout_nanos > waited_nanos
+                                       ? timeout_nanos - waited_nanos
+                                       : 0)) {
+      return;
+    }
+    fence_->Delete(frame.fence);
+    RetireFrame(frame.start_nanos, clock_(), frame.deadline_nanos);
+    pending_.pop_front();
+  }
+}
+
+void FrameScheduler::AddCostSample(uint64_t cost_nanos) {
+  cost_samples_[next_cost_sample_] = cost_nanos;
+  next_cost_sample_ = (next_cost_sample_ + 1) % kCostWindow;
+  // Using the largest recent cost, rather than an average, keeps occasional
+  // slow frames from missing their deadline.
+  cost_estimate_nanos_ = 0;
+  for (int i = 0; i < kCostWindow; ++i) {
+    if (cost_samples_[i] > cost_estimate_nanos_) {
+      cost_estimate_nanos_ = cost_samples_[i];
+    }
+  }
+}
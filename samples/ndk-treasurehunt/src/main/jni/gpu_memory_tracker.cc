@@ -0,0 +1,248 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gpu_memory_tracker.h"  // NOLINT
+
+#include <stdlib.h>
+
+#include "logging.h"  // NOLINT
+
+namespace {
+
+// Bytes per pixel of a texture uploaded with the given format and type.
+static size_t TextureBytesPerPixel(GLenum format, GLenum type) {
+  if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4 ||
+      type == GL_UNSIGNED_SHORT_5_5_5_1) {
+    return 2;
+  }
+  // Float textures (OES_texture_float) take four bytes per component.
+  const size_t component_bytes = type == GL_FLOAT ? 4 : 1;
+  switch (format) {
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+      return component_bytes;
+    case GL_LUMINANCE_ALPHA:
+      return 2 * component_bytes;
+    case GL_RGB:
+      return 3 * component_bytes;
+    default:
+      return 4 * component_bytes;
+  }
+}
+
+static size_t ColorBytesPerPixel(gvr::ColorFormat format) {
+  return format == GVR_COLOR_FORMAT_RGB_565 ? 2 : 4;
+}
+
+static size_t DepthStencilBytesPerPixel(gvr::DepthStencilFormat format) {
+  switch (format) {
+    case GVR_DEPTH_STENCIL_FORMAT_NONE:
+      return 0;
+    case GVR_DEPTH_STENCIL_FORMAT_STENCIL_8:
+      return 1;
+    case GVR_DEPTH_STENCIL_FORMAT_DEPTH_16:
+      return 2;
+    case GVR_DEPTH_STENCIL_FORMAT_DEPTH_32_F_STENCIL_8:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+}  // namespace
+
+GpuMemoryTracker::GpuMemoryTracker()
+    : total_live_bytes_(0), total_peak_bytes_(0) {
+  for (int i = 0; i < kNumCategories; ++i) {
+    live_bytes_[i] = 0;
+    peak_bytes_[i] = 0;
+    budgets_[i].budget_bytes = 0;
+    budgets_[i].notified_bytes = 0;
+  }
+}
+
+GLuint GpuMemoryTracker::CreateBuffer(GLenum target, GLsizeiptr size,
+                                      const void* data, GLenum usage) {
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(target, buffer);
+  glBufferData(target, size, data, usage);
+  glBindBuffer(target, 0);
+  buffer_bytes_[buffer] = static_cast<size_t>(size);
+  Add(kCategoryBuffer, static_cast<size_t>(size));
+  return buffer;
+}
+
+void GpuMemoryTracker::DeleteBuffer(GLuint buffer) {
+  auto it = buffer_bytes_.find(buffer);
+  if (it != buffer_bytes_.end()) {
+    Remove(kCategoryBuffer, it->second);
+    buffer_bytes_.erase(it);
+  }
+  glDeleteBuffers(1, &buffer);
+}
+
+GLuint GpuMemoryTracker::CreateTexture2D(GLenum format, GLenum type, int width,
+                                         int height, const void* pixels) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type,
+               pixels);
+  const size_t bytes = static_cast<size_t>(width) * height *
+                       TextureBytesPerPixel(format, type);
+  texture_bytes_[texture] = bytes;
+  Add(kCategoryTexture, bytes);
+  return texture;
+}
+
+GLuint GpuMemoryTracker::CreateTextureCubeMap(GLenum format, GLenum type,
+                                              int size) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+  for (int face = 0; face < 6; ++face) {
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, format, size, size,
+                 0, format, type, nullptr);
+  }
+  const size_t bytes = static_cast<size_t>(size) * size * 6 *
+                       TextureBytesPerPixel(format, type);
+  texture_bytes_[texture] = bytes;
+  Add(kCategoryTexture, bytes);
+  return texture;
+}
+
+void GpuMemoryTracker::DeleteTexture(GLuint texture) {
+  auto it = texture_bytes_.find(texture);
+  if (it != texture_bytes_.end()) {
+    Remove(kCategoryTexture, it->second);
+    texture_bytes_.erase(it);
+  }
+  glDeleteTextures(1, &texture);
+}
+
+std::unique_ptr<gvr::SwapChain> GpuMemoryTracker::CreateSwapChain(
+    gvr::GvrApi* gvr_api, const std::vector<SwapChainBufferDesc>& buffers) {
+  std::vector<gvr::BufferSpec> specs;
+  for (const SwapChainBufferDesc& desc : buffers) {
+    specs.push_back(gvr_api->CreateBufferSpec());
+    specs.back().SetSize(desc.size);
+    specs.back().SetSamples(desc.samples);
+    specs.back().SetColorFormat(desc.color_format);
+    specs.back().SetDepthStencilFormat(desc.depth_stencil_format);
+  }
+  std::unique_ptr<gvr::SwapChain> swapchain(
+      new gvr::SwapChain(gvr_api->CreateSwapChain(specs)));
+
+  for (const SwapChainBufferDesc& desc : swapchain_buffers_) {
+    Remove(kCategorySwapChain, SwapChainBufferBytes(desc));
+  }
+  swapchain_buffers_ = buffers;
+  for (const SwapChainBufferDesc& desc : swapchain_buffers_) {
+    Add(kCategorySwapChain, SwapChainBufferBytes(desc));
+  }
+  return swapchain;
+}
+
+void GpuMemoryTracker::ResizeSwapChainBuffer(gvr::SwapChain* swapchain,
+                                             int32_t index,
+                                             const gvr::Sizei& size) {
+  swapchain->ResizeBuffer(index, size);
+  if (index < 0 || index >= static_cast<int32_t>(swapchain_buffers_.size())) {
+    return;
+  }
+  SwapChainBufferDesc& desc = swapchain_buffers_[index];
+  Remove(kCategorySwapChain, SwapChainBufferBytes(desc));
+  desc.size = size;
+  Add(kCategorySwapChain, SwapChainBufferBytes(desc));
+}
+
+void GpuMemoryTracker::Reset() {
+  for (int i = 0; i < kNumCategories; ++i) {
+    total_live_bytes_ -= live_bytes_[i];
+    live_bytes_[i] = 0;
+    budgets_[i].notified_bytes = 0;
+  }
+  buffer_bytes_.clear();
+  texture_bytes_.clear();
+  swapchain_buffers_.clear();
+}
+
+size_t GpuMemoryTracker::GetLiveBytes(Category category) const {
+  return live_bytes_[category];
+}
+
+size_t GpuMemoryTracker::GetPeakBytes(Category category) const {
+  return peak_bytes_[category];
+}
+
+size_t GpuMemoryTracker::GetTotalLiveBytes() const { return total_live_bytes_; }
+
+size_t GpuMemoryTracker::GetTotalPeakBytes() const { return total_peak_bytes_; }
+
+void GpuMemoryTracker::SetSoftBudget(Category category, size_t budget_bytes,
+                                     const BudgetCallback& callback) {
+  budgets_[category].budget_bytes = budget_bytes;
+  budgets_[category].callback = callback;
+  budgets_[category].notified_bytes = 0;
+}
+
+void GpuMemoryTracker::CheckBudgets() {
+  for (int i = 0; i < kNumCategories; ++i) {
+    Budget& budget = budgets_[i];
+    if (budget.budget_bytes == 0) continue;
+    if (live_bytes_[i] <= budget.budget_bytes) {
+      budget.notified_bytes = 0;
+      continue;
+    }
+    if (live_bytes_[i] == budget.notified_bytes) continue;
+    budget.notified_bytes = live_bytes_[i];
+    LOGW("GPU memory budget exceeded for category %d: %zu > %zu bytes.", i,
+         live_bytes_[i], budget.budget_bytes);
+    if (budget.callback) {
+      budget.callback(static_cast<Category>(i), live_bytes_[i]);
+    }
+  }
+}
+
+void GpuMemoryTracker::Add(Category category, size_t bytes) {
+  live_bytes_[category] += bytes;
+  total_live_bytes_ += bytes;
+  if (live_bytes_[category] > peak_bytes_[category]) {
+    peak_bytes_[category] = live_bytes_[category];
+  }
+  if (total_live_bytes_ > total_peak_bytes_) {
+    total_peak_bytes_ = total_live_bytes_;
+  }
+}
+
+void GpuMemoryTracker::Remove(Category category, size_t bytes) {
+  CHECK(live_bytes_[category] >= bytes);
+  live_bytes_[category] -= bytes;
+  total_live_bytes_ -= bytes;
+}
+
+size_t GpuMemoryTracker::SwapChainBufferBytes(const SwapChainBufferDesc& desc) {
+  const size_t pixels = static_cast<size_t>(desc.size.width) * desc.size.height;
+  const size_t samples = desc.samples > 1 ? desc.samples : 1;
+  const size_t color = ColorBytesPerPixel(desc.color_format);
+  size_t bytes = pixels * samples *
+                 (color + DepthStencilBytesPerPixel(desc.depth_stencil_format));
+  if (samples > 1) {
+    // Multisampled buffers are resolved into a single-sampled color buffer.
+    bytes += pixels * color;
+  }
+  return bytes;
+}
@@ -0,0 +1,151 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_GPUMEMORYTRACKER_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_GPUMEMORYTRACKER_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr.h"
+
+// Keeps an account of the GPU memory the app allocates, by category.
+//
+// Buffers, textures and swap chains are created and destroyed through this
+// class so that their sizes are known. The sizes are estimates: drivers add
+// alignment and bookkeeping overhead, and the swap chain estimate covers a
+// single copy of each buffer (color, depth and MSAA resolve).
+//
+// Each category may have a soft budget. CheckBudgets() should be called once
+// per frame; it invokes the budget's callback when the live size of the
+// category is above the budget and has changed since the callback last ran,
+// so that the app can release memory (e.g. trim its geometry or lower its
+// render quality) one step at a time.
+//
+// All methods must be called on the rendering thread.
+class GpuMemoryTracker {
+ public:
+  enum Category {
+    kCategoryBuffer,
+    kCategoryTexture,
+    kCategorySwapChain,
+    kNumCategories,
+  };
+
+  // Called with the category and its live size when a budget is exceeded.
+  typedef std::function<void(Category category, size_t live_bytes)>
+      BudgetCallback;
+
+  // Describes one buffer of a swap chain; mirrors the gvr::BufferSpec setters.
+  struct SwapChainBufferDesc {
+    gvr::Sizei size;
+    int32_t samples;
+    gvr::ColorFormat color_format;
+    gvr::DepthStencilFormat depth_stencil_format;
+  };
+
+  GpuMemoryTracker();
+
+  // Creates a buffer object of |size| bytes bound to |target| and uploads
+  // |data| (which may be null) to it. Returns the buffer handle.
+  GLuint CreateBuffer(GLenum target, GLsizeiptr size, const void* data,
+                      GLenum usage);
+
+  // Deletes a buffer created by CreateBuffer().
+  void DeleteBuffer(GLuint buffer);
+
+  // Creates a 2D texture with a single mip level from |pixels| and returns its
+  // handle. The texture is left bound to GL_TEXTURE_2D.
+  GLuint CreateTexture2D(GLenum format, GLenum type, int width, int height,
+                         const void* pixels);
+
+  // Creates a cube map texture with |size| x |size| faces, a single mip level
+  // and undefined contents, and returns its handle. The texture is left bound
+  // to GL_TEXTURE_CUBE_MAP.
+  GLuint CreateTextureCubeMap(GLenum format, GLenum type, int size);
+
+  // Deletes a texture created by CreateTexture2D() or CreateTextureCubeMap().
+  void DeleteTexture(GLuint texture);
+
+  // Creates a swap chain with one buffer per entry of |buffers|. Only one
+  // swap chain is tracked at a time; creating a new one replaces the
+  // accounting for the previous one.
+  std::unique_ptr<gvr::SwapChain> CreateSwapChain(
+      gvr::GvrApi* gvr_api, const std::vector<SwapChainBufferDesc>& buffers);
+
+  // Resizes buffer |index| of |swapchain|.
+  void ResizeSwapChainBuffer(gvr::SwapChain* swapchain, int32_t index,
+                             const gvr::Sizei& size);
+
+  // Forgets about all tracked objects without deleting them, e.g. after the
+  // GL context has been lost.
+  void Reset();
+
+  // Returns the number of bytes currently allocated in |category|.
+  size_t GetLiveBytes(Category category) const;
+
+  // Returns the largest number of bytes ever allocated at once in |category|.
+  size_t GetPeakBytes(Category category) const;
+
+  // Returns the number of bytes currently allocated across all categories.
+  size_t GetTotalLiveBytes() const;
+
+  // Returns the largest total number of bytes ever allocated at once.
+  size_t GetTotalPeakBytes() const;
+
+  // Sets the soft budget for |category|. A budget of zero disables it.
+  void SetSoftBudget(Category category, size_t budget_bytes,
+                     const BudgetCallback& callback);
+
+  // Invokes the callbacks of the budgets that are exceeded, unless the
+  // category has not changed size since its callback last ran. Callbacks may
+  // create or free tracked objects.
+  void CheckBudgets();
+
+ private:
+  struct Budget {
+    size_t budget_bytes;
+    BudgetCallback callback;
+    // Live size of the category when the callback last ran, or 0.
+    size_t notified_bytes;
+  };
+
+  void Add(Category category, size_t bytes);
+  void Remove(Category category, size_t bytes);
+  static size_t SwapChainBufferBytes(const SwapChainBufferDesc& desc);
+
+  size_t live_bytes_[kNumCategories];
+  size_t peak_bytes_[kNumCategories];
+  size_t total_live_bytes_;
+  size_t total_peak_bytes_;
+  Budget budgets_[kNumCategories];
+
+  std::unordered_map<GLuint, size_t> buffer_bytes_;
+  std::unordered_map<GLuint, size_t> texture_bytes_;
+  std::vector<SwapChainBufferDesc> swapchain_buffers_;
+
+  // Disallow copy and assign.
+  GpuMemoryTracker(const GpuMemoryTracker& other) = delete;
+  GpuMemoryTracker& operator=(const GpuMemoryTracker& other) = delete;
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_GPUMEMORYTRACKER_H_  // NOLINT
@@ -0,0 +1,48 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gvr_voice_backend.h"  // NOLINT
+
+GvrVoiceBackend::GvrVoiceBackend(gvr::AudioApi* audio_api)
+    : audio_api_(audio_api) {}
+
+VoiceBackend::SourceId GvrVoiceBackend::CreateSpatialSource(
+    const std::string& filename) {
+  return audio_api_->CreateSoundObject(filename);
+}
+
+VoiceBackend::SourceId GvrVoiceBackend::CreateStereoSource(
+    const std::string& filename) {
+  return audio_api_->CreateStereoSound(filename);
+}
+
+void GvrVoiceBackend::Play(SourceId source, bool looping) {
+  audio_api_->PlaySound(source, looping);
+}
+
+void GvrVoiceBackend::Stop(SourceId source) { audio_api_->StopSound(source); }
+
+bool GvrVoiceBackend::IsPlaying(SourceId source) {
+  return audio_api_->IsSoundPlaying(source);
+}
+
+void GvrVoiceBackend::SetVolume(SourceId source, float volume) {
+  audio_api_->SetSoundVolume(source, volume);
+}
+
+void GvrVoiceBackend::SetPosition(SourceId source, float x, float y,
+                                  float z) {
+  audio_api_->SetSoundObjectPosition(source, x, y, z);
+}
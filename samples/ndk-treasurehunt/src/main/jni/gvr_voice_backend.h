@@ -0,0 +1,49 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_GVRVOICEBACKEND_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_GVRVOICEBACKEND_H_  // NOLINT
+
+#include "voice_manager.h"  // NOLINT
+#include "vr/gvr/capi/include/gvr_audio.h"
+
+/**
+ * VoiceBackend implemented with gvr::AudioApi sound objects and stereo
+ * sounds. The sound files must have been preloaded.
+ */
+class GvrVoiceBackend : public VoiceBackend {
+ public:
+  /**
+   * Create a GvrVoiceBackend on a (non-owned) audio API.
+   */
+  explicit GvrVoiceBackend(gvr::AudioApi* audio_api);
+
+  SourceId CreateSpatialSource(const std::string& filename) override;
+  SourceId CreateStereoSource(const std::string& filename) override;
+  void Play(SourceId source, bool looping) override;
+  void Stop(SourceId source) override;
+  bool IsPlaying(SourceId source) override;
+  void SetVolume(SourceId source, float volume) override;
+  void SetPosition(SourceId source, float x, float y, float z) override;
+
+ private:
+  gvr::AudioApi* const audio_api_;
+
+  // Disallow copy and assign.
+  GvrVoiceBackend(const GvrVoiceBackend& other) = delete;
+  GvrVoiceBackend& operator=(const GvrVoiceBackend& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_GVRVOICEBACKEND_H_  // NOLINT
@@ -0,0 +1,119 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "layer_compositor.h"  // NOLINT
+
+#include <stdlib.h>
+
+#include "logging.h"  // NOLINT
+
+namespace {
+static const gvr::Mat4f kIdentity = {{{1.0f, 0.0f, 0.0f, 0.0f},
+                                      {0.0f, 1.0f, 0.0f, 0.0f},
+                                      {0.0f, 0.0f, 1.0f, 0.0f},
+                                      {0.0f, 0.0f, 0.0f, 1.0f}}};
+}  // anonymous namespace
+
+LayerCompositor::LayerCompositor(gvr::GvrApi* gvr_api,
+                                 GpuMemoryTracker* gpu_memory)
+    : gvr_api_(gvr_api),
+      gpu_memory_(gpu_memory),
+      scratch_viewport_(gvr_api->CreateBufferViewport()),
+      quad_viewport_(gvr_api->CreateBufferViewport()) {}
+
+LayerCompositor::Layer::Layer(const LayerDesc& layer_desc)
+    : desc(layer_desc),
+      pass(layer_desc.render_pass),
+      transforms{kIdentity, kIdentity} {}
+
+int LayerCompositor::AddLayer(const LayerDesc& desc) {
+  CHECK(!swapchain_);
+  layers_.push_back(Layer(desc));
+  return static_cast<int>(layers_.size()) - 1;
+}
+
+void LayerCompositor::InitializeGl() {
+  RenderPass::InitializeGl();
+  int world_layers = 0;
+  std::vector<GpuMemoryTracker::SwapChainBufferDesc> buffers(layers_.size());
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    const LayerDesc& desc = layers_[i].desc;
+    if (desc.type == kLayerTypeWorld) ++world_layers;
+    buffers[i].size = desc.size;
+    buffers[i].samples = desc.samples;
+    buffers[i].color_format = desc.color_format;
+    buffers[i].depth_stencil_format = desc.depth_stencil_format;
+  }
+  CHECK(world_layers == 1);
+  swapchain_ = gpu_memory_->CreateSwapChain(gvr_api_, buffers);
+}
+
+gvr::SwapChain* LayerCompositor::GetSwapChain() const {
+  return swapchain_.get();
+}
+
+gvr::Sizei LayerCompositor::GetLayerSize(int layer) const {
+  return layers_[layer].desc.size;
+}
+
+void LayerCompositor::ResizeLayer(int layer, const gvr::Sizei& size) {
+  Layer& l = layers_[layer];
+  if (l.desc.size.width == size.width && l.desc.size.height == size.height) {
+    return;
+  }
+  l.desc.size = size;
+  if (!swapchain_) return;
+  gpu_memory_->ResizeSwapChainBuffer(swapchain_.get(), layer, size);
+}
+
+void LayerCompositor::SetQuadTransform(int layer, gvr::Eye eye,
+                                       const gvr::Mat4f& transform) {
+  CHECK(layers_[layer].desc.type == kLayerTypeQuad);
+  layers_[layer].transforms[eye == GVR_LEFT_EYE ? 0 : 1] = transform;
+}
+
+void LayerCompositor::UpdateViewports(gvr::BufferViewportList* viewport_list) {
+  viewport_list->SetToRecommendedBufferViewports();
+  size_t next_viewport = viewport_list->GetSize();
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    const Layer& layer = layers_[i];
+    if (layer.desc.type == kLayerTypeWorld) {
+      // The recommended viewports show buffer 0 with full reprojection.
+      for (size_t eye = 0; eye < 2; ++eye) {
+        viewport_list->GetBufferViewport(eye, &scratch_viewport_);
+        scratch_viewport_.SetSourceBufferIndex(i);
+        scratch_viewport_.SetReprojection(layer.desc.reprojection);
+        viewport_list->SetBufferViewport(eye, scratch_viewport_);
+      }
+    } else {
+      quad_viewport_.SetSourceBufferIndex(i);
+      quad_viewport_.SetReprojection(layer.desc.reprojection);
+      quad_viewport_.SetSourceUv({0.f, 1.f, 0.f, 1.f});
+      quad_viewport_.SetTransform(layer.transforms[0]);
+      quad_viewport_.SetTargetEye(GVR_LEFT_EYE);
+      viewport_list->SetBufferViewport(next_viewport++, quad_viewport_);
+      quad_viewport_.SetTransform(layer.transforms[1]);
+      quad_viewport_.SetTargetEye(GVR_RIGHT_EYE);
+      viewport_list->SetBufferViewport(next_viewport++, quad_viewport_);
+    }
+  }
+}
+
+void LayerCompositor::BeginLayer(gvr::Frame* frame, int layer) {
+  Layer& l = layers_[layer];
+  l.pass.Begin(frame, layer, l.desc.size);
+}
+
+void LayerCompositor::EndLayer(int layer) { layers_[layer].pass.End(); }
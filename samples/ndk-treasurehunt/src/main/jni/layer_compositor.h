@@ -0,0 +1,162 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_LAYERCOMPOSITOR_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_LAYERCOMPOSITOR_H_  // NOLINT
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "render_pass.h"  // NOLINT
+#include "vr/gvr/capi/include/gvr.h"
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * How a layer is shown.
+ */
+enum LayerType {
+  // Stereo view of the world: the left half of the buffer is shown to the
+  // left eye and the right half to the right eye, through the recommended
+  // buffer viewports. Exactly one layer must be a world layer.
+  kLayerTypeWorld,
+  // A single image shown to both eyes on a quad, placed by a transform per
+  // eye (see gvr::BufferViewport::SetTransform()).
+  kLayerTypeQuad,
+};
+
+/**
+ * Description of a layer, see LayerCompositor::AddLayer().
+ */
+struct LayerDesc {
+  LayerType type;
+  gvr::Sizei size;
+  int32_t samples;
+  gvr::ColorFormat color_format;
+  gvr::DepthStencilFormat depth_stencil_format;
+  gvr_reprojection reprojection;
+  // Load and store actions used when the layer is rendered.
+  RenderPassDesc render_pass;
+};
+
+/**
+ * Manages a swap chain with one buffer per layer, and the buffer viewports
+ * that show the layers. Every layer is rendered every frame: the swap chain
+ * rotates its buffers from frame to frame, and their previous content is not
+ * available.
+ *
+ * Usage, on the rendering thread:
+ *
+ *   int hud = compositor.AddLayer(hud_desc);  // Before InitializeGl().
+ *   compositor.InitializeGl();                 // Creates the swap chain.
+ *   ...
+ *   compositor.SetQuadTransform(hud, GVR_LEFT_EYE, left_transform);
+ *   compositor.SetQuadTransform(hud, GVR_RIGHT_EYE, right_transform);
+ *   compositor.UpdateViewports(&viewport_list);
+ *   gvr::Frame frame = compositor.GetSwapChain()->AcquireFrame();
+ *   compositor.BeginLayer(&frame, hud);
+ *   <render the layer>
+ *   compositor.EndLayer(hud);
+ *   frame.Submit(viewport_list, head_view);
+ */
+class LayerCompositor {
+ public:
+  /**
+   * Create a LayerCompositor.
+   *
+   * @param gvr_api The (non-owned) GvrApi.
+   * @param gpu_memory The (non-owned) tracker that accounts for the swap
+   *     chain.
+   */
+  LayerCompositor(gvr::GvrApi* gvr_api, GpuMemoryTracker* gpu_memory);
+
+  /**
+   * Add a layer and return its index, which is also the index of its buffer
+   * in the swap chain. Layers are composited in the order they are added,
+   * the first one at the back. Must be called before InitializeGl().
+   */
+  int AddLayer(const LayerDesc& desc);
+
+  /**
+   * Create the swap chain, and call RenderPass::InitializeGl(). Must be
+   * called on the rendering thread with a valid GL context, and again when
+   * the context is recreated.
+   */
+  void InitializeGl();
+
+  /**
+   * Return the swap chain, or null before InitializeGl().
+   */
+  gvr::SwapChain* GetSwapChain() const;
+
+  /**
+   * Return the current buffer size of |layer|.
+   */
+  gvr::Sizei GetLayerSize(int layer) const;
+
+  /**
+   * Resize the buffer of |layer|. Does nothing if the size is unchanged. May
+   * be called before InitializeGl().
+   */
+  void ResizeLayer(int layer, const gvr::Sizei& size);
+
+  /**
+   * Set the transform of the quad shown to |eye| for quad layer |layer|.
+   */
+  void SetQuadTransform(int layer, gvr::Eye eye,
+                        const gvr::Mat4f& transform);
+
+  /**
+   * Fill |viewport_list| with the buffer viewports of all layers, starting
+   * from the recommended ones.
+   */
+  void UpdateViewports(gvr::BufferViewportList* viewport_list);
+
+  /**
+   * Prepare to render |layer| into |frame|: bind its buffer, with the
+   * viewport covering the whole layer, and apply the load actions of the
+   * layer's render pass. EndLayer() must be called afterwards.
+   */
+  void BeginLayer(gvr::Frame* frame, int layer);
+
+  /**
+   * Finish |layer|: apply the store actions of its render pass and unbind
+   * the framebuffer.
+   */
+  void EndLayer(int layer);
+
+ private:
+  struct Layer {
+    explicit Layer(const LayerDesc& layer_desc);
+
+    LayerDesc desc;
+    RenderPass pass;
+    gvr::Mat4f transforms[2];  // Per eye, for quad layers.
+  };
+
+  gvr::GvrApi* gvr_api_;
+  GpuMemoryTracker* gpu_memory_;
+  std::vector<Layer> layers_;
+  std::unique_ptr<gvr::SwapChain> swapchain_;
+  gvr::BufferViewport scratch_viewport_;
+  gvr::BufferViewport quad_viewport_;
+
+  // Disallow copy and assign.
+  LayerCompositor(const LayerCompositor& other) = delete;
+  LayerCompositor& operator=(const LayerCompositor& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_LAYERCOMPOSITOR_H_  // NOLINT
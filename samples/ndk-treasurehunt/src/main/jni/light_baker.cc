@@ -0,0 +1,219 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "light_baker.h"  // NOLINT
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+
+namespace {
+// Identifies cache files, and changes whenever the baking changes.
+static const uint32_t kCacheMagic = 0x504d4c54;  // "TLMP"
+static const uint32_t kCacheVersion = 1;
+
+// Shadow rays start this far off the surface, so that it does not shadow
+// itself.
+static const float kShadowBias = 0.001f;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  int32_t width;
+  int32_t height;
+};
+
+static uint64_t SteadyNowNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// FNV-1a, continued from |hash|.
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+static int WorkerCountOrDefault(int worker_count) {
+  if (worker_count > 0) return worker_count;
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+static uint8_t ToUnorm8(float value) {
+  value = std::min(std::max(value, 0.0f), 1.0f);
+  return static_cast<uint8_t>(value * 255.0f + 0.5f);
+}
+}  // anonymous namespace
+
+LightBaker::LightBaker(const std::string& cache_directory, int worker_count)
+    : cache_directory_(cache_directory),
+      worker_count_(WorkerCountOrDefault(worker_count)),
+      occluders_(nullptr),
+      stats_() {}
+
+void LightBaker::AddLight(const BakeLight& light) { lights_.push_back(light); }
+
+void LightBaker::SetOccluders(const OcclusionBvh* occluders) {
+  occluders_ = occluders;
+}
+
+uint64_t LightBaker::GetCacheKey(const BakeSurface& surface, int width,
+                                 int height) const {
+  uint64_t hash = 14695981039346656037ULL;
+  hash = HashBytes(&kCacheVersion, sizeof(kCacheVersion), hash);
+  hash = HashBytes(&surface, sizeof(surface), hash);
+  hash = HashBytes(&width, sizeof(width), hash);
+  hash = HashBytes(&height, sizeof(height), hash);
+  hash = HashBytes(lights_.data(), lights_.size() * sizeof(BakeLight), hash);
+  if (occluders_ != nullptr) {
+    const uint64_t occluders = occluders_->GetContentHash();
+    hash = HashBytes(&occluders, sizeof(occluders), hash);
+  }
+  return hash;
+}
+
+std::vector<uint8_t> LightBaker::BakeLightmap(const BakeSurface& surface,
+                                              int width, int height) {
+  std::vector<uint8_t> texels;
+  const uint64_t key = GetCacheKey(surface, width, height);
+  if (LoadFromCache(key, width, height, &texels)) {
+    ++stats_.cache_hits;
+    return texels;
+  }
+
+  const uint64_t start_nanos = SteadyNowNanos();
+  texels.resize(4 * static_cast<size_t>(width) * height);
+  BakeRows(surface, width, height, &texels);
+  ++stats_.bakes;
+  stats_.texels_baked += static_cast<uint64_t>(width) * height;
+  stats_.bake_nanos += SteadyNowNanos() - start_nanos;
+  StoreInCache(key, width, height, texels);
+  return texels;
+}
+
+LightBakeStats LightBaker::GetStats() const { return stats_; }
+
+void LightBaker::BakeRows(const BakeSurface& surface, int width, int height,
+                          std::vector<uint8_t>* texels) {
+  std::atomic<int> next_row(0);
+  auto bake = [this, &surface, width, height, texels, &next_row]() {
+    int row;
+    while ((row = next_row.fetch_add(1)) < height) {
+      const float v = (row + 0.5f) / height;
+      uint8_t* output = &(*texels)[4 * static_cast<size_t>(width) * row];
+      for (int column = 0; column < width; ++column) {
+        const float u = (column + 0.5f) / width;
+        float position[3];
+        for (int axis = 0; axis < 3; ++axis) {
+          position[axis] = surface.origin[axis] + u * surface.u_axis[axis] +
+                           v * surface.v_axis[axis];
+        }
+        float light[3] = {0.0f, 0.0f, 0.0f};
+        for (const BakeLight& source : lights_) {
+          float to_light[3];
+          float distance_squared = 0.0f;
+          for (int axis = 0; axis < 3; ++axis) {
+            to_light[axis] = source.position[axis] - position[axis];
+            distance_squared += to_light[axis] * to_light[axis];
+          }
+          const float distance = sqrtf(distance_squared);
+          float diffuse = source.min_diffuse;
+          if (distance > 0.0f) {
+            const float cosine = (to_light[0] * surface.normal[0] +
+                                  to_light[1] * surface.normal[1] +
+                                  to_light[2] * surface.normal[2]) /
+                                 distance;
+            diffuse = std::max(cosine, source.min_diffuse);
+          }
+          if (occluders_ != nullptr && diffuse > source.min_diffuse) {
+            float from[3];
+            for (int axis = 0; axis < 3; ++axis) {
+              from[axis] = position[axis] + kShadowBias * surface.normal[axis];
+            }
+            if (occluders_->IsOccluded(from, source.position)) {
+              diffuse = source.min_diffuse;
+            }
+          }
+          diffuse /= 1.0f + source.attenuation * distance_squared;
+          for (int c = 0; c < 3; ++c) light[c] += source.color[c] * diffuse;
+        }
+        for (int c = 0; c < 3; ++c) {
+          output[4 * column + c] = ToUnorm8(surface.color[c] * light[c]);
+        }
+        output[4 * column + 3] = 255;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < worker_count_; ++i) workers.emplace_back(bake);
+  bake();
+  for (std::thread& worker : workers) worker.join();
+}
+
+std::string LightBaker::GetCachePath(uint64_t key) const {
+  char name[64];
+  snprintf(name, sizeof(name), "/lightmap-%016llx.bin",
+           static_cast<unsigned long long>(key));  // NOLINT
+  return cache_directory_ + name;
+}
+
+bool LightBaker::LoadFromCache(uint64_t key, int width, int height,
+                               std::vector<uint8_t>* texels) const {
+  if (cache_directory_.empty()) return false;
+  FILE* file = fopen(GetCachePath(key).c_str(), "rb");
+  if (file == nullptr) return false;
+  CacheHeader header;
+  bool loaded = fread(&header, sizeof(header), 1, file) == 1 &&
+                header.magic == kCacheMagic &&
+                header.version == kCacheVersion && header.key == key &&
+                header.width == width && header.height == height;
+  if (loaded) {
+    texels->resize(4 * static_cast<size_t>(width) * height);
+    loaded = fread(texels->data(), texels->size(), 1, file) == 1;
+  }
+  fclose(file);
+  return loaded;
+}
+
+void LightBaker::StoreInCache(uint64_t key, int width, int height,
+                              const std::vector<uint8_t>& texels) const {
+  if (cache_directory_.empty()) return;
+  // Write to a temporary file first, so that a crash never leaves a
+  // truncated lightmap under the real name.
+  const std::string path = GetCachePath(key);
+  const std::string temporary_path = path + ".tmp";
+  FILE* file = fopen(temporary_path.c_str(), "wb");
+  if (file == nullptr) return;
+  const CacheHeader header = {kCacheMagic, kCacheVersion, key, width, height};
+  const bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(texels.data(), texels.size(), 1, file) == 1;
+  if (fclose(file) == 0 && written) {
+    rename(temporary_path.c_str(), path.c_str());
+  } else {
+    remove(temporary_path.c_str());
+  }
+}
@@ -0,0 +1,124 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_LIGHTBAKER_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_LIGHTBAKER_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "audio_occlusion.h"  // NOLINT
+
+/**
+ * A light for baking, shaded as the vertex lighting of the renderer: the
+ * diffuse term is never less than |min_diffuse|, which stands in for
+ * ambient light, and the light is divided by 1 + |attenuation| * distance^2.
+ */
+struct BakeLight {
+  float position[3];
+  float color[3];
+  float min_diffuse;
+  float attenuation;
+};
+
+/**
+ * A flat rectangle of static geometry: |origin| is a corner, and the
+ * lightmap spans |u_axis| along its rows and |v_axis| across them.
+ */
+struct BakeSurface {
+  float origin[3];
+  float u_axis[3];
+  float v_axis[3];
+  float normal[3];
+  float color[3];
+};
+
+struct LightBakeStats {
+  uint64_t bakes;
+  uint64_t cache_hits;
+  uint64_t texels_baked;
+  uint64_t bake_nanos;
+};
+
+/**
+ * Bakes the diffuse lighting of static surfaces into lightmaps, so that they
+ * can be drawn with an unlit textured shader.
+ *
+ * Each lightmap is baked by worker threads that take rows in turn, and is
+ * cached on disk under a key computed from everything it depends on: the
+ * lights, the surface, the size and the occluders. Baking the same scene
+ * again, e.g. on the next launch, just loads the file; changing any of them
+ * bakes anew.
+ *
+ * Methods must be called from one thread at a time.
+ */
+class LightBaker {
+ public:
+  /**
+   * Create a LightBaker.
+   *
+   * @param cache_directory Where to keep baked lightmaps, or empty to bake
+   *     every time.
+   * @param worker_count Number of threads baking, or 0 for one per core.
+   */
+  LightBaker(const std::string& cache_directory, int worker_count);
+
+  void AddLight(const BakeLight& light);
+
+  /**
+   * Cast shadows from the (non-owned, built) |occluders|, or from nothing if
+   * null.
+   */
+  void SetOccluders(const OcclusionBvh* occluders);
+
+  /**
+   * Return the lightmap of |surface|, as |height| rows of |width| RGBA
+   * texels, from |origin| along |v_axis|. Texels sample the centers of their
+   * areas.
+   */
+  std::vector<uint8_t> BakeLightmap(const BakeSurface& surface, int width,
+                                    int height);
+
+  /**
+   * Return the key under which the lightmap of |surface| is cached.
+   */
+  uint64_t GetCacheKey(const BakeSurface& surface, int width,
+                       int height) const;
+
+  LightBakeStats GetStats() const;
+
+ private:
+  void BakeRows(const BakeSurface& surface, int width, int height,
+                std::vector<uint8_t>* texels);
+  std::string GetCachePath(uint64_t key) const;
+  bool LoadFromCache(uint64_t key, int width, int height,
+                     std::vector<uint8_t>* texels) const;
+  void StoreInCache(uint64_t key, int width, int height,
+                    const std::vector<uint8_t>& texels) const;
+
+  const std::string cache_directory_;
+  const int worker_count_;
+  std::vector<BakeLight> lights_;
+  const OcclusionBvh* occluders_;
+  LightBakeStats stats_;
+
+  // Disallow copy and assign.
+  LightBaker(const LightBaker& other) = delete;
+  LightBaker& operator=(const LightBaker& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_LIGHTBAKER_H_  // NOLINT
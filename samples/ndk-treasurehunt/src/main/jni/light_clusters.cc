@@ -0,0 +1,371 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "light_clusters.h"  // NOLINT
+
+#include <math.h>
+
+#include <algorithm>
+
+#if !defined(LIGHT_CLUSTERS_DISABLE_SIMD)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LIGHT_CLUSTERS_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define LIGHT_CLUSTERS_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace {
+// Bytes of LightClusters::ranges_ per light: the first and last tile in x,
+// in y, the first and last slice, and whether the light is visible.
+static const int kRangeStride = 8;
+static const int kRangeVisible = 6;
+
+static const float kDegreesToRadians = 3.14159265f / 180.0f;
+
+// Sets the signed distance coefficients of the plane through the eye and
+// the line at |tangent|, facing towards increasing tangents.
+static void SetPlane(float tangent, float* along, float* z) {
+  const float inverse_norm = 1.0f / sqrtf(1.0f + tangent * tangent);
+  *along = inverse_norm;
+  *z = tangent * inverse_norm;
+}
+}  // anonymous namespace
+
+const int LightClusters::kTilesX;
+const int LightClusters::kTilesY;
+const int LightClusters::kSlices;
+const int LightClusters::kClusterCount;
+const int LightClusters::kMaxLights;
+const int LightClusters::kMaxLightsPerCluster;
+const int LightClusters::kIndexRowLength;
+const int LightClusters::kIndexRows;
+
+LightClusters::LightClusters()
+    : cluster_counts_(kClusterCount),
+      light_data_(2 * 4 * kMaxLights, 0.0f),
+      cluster_data_(2 * kClusterCount, 0.0f),
+      index_data_(kIndexRows * kIndexRowLength, 0.0f),
+      visible_lights_(0),
+      index_count_(0),
+      stats_() {
+  SetFrustum(45.0f, 45.0f, 45.0f, 45.0f, 1.0f, 100.0f);
+}
+
+void LightClusters::SetFrustum(float left, float right, float bottom,
+                               float top, float z_near, float z_far) {
+  tangent_left_ = tanf(left * kDegreesToRadians);
+  tangent_right_ = tanf(right * kDegreesToRadians);
+  tangent_bottom_ = tanf(bottom * kDegreesToRadians);
+  tangent_top_ = tanf(top * kDegreesToRadians);
+  // Tiles are evenly spaced in tangent, as pixels are.
+  for (int k = 0; k <= kTilesX; ++k) {
+    const float tangent =
+        -tangent_left_ + (tangent_left_ + tangent_right_) * k / kTilesX;
+    SetPlane(tangent, &x_plane_x_[k], &x_plane_z_[k]);
+  }
+  for (int k = 0; k <= kTilesY; ++k) {
+    const float tangent =
+        -tangent_bottom_ + (tangent_bottom_ + tangent_top_) * k / kTilesY;
+    SetPlane(tangent, &y_plane_y_[k], &y_plane_z_[k]);
+  }
+  for (int k = 0; k <= kSlices; ++k) {
+    slice_depth_[k] =
+        z_near * powf(z_far / z_near, static_cast<float>(k) / kSlices);
+  }
+}
+
+void LightClusters::GetTileTransform(float tiles[4]) const {
+  tiles[0] = kTilesX / (tangent_left_ + tangent_right_);
+  tiles[1] = tangent_left_ * tiles[0];
+  tiles[2] = kTilesY / (tangent_bottom_ + tangent_top_);
+  tiles[3] = tangent_bottom_ * tiles[2];
+}
+
+void LightClusters::GetSliceTransform(float slices[2]) const {
+  slices[0] = kSlices / logf(slice_depth_[kSlices] / slice_depth_[0]);
+  slices[1] = -logf(slice_depth_[0]) * slices[0];
+}
+
+void LightClusters::Bin(const PointLight* lights, size_t count,
+                        const float view[4][4]) {
+  ++stats_.binnings;
+
+  // Transform the lights to view space. The padding lies behind the eye, so
+  // it is never visible.
+  const size_t padded_count = (count + 3) & ~static_cast<size_t>(3);
+  view_x_.assign(padded_count, 0.0f);
+  view_y_.assign(padded_count, 0.0f);
+  view_z_.assign(padded_count, 1.0f);
+  radius_.assign(padded_count, 0.0f);
+  ranges_.resize(kRangeStride * padded_count);
+  for (size_t i = 0; i < count; ++i) {
+    const float* p = lights[i].position;
+    view_x_[i] = view[0][0] * p[0] + view[0][1] * p[1] + view[0][2] * p[2] +
+                 view[0][3];
+    view_y_[i] = view[1][0] * p[0] + view[1][1] * p[1] + view[1][2] * p[2] +
+                 view[1][3];
+    view_z_[i] = view[2][0] * p[0] + view[2][1] * p[1] + view[2][2] * p[2] +
+                 view[2][3];
+    radius_[i] = lights[i].radius;
+  }
+
+  // Find the clusters that each light overlaps. The sphere overlaps tile
+  // column i if its signed distance to plane i is at least -radius and its
+  // distance to plane i + 1 at most radius. In front of the eye the distances
+  // shrink from plane to plane, so the first column is the number of inner
+  // planes the sphere is entirely past, and the last one the number it is not
+  // entirely before. Spheres that reach the near plane may also be behind the
+  // eye, where that order flips, so they get every tile.
+  const float z_near = slice_depth_[0];
+  const float z_far = slice_depth_[kSlices];
+  size_t i = 0;
+#if defined(LIGHT_CLUSTERS_NEON) || defined(LIGHT_CLUSTERS_SSE2)
+  for (; i < padded_count; i += 4) {
+    int32_t results[6][4];
+    uint32_t visible[4];
+#if defined(LIGHT_CLUSTERS_NEON)
+    const float32x4_t x = vld1q_f32(&view_x_[i]);
+    const float32x4_t y = vld1q_f32(&view_y_[i]);
+    const float32x4_t z = vld1q_f32(&view_z_[i]);
+    const float32x4_t radius = vld1q_f32(&radius_[i]);
+    const float32x4_t negative_radius = vnegq_f32(radius);
+    const float32x4_t depth = vnegq_f32(z);
+    const float32x4_t front = vsubq_f32(depth, radius);
+    const float32x4_t back = vaddq_f32(depth, radius);
+    uint32x4_t counts[6];
+    for (int c = 0; c < 6; ++c) counts[c] = vdupq_n_u32(0);
+    for (int k = 1; k < kTilesX; ++k) {
+      const float32x4_t d =
+          vmlaq_n_f32(vmulq_n_f32(x, x_plane_x_[k]), z, x_plane_z_[k]);
+      counts[0] = vsubq_u32(counts[0], vcgtq_f32(d, radius));
+      counts[1] = vsubq_u32(counts[1], vcgeq_f32(d, negative_radius));
+    }
+    for (int k = 1; k < kTilesY; ++k) {
+      const float32x4_t d =
+          vmlaq_n_f32(vmulq_n_f32(y, y_plane_y_[k]), z, y_plane_z_[k]);
+      counts[2] = vsubq_u32(counts[2], vcgtq_f32(d, radius));
+      counts[3] = vsubq_u32(counts[3], vcgeq_f32(d, negative_radius));
+    }
+    for (int k = 1; k < kSlices; ++k) {
+      const float32x4_t boundary = vdupq_n_f32(slice_depth_[k]);
+      counts[4] = vsubq_u32(counts[4], vcleq_f32(boundary, front));
+      counts[5] = vsubq_u32(counts[5], vcltq_f32(boundary, back));
+    }
+    const float32x4_t left =
+        vmlaq_n_f32(vmulq_n_f32(x, x_plane_x_[0]), z, x_plane_z_[0]);
+    const float32x4_t right = vmlaq_n_f32(vmulq_n_f32(x, x_plane_x_[kTilesX]),
+                                          z, x_plane_z_[kTilesX]);
+    const float32x4_t bottom =
+        vmlaq_n_f32(vmulq_n_f32(y, y_plane_y_[0]), z, y_plane_z_[0]);
+    const float32x4_t top = vmlaq_n_f32(vmulq_n_f32(y, y_plane_y_[kTilesY]),
+                                        z, y_plane_z_[kTilesY]);
+    uint32x4_t outside = vorrq_u32(vcltq_f32(left, negative_radius),
+                                   vcgtq_f32(right, radius));
+    outside = vorrq_u32(outside, vcltq_f32(bottom, negative_radius));
+    outside = vorrq_u32(outside, vcgtq_f32(top, radius));
+    outside = vorrq_u32(outside, vcltq_f32(back, vdupq_n_f32(z_near)));
+    outside = vorrq_u32(outside, vcgtq_f32(front, vdupq_n_f32(z_far)));
+    const uint32x4_t near = vcltq_f32(front, vdupq_n_f32(z_near));
+    const uint32x4_t zero = vdupq_n_u32(0);
+    counts[0] = vbslq_u32(near, zero, counts[0]);
+    counts[1] = vbslq_u32(near, vdupq_n_u32(kTilesX - 1), counts[1]);
+    counts[2] = vbslq_u32(near, zero, counts[2]);
+    counts[3] = vbslq_u32(near, vdupq_n_u32(kTilesY - 1), counts[3]);
+    for (int c = 0; c < 6; ++c) {
+      vst1q_s32(results[c], vreinterpretq_s32_u32(counts[c]));
+    }
+    vst1q_u32(visible, vmvnq_u32(outside));
+#else
+    const __m128 x = _mm_loadu_ps(&view_x_[i]);
+    const __m128 y = _mm_loadu_ps(&view_y_[i]);
+    const __m128 z = _mm_loadu_ps(&view_z_[i]);
+    const __m128 radius = _mm_loadu_ps(&radius_[i]);
+    const __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), radius);
+    const __m128 depth = _mm_sub_ps(_mm_setzero_ps(), z);
+    const __m128 front = _mm_sub_ps(depth, radius);
+    const __m128 back = _mm_add_ps(depth, radius);
+    __m128i counts[6];
+    for (int c = 0; c < 6; ++c) counts[c] = _mm_setzero_si128();
+    for (int k = 1; k < kTilesX; ++k) {
+      const __m128 d =
+          _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(x_plane_x_[k])),
+                     _mm_mul_ps(z, _mm_set1_ps(x_plane_z_[k])));
+      counts[0] = _mm_sub_epi32(counts[0],
+                                _mm_castps_si128(_mm_cmpgt_ps(d, radius)));
+      counts[1] = _mm_sub_epi32(
+          counts[1], _mm_castps_si128(_mm_cmpge_ps(d, negative_radius)));
+    }
+    for (int k = 1; k < kTilesY; ++k) {
+      const __m128 d =
+          _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(y_plane_y_[k])),
+                     _mm_mul_ps(z, _mm_set1_ps(y_plane_z_[k])));
+      counts[2] = _mm_sub_epi32(counts[2],
+                                _mm_castps_si128(_mm_cmpgt_ps(d, radius)));
+      counts[3] = _mm_sub_epi32(
+          counts[3], _mm_castps_si128(_mm_cmpge_ps(d, negative_radius)));
+    }
+    for (int k = 1; k < kSlices; ++k) {
+      const __m128 boundary = _mm_set1_ps(slice_depth_[k]);
+      counts[4] = _mm_sub_epi32(
+          counts[4], _mm_castps_si128(_mm_cmple_ps(boundary, front)));
+      counts[5] = _mm_sub_epi32(
+          counts[5], _mm_castps_si128(_mm_cmplt_ps(boundary, back)));
+    }
+    const __m128 left =
+        _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(x_plane_x_[0])),
+                   _mm_mul_ps(z, _mm_set1_ps(x_plane_z_[0])));
+    const __m128 right =
+        _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(x_plane_x_[kTilesX])),
+                   _mm_mul_ps(z, _mm_set1_ps(x_plane_z_[kTilesX])));
+    const __m128 bottom =
+        _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(y_plane_y_[0])),
+                   _mm_mul_ps(z, _mm_set1_ps(y_plane_z_[0])));
+    const __m128 top =
+        _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(y_plane_y_[kTilesY])),
+                   _mm_mul_ps(z, _mm_set1_ps(y_plane_z_[kTilesY])));
+    __m128 outside = _mm_or_ps(_mm_cmplt_ps(left, negative_radius),
+                               _mm_cmpgt_ps(right, radius));
+    outside = _mm_or_ps(outside, _mm_cmplt_ps(bottom, negative_radius));
+    outside = _mm_or_ps(outside, _mm_cmpgt_ps(top, radius));
+    outside = _mm_or_ps(outside, _mm_cmplt_ps(back, _mm_set1_ps(z_near)));
+    outside = _mm_or_ps(outside, _mm_cmpgt_ps(front, _mm_set1_ps(z_far)));
+    const __m128i near =
+        _mm_castps_si128(_mm_cmplt_ps(front, _mm_set1_ps(z_near)));
+    counts[0] = _mm_andnot_si128(near, counts[0]);
+    counts[1] = _mm_or_si128(_mm_andnot_si128(near, counts[1]),
+                             _mm_and_si128(near, _mm_set1_epi32(kTilesX - 1)));
+    counts[2] = _mm_andnot_si128(near, counts[2]);
+    counts[3] = _mm_or_si128(_mm_andnot_si128(near, counts[3]),
+                             _mm_and_si128(near, _mm_set1_epi32(kTilesY - 1)));
+    for (int c = 0; c < 6; ++c) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(results[c]), counts[c]);
+    }
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(visible),
+        _mm_andnot_si128(_mm_castps_si128(outside), _mm_set1_epi32(-1)));
+#endif
+    for (int lane = 0; lane < 4; ++lane) {
+      uint8_t* range = &ranges_[kRangeStride * (i + lane)];
+      for (int c = 0; c < 6; ++c) {
+        range[c] = static_cast<uint8_t>(results[c][lane]);
+      }
+      range[kRangeVisible] = visible[lane] != 0;
+    }
+  }
+#endif
+  for (; i < padded_count; ++i) {
+    const float x = view_x_[i];
+    const float y = view_y_[i];
+    const float z = view_z_[i];
+    const float radius = radius_[i];
+    const float front = -z - radius;
+    const float back = -z + radius;
+    int counts[6] = {0, 0, 0, 0, 0, 0};
+    for (int k = 1; k < kTilesX; ++k) {
+      const float d = x * x_plane_x_[k] + z * x_plane_z_[k];
+      counts[0] += d > radius;
+      counts[1] += d >= -radius;
+    }
+    for (int k = 1; k < kTilesY; ++k) {
+      const float d = y * y_plane_y_[k] + z * y_plane_z_[k];
+      counts[2] += d > radius;
+      counts[3] += d >= -radius;
+    }
+    for (int k = 1; k < kSlices; ++k) {
+      counts[4] += slice_depth_[k] <= front;
+      counts[5] += slice_depth_[k] < back;
+    }
+    const bool outside =
+        x * x_plane_x_[0] + z * x_plane_z_[0] < -radius ||
+        x * x_plane_x_[kTilesX] + z * x_plane_z_[kTilesX] > radius ||
+        y * y_plane_y_[0] + z * y_plane_z_[0] < -radius ||
+        y * y_plane_y_[kTilesY] + z * y_plane_z_[kTilesY] > radius ||
+        back < z_near || front > z_far;
+    if (front < z_near) {
+      counts[0] = 0;
+      counts[1] = kTilesX - 1;
+      counts[2] = 0;
+      counts[3] = kTilesY - 1;
+    }
+    uint8_t* range = &ranges_[kRangeStride * i];
+    for (int c = 0; c < 6; ++c) range[c] = static_cast<uint8_t>(counts[c]);
+    range[kRangeVisible] = !outside;
+  }
+
+  // Give the visible lights their slots, and count the lights of each
+  // cluster.
+  std::fill(cluster_counts_.begin(), cluster_counts_.end(), 0);
+  visible_lights_ = 0;
+  for (i = 0; i < count; ++i) {
+    uint8_t* range = &ranges_[kRangeStride * i];
+    if (!range[kRangeVisible]) continue;
+    if (visible_lights_ == kMaxLights) {
+      ++stats_.lights_dropped;
+      range[kRangeVisible] = 0;
+      continue;
+    }
+    float* data = &light_data_[4 * visible_lights_];
+    data[0] = view_x_[i];
+    data[1] = view_y_[i];
+    data[2] = view_z_[i];
+    data[3] = radius_[i];
+    data += 4 * kMaxLights;
+    data[0] = lights[i].color[0];
+    data[1] = lights[i].color[1];
+    data[2] = lights[i].color[2];
+    data[3] = 1.0f;
+    ++visible_lights_;
+    for (int slice = range[4]; slice <= range[5]; ++slice) {
+      for (int y = range[2]; y <= range[3]; ++y) {
+        int* row = &cluster_counts_[(slice * kTilesY + y) * kTilesX];
+        for (int x = range[0]; x <= range[1]; ++x) ++row[x];
+      }
+    }
+  }
+  stats_.lights_visible += visible_lights_;
+
+  // Lay the clusters out one after the other, then fill them in.
+  index_count_ = 0;
+  for (int cluster = 0; cluster < kClusterCount; ++cluster) {
+    const int lights_in_cluster = cluster_counts_[cluster];
+    const int stored = std::min(lights_in_cluster, kMaxLightsPerCluster);
+    stats_.cluster_overflows += lights_in_cluster - stored;
+    cluster_data_[2 * cluster] = static_cast<float>(index_count_);
+    cluster_data_[2 * cluster + 1] = static_cast<float>(stored);
+    index_count_ += stored;
+    cluster_counts_[cluster] = 0;
+  }
+  stats_.cluster_entries += index_count_;
+  int slot = 0;
+  for (i = 0; i < count; ++i) {
+    const uint8_t* range = &ranges_[kRangeStride * i];
+    if (!range[kRangeVisible]) continue;
+    for (int slice = range[4]; slice <= range[5]; ++slice) {
+      for (int y = range[2]; y <= range[3]; ++y) {
+        const int first = (slice * kTilesY + y) * kTilesX;
+        for (int x = range[0]; x <= range[1]; ++x) {
+          int& filled = cluster_counts_[first + x];
+          if (filled == kMaxLightsPerCluster) continue;
+          const int offset = static_cast<int>(cluster_data_[2 * (first + x)]);
+          index_data_[offset + filled++] = static_cast<float>(slot);
+        }
+      }
+    }
+    ++slot;
+  }
+}
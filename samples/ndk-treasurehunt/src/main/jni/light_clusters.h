@@ -0,0 +1,157 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_LIGHTCLUSTERS_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_LIGHTCLUSTERS_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * A point light. Its influence falls to zero at |radius|.
+ */
+struct PointLight {
+  float position[3];
+  float radius;
+  float color[3];
+};
+
+struct LightClusterStats {
+  uint64_t binnings;
+  // Lights inside the frustum, summed over the binnings.
+  uint64_t lights_visible;
+  // Lights dropped because kMaxLights were already visible.
+  uint64_t lights_dropped;
+  // Light indices stored in clusters, and the ones that did not fit in
+  // kMaxLightsPerCluster.
+  uint64_t cluster_entries;
+  uint64_t cluster_overflows;
+};
+
+/**
+ * Bins point lights into a grid of clusters ("froxels") over the view
+ * frustum of an eye, for clustered forward shading: kTilesX x kTilesY tiles
+ * across the field of view, each split into kSlices slices of exponentially
+ * growing depth. Each fragment then only evaluates the lights of its own
+ * cluster.
+ *
+ * Bin() transforms the lights to view space, and finds the range of tiles
+ * and slices that the sphere of each light overlaps by comparing its signed
+ * distance to each tile boundary plane with its radius, four lights at a
+ * time with NEON or SSE2 where the target has them. Define
+ * LIGHT_CLUSTERS_DISABLE_SIMD to force the portable code, e.g. to benchmark
+ * it. The results are laid out for upload as textures (see
+ * ClusteredLighting). Makes no GL calls.
+ */
+class LightClusters {
+ public:
+  static const int kTilesX = 8;
+  static const int kTilesY = 8;
+  static const int kSlices = 16;
+  static const int kClusterCount = kTilesX * kTilesY * kSlices;
+  static const int kMaxLights = 256;
+  static const int kMaxLightsPerCluster = 32;
+  // The light indices are stored in rows of this many.
+  static const int kIndexRowLength = 1024;
+  static const int kIndexRows =
+      kClusterCount * kMaxLightsPerCluster / kIndexRowLength;
+
+  LightClusters();
+
+  /**
+   * Set the frustum of the eye, as the angles in degrees from the view
+   * direction to each of its edges (as in gvr::Rectf) and the depth range.
+   */
+  void SetFrustum(float left, float right, float bottom, float top,
+                  float z_near, float z_far);
+
+  /**
+   * Bin |count| lights, given in world space, for the eye at |view|, the
+   * row-major world to view matrix (as in gvr::Mat4f).
+   */
+  void Bin(const PointLight* lights, size_t count, const float view[4][4]);
+
+  /**
+   * Return the visible lights, as two rows of kMaxLights RGBA texels: the
+   * view space position and radius, then the color.
+   */
+  const float* GetLightData() const { return light_data_.data(); }
+  int GetVisibleLightCount() const { return visible_lights_; }
+
+  /**
+   * Return the first light index and the light count of each cluster, as
+   * kSlices rows of kTilesX * kTilesY texels. The cluster of tile (x, y) in
+   * slice z is texel x + kTilesX * y of row z.
+   */
+  const float* GetClusterData() const { return cluster_data_.data(); }
+
+  /**
+   * Return the light indices of all the clusters, in rows of
+   * kIndexRowLength.
+   */
+  const float* GetIndexData() const { return index_data_.data(); }
+  int GetIndexCount() const { return index_count_; }
+
+  /**
+   * Return the scale and bias that map the tangents x / -z and y / -z of a
+   * view space position to its tile: tile x = x / -z * tiles[0] + tiles[1],
+   * tile y = y / -z * tiles[2] + tiles[3].
+   */
+  void GetTileTransform(float tiles[4]) const;
+
+  /**
+   * Return the scale and bias that map the log of the depth -z of a view
+   * space position to its slice.
+   */
+  void GetSliceTransform(float slices[2]) const;
+
+  LightClusterStats GetStats() const { return stats_; }
+
+ private:
+  // Tile boundary planes, through the eye. The signed distance of (x, y, z)
+  // to vertical plane k is x * x_plane_x_[k] + z * x_plane_z_[k], and
+  // similarly for the horizontal planes. Plane 0 is the left (bottom) edge of
+  // the frustum, and distances grow towards the right (top).
+  float x_plane_x_[kTilesX + 1];
+  float x_plane_z_[kTilesX + 1];
+  float y_plane_y_[kTilesY + 1];
+  float y_plane_z_[kTilesY + 1];
+  // Depths of the slice boundaries.
+  float slice_depth_[kSlices + 1];
+  float tangent_left_;
+  float tangent_right_;
+  float tangent_bottom_;
+  float tangent_top_;
+
+  // Scratch space for Bin(): the lights in view space, as structures of
+  // arrays padded to a multiple of four, and the clusters each overlaps.
+  std::vector<float> view_x_;
+  std::vector<float> view_y_;
+  std::vector<float> view_z_;
+  std::vector<float> radius_;
+  std::vector<uint8_t> ranges_;
+  std::vector<int> cluster_counts_;
+
+  std::vector<float> light_data_;
+  std::vector<float> cluster_data_;
+  std::vector<float> index_data_;
+  int visible_lights_;
+  int index_count_;
+  LightClusterStats stats_;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_LIGHTCLUSTERS_H_  // NOLINT
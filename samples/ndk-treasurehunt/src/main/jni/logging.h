@@ -0,0 +1,50 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_LOGGING_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_LOGGING_H_  // NOLINT
+
+/**
+ * Logging and CHECK() macros of the rendering modules. Messages go to logcat
+ * on Android, and warnings and errors to stderr elsewhere, so that the
+ * modules also build into the host tools.
+ */
+
+#include <stdlib.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+
+#define LOG_TAG "TreasureHuntCPP"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <stdio.h>
+
+#define LOG_TAG "TreasureHuntCPP"
+// Debug messages are dropped, but their arguments still count as used.
+#define LOGD(...) ((void)sizeof(fprintf(stderr, __VA_ARGS__)))
+#define LOGW(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif  // __ANDROID__
+
+#define CHECK(condition)                                                   \
+  if (!(condition)) {                                                      \
+    LOGE("*** CHECK FAILED at %s:%d: %s", __FILE__, __LINE__, #condition); \
+    abort();                                                               \
+  }
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_LOGGING_H_  // NOLINT
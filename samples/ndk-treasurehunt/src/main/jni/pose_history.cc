@@ -0,0 +1,163 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pose_history.h"  // NOLINT
+
+#include <cmath>
+
+namespace {
+static gvr::Quatf QuatFromMatrix(const gvr::Mat4f& matrix) {
+  const float(&m)[4][4] = matrix.m;
+  gvr::Quatf q;
+  const float trace = m[0][0] + m[1][1] + m[2][2];
+  if (trace > 0.0f) {
+    const float s = std::sqrt(trace + 1.0f) * 2.0f;
+    q.qw = 0.25f * s;
+    q.qx = (m[2][1] - m[1][2]) / s;
+    q.qy = (m[0][2] - m[2][0]) / s;
+    q.qz = (m[1][0] - m[0][1]) / s;
+  } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+    const float s = std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f;
+    q.qw = (m[2][1] - m[1][2]) / s;
+    q.qx = 0.25f * s;
+    q.qy = (m[0][1] + m[1][0]) / s;
+    q.qz = (m[0][2] + m[2][0]) / s;
+  } else if (m[1][1] > m[2][2]) {
+    const float s = std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f;
+    q.qw = (m[0][2] - m[2][0]) / s;
+    q.qx = (m[0][1] + m[1][0]) / s;
+    q.qy = 0.25f * s;
+    q.qz = (m[1][2] + m[2][1]) / s;
+  } else {
+    const float s = std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f;
+    q.qw = (m[1][0] - m[0][1]) / s;
+    q.qx = (m[0][2] + m[2][0]) / s;
+    q.qy = (m[1][2] + m[2][1]) / s;
+    q.qz = 0.25f * s;
+  }
+  return q;
+}
+
+static gvr::Mat4f MatrixFromQuat(const gvr::Quatf& q) {
+  const float x = q.qx, y = q.qy, z = q.qz, w = q.qw;
+  gvr::Mat4f result = {{{1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - z * w),
+                         2.0f * (x * z + y * w), 0.0f},
+                        {2.0f * (x * y + z * w), 1.0f - 2.0f * (x * x + z * z),
+                         2.0f * (y * z - x * w), 0.0f},
+                        {2.0f * (x * z - y * w), 2.0f * (y * z + x * w),
+                         1.0f - 2.0f * (x * x + y * y), 0.0f},
+                        {0.0f, 0.0f, 0.0f, 1.0f}}};
+  return result;
+}
+
+/**
+ * Spherical linear interpolation from |a| (t = 0) to |b| (t = 1).
+ */
+static gvr::Quatf Slerp(const gvr::Quatf& a, gvr::Quatf b, float t) {
+  float cos_angle = a.qx * b.qx + a.qy * b.qy + a.qz * b.qz + a.qw * b.qw;
+  // Take the shorter way around.
+  if (cos_angle < 0.0f) {
+    b = {-b.qx, -b.qy, -b.qz, -b.qw};
+    cos_angle = -cos_angle;
+  }
+  float weight_a = 1.0f - t;
+  float weight_b = t;
+  // For nearly equal rotations, linear interpolation is accurate and avoids
+  // dividing by a tiny sine.
+  if (cos_angle < 0.9995f) {
+    const float angle = std::acos(cos_angle);
+    const float sin_angle = std::sin(angle);
+    weight_a = std::sin((1.0f - t) * angle) / sin_angle;
+    weight_b = std::sin(t * angle) / sin_angle;
+  }
+  gvr::Quatf q = {weight_a * a.qx + weight_b * b.qx,
+                  weight_a * a.qy + weight_b * b.qy,
+                  weight_a * a.qz + weight_b * b.qz,
+                  weight_a * a.qw + weight_b * b.qw};
+  const float norm =
+      std::sqrt(q.qx * q.qx + q.qy * q.qy + q.qz * q.qz + q.qw * q.qw);
+  q.qx /= norm;
+  q.qy /= norm;
+  q.qz /= norm;
+  q.qw /= norm;
+  return q;
+}
+}  // anonymous namespace
+
+PoseHistory::PoseHistory()
+    : newest_sample_(kCapacity - 1),
+      sample_count_(0),
+      samples_taken_(0),
+      queries_interpolated_(0),
+      queries_clamped_(0) {}
+
+void PoseHistory::AddSample(uint64_t time_nanos,
+                            const gvr::Mat4f& head_view) {
+  const gvr::Quatf rotation = QuatFromMatrix(head_view);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (sample_count_ > 0 && time_nanos <= GetSample(0).time_nanos) return;
+  newest_sample_ = (newest_sample_ + 1) % kCapacity;
+  samples_[newest_sample_] = {time_nanos, rotation};
+  if (sample_count_ < kCapacity) ++sample_count_;
+  ++samples_taken_;
+}
+
+bool PoseHistory::GetHeadPose(uint64_t time_nanos,
+                              gvr::Mat4f* head_view) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (sample_count_ == 0) return false;
+
+  const Sample& newest = GetSample(0);
+  const Sample& oldest = GetSample(sample_count_ - 1);
+  if (time_nanos >= newest.time_nanos) {
+    if (time_nanos == newest.time_nanos) {
+      ++queries_interpolated_;
+    } else {
+      ++queries_clamped_;
+    }
+    *head_view = MatrixFromQuat(newest.rotation);
+    return true;
+  }
+  if (time_nanos <= oldest.time_nanos) {
+    ++queries_clamped_;
+    *head_view = MatrixFromQuat(oldest.rotation);
+    return true;
+  }
+
+  // Find the two samples around the query, starting from the newest, since
+  // most queries are for recent times.
+  int later = 0;
+  while (GetSample(later + 1).time_nanos > time_nanos) ++later;
+  const Sample& after = GetSample(later);
+  const Sample& before = GetSample(later + 1);
+  const float t = static_cast<float>(
+      static_cast<double>(time_nanos - before.time_nanos) /
+      static_cast<double>(after.time_nanos - before.time_nanos));
+  ++queries_interpolated_;
+  *head_view = MatrixFromQuat(Slerp(before.rotation, after.rotation, t));
+  return true;
+}
+
+PoseHistoryStats PoseHistory::GetStats() const {
+  PoseHistoryStats stats;
+  stats.samples = samples_taken_.load();
+  stats.queries_interpolated = queries_interpolated_.load();
+  stats.queries_clamped = queries_clamped_.load();
+  return stats;
+}
+
+const PoseHistory::Sample& PoseHistory::GetSample(int index) const {
+  return samples_[(newest_sample_ - index + kCapacity) % kCapacity];
+}
@@ -0,0 +1,98 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_POSEHISTORY_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_POSEHISTORY_H_  // NOLINT
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>  // NOLINT
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * Counters describing how PoseHistory answered queries. A query is
+ * interpolated if its time lies between two samples, and clamped if it lies
+ * before the oldest sample or after the newest one.
+ */
+struct PoseHistoryStats {
+  uint64_t samples;
+  uint64_t queries_interpolated;
+  uint64_t queries_clamped;
+};
+
+/**
+ * Ring buffer of timestamped head rotations, answering "pose at time T"
+ * queries for times between the samples. The samples are added by the
+ * thread that owns the gvr_context, since the GVR API is not thread-safe, and
+ * other threads such as the UI thread can then look up the pose at the time
+ * of an input event without calling into the tracker themselves.
+ *
+ * Queries between two samples are answered by spherical linear interpolation.
+ * The history does not predict: poses for future times, such as the display
+ * time of a frame, must come from the tracker, which has the sensor data to
+ * predict them. Queries after the newest sample are clamped to it.
+ */
+class PoseHistory {
+ public:
+  PoseHistory();
+
+  /**
+   * Add a sample of the rotation from start space to head space taken at
+   * |time_nanos|, in nanoseconds of CLOCK_MONOTONIC. Samples must be added
+   * in time order; older ones are ignored. This may also be used to replay a
+   * recorded pose log.
+   */
+  void AddSample(uint64_t time_nanos, const gvr::Mat4f& head_view);
+
+  /**
+   * Write the rotation from start space to head space at |time_nanos| to
+   * |head_view|. Returns false if there are no samples yet. This may be
+   * called from any thread.
+   */
+  bool GetHeadPose(uint64_t time_nanos, gvr::Mat4f* head_view) const;
+
+  /**
+   * Return a snapshot of the sample and query counters.
+   */
+  PoseHistoryStats GetStats() const;
+
+ private:
+  struct Sample {
+    uint64_t time_nanos;
+    gvr::Quatf rotation;
+  };
+
+  static const int kCapacity = 64;
+
+  // Return the |index|th newest sample. |mutex_| must be held.
+  const Sample& GetSample(int index) const;
+
+  // Guards the ring buffer.
+  mutable std::mutex mutex_;
+  Sample samples_[kCapacity];
+  int newest_sample_;
+  int sample_count_;
+
+  std::atomic<uint64_t> samples_taken_;
+  mutable std::atomic<uint64_t> queries_interpolated_;
+  mutable std::atomic<uint64_t> queries_clamped_;
+
+  // Disallow copy and assign.
+  PoseHistory(const PoseHistory& other) = delete;
+  PoseHistory& operator=(const PoseHistory& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_POSEHISTORY_H_  // NOLINT
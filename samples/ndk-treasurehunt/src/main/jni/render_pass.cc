@@ -0,0 +1,150 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_pass.h"  // NOLINT
+
+#include <EGL/egl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logging.h"  // NOLINT
+
+namespace {
+
+// glInvalidateFramebuffer() and glDiscardFramebufferEXT() have the same
+// signature.
+typedef void (*InvalidateFramebufferFunc)(GLenum target,
+                                          GLsizei num_attachments,
+                                          const GLenum* attachments);
+
+// Null if invalidation is not supported by the current context.
+static InvalidateFramebufferFunc invalidate_framebuffer = nullptr;
+
+// Returns the major version of the current OpenGL ES context.
+static int GetGlesMajorVersion() {
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  int major = 2;
+  if (version != nullptr) sscanf(version, "OpenGL ES %d", &major);
+  return major;
+}
+}  // anonymous namespace
+
+void RenderPass::InitializeGl() {
+  invalidate_framebuffer = nullptr;
+  const char* extensions =
+      reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  if (GetGlesMajorVersion() >= 3) {
+    invalidate_framebuffer = reinterpret_cast<InvalidateFramebufferFunc>(
+        eglGetProcAddress("glInvalidateFramebuffer"));
+  } else if (extensions != nullptr &&
+             strstr(extensions, "GL_EXT_discard_framebuffer") != nullptr) {
+    invalidate_framebuffer = reinterpret_cast<InvalidateFramebufferFunc>(
+        eglGetProcAddress("glDiscardFramebufferEXT"));
+  }
+  LOGD("Framebuffer invalidation %s.",
+       invalidate_framebuffer ? "supported" : "not supported");
+}
+
+bool RenderPass::SupportsInvalidation() {
+  return invalidate_framebuffer != nullptr;
+}
+
+RenderPass::RenderPass(const RenderPassDesc& desc)
+    : desc_(desc), frame_(nullptr), active_(false) {}
+
+void RenderPass::Begin(gvr::Frame* frame, int32_t buffer_index,
+                       const gvr::Sizei& size) {
+  CHECK(!active_);
+  frame_ = frame;
+  frame_->BindBuffer(buffer_index);
+  active_ = true;
+  ApplyLoadActions(size);
+}
+
+void RenderPass::Begin(GLuint framebuffer, const gvr::Sizei& size) {
+  CHECK(!active_);
+  frame_ = nullptr;
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  active_ = true;
+  ApplyLoadActions(size);
+}
+
+void RenderPass::End() {
+  CHECK(active_);
+  ApplyStoreActions();
+  if (frame_ != nullptr) {
+    frame_->Unbind();
+  } else {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+  frame_ = nullptr;
+  active_ = false;
+}
+
+bool RenderPass::IsActive() const { return active_; }
+
+void RenderPass::ApplyLoadActions(const gvr::Sizei& size) {
+  GLbitfield clear_mask = 0;
+  GLenum invalidated[2];
+  GLsizei invalidated_count = 0;
+  if (desc_.color_load == kLoadActionClear) {
+    clear_mask |= GL_COLOR_BUFFER_BIT;
+  } else if (desc_.color_load == kLoadActionDontCare) {
+    if (invalidate_framebuffer) {
+      invalidated[invalidated_count++] = GL_COLOR_ATTACHMENT0;
+    } else {
+      clear_mask |= GL_COLOR_BUFFER_BIT;
+    }
+  }
+  if (desc_.depth_load == kLoadActionClear) {
+    clear_mask |= GL_DEPTH_BUFFER_BIT;
+  } else if (desc_.depth_load == kLoadActionDontCare) {
+    if (invalidate_framebuffer) {
+      invalidated[invalidated_count++] = GL_DEPTH_ATTACHMENT;
+    } else {
+      clear_mask |= GL_DEPTH_BUFFER_BIT;
+    }
+  }
+
+  if (invalidated_count > 0) {
+    invalidate_framebuffer(GL_FRAMEBUFFER, invalidated_count, invalidated);
+  }
+  glDisable(GL_SCISSOR_TEST);
+  glViewport(0, 0, size.width, size.height);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(GL_TRUE);
+  if (clear_mask != 0) {
+    glClearColor(desc_.clear_color[0], desc_.clear_color[1],
+                 desc_.clear_color[2], desc_.clear_color[3]);
+    glClearDepthf(desc_.clear_depth);
+    glClear(clear_mask);
+  }
+}
+
+void RenderPass::ApplyStoreActions() {
+  if (!invalidate_framebuffer) return;
+  GLenum invalidated[2];
+  GLsizei invalidated_count = 0;
+  if (desc_.color_store == kStoreActionDiscard) {
+    invalidated[invalidated_count++] = GL_COLOR_ATTACHMENT0;
+  }
+  if (desc_.depth_store == kStoreActionDiscard) {
+    invalidated[invalidated_count++] = GL_DEPTH_ATTACHMENT;
+  }
+  if (invalidated_count > 0) {
+    invalidate_framebuffer(GL_FRAMEBUFFER, invalidated_count, invalidated);
+  }
+}
@@ -0,0 +1,242 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_log.h"  // NOLINT
+
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Number of records in each per-thread buffer. Must be a power of two.
+static const uint32_t kTraceBufferCapacity = 1024;
+
+// How often the background thread drains the buffers.
+static const std::chrono::milliseconds kFlushInterval(20);
+
+struct TraceRecord {
+  const TraceSite* site;
+  uint64_t timestamp_nanos;
+  uint64_t args[kMaxTraceArgs];
+  int num_args;
+};
+
+// Single-producer, single-consumer ring of trace records. The owning thread
+// is the only producer and the flush thread is the only consumer.
+struct TraceBuffer {
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  uint32_t thread_id;
+  TraceRecord records[kTraceBufferCapacity];
+};
+
+// Buffers are never freed, since a record may still be pending when the
+// owning thread exits. Only a handful of threads ever log.
+std::mutex g_buffers_mutex;
+std::vector<TraceBuffer*> g_buffers;
+thread_local TraceBuffer* t_buffer = nullptr;
+
+std::atomic<uint64_t> g_dropped(0);
+
+// State owned by the flush thread while the logger is running.
+std::mutex g_control_mutex;
+std::thread g_flush_thread;
+std::atomic<bool> g_running(false);
+std::string g_tag;
+FILE* g_file = nullptr;
+std::unordered_map<const TraceSite*, uint32_t> g_site_ids;
+uint64_t g_dropped_reported = 0;
+
+uint64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+TraceBuffer* GetThreadBuffer() {
+  if (t_buffer) return t_buffer;
+  TraceBuffer* buffer = new TraceBuffer;
+  buffer->head = 0;
+  buffer->tail = 0;
+  buffer->thread_id = static_cast<uint32_t>(syscall(__NR_gettid));
+  std::lock_guard<std::mutex> lock(g_buffers_mutex);
+  g_buffers.push_back(buffer);
+  t_buffer = buffer;
+  return buffer;
+}
+
+template <typename T>
+void WriteValue(const T& value) {
+  fwrite(&value, sizeof(value), 1, g_file);
+}
+
+void WriteBytes(const char* bytes, uint32_t length) {
+  WriteValue(length);
+  fwrite(bytes, 1, length, g_file);
+}
+
+// Writes |record| as text to logcat.
+void EmitToLogcat(const TraceRecord& record) {
+  char message[512];
+  FormatTraceMessage(record.site->format, record.args, record.num_args,
+                     message, sizeof(message));
+#ifdef __ANDROID__
+  __android_log_write(record.site->level, g_tag.c_str(), message);
+#else
+  fprintf(stderr, "%s: %s\n", g_tag.c_str(), message);
+#endif  // #ifdef __ANDROID__
+}
+
+// Writes |record| to the trace file, preceded by a site record the first time
+// its call site is seen.
+void EmitToFile(const TraceRecord& record, uint32_t thread_id) {
+  auto it = g_site_ids.find(record.site);
+  if (it == g_site_ids.end()) {
+    const uint32_t id = static_cast<uint32_t>(g_site_ids.size());
+    it = g_site_ids.insert(std::make_pair(record.site, id)).first;
+    WriteValue(static_cast<uint8_t>(kTraceRecordSite));
+    WriteValue(id);
+    WriteValue(static_cast<int32_t>(record.site->level));
+    WriteBytes(record.site->format,
+               static_cast<uint32_t>(strlen(record.site->format)));
+  }
+
+  TraceArgKind kinds[kMaxTraceArgs];
+  const int num_kinds =
+      ParseTraceFormat(record.site->format, kinds, kMaxTraceArgs);
+  WriteValue(static_cast<uint8_t>(kTraceRecordEvent));
+  WriteValue(it->second);
+  WriteValue(thread_id);
+  WriteValue(record.timestamp_nanos);
+  WriteValue(static_cast<uint32_t>(record.num_args));
+  for (int i = 0; i < record.num_args; ++i) {
+    if (i < num_kinds && kinds[i] == kTraceArgString) {
+      const char* str =
+          reinterpret_cast<const char*>(static_cast<uintptr_t>(record.args[i]));
+      if (!str) str = "(null)";
+      WriteBytes(str, static_cast<uint32_t>(strlen(str)));
+    } else {
+      WriteValue(record.args[i]);
+    }
+  }
+}
+
+void DrainBuffers() {
+  std::vector<TraceBuffer*> buffers;
+  {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    buffers = g_buffers;
+  }
+  for (TraceBuffer* buffer : buffers) {
+    const uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+    const uint32_t head = buffer->head.load(std::memory_order_acquire);
+    for (uint32_t i = tail; i != head; ++i) {
+      const TraceRecord& record =
+          buffer->records[i & (kTraceBufferCapacity - 1)];
+      if (g_file) {
+        EmitToFile(record, buffer->thread_id);
+      } else {
+        EmitToLogcat(record);
+      }
+    }
+    buffer->tail.store(head, std::memory_order_release);
+  }
+
+  const uint64_t dropped = g_dropped.load();
+  if (dropped != g_dropped_reported) {
+    if (g_file) {
+      WriteValue(static_cast<uint8_t>(kTraceRecordDropped));
+      WriteValue(dropped);
+    } else {
+#ifdef __ANDROID__
+      __android_log_print(ANDROID_LOG_WARN, g_tag.c_str(),
+                          "Trace log dropped %llu messages.",
+                          static_cast<unsigned long long>(dropped));  // NOLINT
+#endif  // #ifdef __ANDROID__
+    }
+    g_dropped_reported = dropped;
+  }
+  if (g_file) fflush(g_file);
+}
+
+void FlushLoop() {
+  while (g_running.load()) {
+    std::this_thread::sleep_for(kFlushInterval);
+    DrainBuffers();
+  }
+  DrainBuffers();
+}
+
+}  // namespace
+
+bool TraceLog::Start(const char* tag, const char* file_path) {
+  std::lock_guard<std::mutex> lock(g_control_mutex);
+  if (g_running.load()) return false;
+  if (file_path) {
+    g_file = fopen(file_path, "wb");
+    if (!g_file) return false;
+    fwrite(kTraceFileMagic, 1, sizeof(kTraceFileMagic), g_file);
+    WriteValue(kTraceFileVersion);
+  }
+  g_tag = tag;
+  g_site_ids.clear();
+  g_dropped_reported = g_dropped.load();
+  g_running = true;
+  g_flush_thread = std::thread(FlushLoop);
+  return true;
+}
+
+void TraceLog::Stop() {
+  std::lock_guard<std::mutex> lock(g_control_mutex);
+  if (!g_running.load()) return;
+  g_running = false;
+  g_flush_thread.join();
+  if (g_file) {
+    fclose(g_file);
+    g_file = nullptr;
+  }
+}
+
+uint64_t TraceLog::GetDroppedCount() { return g_dropped.load(); }
+
+void TraceLog::WriteRecord(const TraceSite* site, const uint64_t* args,
+                           int num_args) {
+  if (!g_running.load(std::memory_order_relaxed)) return;
+  TraceBuffer* buffer = GetThreadBuffer();
+  const uint32_t head = buffer->head.load(std::memory_order_relaxed);
+  if (head - buffer->tail.load(std::memory_order_acquire) >=
+      kTraceBufferCapacity) {
+    g_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  TraceRecord& record = buffer->records[head & (kTraceBufferCapacity - 1)];
+  record.site = site;
+  record.timestamp_nanos = NowNanos();
+  record.num_args = num_args;
+  for (int i = 0; i < num_args; ++i) {
+    record.args[i] = args[i];
+  }
+  buffer->head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,125 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_SRC_MAIN_JNI_TRACELOG_H_  // NOLINT
+#define NDK_SAMPLES_SRC_MAIN_JNI_TRACELOG_H_  // NOLINT
+
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#else
+// Android log priorities, for host builds such as the trace benchmark.
+enum {
+  ANDROID_LOG_DEBUG = 3,
+  ANDROID_LOG_INFO = 4,
+  ANDROID_LOG_WARN = 5,
+  ANDROID_LOG_ERROR = 6,
+};
+#endif  // #ifdef __ANDROID__
+
+#include "trace_format.h"  // NOLINT
+
+// Low-overhead logging for hot paths such as the frame loop.
+//
+// Unlike LOGD/LOGW/LOGE, which format the message and write it to logcat
+// synchronously, TRACE_LOGD/TRACE_LOGW/TRACE_LOGE only copy a pointer to the
+// static call site and the raw argument values into a lock-free buffer owned
+// by the calling thread. A background thread started by TraceLog::Start()
+// drains the buffers and either formats the messages to logcat or writes
+// binary records to a file, which ndk-controllerpaint/tools/trace_decoder
+// turns back into text.
+//
+// String arguments are not copied when the message is logged, so they must
+// point to storage that outlives the process, such as string literals or the
+// strings returned by gvr_controller_api_status_to_string(). When a thread's
+// buffer is full, messages are dropped rather than blocking the caller.
+// While the logger is stopped, messages are discarded at the cost of one
+// atomic load.
+#define TRACE_LOG(level, format, ...)                      \
+  do {                                                     \
+    static const TraceSite kTraceSite = {(level), format}; \
+    if (false) CheckTraceFormat(format, ##__VA_ARGS__);    \
+    TraceLog::Write(&kTraceSite, ##__VA_ARGS__);           \
+  } while (0)
+#define TRACE_LOGD(...) TRACE_LOG(ANDROID_LOG_DEBUG, __VA_ARGS__)
+#define TRACE_LOGW(...) TRACE_LOG(ANDROID_LOG_WARN, __VA_ARGS__)
+#define TRACE_LOGE(...) TRACE_LOG(ANDROID_LOG_ERROR, __VA_ARGS__)
+
+// Static description of a TRACE_LOG call site.
+struct TraceSite {
+  int level;
+  const char* format;
+};
+
+// Never called; lets the compiler check the format string against the
+// arguments of a TRACE_LOG call.
+inline void CheckTraceFormat(const char* format, ...)
+    __attribute__((format(printf, 1, 2)));
+inline void CheckTraceFormat(const char* /* format */, ...) {}
+
+class TraceLog {
+ public:
+  // Starts the background flush thread. If |file_path| is null, messages are
+  // formatted and written to logcat under |tag|. Otherwise binary trace
+  // records are written to |file_path|. Returns false if the logger is
+  // already running or the file cannot be opened.
+  static bool Start(const char* tag, const char* file_path);
+
+  // Flushes all pending messages and stops the background thread.
+  static void Stop();
+
+  // Returns the number of messages dropped because a buffer was full.
+  static uint64_t GetDroppedCount();
+
+  // Records a message for |site|. Use the TRACE_LOG macros instead of calling
+  // this directly.
+  template <typename... Args>
+  static void Write(const TraceSite* site, Args... args) {
+    static_assert(sizeof...(Args) <= kMaxTraceArgs,
+                  "Too many arguments for a trace message.");
+    const uint64_t packed[sizeof...(Args) + 1] = {ToTraceArg(args)..., 0};
+    WriteRecord(site, packed, static_cast<int>(sizeof...(Args)));
+  }
+
+ private:
+  static void WriteRecord(const TraceSite* site, const uint64_t* args,
+                          int num_args);
+
+  template <typename T>
+  static typename std::enable_if<
+      std::is_integral<T>::value || std::is_enum<T>::value, uint64_t>::type
+  ToTraceArg(T value) {
+    return static_cast<uint64_t>(value);
+  }
+
+  static uint64_t ToTraceArg(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  template <typename T>
+  static uint64_t ToTraceArg(const T* pointer) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer));
+  }
+};
+
+#endif  // NDK_SAMPLES_SRC_MAIN_JNI_TRACELOG_H_  // NOLINT
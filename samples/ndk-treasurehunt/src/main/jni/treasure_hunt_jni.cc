@@ -17,6 +17,7 @@
 #include <jni.h>
 
 #include <memory>
+#include <string>
 
 #include "treasure_hunt_renderer.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
@@ -41,14 +42,20 @@ extern "C" {
 
 JNI_METHOD(jlong, nativeCreateRenderer)
 (JNIEnv *env, jclass clazz, jobject class_loader, jobject android_context,
- jlong native_gvr_api) {
+ jlong native_gvr_api, jstring cache_directory) {
   std::unique_ptr<gvr::AudioApi> audio_context(new gvr::AudioApi);
   audio_context->Init(env, android_context, class_loader,
                       GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY);
 
+  const char *cache_directory_chars =
+      env->GetStringUTFChars(cache_directory, nullptr);
+  const std::string cache_directory_string(cache_directory_chars);
+  env->ReleaseStringUTFChars(cache_directory, cache_directory_chars);
+
   return jptr(
       new TreasureHuntRenderer(reinterpret_cast<gvr_context *>(native_gvr_api),
-                               std::move(audio_context)));
+                               std::move(audio_context),
+                               cache_directory_string));
 }
 
 JNI_METHOD(void, nativeDestroyRenderer)
@@ -81,4 +88,12 @@ JNI_METHOD(void, nativeOnResume)
   native(native_treasure_hunt)->OnResume();
 }
 
+JNI_METHOD(void, nativeOnVsync)
+(JNIEnv *env, jobject obj, jlong native_treasure_hunt, jlong frame_time_nanos,
+ jlong period_nanos) {
+  native(native_treasure_hunt)
+      ->OnVsync(static_cast<uint64_t>(frame_time_nanos),
+                static_cast<uint64_t>(period_nanos));
+}
+
 }  // extern "C"
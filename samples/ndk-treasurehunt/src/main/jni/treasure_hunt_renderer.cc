@@ -15,21 +15,15 @@
 
 #include "treasure_hunt_renderer.h"  // NOLINT
 
-#include <android/log.h>
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <cmath>
 #include <random>
 
-#define LOG_TAG "TreasureHuntCPP"
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define CHECK(condition)                                                   \
-  if (!(condition)) {                                                      \
-    LOGE("*** CHECK FAILED at %s:%d: %s", __FILE__, __LINE__, #condition); \
-    abort();                                                               \
-  }
+#include "logging.h"  // NOLINT
+#include "trace_log.h"  // NOLINT
 
 namespace {
 static const float kZNear = 1.0f;
@@ -41,12 +35,37 @@ static const float kMinCubeDistance = 4.5f;
 static const float kMaxCubeDistance = 8.0f;
 static const float kReticleDistance = 3.0f;
 
-static const float kFloorDepth = 20.0f;
 
 static const int kCoordsPerVertex = 3;
 
 static const uint64_t kPredictionTimeWithoutVsyncNanos = 50000000;
 
+// Time left between the estimated end of a frame and its vsync deadline, to
+// absorb oversleeping and frames slower than the estimate.
+static const uint64_t kFrameScheduleMarginNanos = 2000000;
+
+// Budget of voices rendered binaurally; the next most audible voices are
+// rendered as stereo sources, and the rest are not rendered at all.
+static const int kMaxSpatialVoices = 4;
+static const int kMaxStereoVoices = 8;
+
+// The cube sound is heard at full volume within this distance, which is less
+// than the closest the cube gets.
+static const float kCubeSoundMinDistance = 1.0f;
+
+// Threads casting the occlusion rays. The scene is small enough for one.
+static const int kOcclusionWorkers = 1;
+
+// Maximum time to spend waiting for the swap chain to provide a frame before
+// the frame is counted as dropped.
+static const uint64_t kFrameAcquireBudgetNanos = 4000000;
+
+// Number of submitted frames the GPU may still be working on when a new frame
+// begins, and the longest time to wait for it to catch up. Any more queued
+// frames would add to the latency between pose sampling and display.
+static const int kMaxFramesInFlight = 2;
+static const uint64_t kFrameLimiterBudgetNanos = 8000000;
+
 // Angle threshold for determining whether the controller is pointing at the
 // object.
 static const float kAngleLimit = 0.12f;
@@ -54,24 +73,80 @@ static const float kAngleLimit = 0.12f;
 static const float kPitchLimit = 0.12f;
 static const float kYawLimit = 0.12f;
 
-static const char* kGridFragmentShader = R"glsl(
-    precision mediump float;
+// The floor is unlit: its lighting comes from a baked lightmap, and its grid
+// lines from a repeating texture. The grid fades out with depth as before;
+// 0.5 * (z + w) of the clip space position is what gl_FragCoord.z /
+// gl_FragCoord.w gives, but interpolates exactly from the vertices.
+static const char* kBakedFloorVertexShader = R"glsl(
+    uniform mat4 u_Model;
+    uniform mat4 u_MVP;
+    uniform mat4 u_MVMatrix;
+    uniform vec4 u_LightmapTransform;
+    attribute vec4 a_Position;
+    varying vec2 v_LightmapCoords;
+    varying vec2 v_GridCoords;
+    varying float v_Depth;
+    varying vec3 v_ViewPosition;
+    varying vec3 v_ViewNormal;
+
+    void main() {
+      vec3 world = vec3(u_Model * a_Position);
+      v_LightmapCoords = world.xz * u_LightmapTransform.xy +
+                         u_LightmapTransform.zw;
+      v_GridCoords = world.xz / GRID_SPACING;
+      v_ViewPosition = vec3(u_MVMatrix * a_Position);
+      v_ViewNormal = vec3(u_MVMatrix * vec4(0.0, 1.0, 0.0, 0.0));
+      gl_Position = u_MVP * a_Position;
+      v_Depth = 0.5 * (gl_Position.z + gl_Position.w);
+    })glsl";
+
+// Follows "precision mediump float;", or the clustered lighting code and
+// "#define CLUSTERED_LIGHTING" to add the point lights.
+static const char* kBakedFloorFragmentShader = R"glsl(
+    uniform sampler2D u_Lightmap;
+    uniform sampler2D u_GridTexture;
+    varying vec2 v_LightmapCoords;
+    varying vec2 v_GridCoords;
+    varying float v_Depth;
+    varying vec3 v_ViewPosition;
+    varying vec3 v_ViewNormal;
+
+    void main() {
+      vec4 color = texture2D(u_Lightmap, v_LightmapCoords);
+    #ifdef CLUSTERED_LIGHTING
+      color.rgb += ClusteredLight(v_ViewPosition, normalize(v_ViewNormal));
+    #endif
+      float line = texture2D(u_GridTexture, v_GridCoords).a;
+      float fade = max(0.0, (90.0 - v_Depth) / 90.0);
+      gl_FragColor = mix(color, vec4(1.0), line * fade);
+    })glsl";
+
+static const char* kLightVertexShader = R"glsl(
+    uniform mat4 u_Model;
+    uniform mat4 u_MVP;
+    uniform mat4 u_MVMatrix;
+    uniform vec3 u_LightPos;
+    attribute vec4 a_Position;
+    attribute vec4 a_Color;
+    attribute vec3 a_Normal;
     varying vec4 v_Color;
     varying vec3 v_Grid;
 
     void main() {
-      float depth = gl_FragCoord.z / gl_FragCoord.w;
-      if ((mod(abs(v_Grid.x), 10.0) < 0.1) ||
-          (mod(abs(v_Grid.z), 10.0) < 0.1)) {
-        gl_FragColor = max(0.0, (90.0-depth) / 90.0) *
-                       vec4(1.0, 1.0, 1.0, 1.0) +
-                       min(1.0, depth / 90.0) * v_Color;
-      } else {
-        gl_FragColor = v_Color;
-      }
+      v_Grid = vec3(u_Model * a_Position);
+      vec3 modelViewVertex = vec3(u_MVMatrix * a_Position);
+      vec3 modelViewNormal = vec3(u_MVMatrix * vec4(a_Normal, 0.0));
+      float distance = length(u_LightPos - modelViewVertex);
+      vec3 lightVector = normalize(u_LightPos - modelViewVertex);
+      float diffuse = max(dot(modelViewNormal, lightVector), 0.5);
+      diffuse = diffuse * (1.0 / (1.0 + (0.00001 * distance * distance)));
+      v_Color = vec4(a_Color.rgb * diffuse, a_Color.a);
+      gl_Position = u_MVP * a_Position;
     })glsl";
 
-static const char* kLightVertexShader = R"glsl(
+// Same as kLightVertexShader, and also passes the view space position and
+// normal on for clustered lighting.
+static const char* kClusteredLightVertexShader = R"glsl(
     uniform mat4 u_Model;
     uniform mat4 u_MVP;
     uniform mat4 u_MVMatrix;
@@ -81,6 +156,8 @@ static const char* kLightVertexShader = R"glsl(
     attribute vec3 a_Normal;
     varying vec4 v_Color;
     varying vec3 v_Grid;
+    varying vec3 v_ViewPosition;
+    varying vec3 v_ViewNormal;
 
     void main() {
       v_Grid = vec3(u_Model * a_Position);
@@ -91,9 +168,23 @@ static const char* kLightVertexShader = R"glsl(
       float diffuse = max(dot(modelViewNormal, lightVector), 0.5);
       diffuse = diffuse * (1.0 / (1.0 + (0.00001 * distance * distance)));
       v_Color = vec4(a_Color.rgb * diffuse, a_Color.a);
+      v_ViewPosition = modelViewVertex;
+      v_ViewNormal = modelViewNormal;
       gl_Position = u_MVP * a_Position;
     })glsl";
 
+// The clustered fragment shaders follow ClusteredLighting::GetShaderCode(),
+// and add the point lights to the vertex lighting.
+static const char* kClusteredFragmentShader = R"glsl(
+    varying vec4 v_Color;
+    varying vec3 v_ViewPosition;
+    varying vec3 v_ViewNormal;
+
+    void main() {
+      vec3 light = ClusteredLight(v_ViewPosition, normalize(v_ViewNormal));
+      gl_FragColor = vec4(v_Color.rgb + light, v_Color.a);
+    })glsl";
+
 static const char* kPassthroughFragmentShader = R"glsl(
     precision mediump float;
     varying vec4 v_Color;
@@ -124,6 +215,28 @@ static const char* kReticleFragmentShader = R"glsl(
       gl_FragColor = vec4(alpha);
     })glsl";
 
+// Point lights circling over the floor, in rings out to kPointLightSpread.
+// They demonstrate clustered lighting and are off by default: set
+// kPointLightsEnabled to draw them.
+static const bool kPointLightsEnabled = false;
+static const int kPointLightCount = 192;
+static const float kPointLightSpread = 45.0f;
+static const float kPointLightRadius = 4.0f;
+static const float kPointLightHeight = 1.0f;
+static const float kPointLightSpeed = 0.2f;  // Radians per second.
+
+// Grid lines on the floor, every kGridSpacing meters and kGridLineWidth wide,
+// drawn from a repeating texture of kGridTextureSize texels per cell.
+static const float kGridSpacing = 10.0f;
+static const float kGridLineWidth = 0.1f;
+static const int kGridTextureSize = 256;
+
+// Texture units of the floor; the clustered lighting takes the units in
+// between.
+static const int kLightmapTextureUnit = 0;
+static const int kGridTextureUnit = ClusteredLighting::kFirstTextureUnit +
+                                    ClusteredLighting::kTextureUnitCount;
+
 // Sound file in APK assets.
 static const char* kObjectSoundFile = "cube_sound.wav";
 static const char* kSuccessSoundFile = "success.wav";
@@ -226,6 +339,27 @@ static float RandomUniformFloat() {
   return random_distribution(random_generator);
 }
 
+// Returns the alpha texels of one cell of the floor grid, whose lines run
+// along its bottom and left edges, as the coverage of each texel by the
+// lines.
+static std::vector<uint8_t> MakeGridTexels() {
+  const float line = kGridLineWidth / kGridSpacing * kGridTextureSize;
+  std::vector<float> coverage(kGridTextureSize);
+  for (int i = 0; i < kGridTextureSize; ++i) {
+    coverage[i] = std::min(std::max(line - i, 0.0f), 1.0f);
+  }
+  std::vector<uint8_t> texels(kGridTextureSize * kGridTextureSize);
+  for (int t = 0; t < kGridTextureSize; ++t) {
+    for (int s = 0; s < kGridTextureSize; ++s) {
+      const float union_coverage =
+          coverage[s] + coverage[t] - coverage[s] * coverage[t];
+      texels[t * kGridTextureSize + s] =
+          static_cast<uint8_t>(union_coverage * 255.0f + 0.5f);
+    }
+  }
+  return texels;
+}
+
 static void CheckGLError(const char* label) {
   int gl_error = glGetError();
   if (gl_error != GL_NO_ERROR) {
@@ -290,23 +424,38 @@ static float VectorInnerProduct(const std::array<float, 4>& vect1,
 }  // anonymous namespace
 
 TreasureHuntRenderer::TreasureHuntRenderer(
-    gvr_context* gvr_context, std::unique_ptr<gvr::AudioApi> gvr_audio_api)
+    gvr_context* gvr_context, std::unique_ptr<gvr::AudioApi> gvr_audio_api,
+    const std::string& cache_directory)
     : gvr_api_(gvr::GvrApi::WrapNonOwned(gvr_context)),
       gvr_audio_api_(std::move(gvr_audio_api)),
+      voice_backend_(gvr_audio_api_.get()),
+      voice_manager_(&voice_backend_, kMaxSpatialVoices, kMaxStereoVoices),
+      audio_occlusion_(&occlusion_bvh_, kOcclusionWorkers),
       scratch_viewport_(gvr_api_->CreateBufferViewport()),
-      floor_vertices_(world_layout_data_.floor_coords.data()),
-      cube_vertices_(world_layout_data_.cube_coords.data()),
-      cube_colors_(world_layout_data_.cube_colors.data()),
-      cube_found_colors_(world_layout_data_.cube_found_color.data()),
-      cube_normals_(world_layout_data_.cube_normals.data()),
-      reticle_vertices_(world_layout_data_.reticle_coords.data()),
+      frame_acquirer_(gvr_api_.get(), FrameAcquirer::kPolicyWait,
+                      kFrameAcquireBudgetNanos),
+      frame_limiter_(kMaxFramesInFlight, FrameLimiter::kPolicyWait,
+                     kFrameLimiterBudgetNanos),
+      frame_scheduler_(kFrameScheduleMarginNanos,
+                       kPredictionTimeWithoutVsyncNanos),
+      compositor_(gvr_api_.get(), &gpu_memory_),
+      frame_graph_(&gpu_memory_),
+      clustered_lighting_(&gpu_memory_),
+      point_lights_(kPointLightCount),
+      clustered_lighting_enabled_(false),
+      light_baker_(cache_directory, 0),
+      floor_lightmap_(0),
+      floor_grid_texture_(0),
       reticle_render_size_{128, 128},
-      light_pos_world_space_({0.0f, 2.0f, 0.0f, 1.0f}),
+      light_pos_world_space_(
+          {kLightPosition[0], kLightPosition[1], kLightPosition[2], 1.0f}),
       object_distance_(kMinCubeDistance),
-      audio_source_id_(-1),
+      cube_voice_(VoiceManager::kInvalidVoice),
+      cube_occlusion_(AudioOcclusion::kInvalidSource),
       success_source_id_(-1),
       gvr_controller_api_(nullptr),
       gvr_viewer_type_(gvr_api_->GetViewerType()) {
+  TraceLog::Start(LOG_TAG, nullptr);
   ResumeControllerApiAsNeeded();
   if (gvr_viewer_type_ == GVR_VIEWER_TYPE_CARDBOARD) {
     LOGD("Viewer type: CARDBOARD");
@@ -315,6 +464,55 @@ TreasureHuntRenderer::TreasureHuntRenderer(
   } else {
     LOGE("Unexpected viewer type.");
   }
+
+  // The size of the world layer is set in InitializeGl().
+  LayerDesc world;
+  world.type = kLayerTypeWorld;
+  world.size = {0, 0};
+  world.samples = 2;
+  world.color_format = GVR_COLOR_FORMAT_RGBA_8888;
+  world.depth_stencil_format = GVR_DEPTH_STENCIL_FORMAT_DEPTH_16;
+  world.reprojection = GVR_REPROJECTION_FULL;
+  // Dark background so text shows up. Depth is not needed after the frame,
+  // so it is neither stored nor resolved.
+  world.render_pass = {kLoadActionClear, kStoreActionStore, kLoadActionClear,
+                       kStoreActionDiscard, {0.1f, 0.1f, 0.1f, 0.5f}, 1.0f};
+  world_layer_ = compositor_.AddLayer(world);
+
+  LayerDesc reticle;
+  reticle.type = kLayerTypeQuad;
+  reticle.size = reticle_render_size_;
+  reticle.samples = 1;
+  reticle.color_format = GVR_COLOR_FORMAT_RGBA_8888;
+  reticle.depth_stencil_format = GVR_DEPTH_STENCIL_FORMAT_NONE;
+  reticle.reprojection = GVR_REPROJECTION_NONE;
+  // Transparent background.
+  reticle.render_pass = {kLoadActionClear, kStoreActionStore,
+                         kLoadActionDontCare, kStoreActionDiscard,
+                         {0.0f, 0.0f, 0.0f, 0.0f}, 1.0f};
+  reticle_layer_ = compositor_.AddLayer(reticle);
+
+  // Offscreen passes go before the layers that use their render targets.
+  const int world_output = frame_graph_.AddOutput("world layer");
+  const int reticle_output = frame_graph_.AddOutput("reticle layer");
+  frame_graph_.AddPass(
+      "world", {}, {world_output},
+      [this](gvr::Frame* frame, const FrameGraph&) { DrawWorldLayer(frame); });
+  frame_graph_.AddPass("reticle", {}, {reticle_output},
+                       [this](gvr::Frame* frame, const FrameGraph&) {
+                         DrawReticleLayer(frame);
+                       });
+  frame_graph_.Compile();
+
+  // The floor is lit by the light of the scene alone; the cube moves, so it
+  // casts no baked shadow.
+  const BakeLight light = {
+      {kLightPosition[0], kLightPosition[1], kLightPosition[2]},
+      {1.0f, 1.0f, 1.0f},
+      kLightMinDiffuse,
+      kLightAttenuation,
+  };
+  light_baker_.AddLight(light);
 }
 
 TreasureHuntRenderer::~TreasureHuntRenderer() {
@@ -322,16 +520,49 @@ TreasureHuntRenderer::~TreasureHuntRenderer() {
   if (audio_initialization_thread_.joinable()) {
     audio_initialization_thread_.join();
   }
+  TraceLog::Stop();
 }
 
 void TreasureHuntRenderer::InitializeGl() {
   gvr_api_->InitializeGl();
 
-  const int vertex_shader = LoadGLShader(GL_VERTEX_SHADER, &kLightVertexShader);
-  const int grid_shader =
-      LoadGLShader(GL_FRAGMENT_SHADER, &kGridFragmentShader);
+  // Without clustered lighting, the point lights are not drawn.
+  clustered_lighting_enabled_ = false;
+  if (kPointLightsEnabled) {
+    clustered_lighting_enabled_ = clustered_lighting_.InitializeGl();
+    if (!clustered_lighting_enabled_) {
+      LOGW("Float textures are not supported; point lights disabled.");
+    }
+  }
+  const std::string clustered_fragment_shader =
+      ClusteredLighting::GetShaderCode() + kClusteredFragmentShader;
+  char grid_define[64];
+  snprintf(grid_define, sizeof(grid_define), "#define GRID_SPACING %f\n",
+           kGridSpacing);
+  const std::string floor_vertex_code =
+      std::string(grid_define) + kBakedFloorVertexShader;
+  const std::string floor_fragment_code =
+      (clustered_lighting_enabled_
+           ? "#define CLUSTERED_LIGHTING\n" + ClusteredLighting::GetShaderCode()
+           : std::string("precision mediump float;\n")) +
+      kBakedFloorFragmentShader;
+  const char* light_vertex_source = kLightVertexShader;
+  const char* floor_vertex_source = floor_vertex_code.c_str();
+  const char* floor_fragment_source = floor_fragment_code.c_str();
+  const char* pass_through_source = kPassthroughFragmentShader;
+  if (clustered_lighting_enabled_) {
+    light_vertex_source = kClusteredLightVertexShader;
+    pass_through_source = clustered_fragment_shader.c_str();
+  }
+
+  const int vertex_shader =
+      LoadGLShader(GL_VERTEX_SHADER, &light_vertex_source);
+  const int floor_vertex_shader =
+      LoadGLShader(GL_VERTEX_SHADER, &floor_vertex_source);
+  const int floor_fragment_shader =
+      LoadGLShader(GL_FRAGMENT_SHADER, &floor_fragment_source);
   const int pass_through_shader =
-      LoadGLShader(GL_FRAGMENT_SHADER, &kPassthroughFragmentShader);
+      LoadGLShader(GL_FRAGMENT_SHADER, &pass_through_source);
   const int reticle_vertex_shader =
       LoadGLShader(GL_VERTEX_SHADER, &kReticleVertexShader);
   const int reticle_fragment_shader =
@@ -356,25 +587,34 @@ void TreasureHuntRenderer::InitializeGl() {
   CheckGLError("Cube program params");
 
   floor_program_ = glCreateProgram();
-  glAttachShader(floor_program_, vertex_shader);
-  glAttachShader(floor_program_, grid_shader);
+  glAttachShader(floor_program_, floor_vertex_shader);
+  glAttachShader(floor_program_, floor_fragment_shader);
   glLinkProgram(floor_program_);
   glUseProgram(floor_program_);
 
   CheckGLError("Floor program");
 
   floor_position_param_ = glGetAttribLocation(floor_program_, "a_Position");
-  floor_normal_param_ = glGetAttribLocation(floor_program_, "a_Normal");
-  floor_color_param_ = glGetAttribLocation(floor_program_, "a_Color");
 
   floor_model_param_ = glGetUniformLocation(floor_program_, "u_Model");
   floor_modelview_param_ = glGetUniformLocation(floor_program_, "u_MVMatrix");
   floor_modelview_projection_param_ =
       glGetUniformLocation(floor_program_, "u_MVP");
-  floor_light_pos_param_ = glGetUniformLocation(floor_program_, "u_LightPos");
+  floor_lightmap_param_ = glGetUniformLocation(floor_program_, "u_Lightmap");
+  floor_lightmap_transform_param_ =
+      glGetUniformLocation(floor_program_, "u_LightmapTransform");
+  floor_grid_texture_param_ =
+      glGetUniformLocation(floor_program_, "u_GridTexture");
 
   CheckGLError("Floor program params");
 
+  BakeFloorLighting();
+
+  if (clustered_lighting_enabled_) {
+    cube_cluster_uniforms_ = ClusteredLighting::GetUniforms(cube_program_);
+    floor_cluster_uniforms_ = ClusteredLighting::GetUniforms(floor_program_);
+  }
+
   reticle_program_ = glCreateProgram();
   glAttachShader(reticle_program_, reticle_vertex_shader);
   glAttachShader(reticle_program_, reticle_fragment_shader);
@@ -408,24 +648,35 @@ void TreasureHuntRenderer::InitializeGl() {
   // achieve similar quality.
   render_size_ =
       HalfPixelCount(gvr_api_->GetMaximumEffectiveRenderTargetSize());
-  std::vector<gvr::BufferSpec> specs;
-
-  specs.push_back(gvr_api_->CreateBufferSpec());
-  specs[0].SetColorFormat(GVR_COLOR_FORMAT_RGBA_8888);
-  specs[0].SetDepthStencilFormat(GVR_DEPTH_STENCIL_FORMAT_DEPTH_16);
-  specs[0].SetSize(render_size_);
-  specs[0].SetSamples(2);
-
-  specs.push_back(gvr_api_->CreateBufferSpec());
-  specs[1].SetSize(reticle_render_size_);
-  specs[1].SetColorFormat(GVR_COLOR_FORMAT_RGBA_8888);
-  specs[1].SetDepthStencilFormat(GVR_DEPTH_STENCIL_FORMAT_NONE);
-  specs[1].SetSamples(1);
-  swapchain_.reset(new gvr::SwapChain(gvr_api_->CreateSwapChain(specs)));
+  compositor_.ResizeLayer(world_layer_, render_size_);
+  compositor_.InitializeGl();
+  frame_graph_.InitializeGl();
+  hidden_area_.InitializeGl();
+  if (!fence_.InitializeGl()) {
+    LOGW("EGL_KHR_fence_sync is not supported; frames in flight unlimited.");
+  }
+  frame_limiter_.SetFence(&fence_);
+  frame_scheduler_.SetFence(&fence_);
+  frame_scheduler_.SetVsyncProvider(&vsync_);
 
   viewport_list_.reset(
       new gvr::BufferViewportList(gvr_api_->CreateEmptyBufferViewportList()));
 
+  // The occluders never move, so the hierarchy is built once, before the
+  // first frame starts casting rays against it.
+  if (occlusion_bvh_.GetTriangleCount() == 0) {
+    occlusion_bvh_.AddMesh(kFloorMesh.vertices[0].position,
+                           sizeof(PositionVertex), kFloorMesh.indices,
+                           kFloorMesh.kIndexCount, model_floor_.m);
+    occlusion_bvh_.Build();
+    cube_occlusion_ = audio_occlusion_.AddSource(
+        model_cube_.m[0][3], model_cube_.m[1][3], model_cube_.m[2][3]);
+  } else {
+    audio_occlusion_.SetSourcePosition(cube_occlusion_, model_cube_.m[0][3],
+                                       model_cube_.m[1][3],
+                                       model_cube_.m[2][3]);
+  }
+
   // Initialize audio engine and preload sample in a separate thread to avoid
   // any delay during construction and app initialization. Only do this once.
   if (!audio_initialization_thread_.joinable()) {
@@ -465,11 +716,12 @@ void TreasureHuntRenderer::ProcessControllerInput() {
   // Print new API status and connection state, if they changed.
   if (gvr_controller_state_.GetApiStatus() != old_status ||
       gvr_controller_state_.GetConnectionState() != old_connection_state) {
-    LOGD("TreasureHuntApp: controller API status: %s, connection state: %s",
-         gvr_controller_api_status_to_string(
-             gvr_controller_state_.GetApiStatus()),
-         gvr_controller_connection_state_to_string(
-             gvr_controller_state_.GetConnectionState()));
+    TRACE_LOGD(
+        "TreasureHuntApp: controller API status: %s, connection state: %s",
+        gvr_controller_api_status_to_string(
+            gvr_controller_state_.GetApiStatus()),
+        gvr_controller_connection_state_to_string(
+            gvr_controller_state_.GetConnectionState()));
   }
 
   // Trigger click event if app/click button is clicked.
@@ -480,72 +732,112 @@ void TreasureHuntRenderer::ProcessControllerInput() {
 }
 
 void TreasureHuntRenderer::DrawFrame() {
+  // Acquire the frame before any other work, so that a frame that cannot be
+  // rendered costs no more than the audio update.
+  gvr::Frame frame = frame_acquirer_.AcquireFrame(compositor_.GetSwapChain());
+  if (!frame) {
+    // No frame became available within the budget. The drop has been
+    // recorded by |frame_acquirer_|; audio keeps following the head.
+    UpdateAudio(false);
+    return;
+  }
+
+  // Wait for the GPU before sampling any input, so that the head pose and
+  // controller state are as recent as possible. If it is still behind, skip
+  // the work that can wait for the next frame.
+  const bool gpu_caught_up = frame_limiter_.BeginFrame();
+  // Then wait until the latest start that still meets the next vsync.
+  gvr::ClockTimePoint target_time;
+  target_time.monotonic_system_time_nanos = frame_scheduler_.BeginFrame();
   if (gvr_viewer_type_ == GVR_VIEWER_TYPE_DAYDREAM) {
     ProcessControllerInput();
   }
-  PrepareFramebuffer();
-  gvr::Frame frame = swapchain_->AcquireFrame();
-
-  // A client app does its rendering here.
-  gvr::ClockTimePoint target_time = gvr::GvrApi::GetTimePointNow();
-  target_time.monotonic_system_time_nanos += kPredictionTimeWithoutVsyncNanos;
 
+  // A client app does its rendering here. The tracker is asked for the head
+  // pose once per frame, at the time the frame is displayed, and the pose is
+  // recorded for audio and picking.
   head_view_ = gvr_api_->GetHeadSpaceFromStartSpaceRotation(target_time);
+  pose_history_.AddSample(target_time.monotonic_system_time_nanos,
+                          head_view_);
+  if (clustered_lighting_enabled_ && gpu_caught_up) {
+    UpdatePointLights(target_time.monotonic_system_time_nanos);
+  }
   gvr::Mat4f left_eye_matrix = gvr_api_->GetEyeFromHeadMatrix(GVR_LEFT_EYE);
   gvr::Mat4f right_eye_matrix = gvr_api_->GetEyeFromHeadMatrix(GVR_RIGHT_EYE);
-  gvr::Mat4f left_eye_view = MatrixMul(left_eye_matrix, head_view_);
-  gvr::Mat4f right_eye_view = MatrixMul(right_eye_matrix, head_view_);
-
-  viewport_list_->SetToRecommendedBufferViewports();
-  gvr::BufferViewport reticle_viewport = gvr_api_->CreateBufferViewport();
-  reticle_viewport.SetSourceBufferIndex(1);
-  reticle_viewport.SetReprojection(GVR_REPROJECTION_NONE);
-  reticle_viewport.SetSourceUv({0.f, 1.f, 0.f, 1.f});
 
   // Use the viewport transform to put the reticle in the correct place.
-  reticle_viewport.SetTransform(MatrixMul(left_eye_matrix, model_reticle_));
-  reticle_viewport.SetTargetEye(GVR_LEFT_EYE);
-  viewport_list_->SetBufferViewport(2, reticle_viewport);
-  reticle_viewport.SetTransform(MatrixMul(right_eye_matrix, model_reticle_));
-  reticle_viewport.SetTargetEye(GVR_RIGHT_EYE);
-  viewport_list_->SetBufferViewport(3, reticle_viewport);
+  compositor_.SetQuadTransform(reticle_layer_, GVR_LEFT_EYE,
+                               MatrixMul(left_eye_matrix, model_reticle_));
+  compositor_.SetQuadTransform(reticle_layer_, GVR_RIGHT_EYE,
+                               MatrixMul(right_eye_matrix, model_reticle_));
+  compositor_.UpdateViewports(viewport_list_.get());
+
+  frame_graph_.Execute(&frame);
+
+  // Submit frame.
+  frame.Submit(*viewport_list_, head_view_);
+  frame_limiter_.EndFrame();
+  frame_scheduler_.EndFrame();
+
+  CheckGLError("onDrawFrame");
+
+  // A resize can wait a frame, rather than reallocate buffers that the GPU
+  // may still be using.
+  if (gpu_caught_up) PrepareFramebuffer();
+  UpdateAudio(gpu_caught_up);
+}
+
+void TreasureHuntRenderer::UpdateAudio(bool cast_occlusion_rays) {
+  // Audio is rendered from now on, so it follows the pose on display now,
+  // which lies between the poses recorded for the last frames.
+  const uint64_t now_nanos =
+      gvr::GvrApi::GetTimePointNow().monotonic_system_time_nanos;
+  gvr::Mat4f head_view;
+  if (pose_history_.GetHeadPose(now_nanos, &head_view)) {
+    gvr_audio_api_->SetHeadPose(head_view);
+  }
+  if (cast_occlusion_rays) {
+    // The listener stays at the origin; only its head rotates.
+    audio_occlusion_.Update(0.0f, 0.0f, 0.0f, now_nanos);
+  }
+  // GVR audio cannot filter individual sources, so only the volume follows
+  // the occlusion.
+  const OcclusionParams cube_params =
+      audio_occlusion_.GetParams(cube_occlusion_);
+  voice_manager_.SetVoiceVolume(cube_voice_, cube_params.volume);
+  voice_manager_.Update(0.0f, 0.0f, 0.0f, now_nanos);
+  gvr_audio_api_->Update();
+}
+
+void TreasureHuntRenderer::DrawWorldLayer(gvr::Frame* frame) {
+  const gvr::Mat4f left_eye_view =
+      MatrixMul(gvr_api_->GetEyeFromHeadMatrix(GVR_LEFT_EYE), head_view_);
+  const gvr::Mat4f right_eye_view =
+      MatrixMul(gvr_api_->GetEyeFromHeadMatrix(GVR_RIGHT_EYE), head_view_);
 
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_CULL_FACE);
   glDisable(GL_SCISSOR_TEST);
   glDisable(GL_BLEND);
 
-  // Draw the world.
-  frame.BindBuffer(0);
-  glClearColor(0.1f, 0.1f, 0.1f, 0.5f);  // Dark background so text shows up.
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  compositor_.BeginLayer(frame, world_layer_);
   viewport_list_->GetBufferViewport(0, &scratch_viewport_);
   DrawWorld(left_eye_view, scratch_viewport_);
   viewport_list_->GetBufferViewport(1, &scratch_viewport_);
   DrawWorld(right_eye_view, scratch_viewport_);
-  frame.Unbind();
-
-  frame.BindBuffer(1);
-  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);  // Transparent background.
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  compositor_.EndLayer(world_layer_);
+}
 
-  // In Cardboard viewer, draw head-locked reticle on a separate layer since the
-  // cursor is controlled by head movement. In Daydream viewer, this layer is
-  // left empty, since the cursor is controlled by controller and drawn with
-  // DrawCursor() in the same frame buffer as the virtual scene.
+void TreasureHuntRenderer::DrawReticleLayer(gvr::Frame* frame) {
+  compositor_.BeginLayer(frame, reticle_layer_);
+  // In Cardboard viewer, draw head-locked reticle on a separate layer since
+  // the cursor is controlled by head movement. In Daydream viewer, this
+  // layer is left empty, since the cursor is controlled by controller and
+  // drawn with DrawCursor() in the same frame buffer as the virtual scene.
   if (gvr_viewer_type_ == GVR_VIEWER_TYPE_CARDBOARD) {
     DrawReticle();
   }
-  frame.Unbind();
-
-  // Submit frame.
-  frame.Submit(*viewport_list_, head_view_);
-
-  CheckGLError("onDrawFrame");
-
-  // Update audio head rotation in audio API.
-  gvr_audio_api_->SetHeadPose(head_view_);
-  gvr_audio_api_->Update();
+  compositor_.EndLayer(reticle_layer_);
 }
 
 void TreasureHuntRenderer::PrepareFramebuffer() {
@@ -556,7 +848,7 @@ void TreasureHuntRenderer::PrepareFramebuffer() {
   if (render_size_.width != recommended_size.width ||
       render_size_.height != recommended_size.height) {
     // We need to resize the framebuffer.
-    swapchain_->ResizeBuffer(0, recommended_size);
+    compositor_.ResizeLayer(world_layer_, recommended_size);
     render_size_ = recommended_size;
   }
 }
@@ -570,6 +862,59 @@ void TreasureHuntRenderer::OnTriggerEvent() {
 }
 
 void TreasureHuntRenderer::OnPause() {
+  const FrameStats stats = frame_acquirer_.GetStats();
+  LOGD("Frames acquired: %llu, late: %llu, dropped: %llu, max wait: %llu ns",
+       static_cast<unsigned long long>(stats.frames_acquired),  // NOLINT
+       static_cast<unsigned long long>(stats.frames_late),      // NOLINT
+       static_cast<unsigned long long>(stats.frames_dropped),   // NOLINT
+       static_cast<unsigned long long>(stats.max_wait_nanos));  // NOLINT
+  LOGD("Swapchain GPU memory: %zu bytes live, %zu bytes peak",
+       gpu_memory_.GetTotalLiveBytes(), gpu_memory_.GetTotalPeakBytes());
+  const FrameLatencyStats latency = frame_limiter_.GetStats();
+  const uint64_t mean_lag_nanos =
+      latency.frames_completed
+          ? latency.total_lag_nanos / latency.frames_completed
+          : 0;
+  LOGD("CPU to GPU lag: mean %llu ns, max %llu ns; limited frames: %llu, "
+       "untracked: %llu",
+       static_cast<unsigned long long>(mean_lag_nanos),             // NOLINT
+       static_cast<unsigned long long>(latency.max_lag_nanos),      // NOLINT
+       static_cast<unsigned long long>(latency.frames_limited),     // NOLINT
+       static_cast<unsigned long long>(latency.frames_untracked));  // NOLINT
+  const FrameScheduleStats schedule = frame_scheduler_.GetStats();
+  const uint64_t mean_latency_nanos =
+      schedule.frames_scheduled
+          ? schedule.total_latency_nanos / schedule.frames_scheduled
+          : 0;
+  LOGD("Scheduled frames: %llu, missed deadlines: %llu, mean latency %llu ns",
+       static_cast<unsigned long long>(schedule.frames_scheduled),  // NOLINT
+       static_cast<unsigned long long>(schedule.deadlines_missed),  // NOLINT
+       static_cast<unsigned long long>(mean_latency_nanos));        // NOLINT
+  const PoseHistoryStats poses = pose_history_.GetStats();
+  LOGD("Pose samples: %llu; queries interpolated: %llu, clamped: %llu",
+       static_cast<unsigned long long>(poses.samples),               // NOLINT
+       static_cast<unsigned long long>(poses.queries_interpolated),  // NOLINT
+       static_cast<unsigned long long>(poses.queries_clamped));      // NOLINT
+  const VoiceStats voices = voice_manager_.GetStats();
+  LOGD("Voices spatial: %d, stereo: %d, virtual: %d; transitions: %llu",
+       voices.spatial_voices, voices.stereo_voices, voices.virtual_voices,
+       static_cast<unsigned long long>(voices.transitions));  // NOLINT
+  const LightClusterStats lights = light_clusters_.GetStats();
+  LOGD("Light binnings: %llu; lights visible: %llu, dropped: %llu; "
+       "cluster entries: %llu, overflows: %llu",
+       static_cast<unsigned long long>(lights.binnings),           // NOLINT
+       static_cast<unsigned long long>(lights.lights_visible),     // NOLINT
+       static_cast<unsigned long long>(lights.lights_dropped),     // NOLINT
+       static_cast<unsigned long long>(lights.cluster_entries),    // NOLINT
+       static_cast<unsigned long long>(lights.cluster_overflows));  // NOLINT
+  const AudioOcclusionStats occlusion = audio_occlusion_.GetStats();
+  LOGD("Occlusion ticks: %llu, skipped: %llu; rays: %llu in %llu us",
+       static_cast<unsigned long long>(occlusion.ticks),          // NOLINT
+       static_cast<unsigned long long>(occlusion.ticks_skipped),  // NOLINT
+       static_cast<unsigned long long>(occlusion.rays),           // NOLINT
+       static_cast<unsigned long long>(                           // NOLINT
+           occlusion.total_cast_nanos / 1000));
+  vsync_.Reset();
   gvr_api_->PauseTracking();
   gvr_audio_api_->Pause();
   if (gvr_controller_api_) gvr_controller_api_->Pause();
@@ -582,6 +927,15 @@ void TreasureHuntRenderer::OnResume() {
   ResumeControllerApiAsNeeded();
 }
 
+void TreasureHuntRenderer::OnVsync(uint64_t frame_time_nanos,
+                                   uint64_t period_nanos) {
+  vsync_.OnVsync(frame_time_nanos, period_nanos);
+}
+
+FrameStats TreasureHuntRenderer::GetFrameStats() const {
+  return frame_acquirer_.GetStats();
+}
+
 /**
  * Converts a raw text file, saved as a resource, into an OpenGL ES shader.
  *
@@ -621,10 +975,23 @@ void TreasureHuntRenderer::DrawWorld(const gvr::Mat4f& view_matrix,
              pixel_rect.right - pixel_rect.left,
              pixel_rect.top - pixel_rect.bottom);
 
+  // Keep the pixels that the lenses never show out of the depth test.
+  const gvr::Eye eye = viewport.GetTargetEye();
+  hidden_area_.Update(gvr_api_.get(), eye, viewport.GetSourceFov());
+  hidden_area_.Draw(eye);
+
   CheckGLError("World drawing setup");
 
   // Set the position of the light
   light_pos_eye_space_ = MatrixVectorMul(view_matrix, light_pos_world_space_);
+  if (clustered_lighting_enabled_) {
+    const gvr::Rectf fov = viewport.GetSourceFov();
+    light_clusters_.SetFrustum(fov.left, fov.right, fov.bottom, fov.top,
+                               kZNear, kZFar);
+    light_clusters_.Bin(point_lights_.data(), point_lights_.size(),
+                        view_matrix.m);
+    clustered_lighting_.Upload(light_clusters_);
+  }
   const gvr::Mat4f perspective =
       PerspectiveMatrixFromView(viewport.GetSourceFov(), kZNear, kZFar);
   modelview_ = MatrixMul(view_matrix, model_cube_);
@@ -650,6 +1017,9 @@ void TreasureHuntRenderer::DrawCube() {
   glUseProgram(cube_program_);
 
   glUniform3fv(cube_light_pos_param_, 1, light_pos_eye_space_.data());
+  if (clustered_lighting_enabled_) {
+    clustered_lighting_.Bind(cube_cluster_uniforms_);
+  }
 
   // Set the Model in the shader, used to calculate lighting
   glUniformMatrix4fv(cube_model_param_, 1, GL_FALSE,
@@ -663,27 +1033,27 @@ void TreasureHuntRenderer::DrawCube() {
 
   // Set the position of the cube
   glVertexAttribPointer(cube_position_param_, kCoordsPerVertex, GL_FLOAT, false,
-                        0, cube_vertices_);
+                        sizeof(LitVertex), kCubeMesh.vertices[0].position);
   glEnableVertexAttribArray(cube_position_param_);
 
   // Set the normal positions of the cube, again for shading
-  glVertexAttribPointer(cube_normal_param_, 3, GL_FLOAT, false, 0,
-                        cube_normals_);
+  glVertexAttribPointer(cube_normal_param_, 3, GL_FLOAT, false,
+                        sizeof(LitVertex), kCubeMesh.vertices[0].normal);
   glEnableVertexAttribArray(cube_normal_param_);
 
   // Set vertex colors
   if (ObjectIsFound()) {
-    const float* found_color = world_layout_data_.cube_found_color.data();
-    glVertexAttrib4f(cube_color_param_, found_color[0], found_color[1],
-                     found_color[2], 1.0f);
+    glVertexAttrib4f(cube_color_param_, kCubeFoundColor[0], kCubeFoundColor[1],
+                     kCubeFoundColor[2], 1.0f);
     glDisableVertexAttribArray(cube_color_param_);
   } else {
-    glVertexAttribPointer(cube_color_param_, 3, GL_FLOAT, false, 0,
-                          cube_colors_);
+    glVertexAttribPointer(cube_color_param_, 3, GL_FLOAT, false,
+                          sizeof(LitVertex), kCubeMesh.vertices[0].color);
     glEnableVertexAttribArray(cube_color_param_);
   }
 
-  glDrawArrays(GL_TRIANGLES, 0, 36);
+  glDrawElements(GL_TRIANGLES, kCubeMesh.kIndexCount, GL_UNSIGNED_SHORT,
+                 kCubeMesh.indices);
 
   glDisableVertexAttribArray(cube_position_param_);
   glDisableVertexAttribArray(cube_normal_param_);
@@ -695,8 +1065,20 @@ void TreasureHuntRenderer::DrawCube() {
 void TreasureHuntRenderer::DrawFloor() {
   glUseProgram(floor_program_);
 
-  // Set ModelView, MVP, position, normals, and color.
-  glUniform3fv(floor_light_pos_param_, 1, light_pos_eye_space_.data());
+  // Set the textures, ModelView, MVP and position.
+  glActiveTexture(GL_TEXTURE0 + kLightmapTextureUnit);
+  glBindTexture(GL_TEXTURE_2D, floor_lightmap_);
+  glUniform1i(floor_lightmap_param_, kLightmapTextureUnit);
+  glActiveTexture(GL_TEXTURE0 + kGridTextureUnit);
+  glBindTexture(GL_TEXTURE_2D, floor_grid_texture_);
+  glUniform1i(floor_grid_texture_param_, kGridTextureUnit);
+  glActiveTexture(GL_TEXTURE0);
+  const float lightmap_scale = 0.5f / kFloorHalfExtent;
+  glUniform4f(floor_lightmap_transform_param_, lightmap_scale, lightmap_scale,
+              0.5f, 0.5f);
+  if (clustered_lighting_enabled_) {
+    clustered_lighting_.Bind(floor_cluster_uniforms_);
+  }
   glUniformMatrix4fv(floor_model_param_, 1, GL_FALSE,
                      MatrixToGLArray(model_floor_).data());
   glUniformMatrix4fv(floor_modelview_param_, 1, GL_FALSE,
@@ -704,25 +1086,105 @@ void TreasureHuntRenderer::DrawFloor() {
   glUniformMatrix4fv(floor_modelview_projection_param_, 1, GL_FALSE,
                      MatrixToGLArray(modelview_projection_floor_).data());
   glVertexAttribPointer(floor_position_param_, kCoordsPerVertex, GL_FLOAT,
-                        false, 0, floor_vertices_);
-  glVertexAttrib3f(floor_normal_param_, 0.0f, 1.0f, 0.0f);
-  glVertexAttrib4f(floor_color_param_, 0.0f, 0.3398f, 0.9023f, 1.0f);
+                        false, sizeof(PositionVertex),
+                        kFloorMesh.vertices[0].position);
 
   glEnableVertexAttribArray(floor_position_param_);
-  glDrawArrays(GL_TRIANGLES, 0, 24);
+  glDrawElements(GL_TRIANGLES, kFloorMesh.kIndexCount, GL_UNSIGNED_SHORT,
+                 kFloorMesh.indices);
   glDisableVertexAttribArray(floor_position_param_);
 
   CheckGLError("Drawing floor");
 }
 
+void TreasureHuntRenderer::BakeFloorLighting() {
+  // The textures of a previous context are gone; only the accounting is
+  // left.
+  if (floor_lightmap_ != 0) {
+    gpu_memory_.DeleteTexture(floor_lightmap_);
+    gpu_memory_.DeleteTexture(floor_grid_texture_);
+  }
+
+  // The lightmap covers the floor from (-x, -z) to (x, z), with rows along z,
+  // so that u_LightmapTransform maps world x and z to s and t.
+  const BakeSurface floor = {
+      {-kFloorHalfExtent, -kFloorDepth, -kFloorHalfExtent},
+      {2.0f * kFloorHalfExtent, 0.0f, 0.0f},
+      {0.0f, 0.0f, 2.0f * kFloorHalfExtent},
+      {0.0f, 1.0f, 0.0f},
+      {kFloorColor[0], kFloorColor[1], kFloorColor[2]},
+  };
+  const LightBakeStats before = light_baker_.GetStats();
+  const std::vector<uint8_t> lightmap = light_baker_.BakeLightmap(
+      floor, kFloorLightmapSize, kFloorLightmapSize);
+  const LightBakeStats after = light_baker_.GetStats();
+  if (after.cache_hits > before.cache_hits) {
+    LOGD("Floor lightmap loaded from the cache");
+  } else {
+    LOGD("Floor lightmap baked in %.1f ms",
+         (after.bake_nanos - before.bake_nanos) * 1e-6);
+  }
+
+  floor_lightmap_ =
+      gpu_memory_.CreateTexture2D(GL_RGBA, GL_UNSIGNED_BYTE, kFloorLightmapSize,
+                                  kFloorLightmapSize, lightmap.data());
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  const std::vector<uint8_t> grid = MakeGridTexels();
+  floor_grid_texture_ =
+      gpu_memory_.CreateTexture2D(GL_ALPHA, GL_UNSIGNED_BYTE, kGridTextureSize,
+                                  kGridTextureSize, grid.data());
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+  CheckGLError("Floor textures");
+}
+
+void TreasureHuntRenderer::UpdatePointLights(uint64_t time_nanos) {
+  // Spread the lights out on a sunflower pattern, each ring turning at the
+  // same angular speed, alternately one way and the other.
+  const float turn = static_cast<float>(
+      std::fmod(kPointLightSpeed * (time_nanos * 1e-9), 2.0 * M_PI));
+  const float golden_angle = 2.39996323f;
+  for (int i = 0; i < kPointLightCount; ++i) {
+    PointLight& light = point_lights_[i];
+    const float distance =
+        kPointLightSpread * std::sqrt((i + 0.5f) / kPointLightCount);
+    const float direction = i % 2 == 0 ? 1.0f : -1.0f;
+    const float angle = i * golden_angle + direction * turn;
+    light.position[0] = distance * std::cos(angle);
+    light.position[1] = -kFloorDepth + kPointLightHeight;
+    light.position[2] = distance * std::sin(angle);
+    light.radius = kPointLightRadius;
+    // Fully saturated hues around the color wheel.
+    const float hue = 6.0f * i / kPointLightCount;
+    for (int c = 0; c < 3; ++c) {
+      const float h = std::fmod(hue + 6.0f - 2.0f * c, 6.0f);
+      light.color[c] =
+          std::min(std::max(std::fabs(h - 3.0f) - 1.0f, 0.0f), 1.0f);
+    }
+  }
+}
+
 void TreasureHuntRenderer::DrawCursor() {
   glUseProgram(reticle_program_);
   glUniformMatrix4fv(reticle_modelview_projection_param_, 1, GL_FALSE,
                      MatrixToGLArray(modelview_projection_cursor_).data());
   glVertexAttribPointer(reticle_position_param_, kCoordsPerVertex, GL_FLOAT,
-                        false, 0, reticle_vertices_);
+                        false, sizeof(PositionVertex),
+                        kReticleMesh.vertices[0].position);
   glEnableVertexAttribArray(reticle_position_param_);
-  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glDrawElements(GL_TRIANGLES, kReticleMesh.kIndexCount, GL_UNSIGNED_SHORT,
+                 kReticleMesh.indices);
   glDisableVertexAttribArray(reticle_position_param_);
   CheckGLError("Drawing cursor");
 }
@@ -737,9 +1199,11 @@ void TreasureHuntRenderer::DrawReticle() {
   glUniformMatrix4fv(reticle_modelview_projection_param_, 1, GL_FALSE,
                      MatrixToGLArray(uniform_matrix).data());
   glVertexAttribPointer(reticle_position_param_, kCoordsPerVertex, GL_FLOAT,
-                        false, 0, reticle_vertices_);
+                        false, sizeof(PositionVertex),
+                        kReticleMesh.vertices[0].position);
   glEnableVertexAttribArray(reticle_position_param_);
-  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glDrawElements(GL_TRIANGLES, kReticleMesh.kIndexCount, GL_UNSIGNED_SHORT,
+                 kReticleMesh.indices);
   glDisableVertexAttribArray(reticle_position_param_);
 
   CheckGLError("Drawing reticle");
@@ -777,10 +1241,10 @@ void TreasureHuntRenderer::HideObject() {
   model_cube_.m[1][3] = cube_position[1];
   model_cube_.m[2][3] = cube_position[2];
 
-  if (audio_source_id_ >= 0) {
-    gvr_audio_api_->SetSoundObjectPosition(audio_source_id_, cube_position[0],
-                                           cube_position[1], cube_position[2]);
-  }
+  voice_manager_.SetVoicePosition(cube_voice_, cube_position[0],
+                                  cube_position[1], cube_position[2]);
+  audio_occlusion_.SetSourcePosition(cube_occlusion_, cube_position[0],
+                                     cube_position[1], cube_position[2]);
 }
 
 bool TreasureHuntRenderer::ObjectIsFound() {
@@ -800,8 +1264,22 @@ bool TreasureHuntRenderer::ObjectIsFound() {
   }
 }
 
+bool TreasureHuntRenderer::GetDisplayedHeadView(gvr::Mat4f* head_view) const {
+  // The history holds the poses of the frames at their display times, so the
+  // pose on display now is interpolated between two of them.
+  return pose_history_.GetHeadPose(
+      gvr::GvrApi::GetTimePointNow().monotonic_system_time_nanos, head_view);
+}
+
 bool TreasureHuntRenderer::IsLookingAtObject() {
-  const gvr::Mat4f modelview = MatrixMul(head_view_, model_cube_);
+  // Use the pose the user sees at the time of the trigger. This may run on
+  // the UI thread, so it must not call into the gvr_context.
+  gvr::Mat4f head_view;
+  if (!GetDisplayedHeadView(&head_view)) {
+    // Nothing has been rendered yet.
+    return false;
+  }
+  const gvr::Mat4f modelview = MatrixMul(head_view, model_cube_);
 
   const std::array<float, 4> temp_position =
       MatrixVectorMul(modelview, {0.f, 0.f, 0.f, 1.f});
@@ -813,8 +1291,12 @@ bool TreasureHuntRenderer::IsLookingAtObject() {
 }
 
 bool TreasureHuntRenderer::IsPointingAtObject() {
-  gvr::Mat4f modelview_cursor = MatrixMul(head_view_, model_cursor_);
-  gvr::Mat4f modelview_cube = MatrixMul(head_view_, model_cube_);
+  gvr::Mat4f head_view;
+  if (!GetDisplayedHeadView(&head_view)) {
+    return false;
+  }
+  gvr::Mat4f modelview_cursor = MatrixMul(head_view, model_cursor_);
+  gvr::Mat4f modelview_cube = MatrixMul(head_view, model_cube_);
 
   const std::array<float, 4> center_cursor_position =
       MatrixVectorMul(modelview_cursor, {0.f, 0.f, 0.f, 1.f});
@@ -832,12 +1314,14 @@ void TreasureHuntRenderer::LoadAndPlayCubeSound() {
   // Preload sound files.
   gvr_audio_api_->PreloadSoundfile(kObjectSoundFile);
   gvr_audio_api_->PreloadSoundfile(kSuccessSoundFile);
-  // Create sound file handler from preloaded sound file.
-  audio_source_id_ = gvr_audio_api_->CreateSoundObject(kObjectSoundFile);
-  // Set sound object to current cube position.
-  gvr_audio_api_->SetSoundObjectPosition(audio_source_id_, model_cube_.m[0][3],
-                                         model_cube_.m[1][3],
-                                         model_cube_.m[2][3]);
-  // Trigger sound object playback.
-  gvr_audio_api_->PlaySound(audio_source_id_, true /* looped playback */);
+  // Start a looping voice at the current cube position. The voice manager
+  // creates its sound object, or stereo sound, on the next frame.
+  VoiceParams params;
+  params.filename = kObjectSoundFile;
+  params.volume = 1.0f;
+  params.looping = true;
+  params.min_distance = kCubeSoundMinDistance;
+  cube_voice_ = voice_manager_.AddVoice(
+      params, model_cube_.m[0][3], model_cube_.m[1][3], model_cube_.m[2][3],
+      gvr::GvrApi::GetTimePointNow().monotonic_system_time_nanos);
 }
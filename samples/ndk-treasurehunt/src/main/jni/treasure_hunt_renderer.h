@@ -18,16 +18,32 @@
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
-#include <jni.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
 #include <vector>
 
+#include "audio_occlusion.h"  // NOLINT
+#include "choreographer_vsync.h"  // NOLINT
+#include "clustered_lighting.h"  // NOLINT
+#include "egl_fence.h"  // NOLINT
+#include "frame_acquirer.h"  // NOLINT
+#include "frame_graph.h"  // NOLINT
+#include "frame_limiter.h"  // NOLINT
+#include "frame_scheduler.h"  // NOLINT
+#include "gpu_memory_tracker.h"  // NOLINT
+#include "gvr_voice_backend.h"  // NOLINT
+#include "hidden_area_mesh.h"  // NOLINT
+#include "layer_compositor.h"  // NOLINT
+#include "light_baker.h"  // NOLINT
+#include "light_clusters.h"  // NOLINT
+#include "pose_history.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
 #include "vr/gvr/capi/include/gvr_audio.h"
 #include "vr/gvr/capi/include/gvr_controller.h"
+#include "voice_manager.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr_types.h"
 #include "world_layout_data.h"  // NOLINT
 
@@ -38,9 +54,11 @@ class TreasureHuntRenderer {
    *
    * @param gvr_api The (non-owned) gvr_context.
    * @param gvr_audio_api The (owned) gvr::AudioApi context.
+   * @param cache_directory Where to cache baked lighting between launches.
    */
   TreasureHuntRenderer(gvr_context* gvr_context,
-                       std::unique_ptr<gvr::AudioApi> gvr_audio_api);
+                       std::unique_ptr<gvr::AudioApi> gvr_audio_api,
+                       const std::string& cache_directory);
 
   /**
    * Destructor.
@@ -73,14 +91,39 @@ class TreasureHuntRenderer {
    */
   void OnResume();
 
+  /**
+   * Record a display vsync at |frame_time_nanos|, as reported by a
+   * Choreographer frame callback. This should be called on the UI thread.
+   */
+  void OnVsync(uint64_t frame_time_nanos, uint64_t period_nanos);
+
+  /**
+   * Returns the frame acquisition counters (acquired, late and dropped
+   * frames). This may be called from any thread.
+   */
+  FrameStats GetFrameStats() const;
+
  private:
+  // Times the picking functions on the host, see tools/perf_suite.cc.
+  friend class TreasureHuntRendererPeer;
+
   int CreateTexture(int width, int height, int textureFormat, int textureType);
 
   /*
-   * Prepares the GvrApi framebuffer for rendering, resizing if needed.
+   * Resizes the world layer if its recommended size changed. The frame that
+   * is already acquired keeps its size, so this is called after submitting.
    */
   void PrepareFramebuffer();
 
+  /**
+   * Update the audio listener, and the cube voice, for the current time.
+   * Called once per frame, including frames that are dropped.
+   *
+   * @param cast_occlusion_rays Whether to update the occlusion of the cube
+   *     voice, or keep the last one.
+   */
+  void UpdateAudio(bool cast_occlusion_rays);
+
   /**
    * Converts a raw text file, saved as a resource, into an OpenGL ES shader.
    *
@@ -99,6 +142,17 @@ class TreasureHuntRenderer {
   void DrawWorld(const gvr::Mat4f& view_matrix,
                  const gvr::BufferViewport& viewport);
 
+  /**
+   * Renders the world layer for both eyes into |frame|. Run by the frame
+   * graph.
+   */
+  void DrawWorldLayer(gvr::Frame* frame);
+
+  /**
+   * Renders the reticle layer into |frame|. Run by the frame graph.
+   */
+  void DrawReticleLayer(gvr::Frame* frame);
+
   /**
    * Draws the reticle. The reticle is positioned using viewport parameters,
    * so no data about its eye-space position is needed here.
@@ -116,12 +170,17 @@ class TreasureHuntRenderer {
   /**
    * Draw the floor.
    *
-   * This feeds in data for the floor into the shader. Note that this doesn't
-   * feed in data about position of the light, so if we rewrite our code to
-   * draw the floor first, the lighting might look strange.
+   * The floor and the light never move, so the floor is drawn unlit, with
+   * its lighting baked into a lightmap by BakeFloorLighting().
    */
   void DrawFloor();
 
+  /**
+   * Bake the lighting of the floor, or load it from the cache, and create
+   * the textures of the floor.
+   */
+  void BakeFloorLighting();
+
   /**
    * Draws the cursor.
    *
@@ -130,6 +189,12 @@ class TreasureHuntRenderer {
    */
   void DrawCursor();
 
+  /**
+   * Move the point lights that circle over the floor to where they are at
+   * |time_nanos|.
+   */
+  void UpdatePointLights(uint64_t time_nanos);
+
   /**
    * Find a new random position for the object.
    *
@@ -154,6 +219,12 @@ class TreasureHuntRenderer {
    */
   bool IsPointingAtObject();
 
+  /**
+   * Get the head pose shown on the display now, from |pose_history_|.
+   * Returns false before the first frame.
+   */
+  bool GetDisplayedHeadView(gvr::Mat4f* head_view) const;
+
   /**
    * Check if the object has been found. If the viewer is CARDBOARD, it checks
    * whether the user is looking at the object. If the viewer is DAYDREAM, it
@@ -191,20 +262,65 @@ class TreasureHuntRenderer {
 
   std::unique_ptr<gvr::GvrApi> gvr_api_;
   std::unique_ptr<gvr::AudioApi> gvr_audio_api_;
+
+  // Renders only the most audible voices binaurally, to bound the cost of
+  // spatial audio.
+  GvrVoiceBackend voice_backend_;
+  VoiceManager voice_manager_;
+
+  // Turns the voices down as the scene comes between them and the listener.
+  OcclusionBvh occlusion_bvh_;
+  AudioOcclusion audio_occlusion_;
+
   std::unique_ptr<gvr::BufferViewportList> viewport_list_;
-  std::unique_ptr<gvr::SwapChain> swapchain_;
   gvr::BufferViewport scratch_viewport_;
 
-  std::vector<float> lightpos_;
+  // Acquires frames from the swap chain and counts dropped and late frames.
+  FrameAcquirer frame_acquirer_;
 
-  WorldLayoutData world_layout_data_;
+  // Keeps the CPU from running more than kMaxFramesInFlight frames ahead of
+  // the GPU.
+  FrameLimiter frame_limiter_;
+  EglFence fence_;
 
-  const float* floor_vertices_;
-  const float* cube_vertices_;
-  const float* cube_colors_;
-  const float* cube_found_colors_;
-  const float* cube_normals_;
-  const float* reticle_vertices_;
+  // Delays the start of each frame so that it completes just before a vsync.
+  FrameScheduler frame_scheduler_;
+  ChoreographerVsync vsync_;
+
+  // The head pose of each frame at its display time, recorded by the render
+  // thread for audio, and for picking on the UI thread at the time of the
+  // trigger.
+  PoseHistory pose_history_;
+
+  // Accounts for the GPU memory used by the swapchain buffers.
+  GpuMemoryTracker gpu_memory_;
+
+  // Owns the swap chain, with one buffer per layer.
+  LayerCompositor compositor_;
+  int world_layer_;
+  int reticle_layer_;
+
+  // The passes of a frame.
+  FrameGraph frame_graph_;
+
+  // Masks the parts of the eye buffers that the lenses never show.
+  HiddenAreaMesh hidden_area_;
+
+  // Point lights over the floor, shaded per fragment by clustered forward
+  // lighting where the GPU supports it.
+  ClusteredLighting clustered_lighting_;
+  LightClusters light_clusters_;
+  std::vector<PointLight> point_lights_;
+  bool clustered_lighting_enabled_;
+  ClusteredLighting::Uniforms cube_cluster_uniforms_;
+  ClusteredLighting::Uniforms floor_cluster_uniforms_;
+
+  // Bakes the lighting of the static floor at load time.
+  LightBaker light_baker_;
+  GLuint floor_lightmap_;
+  GLuint floor_grid_texture_;
+
+  std::vector<float> lightpos_;
 
   int cube_program_;
   int floor_program_;
@@ -219,12 +335,12 @@ class TreasureHuntRenderer {
   int cube_light_pos_param_;
 
   int floor_position_param_;
-  int floor_normal_param_;
-  int floor_color_param_;
   int floor_model_param_;
   int floor_modelview_param_;
   int floor_modelview_projection_param_;
-  int floor_light_pos_param_;
+  int floor_lightmap_param_;
+  int floor_lightmap_transform_param_;
+  int floor_grid_texture_param_;
 
   int reticle_position_param_;
   int reticle_modelview_projection_param_;
@@ -251,7 +367,10 @@ class TreasureHuntRenderer {
   float object_distance_;
   float reticle_distance_;
 
-  gvr::AudioSourceId audio_source_id_;
+  // Set on the audio initialization and GL threads, and read on the render
+  // and UI threads.
+  std::atomic<VoiceManager::VoiceId> cube_voice_;
+  std::atomic<AudioOcclusion::SourceId> cube_occlusion_;
 
   gvr::AudioSourceId success_source_id_;
 
@@ -0,0 +1,274 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "voice_manager.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Duration of the crossfade when a voice changes tier.
+static const uint64_t kFadeNanos = 100000000;
+
+// Voices started less than this long ago rank higher, so that new sounds are
+// heard in full even when they are quieter than older ones. The boost decays
+// linearly to nothing over the window.
+static const uint64_t kRecencyWindowNanos = 1000000000;
+static const float kRecencyBoost = 1.0f;
+
+// Ranking bonus of the voices that are already rendered binaurally.
+static const float kSpatialHysteresis = 1.25f;
+
+// Voices quieter than this are virtualized whatever the budget.
+static const float kInaudibleGain = 0.001f;
+}  // anonymous namespace
+
+const VoiceBackend::SourceId VoiceBackend::kInvalidSource;
+const VoiceManager::VoiceId VoiceManager::kInvalidVoice;
+
+VoiceManager::VoiceManager(VoiceBackend* backend, int max_spatial,
+                           int max_stereo)
+    : backend_(backend),
+      max_spatial_(max_spatial),
+      max_stereo_(max_stereo),
+      transitions_(0) {}
+
+VoiceManager::~VoiceManager() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Voice& voice : voices_) {
+    if (voice.active) StopSources(&voice);
+  }
+}
+
+VoiceManager::VoiceId VoiceManager::AddVoice(const VoiceParams& params,
+                                             float x, float y, float z,
+                                             uint64_t now_nanos) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Voice voice;
+  voice.params = params;
+  voice.position[0] = x;
+  voice.position[1] = y;
+  voice.position[2] = z;
+  voice.start_nanos = now_nanos;
+  voice.active = true;
+  voice.tier = VoiceTier::kVirtual;
+  voice.audibility = 0.0f;
+  voice.gain = 0.0f;
+  voice.source = VoiceBackend::kInvalidSource;
+  voice.fading_source = VoiceBackend::kInvalidSource;
+  voice.fading_gain = 0.0f;
+  voice.fade_start_nanos = now_nanos;
+
+  // Reuse the slot of a removed voice, so that ids stay small.
+  for (size_t i = 0; i < voices_.size(); ++i) {
+    if (!voices_[i].active) {
+      voices_[i] = voice;
+      return static_cast<VoiceId>(i);
+    }
+  }
+  voices_.push_back(voice);
+  return static_cast<VoiceId>(voices_.size() - 1);
+}
+
+void VoiceManager::RemoveVoice(VoiceId voice) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (voice < 0 || voice >= static_cast<VoiceId>(voices_.size()) ||
+      !voices_[voice].active) {
+    return;
+  }
+  StopSources(&voices_[voice]);
+  voices_[voice].active = false;
+}
+
+void VoiceManager::SetVoicePosition(VoiceId voice, float x, float y,
+                                    float z) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (voice < 0 || voice >= static_cast<VoiceId>(voices_.size())) return;
+  float* position = voices_[voice].position;
+  position[0] = x;
+  position[1] = y;
+  position[2] = z;
+}
+
+void VoiceManager::SetVoiceVolume(VoiceId voice, float volume) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (voice < 0 || voice >= static_cast<VoiceId>(voices_.size())) return;
+  voices_[voice].params.volume = volume;
+}
+
+void VoiceManager::Update(float x, float y, float z, uint64_t now_nanos) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  ranking_.clear();
+  for (size_t i = 0; i < voices_.size(); ++i) {
+    Voice& voice = voices_[i];
+    if (!voice.active) continue;
+    const float dx = voice.position[0] - x;
+    const float dy = voice.position[1] - y;
+    const float dz = voice.position[2] - z;
+    const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    float rolloff = 1.0f;
+    if (distance > voice.params.min_distance) {
+      rolloff = voice.params.min_distance / distance;
+    }
+    voice.gain = voice.params.volume * rolloff;
+
+    const uint64_t age_nanos =
+        now_nanos > voice.start_nanos ? now_nanos - voice.start_nanos : 0;
+    float recency = 0.0f;
+    if (age_nanos < kRecencyWindowNanos) {
+      recency = kRecencyBoost *
+                (1.0f - static_cast<float>(age_nanos) / kRecencyWindowNanos);
+    }
+    voice.audibility = voice.gain * (1.0f + recency);
+    if (voice.tier == VoiceTier::kSpatial) {
+      voice.audibility *= kSpatialHysteresis;
+    }
+    ranking_.push_back(static_cast<int>(i));
+  }
+
+  // Stable, so that voices of equal audibility keep their order and tier.
+  std::stable_sort(ranking_.begin(), ranking_.end(), [this](int a, int b) {
+    return voices_[a].audibility > voices_[b].audibility;
+  });
+
+  for (size_t rank = 0; rank < ranking_.size(); ++rank) {
+    Voice* voice = &voices_[ranking_[rank]];
+    const int index = static_cast<int>(rank);
+    VoiceTier tier = VoiceTier::kVirtual;
+    if (voice->gain < kInaudibleGain) {
+      tier = VoiceTier::kVirtual;
+    } else if (index < max_spatial_) {
+      tier = VoiceTier::kSpatial;
+    } else if (index < max_spatial_ + max_stereo_) {
+      tier = VoiceTier::kStereo;
+    }
+    if (tier != voice->tier) ChangeTier(voice, tier, now_nanos);
+    UpdateSources(voice, now_nanos);
+  }
+}
+
+VoiceTier VoiceManager::GetVoiceTier(VoiceId voice) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (voice < 0 || voice >= static_cast<VoiceId>(voices_.size()) ||
+      !voices_[voice].active) {
+    return VoiceTier::kVirtual;
+  }
+  return voices_[voice].tier;
+}
+
+VoiceStats VoiceManager::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  VoiceStats stats = {0, 0, 0, transitions_};
+  for (const Voice& voice : voices_) {
+    if (!voice.active) continue;
+    switch (voice.tier) {
+      case VoiceTier::kSpatial:
+        ++stats.spatial_voices;
+        break;
+      case VoiceTier::kStereo:
+        ++stats.stereo_voices;
+        break;
+      case VoiceTier::kVirtual:
+        ++stats.virtual_voices;
+        break;
+    }
+  }
+  return stats;
+}
+
+void VoiceManager::ChangeTier(Voice* voice, VoiceTier tier,
+                              uint64_t now_nanos) {
+  ++transitions_;
+
+  // A fade still in progress is cut short; the source fading out is by then
+  // quieter than the one that is about to start fading out.
+  if (voice->fading_source != VoiceBackend::kInvalidSource) {
+    backend_->Stop(voice->fading_source);
+  }
+
+  // The current source fades out from the volume it is playing at.
+  const float fade =
+      std::min(1.0f, static_cast<float>(now_nanos - voice->fade_start_nanos) /
+                         kFadeNanos);
+  voice->fading_source = voice->source;
+  voice->fading_gain = voice->tier == VoiceTier::kSpatial
+                           ? voice->params.volume * fade
+                           : voice->gain * fade;
+  voice->fade_start_nanos = now_nanos;
+  voice->tier = tier;
+  voice->source = VoiceBackend::kInvalidSource;
+
+  if (tier == VoiceTier::kVirtual) return;
+  voice->source = tier == VoiceTier::kSpatial
+                      ? backend_->CreateSpatialSource(voice->params.filename)
+                      : backend_->CreateStereoSource(voice->params.filename);
+  if (voice->source == VoiceBackend::kInvalidSource) return;
+  backend_->SetVolume(voice->source, 0.0f);
+  if (tier == VoiceTier::kSpatial) {
+    backend_->SetPosition(voice->source, voice->position[0],
+                          voice->position[1], voice->position[2]);
+  }
+  backend_->Play(voice->source, voice->params.looping);
+}
+
+void VoiceManager::UpdateSources(Voice* voice, uint64_t now_nanos) {
+  const float fade = std::min(
+      1.0f,
+      static_cast<float>(now_nanos - voice->fade_start_nanos) / kFadeNanos);
+
+  if (voice->fading_source != VoiceBackend::kInvalidSource) {
+    if (fade >= 1.0f) {
+      backend_->Stop(voice->fading_source);
+      voice->fading_source = VoiceBackend::kInvalidSource;
+    } else {
+      backend_->SetVolume(voice->fading_source,
+                          voice->fading_gain * (1.0f - fade));
+    }
+  }
+
+  if (voice->source != VoiceBackend::kInvalidSource) {
+    if (voice->tier == VoiceTier::kSpatial) {
+      // The audio engine applies the distance rolloff to sound objects.
+      backend_->SetVolume(voice->source, voice->params.volume * fade);
+      backend_->SetPosition(voice->source, voice->position[0],
+                            voice->position[1], voice->position[2]);
+    } else {
+      backend_->SetVolume(voice->source, voice->gain * fade);
+    }
+    if (!voice->params.looping && fade >= 1.0f &&
+        !backend_->IsPlaying(voice->source)) {
+      // A one-shot voice that has finished.
+      StopSources(voice);
+      voice->active = false;
+    }
+  } else if (!voice->params.looping &&
+             voice->fading_source == VoiceBackend::kInvalidSource) {
+    // A one-shot voice cannot resume where it left off, so once it is
+    // virtualized it is done.
+    voice->active = false;
+  }
+}
+
+void VoiceManager::StopSources(Voice* voice) {
+  if (voice->source != VoiceBackend::kInvalidSource) {
+    backend_->Stop(voice->source);
+    voice->source = VoiceBackend::kInvalidSource;
+  }
+  if (voice->fading_source != VoiceBackend::kInvalidSource) {
+    backend_->Stop(voice->fading_source);
+    voice->fading_source = VoiceBackend::kInvalidSource;
+  }
+}
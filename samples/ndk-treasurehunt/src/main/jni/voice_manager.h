@@ -0,0 +1,189 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_VOICEMANAGER_H_  // NOLINT
+#define TREASUREHUNT_APP_SRC_MAIN_JNI_VOICEMANAGER_H_  // NOLINT
+
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+/**
+ * Audio sources, as used by VoiceManager. Implemented with gvr::AudioApi on
+ * the device (see GvrVoiceBackend), and by a stub in
+ * tools/voice_manager_test.cc to check VoiceManager on a host.
+ */
+class VoiceBackend {
+ public:
+  typedef int32_t SourceId;
+  static const SourceId kInvalidSource = -1;
+
+  virtual ~VoiceBackend() {}
+
+  /**
+   * Create a binaurally rendered source, positioned in the world, playing
+   * |filename|. Returns kInvalidSource on failure.
+   */
+  virtual SourceId CreateSpatialSource(const std::string& filename) = 0;
+
+  /**
+   * Create a plain stereo source playing |filename|, which is much cheaper to
+   * render. Returns kInvalidSource on failure.
+   */
+  virtual SourceId CreateStereoSource(const std::string& filename) = 0;
+
+  virtual void Play(SourceId source, bool looping) = 0;
+
+  /**
+   * Stop |source| and release it.
+   */
+  virtual void Stop(SourceId source) = 0;
+
+  virtual bool IsPlaying(SourceId source) = 0;
+  virtual void SetVolume(SourceId source, float volume) = 0;
+  virtual void SetPosition(SourceId source, float x, float y, float z) = 0;
+};
+
+/**
+ * How a voice is currently rendered.
+ */
+enum class VoiceTier {
+  // A binaural sound object.
+  kSpatial,
+  // A stereo source, attenuated by distance but not spatialized.
+  kStereo,
+  // Not rendered; looping voices come back when they become audible enough.
+  kVirtual,
+};
+
+struct VoiceParams {
+  std::string filename;
+  float volume;
+  bool looping;
+  // Distance within which the voice is heard at full volume. Beyond it, the
+  // gain falls off inversely with distance.
+  float min_distance;
+};
+
+struct VoiceStats {
+  int spatial_voices;
+  int stereo_voices;
+  int virtual_voices;
+  uint64_t transitions;
+};
+
+/**
+ * Bounds the cost of spatial audio by rendering only the most audible voices
+ * binaurally. Each Update() ranks the voices by audibility (volume, distance
+ * attenuation and a boost for recently started voices), renders the top
+ * max_spatial binaurally and the next max_stereo as stereo sources, and
+ * virtualizes the rest.
+ *
+ * A voice that changes tier is crossfaded from its old source to a new one
+ * over kFadeNanos, so transitions do not click, and the voices that are
+ * already rendered binaurally get a small ranking bonus, so that voices of
+ * similar audibility do not keep swapping.
+ *
+ * All methods may be called from any thread.
+ */
+class VoiceManager {
+ public:
+  typedef int VoiceId;
+  static const VoiceId kInvalidVoice = -1;
+
+  /**
+   * Create a VoiceManager.
+   *
+   * @param backend The (non-owned) audio sources to use.
+   * @param max_spatial Largest number of voices rendered binaurally.
+   * @param max_stereo Largest number of voices rendered as stereo sources.
+   */
+  VoiceManager(VoiceBackend* backend, int max_spatial, int max_stereo);
+
+  /**
+   * Stop all voices.
+   */
+  ~VoiceManager();
+
+  /**
+   * Start a voice at the given position. It is rendered from the next
+   * Update().
+   */
+  VoiceId AddVoice(const VoiceParams& params, float x, float y, float z,
+                   uint64_t now_nanos);
+
+  /**
+   * Stop a voice immediately.
+   */
+  void RemoveVoice(VoiceId voice);
+
+  void SetVoicePosition(VoiceId voice, float x, float y, float z);
+
+  /**
+   * Change the volume of a voice, e.g. as it becomes occluded. Applied from
+   * the next Update().
+   */
+  void SetVoiceVolume(VoiceId voice, float volume);
+
+  /**
+   * Rank the voices for a listener at (x, y, z) and update their sources.
+   * Call once per audio tick, e.g. once per frame.
+   */
+  void Update(float x, float y, float z, uint64_t now_nanos);
+
+  /**
+   * Return the tier that |voice| is rendered in, or is fading into.
+   */
+  VoiceTier GetVoiceTier(VoiceId voice) const;
+
+  VoiceStats GetStats() const;
+
+ private:
+  struct Voice {
+    VoiceParams params;
+    float position[3];
+    uint64_t start_nanos;
+    bool active;
+    VoiceTier tier;
+    float audibility;
+    float gain;
+    VoiceBackend::SourceId source;
+    // The source of the previous tier, while it fades out.
+    VoiceBackend::SourceId fading_source;
+    float fading_gain;
+    uint64_t fade_start_nanos;
+  };
+
+  void ChangeTier(Voice* voice, VoiceTier tier, uint64_t now_nanos);
+  void UpdateSources(Voice* voice, uint64_t now_nanos);
+  void StopSources(Voice* voice);
+
+  VoiceBackend* const backend_;
+  const int max_spatial_;
+  const int max_stereo_;
+
+  mutable std::mutex mutex_;
+  std::vector<Voice> voices_;
+  // Scratch space for ranking, kept to avoid allocating every tick.
+  std::vector<int> ranking_;
+  uint64_t transitions_;
+
+  // Disallow copy and assign.
+  VoiceManager(const VoiceManager& other) = delete;
+  VoiceManager& operator=(const VoiceManager& other) = delete;
+};
+
+#endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_VOICEMANAGER_H_  // NOLINT
@@ -16,207 +16,225 @@
 #ifndef TREASUREHUNT_APP_SRC_MAIN_JNI_WORLDLAYOUTDATA_H_  // NOLINT
 #define TREASUREHUNT_APP_SRC_MAIN_JNI_WORLDLAYOUTDATA_H_  // NOLINT
 
-#include <array>
-
-// Contains vertex, normal and other data.
-class WorldLayoutData {
- public:
-  const std::array<float, 108> cube_coords;
-  const std::array<float, 108> cube_colors;
-  const std::array<float, 3> cube_found_color;
-  const std::array<float, 108> cube_normals;
-  const std::array<float, 72> floor_coords;
-  const std::array<float, 18> reticle_coords;
-
-  WorldLayoutData() :
-    cube_coords({{
-        // Front face
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-
-        // Right face
-        1.0f,  1.0f,  1.0f,
-        1.0f, -1.0f,  1.0f,
-        1.0f,  1.0f, -1.0f,
-        1.0f, -1.0f,  1.0f,
-        1.0f, -1.0f, -1.0f,
-        1.0f,  1.0f, -1.0f,
-
-        // Back face
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-
-        // Left face
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-
-        // Top face
-        -1.0f, 1.0f, -1.0f,
-        -1.0f, 1.0f,  1.0f,
-         1.0f, 1.0f, -1.0f,
-        -1.0f, 1.0f,  1.0f,
-         1.0f, 1.0f,  1.0f,
-         1.0f, 1.0f, -1.0f,
-
-        // Bottom face
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f}}),
-    cube_colors({{
-        // front, green
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-
-        // right, blue
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-
-        // back, also green
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-        0.0f, 0.5273f, 0.2656f,
-
-        // left, also blue
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-        0.0f, 0.3398f, 0.9023f,
-
-        // top, red
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-
-        // bottom, also red
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f,
-        0.8359375f, 0.17578125f, 0.125f}}),
-    cube_found_color({{ 1.0f, 0.6523f, 0.0f }}),  // yellow
-    cube_normals({{
-        // Front face
-        0.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 1.0f,
-
-        // Right face
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 0.0f,
-
-        // Back face
-        0.0f, 0.0f, -1.0f,
-        0.0f, 0.0f, -1.0f,
-        0.0f, 0.0f, -1.0f,
-        0.0f, 0.0f, -1.0f,
-        0.0f, 0.0f, -1.0f,
-        0.0f, 0.0f, -1.0f,
-
-        // Left face
-        -1.0f, 0.0f, 0.0f,
-        -1.0f, 0.0f, 0.0f,
-        -1.0f, 0.0f, 0.0f,
-        -1.0f, 0.0f, 0.0f,
-        -1.0f, 0.0f, 0.0f,
-        -1.0f, 0.0f, 0.0f,
-
-        // Top face
-        0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 0.0f,
-
-        // Bottom face
-        0.0f, -1.0f, 0.0f,
-        0.0f, -1.0f, 0.0f,
-        0.0f, -1.0f, 0.0f,
-        0.0f, -1.0f, 0.0f,
-        0.0f, -1.0f, 0.0f,
-        0.0f, -1.0f, 0.0f}}),
-    // The grid lines on the floor are rendered procedurally and large polygons
-    // cause floating point precision problems on some architectures. So we
-    // split the floor into 4 quadrants.
-    floor_coords({{
-        // +X, +Z quadrant
-        200.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 200.0f,
-        200.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 200.0f,
-        200.0f, 0.0f, 200.0f,
-
-        // -X, +Z quadrant
-        0.0f, 0.0f, 0.0f,
-        -200.0f, 0.0f, 0.0f,
-        -200.0f, 0.0f, 200.0f,
-        0.0f, 0.0f, 0.0f,
-        -200.0f, 0.0f, 200.0f,
-        0.0f, 0.0f, 200.0f,
-
-        // +X, -Z quadrant
-        200.0f, 0.0f, -200.0f,
-        0.0f, 0.0f, -200.0f,
-        0.0f, 0.0f, 0.0f,
-        200.0f, 0.0f, -200.0f,
-        0.0f, 0.0f, 0.0f,
-        200.0f, 0.0f, 0.0f,
-
-        // -X, -Z quadrant
-        0.0f, 0.0f, -200.0f,
-        -200.0f, 0.0f, -200.0f,
-        -200.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, -200.0f,
-        -200.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f,
-      }}),
-    reticle_coords({{
-        -1.f, 1.f, 0.0f,
-        -1.f, -1.f, 0.0f,
-        1.f, 1.f, 0.0f,
-        -1.f, -1.f, 0.0f,
-        1.f, -1.f, 0.0f,
-        1.f, 1.f, 0.0f,
-      }}) {}
+#include <stddef.h>
+#include <stdint.h>
+
+// Indexed meshes for the world. All meshes are constexpr, so they live in
+// read-only memory and are never copied at startup. Vertices are shared
+// between the triangles of a face, and their attributes are interleaved so
+// that a single pointer and stride describe each mesh.
+
+/**
+ * A vertex with a position, a normal and a color.
+ */
+struct LitVertex {
+  float position[3];
+  float normal[3];
+  float color[3];
+};
+
+/**
+ * A vertex with only a position.
+ */
+struct PositionVertex {
+  float position[3];
+};
+
+/**
+ * An indexed triangle list with |kVertices| vertices and |kIndices| indices.
+ */
+template <typename Vertex, size_t kVertices, size_t kIndices>
+struct IndexedMesh {
+  static constexpr size_t kVertexCount = kVertices;
+  static constexpr size_t kIndexCount = kIndices;
+  static_assert(kVertices <= 65536, "Indices must fit in 16 bits.");
+
+  Vertex vertices[kVertices];
+  uint16_t indices[kIndices];
+};
+
+template <typename Vertex, size_t kVertices, size_t kIndices>
+constexpr size_t IndexedMesh<Vertex, kVertices, kIndices>::kVertexCount;
+template <typename Vertex, size_t kVertices, size_t kIndices>
+constexpr size_t IndexedMesh<Vertex, kVertices, kIndices>::kIndexCount;
+
+/**
+ * A flat grid of |kCells| x |kCells| quads in the XZ plane.
+ */
+template <size_t kCells>
+using GridMesh = IndexedMesh<PositionVertex, (kCells + 1) * (kCells + 1),
+                             kCells * kCells * 6>;
+
+namespace mesh_internal {
+
+// Minimal compile-time integer sequence, as std::index_sequence is C++14.
+template <size_t... I>
+struct IndexSequence {};
+
+template <size_t N, size_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MakeIndexSequence<0, I...> {
+  typedef IndexSequence<I...> type;
 };
+
+// Returns vertex |i| of a grid of |cells| x |cells| quads spanning
+// [-half_extent, half_extent] along X and Z. Vertices are laid out row by
+// row along +Z, with X increasing within a row.
+constexpr PositionVertex GridVertex(size_t cells, float half_extent,
+                                    size_t i) {
+  return PositionVertex{
+      {-half_extent + 2.0f * half_extent * (i % (cells + 1)) / cells, 0.0f,
+       -half_extent + 2.0f * half_extent * (i / (cells + 1)) / cells}};
+}
+
+// Returns corner |corner| (0-3) of quad |quad|: (+X, -Z), (-X, -Z), (-X, +Z)
+// and (+X, +Z) in that order.
+constexpr uint16_t GridQuadCorner(size_t cells, size_t quad, size_t corner) {
+  return static_cast<uint16_t>(
+      (quad / cells + (corner >= 2 ? 1 : 0)) * (cells + 1) + quad % cells +
+      (corner == 1 || corner == 2 ? 0 : 1));
+}
+
+// Returns index |i| of a grid; each quad is split into two triangles facing
+// +Y.
+constexpr uint16_t GridIndex(size_t cells, size_t i) {
+  return GridQuadCorner(cells, i / 6,
+                        i % 6 == 0 || i % 6 == 3 ? 0 :
+                        i % 6 == 1 ? 1 :
+                        i % 6 == 5 ? 3 : 2);
+}
+
+template <size_t kCells, size_t... V, size_t... I>
+constexpr GridMesh<kCells> MakeGrid(float half_extent, IndexSequence<V...>,
+                                    IndexSequence<I...>) {
+  return GridMesh<kCells>{{GridVertex(kCells, half_extent, V)...},
+                          {GridIndex(kCells, I)...}};
+}
+
+}  // namespace mesh_internal
+
+/**
+ * Generates at compile time a grid of |kCells| x |kCells| quads in the XZ
+ * plane, centered at the origin and spanning [-half_extent, half_extent].
+ * A grid with a single cell is a plane.
+ */
+template <size_t kCells>
+constexpr GridMesh<kCells> MakeGrid(float half_extent) {
+  return mesh_internal::MakeGrid<kCells>(
+      half_extent,
+      typename mesh_internal::MakeIndexSequence<
+          GridMesh<kCells>::kVertexCount>::type(),
+      typename mesh_internal::MakeIndexSequence<
+          GridMesh<kCells>::kIndexCount>::type());
+}
+
+/**
+ * The cube: 4 vertices per face, so that each face has its own normal and
+ * color.
+ */
+constexpr IndexedMesh<LitVertex, 24, 36> kCubeMesh = {
+    {
+        // Front face, green
+        {{-1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.5273f, 0.2656f}},
+        {{-1.0f, -1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.5273f, 0.2656f}},
+        {{1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.5273f, 0.2656f}},
+        {{1.0f, -1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.5273f, 0.2656f}},
+
+        // Right face, blue
+        {{1.0f, 1.0f, 1.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+        {{1.0f, -1.0f, 1.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+        {{1.0f, 1.0f, -1.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+        {{1.0f, -1.0f, -1.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+
+        // Back face, also green
+        {{1.0f, 1.0f, -1.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.5273f, 0.2656f}},
+        {{1.0f, -1.0f, -1.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.5273f, 0.2656f}},
+        {{-1.0f, 1.0f, -1.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.5273f, 0.2656f}},
+        {{-1.0f, -1.0f, -1.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.5273f, 0.2656f}},
+
+        // Left face, also blue
+        {{-1.0f, 1.0f, -1.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+        {{-1.0f, -1.0f, -1.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+        {{-1.0f, 1.0f, 1.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+        {{-1.0f, -1.0f, 1.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 0.3398f, 0.9023f}},
+
+        // Top face, red
+        {{-1.0f, 1.0f, -1.0f}, {0.0f, 1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+        {{-1.0f, 1.0f, 1.0f}, {0.0f, 1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+        {{1.0f, 1.0f, -1.0f}, {0.0f, 1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+        {{1.0f, 1.0f, 1.0f}, {0.0f, 1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+
+        // Bottom face, also red
+        {{1.0f, -1.0f, -1.0f}, {0.0f, -1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+        {{1.0f, -1.0f, 1.0f}, {0.0f, -1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+        {{-1.0f, -1.0f, -1.0f}, {0.0f, -1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+        {{-1.0f, -1.0f, 1.0f}, {0.0f, -1.0f, 0.0f},
+         {0.8359375f, 0.17578125f, 0.125f}},
+    },
+    {
+        0, 1, 2, 1, 3, 2,        // Front
+        4, 5, 6, 5, 7, 6,        // Right
+        8, 9, 10, 9, 11, 10,     // Back
+        12, 13, 14, 13, 15, 14,  // Left
+        16, 17, 18, 17, 19, 18,  // Top
+        20, 21, 22, 21, 23, 22,  // Bottom
+    },
+};
+
+/**
+ * Color of the cube once it has been found: yellow.
+ */
+constexpr float kCubeFoundColor[3] = {1.0f, 0.6523f, 0.0f};
+
+/**
+ * The grid lines on the floor repeat every few meters, and large polygons
+ * cause floating point precision problems on some architectures. So we
+ * split the floor into 4 quadrants.
+ */
+constexpr float kFloorHalfExtent = 200.0f;
+constexpr GridMesh<2> kFloorMesh = MakeGrid<2>(kFloorHalfExtent);
+
+/**
+ * The floor lies this far below the origin, and has this color.
+ */
+constexpr float kFloorDepth = 20.0f;
+constexpr float kFloorColor[3] = {0.0f, 0.3398f, 0.9023f};
+
+/**
+ * The light of the scene, in world space, and the shading of its vertex
+ * lighting, which the baked lighting of the floor must match: the diffuse
+ * term is at least kLightMinDiffuse, and the light is divided by
+ * 1 + kLightAttenuation * distance^2.
+ */
+constexpr float kLightPosition[3] = {0.0f, 2.0f, 0.0f};
+constexpr float kLightMinDiffuse = 0.5f;
+constexpr float kLightAttenuation = 0.00001f;
+
+/**
+ * Size of the baked lightmap of the floor, in texels along each side.
+ */
+constexpr int kFloorLightmapSize = 256;
+
+/**
+ * The reticle: a unit quad in the XY plane, facing +Z.
+ */
+constexpr IndexedMesh<PositionVertex, 4, 6> kReticleMesh = {
+    {
+        {{-1.0f, 1.0f, 0.0f}},
+        {{-1.0f, -1.0f, 0.0f}},
+        {{1.0f, 1.0f, 0.0f}},
+        {{1.0f, -1.0f, 0.0f}},
+    },
+    {0, 1, 2, 1, 3, 2},
+};
+
 #endif  // TREASUREHUNT_APP_SRC_MAIN_JNI_WORLDLAYOUTDATA_H_  // NOLINT
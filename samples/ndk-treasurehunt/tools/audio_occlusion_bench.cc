@@ -0,0 +1,247 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side benchmark of the audio occlusion in src/main/jni/audio_occlusion.h.
+//
+// The tool builds a room full of random boxes, places thousands of sources
+// in it, and ticks AudioOcclusion with the listener in the middle, waiting
+// for each batch to finish. For each number of sources and of worker
+// threads it reports the time to cast the rays of one source, summed over
+// the workers, and the wall time of a whole batch, to compare with the
+// audio tick. It also checks that:
+//
+//  * the hierarchy agrees with a brute force test of every triangle;
+//  * a source behind a wall converges to fully occluded, and one in the
+//    open to not occluded at all.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -pthread -I$JNI -o audio_occlusion_bench
+//       audio_occlusion_bench.cc $JNI/audio_occlusion.cc
+//   ./audio_occlusion_bench [boxes]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>  // NOLINT
+#include <random>
+#include <vector>
+
+#include "audio_occlusion.h"  // NOLINT
+
+namespace {
+const int kSourceCounts[] = {1000, 4000, 16000};
+const int kWorkerCounts[] = {1, 2, 4};
+const int kTicks = 20;
+
+// Half the width of the room, in meters.
+const float kRoomSize = 20.0f;
+
+// 60 Hz audio ticks.
+const uint64_t kTickNanos = 16666667;
+
+const float kBoxVertices[8][3] = {
+    {-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1},
+    {-1, -1, 1},  {1, -1, 1},  {1, 1, 1},  {-1, 1, 1},
+};
+const uint16_t kBoxIndices[36] = {
+    0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+    3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2,
+};
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// A box scaled by |size| and moved to |center|, both as a mesh for the
+// hierarchy and as plain triangles for the brute force test.
+void AddBox(const float center[3], const float size[3], OcclusionBvh* bvh,
+            std::vector<float>* triangles) {
+  float transform[4][4] = {};
+  for (int axis = 0; axis < 3; ++axis) {
+    transform[axis][axis] = size[axis];
+    transform[axis][3] = center[axis];
+  }
+  transform[3][3] = 1.0f;
+  bvh->AddMesh(&kBoxVertices[0][0], sizeof(kBoxVertices[0]), kBoxIndices,
+               36, transform);
+  for (int i = 0; i < 36; ++i) {
+    for (int axis = 0; axis < 3; ++axis) {
+      triangles->push_back(center[axis] +
+                           size[axis] * kBoxVertices[kBoxIndices[i]][axis]);
+    }
+  }
+}
+
+bool SegmentHitsTriangle(const float from[3], const float to[3],
+                         const float* v) {
+  float d[3], e1[3], e2[3], s[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    d[axis] = to[axis] - from[axis];
+    e1[axis] = v[3 + axis] - v[axis];
+    e2[axis] = v[6 + axis] - v[axis];
+    s[axis] = from[axis] - v[axis];
+  }
+  const float p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2],
+                      d[0] * e2[1] - d[1] * e2[0]};
+  const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+  if (fabsf(det) < 1e-12f) return false;
+  const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+  if (u < 0.0f || u > 1.0f) return false;
+  const float q[3] = {s[1] * e1[2] - s[2] * e1[1],
+                      s[2] * e1[0] - s[0] * e1[2],
+                      s[0] * e1[1] - s[1] * e1[0]};
+  const float v2 = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+  if (v2 < 0.0f || u + v2 > 1.0f) return false;
+  const float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+  return t > 1e-4f && t < 1.0f - 1e-4f;
+}
+
+bool Check(bool condition, const char* what) {
+  printf("%s: %s\n", condition ? "PASS" : "FAIL", what);
+  return condition;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int boxes = argc > 1 ? atoi(argv[1]) : 200;
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> coordinate(-kRoomSize, kRoomSize);
+  std::uniform_real_distribution<float> extent(0.2f, 1.5f);
+
+  OcclusionBvh bvh;
+  std::vector<float> triangles;
+  const float floor_center[3] = {0.0f, -2.0f, 0.0f};
+  const float floor_size[3] = {kRoomSize, 0.1f, kRoomSize};
+  AddBox(floor_center, floor_size, &bvh, &triangles);
+  for (int i = 0; i < boxes; ++i) {
+    float center[3] = {coordinate(random), coordinate(random) * 0.1f,
+                       coordinate(random)};
+    // Keep the listener, at the origin, in the open.
+    if (fabsf(center[0]) < 3.0f && fabsf(center[2]) < 3.0f) center[0] += 6.0f;
+    const float size[3] = {extent(random), extent(random), extent(random)};
+    AddBox(center, size, &bvh, &triangles);
+  }
+  double start = NowSeconds();
+  bvh.Build();
+  printf("%zu triangles, built in %.2f ms\n", bvh.GetTriangleCount(),
+         1e3 * (NowSeconds() - start));
+
+  bool ok = true;
+  {
+    int mismatches = 0, hits = 0;
+    const int segments = 20000;
+    for (int i = 0; i < segments; ++i) {
+      const float from[3] = {coordinate(random), coordinate(random) * 0.1f,
+                             coordinate(random)};
+      const float to[3] = {coordinate(random), coordinate(random) * 0.1f,
+                           coordinate(random)};
+      bool brute_force = false;
+      for (size_t t = 0; t < triangles.size() && !brute_force; t += 9) {
+        brute_force = SegmentHitsTriangle(from, to, &triangles[t]);
+      }
+      hits += brute_force;
+      if (bvh.IsOccluded(from, to) != brute_force) ++mismatches;
+    }
+    printf("%d of %d segments occluded, %d mismatches\n", hits, segments,
+           mismatches);
+    // Allow for a few rays grazing an edge, where rounding may differ.
+    ok &= Check(mismatches <= segments / 1000,
+                "hierarchy agrees with brute force");
+  }
+
+  {
+    OcclusionBvh wall_bvh;
+    std::vector<float> unused;
+    const float wall_center[3] = {0.0f, 0.0f, -5.0f};
+    const float wall_size[3] = {3.0f, 3.0f, 0.1f};
+    AddBox(wall_center, wall_size, &wall_bvh, &unused);
+    wall_bvh.Build();
+    AudioOcclusion occlusion(&wall_bvh, 1);
+    const AudioOcclusion::SourceId hidden = occlusion.AddSource(0, 0, -10);
+    const AudioOcclusion::SourceId open = occlusion.AddSource(0, 0, 10);
+    uint64_t now_nanos = kTickNanos;
+    for (int tick = 0; tick < 60; ++tick) {
+      occlusion.Update(0, 0, 0, now_nanos);
+      occlusion.Flush();
+      now_nanos += kTickNanos;
+    }
+    const float after_one_tick = 1.0f - expf(-1e-8f * kTickNanos);
+    printf("hidden %.3f, open %.3f, volume %.2f, low pass %.0f Hz\n",
+           occlusion.GetOcclusion(hidden), occlusion.GetOcclusion(open),
+           occlusion.GetParams(hidden).volume,
+           occlusion.GetParams(hidden).lowpass_hz);
+    ok &= Check(occlusion.GetOcclusion(hidden) > 0.99f,
+                "source behind a wall is occluded");
+    ok &= Check(occlusion.GetOcclusion(open) == 0.0f,
+                "source in the open is not occluded");
+    // The first result is smoothed in, rather than jumping.
+    AudioOcclusion fresh(&wall_bvh, 1);
+    const AudioOcclusion::SourceId late = fresh.AddSource(0, 0, -10);
+    fresh.Update(0, 0, 0, kTickNanos);
+    fresh.Flush();
+    fresh.Update(0, 0, 0, 2 * kTickNanos);
+    ok &= Check(fabsf(fresh.GetOcclusion(late) - after_one_tick) < 1e-3f,
+                "occlusion is smoothed over time");
+  }
+
+  printf("\n%8s %8s %14s %14s %12s %10s\n", "sources", "workers",
+         "us/source", "Mrays/s/core", "batch ms", "occluded");
+  for (int source_count : kSourceCounts) {
+    std::vector<float> positions;
+    for (int i = 0; i < source_count; ++i) {
+      positions.push_back(coordinate(random));
+      positions.push_back(coordinate(random) * 0.1f);
+      positions.push_back(coordinate(random));
+    }
+    for (int worker_count : kWorkerCounts) {
+      AudioOcclusion occlusion(&bvh, worker_count);
+      std::vector<AudioOcclusion::SourceId> sources;
+      for (int i = 0; i < source_count; ++i) {
+        sources.push_back(occlusion.AddSource(
+            positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]));
+      }
+      // The first tick starts a batch with nothing to harvest yet.
+      uint64_t now_nanos = kTickNanos;
+      occlusion.Update(0, 0, 0, now_nanos);
+      occlusion.Flush();
+      const AudioOcclusionStats before = occlusion.GetStats();
+      start = NowSeconds();
+      for (int tick = 0; tick < kTicks; ++tick) {
+        now_nanos += kTickNanos;
+        occlusion.Update(0, 0, 0, now_nanos);
+        occlusion.Flush();
+      }
+      const double batch_seconds = (NowSeconds() - start) / kTicks;
+      const AudioOcclusionStats after = occlusion.GetStats();
+      const double cast_seconds =
+          1e-9 * (after.total_cast_nanos - before.total_cast_nanos);
+      const double rays = static_cast<double>(after.rays - before.rays);
+      int occluded = 0;
+      for (AudioOcclusion::SourceId source : sources) {
+        occluded += occlusion.GetOcclusion(source) > 0.5f;
+      }
+      printf("%8d %8d %14.3f %14.2f %12.2f %9.0f%%\n", source_count,
+             worker_count, 1e6 * cast_seconds / (kTicks * source_count),
+             1e-6 * rays / cast_seconds, 1e3 * batch_seconds,
+             100.0 * occluded / source_count);
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side tool for the light baker in src/main/jni/light_baker.h.
+//
+// Given a directory, the tool bakes the lightmap of the TreasureHunt floor
+// into it, from the same constants as the app and under the same cache key,
+// so that the app finds it there instead of baking on the first launch.
+//
+// It then benchmarks the baker on a busier scene, a floor lit by many lights
+// and shadowed by random boxes, with each number of worker threads,
+// reporting the bake time, the texels baked per second and the speedup over
+// one worker. It also checks that:
+//
+//  * every number of workers bakes the same texels;
+//  * a second bake loads the lightmap from the cache, unchanged;
+//  * moving a light changes the cache key.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -pthread -I$JNI -o bake_lighting
+//       bake_lighting.cc $JNI/light_baker.cc $JNI/audio_occlusion.cc
+//   ./bake_lighting [cache_directory]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "audio_occlusion.h"    // NOLINT
+#include "light_baker.h"        // NOLINT
+#include "world_layout_data.h"  // NOLINT
+
+namespace {
+const int kWorkerCounts[] = {1, 2, 4, 8};
+
+const int kBenchLightmapSize = 512;
+const int kBenchLights = 16;
+const int kBenchBoxes = 100;
+
+// Half the width of the benchmark floor, in meters.
+const float kBenchFloorSize = 20.0f;
+
+const float kBoxVertices[8][3] = {
+    {-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1},
+    {-1, -1, 1},  {1, -1, 1},  {1, 1, 1},  {-1, 1, 1},
+};
+const uint16_t kBoxIndices[36] = {
+    0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+    3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2,
+};
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Bakes the floor of TreasureHunt as the renderer does.
+bool BakeFloor(const std::string& cache_directory) {
+  LightBaker baker(cache_directory, 0);
+  const BakeLight light = {
+      {kLightPosition[0], kLightPosition[1], kLightPosition[2]},
+      {1.0f, 1.0f, 1.0f},
+      kLightMinDiffuse,
+      kLightAttenuation,
+  };
+  baker.AddLight(light);
+  const BakeSurface floor = {
+      {-kFloorHalfExtent, -kFloorDepth, -kFloorHalfExtent},
+      {2.0f * kFloorHalfExtent, 0.0f, 0.0f},
+      {0.0f, 0.0f, 2.0f * kFloorHalfExtent},
+      {0.0f, 1.0f, 0.0f},
+      {kFloorColor[0], kFloorColor[1], kFloorColor[2]},
+  };
+  const std::vector<uint8_t> lightmap =
+      baker.BakeLightmap(floor, kFloorLightmapSize, kFloorLightmapSize);
+  const LightBakeStats stats = baker.GetStats();
+  printf("floor lightmap %016llx: %s in %.1f ms\n",
+         static_cast<unsigned long long>(  // NOLINT
+             baker.GetCacheKey(floor, kFloorLightmapSize, kFloorLightmapSize)),
+         stats.cache_hits > 0 ? "already cached" : "baked",
+         stats.bake_nanos * 1e-6);
+  return !lightmap.empty();
+}
+
+// Adds a box scaled by |size| and moved to |center| to |bvh|.
+void AddBox(const float center[3], const float size[3], OcclusionBvh* bvh) {
+  float transform[4][4] = {};
+  for (int axis = 0; axis < 3; ++axis) {
+    transform[axis][axis] = size[axis];
+    transform[axis][3] = center[axis];
+  }
+  transform[3][3] = 1.0f;
+  bvh->AddMesh(&kBoxVertices[0][0], sizeof(kBoxVertices[0]), kBoxIndices,
+               36, transform);
+}
+
+// Returns a fresh directory for the cache check.
+std::string MakeTempDirectory() {
+  char path[] = "/tmp/bake_lighting.XXXXXX";
+  return mkdtemp(path) != nullptr ? path : "";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool ok = true;
+  if (argc > 1) ok &= BakeFloor(argv[1]);
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  std::vector<BakeLight> lights(kBenchLights);
+  for (BakeLight& light : lights) {
+    light.position[0] = kBenchFloorSize * (2.0f * unit(random) - 1.0f);
+    light.position[1] = 3.0f + 3.0f * unit(random);
+    light.position[2] = kBenchFloorSize * (2.0f * unit(random) - 1.0f);
+    for (int c = 0; c < 3; ++c) light.color[c] = 0.2f * unit(random);
+    light.min_diffuse = 0.0f;
+    light.attenuation = 0.05f;
+  }
+  OcclusionBvh occluders;
+  for (int i = 0; i < kBenchBoxes; ++i) {
+    const float size[3] = {0.3f + unit(random), 0.5f + 2.0f * unit(random),
+                           0.3f + unit(random)};
+    const float center[3] = {kBenchFloorSize * (2.0f * unit(random) - 1.0f),
+                             size[1],
+                             kBenchFloorSize * (2.0f * unit(random) - 1.0f)};
+    AddBox(center, size, &occluders);
+  }
+  occluders.Build();
+  const BakeSurface floor = {
+      {-kBenchFloorSize, 0.0f, -kBenchFloorSize},
+      {2.0f * kBenchFloorSize, 0.0f, 0.0f},
+      {0.0f, 0.0f, 2.0f * kBenchFloorSize},
+      {0.0f, 1.0f, 0.0f},
+      {0.8f, 0.8f, 0.8f},
+  };
+
+  printf("%d lights, %zu occluding triangles, %dx%d texels, %u cores\n",
+         kBenchLights, occluders.GetTriangleCount(), kBenchLightmapSize,
+         kBenchLightmapSize, std::thread::hardware_concurrency());
+  printf("%8s %10s %14s %10s\n", "workers", "ms", "Mtexels/s", "speedup");
+  std::vector<uint8_t> reference;
+  double reference_seconds = 0.0;
+  for (int worker_count : kWorkerCounts) {
+    LightBaker baker("", worker_count);
+    for (const BakeLight& light : lights) baker.AddLight(light);
+    baker.SetOccluders(&occluders);
+    const double start = NowSeconds();
+    const std::vector<uint8_t> texels =
+        baker.BakeLightmap(floor, kBenchLightmapSize, kBenchLightmapSize);
+    const double seconds = NowSeconds() - start;
+    if (reference.empty()) {
+      reference = texels;
+      reference_seconds = seconds;
+    }
+    ok &= texels == reference;
+    printf("%8d %10.1f %14.2f %10.2f\n", worker_count, 1e3 * seconds,
+           1e-6 * kBenchLightmapSize * kBenchLightmapSize / seconds,
+           reference_seconds / seconds);
+  }
+  printf("%s: every number of workers bakes the same texels\n",
+         ok ? "PASS" : "FAIL");
+
+  // The second bake must come from the cache, and moving a light must
+  // change the key.
+  const std::string directory = MakeTempDirectory();
+  LightBaker cached(directory, 0);
+  for (const BakeLight& light : lights) cached.AddLight(light);
+  cached.SetOccluders(&occluders);
+  const std::vector<uint8_t> first =
+      cached.BakeLightmap(floor, kBenchLightmapSize, kBenchLightmapSize);
+  const std::vector<uint8_t> second =
+      cached.BakeLightmap(floor, kBenchLightmapSize, kBenchLightmapSize);
+  const LightBakeStats stats = cached.GetStats();
+  const bool cache_ok = !directory.empty() && stats.bakes == 1 &&
+                        stats.cache_hits == 1 && first == reference &&
+                        second == reference;
+  printf("%s: the cache returns the baked lightmap\n",
+         cache_ok ? "PASS" : "FAIL");
+
+  LightBaker moved("", 0);
+  lights[0].position[0] += 0.01f;
+  for (const BakeLight& light : lights) moved.AddLight(light);
+  moved.SetOccluders(&occluders);
+  const bool key_ok =
+      moved.GetCacheKey(floor, kBenchLightmapSize, kBenchLightmapSize) !=
+      cached.GetCacheKey(floor, kBenchLightmapSize, kBenchLightmapSize);
+  printf("%s: moving a light changes the cache key\n",
+         key_ok ? "PASS" : "FAIL");
+
+  if (!directory.empty()) {
+    const std::string command = "rm -r " + directory;
+    if (system(command.c_str()) != 0) ok = false;
+  }
+  return ok && cache_ok && key_ok ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side checks of the frame graph in src/main/jni/frame_graph.h, run
+// against the recording GL stub in gl_stub.h.
+//
+// The tool builds small graphs by hand and many random ones, and checks
+// that:
+//
+//  * exactly the passes that contribute to an output are kept;
+//  * every pass runs after the passes that write what it reads, passes that
+//    write the same resource run in declaration order, and Execute() runs
+//    them in the scheduled order;
+//  * transient targets only share GL objects when they are compatible and
+//    their lifetimes do not overlap, and a chain of passes ping-pongs
+//    between two targets;
+//  * InitializeGl() creates one texture and framebuffer per shared target,
+//    and a depth renderbuffer only where one is needed.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -I../../../libraries/headers
+//       -o frame_graph_test frame_graph_test.cc gl_stub.cc
+//       $JNI/frame_graph.cc $JNI/gpu_memory_tracker.cc
+//   ./frame_graph_test [graphs]
+
+#include <GLES2/gl2.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frame_graph.h"         // NOLINT
+#include "gl_stub.h"             // NOLINT
+#include "gpu_memory_tracker.h"  // NOLINT
+
+namespace {
+const RenderTargetDesc kColor = {{256, 256}, GL_RGBA, GL_UNSIGNED_BYTE,
+                                 false};
+const RenderTargetDesc kColorDepth = {{256, 256}, GL_RGBA, GL_UNSIGNED_BYTE,
+                                      true};
+const RenderTargetDesc kSmallColor = {{64, 64}, GL_RGBA, GL_UNSIGNED_BYTE,
+                                      false};
+
+bool ok = true;
+
+void Check(bool condition, const std::string& what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what.c_str());
+    ok = false;
+  }
+}
+
+// Records the passes that Execute() runs.
+FrameGraph::PassFunction Record(std::vector<int>* executed, int pass) {
+  return [executed, pass](gvr::Frame* /* frame */,
+                          const FrameGraph& /* graph */) {
+    executed->push_back(pass);
+  };
+}
+
+void CheckCulling() {
+  GpuMemoryTracker gpu_memory;
+  FrameGraph graph(&gpu_memory);
+  std::vector<int> executed;
+  const int shadow = graph.CreateRenderTarget("shadow", kColorDepth);
+  const int unused = graph.CreateRenderTarget("unused", kColor);
+  const int debug = graph.CreateRenderTarget("debug", kColor);
+  const int eyes = graph.AddOutput("eyes");
+  graph.AddPass("shadow", {}, {shadow}, Record(&executed, 0));
+  graph.AddPass("unused", {shadow}, {unused}, Record(&executed, 1));
+  graph.AddPass("debug source", {}, {debug}, Record(&executed, 2));
+  graph.AddPass("debug", {debug}, {unused}, Record(&executed, 3));
+  graph.AddPass("world", {shadow}, {eyes}, Record(&executed, 4));
+  graph.Compile();
+  Check(graph.GetSchedule() == std::vector<int>({0, 4}),
+        "culling keeps only the passes that reach an output");
+  Check(graph.GetPhysicalTarget(unused) < 0 &&
+            graph.GetPhysicalTarget(debug) < 0 &&
+            graph.GetPhysicalTarget(shadow) == 0 &&
+            graph.GetPhysicalTargetCount() == 1,
+        "culling allocates only the targets of the passes kept");
+  graph.Execute(nullptr);
+  Check(executed == graph.GetSchedule(), "Execute() runs the schedule");
+}
+
+void CheckOrder() {
+  GpuMemoryTracker gpu_memory;
+  FrameGraph graph(&gpu_memory);
+  std::vector<int> executed;
+  const int blur = graph.CreateRenderTarget("blur", kColor);
+  const int scene = graph.CreateRenderTarget("scene", kColor);
+  const int eyes = graph.AddOutput("eyes");
+  // Declared in reverse: composite reads blur, which reads scene.
+  graph.AddPass("composite", {blur}, {eyes}, Record(&executed, 0));
+  graph.AddPass("blur", {scene}, {blur}, Record(&executed, 1));
+  graph.AddPass("scene", {}, {scene}, Record(&executed, 2));
+  // Two more writers of the output, which keep their declaration order.
+  graph.AddPass("overlay", {}, {eyes}, Record(&executed, 3));
+  graph.AddPass("cursor", {}, {eyes}, Record(&executed, 4));
+  graph.Compile();
+  Check(graph.GetSchedule() == std::vector<int>({2, 1, 0, 3, 4}),
+        "passes run after their inputs, writers in declaration order");
+  graph.Execute(nullptr);
+  Check(executed == graph.GetSchedule(),
+        "Execute() runs the passes in the scheduled order");
+}
+
+void CheckAliasing() {
+  GpuMemoryTracker gpu_memory;
+  FrameGraph graph(&gpu_memory);
+  // A chain of post-processing passes only needs two targets.
+  const int kChain = 6;
+  std::vector<int> targets;
+  for (int i = 0; i < kChain; ++i) {
+    targets.push_back(
+        graph.CreateRenderTarget("step " + std::to_string(i), kColor));
+  }
+  const int small = graph.CreateRenderTarget("small", kSmallColor);
+  const int eyes = graph.AddOutput("eyes");
+  graph.AddPass("step 0", {}, {targets[0]}, nullptr);
+  for (int i = 1; i < kChain; ++i) {
+    graph.AddPass("step " + std::to_string(i), {targets[i - 1]},
+                  {targets[i]}, nullptr);
+  }
+  graph.AddPass("small", {targets[kChain - 1]}, {small}, nullptr);
+  graph.AddPass("final", {small}, {eyes}, nullptr);
+  graph.Compile();
+  Check(graph.GetPhysicalTargetCount() == 3,
+        "a chain ping-pongs between two targets, plus an incompatible one");
+  for (int i = 0; i < kChain; ++i) {
+    Check(graph.GetPhysicalTarget(targets[i]) == i % 2,
+          "step " + std::to_string(i) + " uses target " +
+              std::to_string(i % 2));
+  }
+  Check(graph.GetPhysicalTarget(small) == 2,
+        "an incompatible target is not shared");
+
+  // One texture and framebuffer per shared target, no depth.
+  GlStubReset("OpenGL ES 3.0", "");
+  graph.InitializeGl();
+  Check(GlStubCount("glGenTextures") == 3 &&
+            GlStubCount("glGenFramebuffers") == 3 &&
+            GlStubCount("glGenRenderbuffers") == 0,
+        "InitializeGl() creates one texture and framebuffer per target");
+  Check(graph.GetFramebuffer(targets[0]) == graph.GetFramebuffer(targets[2]) &&
+            graph.GetTexture(targets[1]) == graph.GetTexture(targets[5]) &&
+            graph.GetTexture(targets[0]) != graph.GetTexture(targets[1]),
+        "aliased targets share their GL objects");
+  const size_t expected_bytes = 2 * 256 * 256 * 4 + 64 * 64 * 4;
+  Check(gpu_memory.GetLiveBytes(GpuMemoryTracker::kCategoryTexture) ==
+            expected_bytes,
+        "the tracker accounts for the shared targets only");
+}
+
+void CheckDepth() {
+  GpuMemoryTracker gpu_memory;
+  FrameGraph graph(&gpu_memory);
+  const int color = graph.CreateRenderTarget("color", kColor);
+  const int depth = graph.CreateRenderTarget("depth", kColorDepth);
+  const int eyes = graph.AddOutput("eyes");
+  graph.AddPass("a", {}, {color}, nullptr);
+  graph.AddPass("b", {color}, {depth}, nullptr);
+  graph.AddPass("c", {depth}, {eyes}, nullptr);
+  graph.Compile();
+  GlStubReset("OpenGL ES 3.0", "");
+  graph.InitializeGl();
+  char text[96];
+  snprintf(text, sizeof(text), "glFramebufferRenderbuffer(%#x, %#x",
+           GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT);
+  Check(graph.GetPhysicalTargetCount() == 2 &&
+            GlStubCount("glGenRenderbuffers") == 1 && GlStubCount(text) == 1,
+        "only targets with depth get a depth renderbuffer");
+}
+
+// Builds a random graph, and checks its schedule and aliasing against the
+// declared reads and writes.
+void CheckRandomGraph(std::mt19937* random, int index) {
+  const RenderTargetDesc kDescs[] = {kColor, kColorDepth, kSmallColor};
+  std::uniform_int_distribution<int> resource_count_distribution(2, 12);
+  std::uniform_int_distribution<int> pass_count_distribution(1, 16);
+  const int resource_count = resource_count_distribution(*random);
+  const int pass_count = pass_count_distribution(*random);
+
+  GpuMemoryTracker gpu_memory;
+  FrameGraph graph(&gpu_memory);
+  std::vector<bool> is_output(resource_count);
+  std::vector<int> desc_of(resource_count, -1);
+  for (int resource = 0; resource < resource_count; ++resource) {
+    is_output[resource] = (*random)() % 4 == 0;
+    if (is_output[resource]) {
+      graph.AddOutput("output");
+    } else {
+      desc_of[resource] = (*random)() % 3;
+      graph.CreateRenderTarget("target", kDescs[desc_of[resource]]);
+    }
+  }
+  // Passes read resources that earlier passes wrote, and a resource is not
+  // written again once it has been read, so that there are no cycles and
+  // every reader is declared after every writer of what it reads.
+  std::vector<std::vector<int>> reads(pass_count), writes(pass_count);
+  std::vector<std::vector<int>> writers(resource_count);
+  std::vector<bool> was_read(resource_count, false);
+  for (int pass = 0; pass < pass_count; ++pass) {
+    for (int resource = 0; resource < resource_count; ++resource) {
+      if (!writers[resource].empty() && (*random)() % 4 == 0) {
+        reads[pass].push_back(resource);
+        was_read[resource] = true;
+      } else if (!was_read[resource] && (*random)() % 4 == 0) {
+        writes[pass].push_back(resource);
+        writers[resource].push_back(pass);
+      }
+    }
+    graph.AddPass("pass", reads[pass], writes[pass], nullptr);
+  }
+  graph.Compile();
+
+  // Brute force: a pass is live if it writes an output or something that a
+  // live pass reads.
+  std::vector<bool> live(pass_count, false);
+  for (int pass = pass_count - 1; pass >= 0; --pass) {
+    for (int resource : writes[pass]) {
+      if (is_output[resource]) live[pass] = true;
+      for (int reader = pass + 1; reader < pass_count; ++reader) {
+        for (int read : reads[reader]) {
+          if (read == resource && live[reader]) live[pass] = true;
+        }
+      }
+    }
+  }
+  const std::vector<int>& schedule = graph.GetSchedule();
+  std::vector<int> position(pass_count, -1);
+  for (size_t i = 0; i < schedule.size(); ++i) position[schedule[i]] = i;
+  const std::string name = "random graph " + std::to_string(index);
+  for (int pass = 0; pass < pass_count; ++pass) {
+    if (live[pass] != (position[pass] >= 0)) {
+      Check(false, name + ": pass " + std::to_string(pass) +
+                       (live[pass] ? " is culled" : " is not culled"));
+    }
+  }
+  for (int resource = 0; resource < resource_count; ++resource) {
+    for (size_t i = 0; i < writers[resource].size(); ++i) {
+      const int writer = writers[resource][i];
+      if (position[writer] < 0) continue;
+      if (i > 0 && position[writers[resource][i - 1]] >= 0 &&
+          position[writers[resource][i - 1]] > position[writer]) {
+        Check(false, name + ": writers out of declaration order");
+      }
+      for (int reader = 0; reader < pass_count; ++reader) {
+        for (int read : reads[reader]) {
+          if (read == resource && position[reader] >= 0 &&
+              position[reader] < position[writer]) {
+            Check(false, name + ": a pass runs before its input is written");
+          }
+        }
+      }
+    }
+  }
+
+  // Lifetimes, in positions in the schedule, of the transient targets.
+  std::vector<int> first_use(resource_count, -1);
+  std::vector<int> last_use(resource_count, -1);
+  for (size_t i = 0; i < schedule.size(); ++i) {
+    for (const std::vector<int>* list : {&reads[schedule[i]],
+                                         &writes[schedule[i]]}) {
+      for (int resource : *list) {
+        if (first_use[resource] < 0) first_use[resource] = i;
+        last_use[resource] = i;
+      }
+    }
+  }
+  for (int a = 0; a < resource_count; ++a) {
+    if (is_output[a]) continue;
+    const int physical = graph.GetPhysicalTarget(a);
+    if ((physical >= 0) != (first_use[a] >= 0)) {
+      Check(false, name + ": a used target has no storage, or the reverse");
+    }
+    for (int b = a + 1; b < resource_count; ++b) {
+      if (is_output[b] || physical < 0 ||
+          graph.GetPhysicalTarget(b) != physical) {
+        continue;
+      }
+      if (desc_of[a] != desc_of[b]) {
+        Check(false, name + ": incompatible targets are aliased");
+      }
+      if (first_use[a] <= last_use[b] && first_use[b] <= last_use[a]) {
+        Check(false, name + ": targets that are alive together are aliased");
+      }
+    }
+  }
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int graphs = argc > 1 ? atoi(argv[1]) : 10000;
+  CheckCulling();
+  CheckOrder();
+  CheckAliasing();
+  CheckDepth();
+  std::mt19937 random(1);
+  const bool was_ok = ok;
+  for (int i = 0; i < graphs && ok == was_ok; ++i) {
+    CheckRandomGraph(&random, i);
+  }
+  printf("%d random graphs checked\n", graphs);
+
+  if (ok) printf("PASS: culling, order and aliasing\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side checks of the frame limiter in src/main/jni/frame_limiter.h,
+// with a stub fence backed by a simulated GPU and a simulated clock.
+//
+// The simulated GPU runs the frames one after the other, each for a fixed
+// time from when it is submitted or the previous one finishes, whichever is
+// later. Waiting on a fence advances the clock up to the time the fence is
+// signaled or the timeout, and the CPU spends a fixed time on each frame.
+// For each policy and limit, with the GPU slower and faster than the CPU,
+// the tool runs a few hundred frames and checks that:
+//
+//  * BeginFrame() only returns true when fewer than the limit are in
+//    flight, and no more frames than the limit are ever in flight unless
+//    the wait budget is shorter than a frame of GPU time;
+//  * the limiter never tracks more frames than the limit, even when the GPU
+//    falls further behind;
+//  * kPolicySkip never waits, and kPolicyWait never waits longer than its
+//    budget;
+//  * frames are only limited when the GPU is the bottleneck;
+//  * the lag of every frame is at least its GPU time, and no fence leaks;
+//  * frames are only left untracked when the wait budget runs out;
+//  * without fences, or when fences are not supported, nothing is limited.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -o frame_limiter_test frame_limiter_test.cc
+//       $JNI/frame_limiter.cc
+//   ./frame_limiter_test
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+
+#include "frame_limiter.h"  // NOLINT
+
+namespace {
+const uint64_t kMillis = 1000000;
+const int kFrames = 300;
+
+// A fence per submitted frame, signaled when the simulated GPU finishes it.
+class StubFence : public GpuFence {
+ public:
+  StubFence(uint64_t* now_nanos, uint64_t gpu_nanos, bool supported)
+      : now_nanos_(now_nanos),
+        gpu_nanos_(gpu_nanos),
+        supported_(supported),
+        gpu_idle_nanos_(0),
+        next_handle_(1),
+        max_queued_(0) {}
+
+  Handle Insert() override {
+    if (!supported_) return nullptr;
+    gpu_idle_nanos_ = std::max(gpu_idle_nanos_, *now_nanos_) + gpu_nanos_;
+    const uintptr_t handle = next_handle_++;
+    signal_nanos_[handle] = gpu_idle_nanos_;
+    // The GPU queue holds the frames it has not finished, whether or not
+    // their fences were deleted.
+    queue_.push_back(gpu_idle_nanos_);
+    while (queue_.front() <= *now_nanos_) queue_.pop_front();
+    max_queued_ = std::max(max_queued_, static_cast<int>(queue_.size()));
+    return reinterpret_cast<Handle>(handle);
+  }
+
+  bool Wait(Handle fence, uint64_t timeout_nanos) override {
+    const uint64_t signal_nanos =
+        signal_nanos_.at(reinterpret_cast<uintptr_t>(fence));
+    if (signal_nanos <= *now_nanos_) return true;
+    *now_nanos_ = std::min(signal_nanos, *now_nanos_ + timeout_nanos);
+    return signal_nanos <= *now_nanos_;
+  }
+
+  void Delete(Handle fence) override {
+    signal_nanos_.erase(reinterpret_cast<uintptr_t>(fence));
+  }
+
+  int GetLiveCount() const { return static_cast<int>(signal_nanos_.size()); }
+  int GetMaxQueuedCount() const { return max_queued_; }
+
+ private:
+  uint64_t* now_nanos_;
+  const uint64_t gpu_nanos_;
+  const bool supported_;
+  uint64_t gpu_idle_nanos_;
+  uintptr_t next_handle_;
+  std::map<uintptr_t, uint64_t> signal_nanos_;
+  std::deque<uint64_t> queue_;
+  int max_queued_;
+};
+
+struct Scenario {
+  const char* name;
+  int max_frames_in_flight;
+  FrameLimiter::Policy policy;
+  uint64_t wait_budget_nanos;
+  uint64_t cpu_nanos;
+  uint64_t gpu_nanos;
+  bool fences_supported;
+};
+
+bool ok = true;
+
+void Check(bool condition, const std::string& what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what.c_str());
+    ok = false;
+  }
+}
+
+void Run(const Scenario& scenario) {
+  uint64_t now_nanos = 0;
+  StubFence fence(&now_nanos, scenario.gpu_nanos, scenario.fences_supported);
+  FrameLimiter limiter(scenario.max_frames_in_flight, scenario.policy,
+                       scenario.wait_budget_nanos);
+  limiter.SetClock([&now_nanos]() { return now_nanos; });
+  limiter.SetFence(&fence);
+
+  const std::string name = scenario.name;
+  int begun = 0, ended = 0, over_limit = 0, max_tracked = 0;
+  uint64_t max_wait_nanos = 0;
+  for (int frame = 0; frame < kFrames; ++frame) {
+    const uint64_t start_nanos = now_nanos;
+    const bool under_limit = limiter.BeginFrame();
+    const uint64_t wait_nanos = now_nanos - start_nanos;
+    max_wait_nanos = std::max(max_wait_nanos, wait_nanos);
+    max_tracked = std::max(max_tracked, limiter.GetFramesInFlight());
+    // The in-flight count after BeginFrame() is what the GPU still has.
+    if (under_limit) {
+      ++begun;
+      if (limiter.GetFramesInFlight() >= scenario.max_frames_in_flight) {
+        ++over_limit;
+      }
+    }
+    if (scenario.policy == FrameLimiter::kPolicySkip) {
+      Check(wait_nanos == 0, name + ": kPolicySkip does not wait");
+    }
+    if (!under_limit && scenario.policy == FrameLimiter::kPolicySkip) {
+      // The caller skips the frame, and tries again a bit later.
+      now_nanos += scenario.cpu_nanos / 4;
+      continue;
+    }
+    // Under kPolicyWait, the frame is rendered even when the budget ran out.
+    now_nanos += scenario.cpu_nanos;
+    limiter.EndFrame();
+    max_tracked = std::max(max_tracked, limiter.GetFramesInFlight());
+    ++ended;
+  }
+
+  const FrameLatencyStats stats = limiter.GetStats();
+  const bool gpu_bound = scenario.fences_supported &&
+                         scenario.gpu_nanos > scenario.cpu_nanos;
+  printf("%-34s begun %3d, limited %3llu, max wait %5.2f ms, "
+         "mean lag %5.2f ms, max tracked %d, untracked %3llu, "
+         "max GPU queue %d\n",
+         scenario.name, begun,
+         static_cast<unsigned long long>(stats.frames_limited),
+         max_wait_nanos / 1e6,
+         stats.frames_completed
+             ? stats.total_lag_nanos / 1e6 / stats.frames_completed
+             : 0.0,
+         max_tracked, static_cast<unsigned long long>(stats.frames_untracked),
+         fence.GetMaxQueuedCount());
+
+  Check(over_limit == 0, name + ": frames only begin under the limit");
+  Check(max_wait_nanos <= scenario.wait_budget_nanos,
+        name + ": waits stay within the budget");
+  Check(stats.max_wait_nanos == (scenario.policy == FrameLimiter::kPolicySkip
+                                     ? 0
+                                     : max_wait_nanos),
+        name + ": reports the longest wait");
+  Check((stats.frames_limited > 0) == gpu_bound,
+        name + ": frames are limited only when the GPU is the bottleneck");
+  const bool budget_suffices =
+      scenario.policy == FrameLimiter::kPolicySkip ||
+      scenario.wait_budget_nanos >= scenario.gpu_nanos;
+  if (budget_suffices) {
+    Check(fence.GetMaxQueuedCount() <= scenario.max_frames_in_flight,
+          name + ": no more frames than the limit are ever in flight");
+  }
+  Check(max_tracked <= scenario.max_frames_in_flight,
+        name + ": no more frames than the limit are ever tracked");
+  Check((stats.frames_untracked > 0) == (gpu_bound && !budget_suffices),
+        name + ": frames are left untracked only when the budget runs out");
+  Check(stats.total_lag_nanos >= stats.frames_completed * scenario.gpu_nanos,
+        name + ": the lag of a frame includes its GPU time");
+  Check(static_cast<uint64_t>(fence.GetLiveCount()) +
+                stats.frames_completed + stats.frames_untracked ==
+            static_cast<uint64_t>(scenario.fences_supported ? ended : 0),
+        name + ": every fence is either in flight or deleted");
+  Check(fence.GetLiveCount() == limiter.GetFramesInFlight(),
+        name + ": the fences in flight are the frames tracked");
+
+  limiter.SetFence(nullptr);
+  Check(limiter.GetFramesInFlight() == 0 && limiter.BeginFrame(),
+        name + ": no limit without fences");
+}
+}  // namespace
+
+int main() {
+  const Scenario kScenarios[] = {
+      {"skip, 1 in flight, GPU bound", 1, FrameLimiter::kPolicySkip, 0,
+       5 * kMillis, 12 * kMillis, true},
+      {"skip, 2 in flight, GPU bound", 2, FrameLimiter::kPolicySkip, 0,
+       5 * kMillis, 12 * kMillis, true},
+      {"skip, 2 in flight, CPU bound", 2, FrameLimiter::kPolicySkip, 0,
+       12 * kMillis, 5 * kMillis, true},
+      {"wait, 1 in flight, GPU bound", 1, FrameLimiter::kPolicyWait,
+       16 * kMillis, 5 * kMillis, 12 * kMillis, true},
+      {"wait, 2 in flight, GPU bound", 2, FrameLimiter::kPolicyWait,
+       16 * kMillis, 5 * kMillis, 12 * kMillis, true},
+      {"wait, 2 in flight, CPU bound", 2, FrameLimiter::kPolicyWait,
+       16 * kMillis, 12 * kMillis, 5 * kMillis, true},
+      {"wait, 1 in flight, short budget", 1, FrameLimiter::kPolicyWait,
+       2 * kMillis, 5 * kMillis, 12 * kMillis, true},
+      {"wait, 1 in flight, no fences", 1, FrameLimiter::kPolicyWait,
+       16 * kMillis, 5 * kMillis, 12 * kMillis, false},
+  };
+  for (const Scenario& scenario : kScenarios) Run(scenario);
+
+  if (ok) printf("PASS: frames in flight stay within the limit\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,351 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side checks of the frame scheduler in src/main/jni/frame_scheduler.h,
+// against a simulated display, GPU and clock.
+//
+// The simulated display provides vsync timing through a fake VsyncProvider,
+// which may report a vsync several periods old. Sleeping and waiting on a
+// fence advance a simulated clock, and the simulated GPU runs each submitted
+// frame for a fixed time from when it is submitted or the previous frame
+// finishes, whichever is later, in parallel with the CPU.
+//
+// The tool first checks the deadline logic on single frames:
+//
+//  * the deadline is the first vsync that the estimated frame can make,
+//    extrapolated from a stale or a future vsync, and a frame that begins
+//    too late for a vsync skips to the next one;
+//  * the frame starts, after sleeping, as late as that deadline allows, and
+//    the display time is one period after the deadline;
+//  * without vsync timing nothing sleeps and the fallback prediction is
+//    used, and aborted frames are neither counted nor sampled;
+//  * EndFrame() never waits for the GPU.
+//
+// It then runs a few hundred frames of several workloads, reporting the
+// deadlines hit and the latency from start to display, and checks that once
+// the estimate has settled every deadline is hit, and that the estimate
+// covers the GPU time of the frames. The last workload runs without fences,
+// to show that the CPU cost alone misses every deadline once the GPU takes
+// longer than the safety margin.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -o frame_scheduler_test frame_scheduler_test.cc
+//       $JNI/frame_scheduler.cc
+//   ./frame_scheduler_test
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "frame_scheduler.h"  // NOLINT
+
+namespace {
+const uint64_t kMillis = 1000000;
+const uint64_t kPeriod = 16666667;
+const uint64_t kMargin = 2 * kMillis;
+const uint64_t kFallback = 50 * kMillis;
+const int kFrames = 600;
+// Frames after which the cost estimate has settled.
+const int kWarmupFrames = 32;
+
+// A display that refreshes every kPeriod from |first_vsync_nanos|, and
+// reports a vsync |stale_periods| old.
+class SimulatedDisplay : public VsyncProvider {
+ public:
+  SimulatedDisplay(const uint64_t* now_nanos, uint64_t first_vsync_nanos)
+      : now_nanos_(now_nanos),
+        first_vsync_nanos_(first_vsync_nanos),
+        stale_periods_(0),
+        known_(true) {}
+
+  bool GetVsync(uint64_t* vsync_nanos, uint64_t* period_nanos) const override {
+    if (!known_ || *now_nanos_ < first_vsync_nanos_) return false;
+    const uint64_t periods = (*now_nanos_ - first_vsync_nanos_) / kPeriod;
+    *vsync_nanos = first_vsync_nanos_ +
+                   (periods - std::min(periods, stale_periods_)) * kPeriod;
+    *period_nanos = kPeriod;
+    return true;
+  }
+
+  // Returns the first vsync at or after |nanos|.
+  uint64_t NextVsync(uint64_t nanos) const {
+    if (nanos <= first_vsync_nanos_) return first_vsync_nanos_;
+    return first_vsync_nanos_ +
+           (nanos - first_vsync_nanos_ + kPeriod - 1) / kPeriod * kPeriod;
+  }
+
+  void SetStalePeriods(uint64_t periods) { stale_periods_ = periods; }
+  void SetKnown(bool known) { known_ = known; }
+
+ private:
+  const uint64_t* now_nanos_;
+  const uint64_t first_vsync_nanos_;
+  uint64_t stale_periods_;
+  bool known_;
+};
+
+// A GPU that runs submitted frames one after the other, with a fence per
+// frame.
+class SimulatedGpu : public GpuFence {
+ public:
+  explicit SimulatedGpu(uint64_t* now_nanos)
+      : now_nanos_(now_nanos), idle_nanos_(0), next_handle_(1) {}
+
+  // Submits a frame that takes |gpu_nanos|, and returns when it finishes.
+  uint64_t Submit(uint64_t gpu_nanos) {
+    idle_nanos_ = std::max(idle_nanos_, *now_nanos_) + gpu_nanos;
+    return idle_nanos_;
+  }
+
+  Handle Insert() override {
+    const uintptr_t handle = next_handle_++;
+    signal_nanos_[handle] = std::max(idle_nanos_, *now_nanos_);
+    return reinterpret_cast<Handle>(handle);
+  }
+
+  bool Wait(Handle fence, uint64_t timeout_nanos) override {
+    const uint64_t signal_nanos =
+        signal_nanos_.at(reinterpret_cast<uintptr_t>(fence));
+    if (signal_nanos <= *now_nanos_) return true;
+    *now_nanos_ = std::min(signal_nanos, *now_nanos_ + timeout_nanos);
+    return signal_nanos <= *now_nanos_;
+  }
+
+  void Delete(Handle fence) override {
+    signal_nanos_.erase(reinterpret_cast<uintptr_t>(fence));
+  }
+
+  int GetLiveCount() const { return static_cast<int>(signal_nanos_.size()); }
+
+ private:
+  uint64_t* now_nanos_;
+  uint64_t idle_nanos_;
+  uintptr_t next_handle_;
+  std::map<uintptr_t, uint64_t> signal_nanos_;
+};
+
+// Reports a vsync 3 periods and 1 ms in the future.
+class FutureVsync : public VsyncProvider {
+ public:
+  explicit FutureVsync(const uint64_t* now_nanos) : now_nanos_(now_nanos) {}
+
+  bool GetVsync(uint64_t* vsync_nanos, uint64_t* period_nanos) const override {
+    *vsync_nanos = *now_nanos_ + 3 * kPeriod + kMillis;
+    *period_nanos = kPeriod;
+    return true;
+  }
+
+ private:
+  const uint64_t* now_nanos_;
+};
+
+bool ok = true;
+
+void Check(bool condition, const std::string& what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what.c_str());
+    ok = false;
+  }
+}
+
+// A scheduler running on the simulated clock.
+struct Simulation {
+  explicit Simulation(uint64_t first_vsync_nanos)
+      : now_nanos(0),
+        display(&now_nanos, first_vsync_nanos),
+        gpu(&now_nanos),
+        scheduler(kMargin, kFallback) {
+    scheduler.SetClock([this]() { return now_nanos; },
+                       [this](uint64_t nanos) { now_nanos += nanos; });
+    scheduler.SetVsyncProvider(&display);
+  }
+
+  // Runs a frame that costs |cpu_nanos| then |gpu_nanos|, and returns its
+  // display time.
+  uint64_t RunFrame(uint64_t cpu_nanos, uint64_t gpu_nanos) {
+    const uint64_t display_nanos = scheduler.BeginFrame();
+    now_nanos += cpu_nanos;
+    gpu.Submit(gpu_nanos);
+    scheduler.EndFrame();
+    return display_nanos;
+  }
+
+  uint64_t now_nanos;
+  SimulatedDisplay display;
+  SimulatedGpu gpu;
+  FrameScheduler scheduler;
+};
+
+void CheckDeadlines() {
+  const uint64_t kFirstVsync = 100 * kMillis;
+  const uint64_t kCpu = 3 * kMillis;
+
+  // Without fences, the estimate is the CPU cost of the last frames.
+  Simulation sim(kFirstVsync);
+  sim.now_nanos = kFirstVsync + 10 * kPeriod + kMillis;
+  for (int i = 0; i < 4; ++i) sim.RunFrame(kCpu, 0);
+  Check(sim.scheduler.GetFrameCostEstimate() == kCpu,
+        "without fences, the estimate is the CPU cost");
+
+  // A frame that can make the next vsync sleeps until the latest start.
+  for (uint64_t stale : {0, 1, 5}) {
+    sim.display.SetStalePeriods(stale);
+    const uint64_t begin_nanos = sim.now_nanos;
+    const uint64_t deadline = sim.display.NextVsync(begin_nanos + kCpu +
+                                                    kMargin);
+    const uint64_t display_nanos = sim.scheduler.BeginFrame();
+    const std::string name =
+        "vsync " + std::to_string(stale) + " periods old: ";
+    Check(display_nanos == deadline + kPeriod,
+          name + "display is one period after the first reachable vsync");
+    Check(sim.now_nanos == deadline - kCpu - kMargin,
+          name + "starts as late as the deadline allows");
+    sim.now_nanos += kCpu;
+    const uint64_t end_nanos = sim.now_nanos;
+    sim.scheduler.EndFrame();
+    Check(sim.now_nanos == end_nanos, name + "EndFrame() does not wait");
+  }
+  sim.display.SetStalePeriods(0);
+
+  // A frame that begins too late for a vsync skips to the next one.
+  const uint64_t vsync = sim.display.NextVsync(sim.now_nanos + kPeriod);
+  sim.now_nanos = vsync - kCpu - kMargin + 1;
+  Check(sim.scheduler.BeginFrame() == vsync + 2 * kPeriod &&
+            sim.now_nanos == vsync + kPeriod - kCpu - kMargin,
+        "a late frame skips to the next vsync");
+  sim.now_nanos += kCpu;
+  sim.scheduler.EndFrame();
+
+  // A vsync reported ahead of the clock is extrapolated backwards.
+  Simulation future(kFirstVsync);
+  future.display.SetKnown(false);
+  future.RunFrame(kCpu, 0);
+  FutureVsync future_vsync(&future.now_nanos);
+  future.scheduler.SetVsyncProvider(&future_vsync);
+  const uint64_t future_begin = future.now_nanos;
+  const uint64_t future_deadline = future_begin + kMillis + kPeriod;
+  Check(future.scheduler.BeginFrame() == future_deadline + kPeriod &&
+            future.now_nanos == future_deadline - kCpu - kMargin,
+        "a vsync in the future is extrapolated backwards");
+  future.scheduler.AbortFrame();
+
+  // Without vsync timing, nothing sleeps.
+  Simulation unknown(kFirstVsync);
+  unknown.display.SetKnown(false);
+  unknown.now_nanos = kFirstVsync + kPeriod / 3;
+  const uint64_t unknown_begin = unknown.now_nanos;
+  Check(unknown.scheduler.BeginFrame() == unknown_begin + kFallback &&
+            unknown.now_nanos == unknown_begin,
+        "without vsync timing, nothing sleeps and the fallback is used");
+  unknown.now_nanos += kCpu;
+  unknown.scheduler.EndFrame();
+  Check(unknown.scheduler.GetStats().frames_scheduled == 0,
+        "frames without vsync timing are not counted as scheduled");
+
+  // An aborted frame is not sampled.
+  Simulation aborted(kFirstVsync);
+  aborted.now_nanos = kFirstVsync + kPeriod;
+  for (int i = 0; i < 4; ++i) aborted.RunFrame(kCpu, 0);
+  const FrameScheduleStats before_abort = aborted.scheduler.GetStats();
+  aborted.scheduler.BeginFrame();
+  aborted.now_nanos += 10 * kMillis;
+  aborted.scheduler.AbortFrame();
+  aborted.RunFrame(kCpu, 0);
+  Check(aborted.scheduler.GetFrameCostEstimate() == kCpu &&
+            aborted.scheduler.GetStats().frames_scheduled ==
+                before_abort.frames_scheduled + 1 &&
+            aborted.scheduler.GetStats().deadlines_missed ==
+                before_abort.deadlines_missed,
+        "an aborted frame is neither counted nor sampled");
+}
+
+struct Workload {
+  const char* name;
+  uint64_t cpu_nanos;
+  uint64_t gpu_nanos;
+  // Every |spike_interval| frames, the GPU takes |spike_nanos| longer.
+  int spike_interval;
+  uint64_t spike_nanos;
+  bool fences;
+};
+
+void RunWorkload(const Workload& workload) {
+  Simulation sim(10 * kMillis);
+  if (workload.fences) sim.scheduler.SetFence(&sim.gpu);
+  sim.now_nanos = 10 * kMillis + kPeriod / 2;
+  int hit = 0, settled_missed = 0;
+  uint64_t total_latency = 0;
+  uint64_t max_cost = 0;
+  for (int frame = 0; frame < kFrames; ++frame) {
+    uint64_t gpu_nanos = workload.gpu_nanos;
+    if (workload.spike_interval > 0 && frame % workload.spike_interval == 1) {
+      gpu_nanos += workload.spike_nanos;
+    }
+    const uint64_t display_nanos = sim.scheduler.BeginFrame();
+    const uint64_t start_nanos = sim.now_nanos;
+    sim.now_nanos += workload.cpu_nanos;
+    const uint64_t gpu_end_nanos = sim.gpu.Submit(gpu_nanos);
+    const uint64_t submit_nanos = sim.now_nanos;
+    sim.scheduler.EndFrame();
+    if (sim.now_nanos != submit_nanos) {
+      Check(false, std::string(workload.name) + ": EndFrame() waits");
+    }
+    // The compositor latches the frame at the vsync before it is displayed.
+    const bool frame_hit = gpu_end_nanos <= display_nanos - kPeriod;
+    if (frame_hit) ++hit;
+    if (frame >= kWarmupFrames) {
+      if (!frame_hit) ++settled_missed;
+      total_latency += display_nanos - start_nanos;
+      max_cost = std::max(max_cost, gpu_end_nanos - start_nanos);
+    }
+  }
+  const int settled = kFrames - kWarmupFrames;
+  const FrameScheduleStats stats = sim.scheduler.GetStats();
+  printf("%-30s hit %3d/%d, settled misses %3d, mean latency %5.2f ms, "
+         "estimate %5.2f ms, reported misses %llu\n",
+         workload.name, hit, kFrames, settled_missed,
+         total_latency / 1e6 / settled,
+         sim.scheduler.GetFrameCostEstimate() / 1e6,
+         static_cast<unsigned long long>(stats.deadlines_missed));
+  const std::string name = workload.name;
+  if (workload.fences) {
+    Check(settled_missed == 0, name + ": every settled deadline is hit");
+    Check(sim.scheduler.GetFrameCostEstimate() >= max_cost - kMargin,
+          name + ": the estimate covers the GPU time");
+    Check(sim.gpu.GetLiveCount() <= 3, name + ": fences do not accumulate");
+  }
+}
+}  // namespace
+
+int main() {
+  CheckDeadlines();
+
+  const Workload kWorkloads[] = {
+      {"light", 3 * kMillis, 4 * kMillis, 0, 0, true},
+      {"heavy", 6 * kMillis, 8 * kMillis, 0, 0, true},
+      {"GPU spikes", 4 * kMillis, 6 * kMillis, 10, 3 * kMillis, true},
+      {"longer than a period", 9 * kMillis, 10 * kMillis, 0, 0, true},
+      {"heavy, CPU cost only", 6 * kMillis, 8 * kMillis, 0, 0, false},
+  };
+  for (const Workload& workload : kWorkloads) RunWorkload(workload);
+
+  if (ok) printf("PASS: deadlines and skips\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmark and checks of the host reference renderer of the gvr_audio C API
+// (gvr_audio_host.cc), driven through the gvr::AudioApi C++ wrapper as an
+// app would.
+//
+// The checks render short scenes and verify the cues that the output should
+// carry: which ear is louder and earlier for a source to one side, how that
+// follows head rotation and soundfield rotation, the distance rolloff
+// models, and the lifetime of sources.
+//
+// The benchmark then renders looping sound objects that orbit the listener,
+// with the head pose and the positions updated every 512 frames (about
+// 94 Hz), for several source counts in each rendering mode. It fits the
+// render time to a fixed cost plus a cost per source, both as a fraction of
+// one core in real time, and reports how many sources one core can render.
+//
+// Build and run on the host with:
+//
+//   g++ -std=c++11 -O2 -I../../../libraries/headers
+//       -o gvr_audio_bench gvr_audio_bench.cc gvr_audio_host.cc
+//   ./gvr_audio_bench [demo.wav]
+//
+// The test sounds are written to the current directory. If a file name is
+// given, a 10 s binaural demo of a source circling the head is written to it.
+// Add -DGVR_AUDIO_HOST_DISABLE_SIMD to measure the portable code.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>  // NOLINT
+#include <random>
+#include <vector>
+
+#include "gvr_audio_host.h"  // NOLINT
+
+namespace {
+const float kPi = 3.14159265358979f;
+const size_t kSampleRate = GVR_AUDIO_HOST_SAMPLE_RATE;
+
+const char* kNoiseFile = "gvr_audio_bench_noise.wav";
+const char* kShortFile = "gvr_audio_bench_short.wav";
+const char* kFieldFile = "gvr_audio_bench_field.wav";
+
+// Frames between pose and position updates, like a frame of the app.
+const size_t kUpdateFrames = 512;
+
+// Audio rendered for each benchmark measurement.
+const float kBenchmarkSeconds = 2.0f;
+
+const int kSourceCounts[] = {1, 16, 64, 256};
+
+bool WriteWav(const char* filename, int channels,
+              const std::vector<float>& samples) {
+  FILE* file = fopen(filename, "wb");
+  if (!file) return false;
+  const uint32_t data_size = samples.size() * sizeof(float);
+  const uint32_t header[] = {
+      0x46464952,  // "RIFF"
+      36 + data_size,
+      0x45564157,  // "WAVE"
+      0x20746d66,  // "fmt "
+      16,
+      3u | static_cast<uint32_t>(channels) << 16,  // IEEE float
+      static_cast<uint32_t>(kSampleRate),
+      static_cast<uint32_t>(kSampleRate * channels * sizeof(float)),
+      static_cast<uint32_t>(channels * sizeof(float)) | 32u << 16,
+      0x61746164,  // "data"
+      data_size};
+  fwrite(header, sizeof(header), 1, file);
+  fwrite(samples.data(), sizeof(float), samples.size(), file);
+  fclose(file);
+  return true;
+}
+
+/**
+ * Write the test sounds: a second of white noise, 0.1 s of it, and a first
+ * order ambisonic (ACN, SN3D) soundfield of noise arriving from the right.
+ */
+bool WriteTestSounds() {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+  std::vector<float> noise(kSampleRate);
+  for (float& sample : noise) sample = uniform(random);
+  std::vector<float> short_noise(noise.begin(),
+                                 noise.begin() + kSampleRate / 10);
+  // From the right, the ambisonic Y (left) channel is inverted and X (front)
+  // and Z (up) are silent.
+  std::vector<float> field(4 * kSampleRate, 0.0f);
+  for (size_t frame = 0; frame < kSampleRate; ++frame) {
+    field[4 * frame] = noise[frame];
+    field[4 * frame + 1] = -noise[frame];
+  }
+  return WriteWav(kNoiseFile, 1, noise) &&
+         WriteWav(kShortFile, 1, short_noise) &&
+         WriteWav(kFieldFile, 4, field);
+}
+
+gvr::Mat4f YawMatrix(float yaw) {
+  gvr::Mat4f matrix = {{{cosf(yaw), 0.0f, sinf(yaw), 0.0f},
+                        {0.0f, 1.0f, 0.0f, 0.0f},
+                        {-sinf(yaw), 0.0f, cosf(yaw), 0.0f},
+                        {0.0f, 0.0f, 0.0f, 1.0f}}};
+  return matrix;
+}
+
+struct Channels {
+  std::vector<float> left;
+  std::vector<float> right;
+};
+
+Channels Render(gvr::AudioApi* audio, size_t frames) {
+  std::vector<float> interleaved(2 * frames);
+  gvr_audio_host_render(audio->cobj(), interleaved.data(), frames);
+  Channels channels;
+  for (size_t frame = 0; frame < frames; ++frame) {
+    channels.left.push_back(interleaved[2 * frame]);
+    channels.right.push_back(interleaved[2 * frame + 1]);
+  }
+  return channels;
+}
+
+float Rms(const std::vector<float>& samples) {
+  double sum = 0.0;
+  for (float sample : samples) sum += sample * sample;
+  return sqrt(sum / samples.size());
+}
+
+/**
+ * Return the lag, in samples, by which |later| best matches |earlier|.
+ */
+int InterauralLag(const std::vector<float>& earlier,
+                  const std::vector<float>& later) {
+  int best_lag = 0;
+  double best = -1.0;
+  for (int lag = -60; lag <= 60; ++lag) {
+    double sum = 0.0;
+    for (size_t i = 60; i + 60 < earlier.size(); ++i) {
+      sum += earlier[i] * later[i + lag];
+    }
+    if (sum > best) {
+      best = sum;
+      best_lag = lag;
+    }
+  }
+  return best_lag;
+}
+
+bool Check(bool condition, const char* what) {
+  printf("  %s: %s\n", condition ? "ok  " : "FAIL", what);
+  return condition;
+}
+
+/**
+ * Render a looping noise object at (x, y, z) for |yaw| and return its
+ * steady state output.
+ */
+Channels RenderObject(gvr::AudioRenderingMode mode, float x, float y, float z,
+                      float yaw) {
+  gvr::AudioApi audio;
+  audio.Init(mode);
+  audio.PreloadSoundfile(kNoiseFile);
+  const gvr::AudioSourceId source = audio.CreateSoundObject(kNoiseFile);
+  audio.SetSoundObjectPosition(source, x, y, z);
+  audio.SetHeadPose(YawMatrix(yaw));
+  audio.PlaySound(source, true);
+  Render(&audio, 4096);  // Skip the convolution latency.
+  return Render(&audio, 8192);
+}
+
+bool RunChecks() {
+  bool ok = true;
+  const gvr::AudioRenderingMode modes[] = {
+      GVR_AUDIO_RENDERING_STEREO_PANNING,
+      GVR_AUDIO_RENDERING_BINAURAL_LOW_QUALITY,
+      GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY};
+  const char* mode_names[] = {"stereo panning", "binaural low quality",
+                              "binaural high quality"};
+  for (int i = 0; i < 3; ++i) {
+    printf("%s:\n", mode_names[i]);
+    const Channels right = RenderObject(modes[i], 2.0f, 0.0f, 0.0f, 0.0f);
+    ok &= Check(Rms(right.right) > 2.0f * Rms(right.left),
+                "source to the right is louder in the right ear");
+    // Yawing the head left by 90 degrees brings the source in front.
+    const Channels front = RenderObject(modes[i], 2.0f, 0.0f, 0.0f,
+                                        0.5f * kPi);
+    const float balance = Rms(front.right) / Rms(front.left);
+    ok &= Check(balance > 0.9f && balance < 1.1f,
+                "source in front after turning towards it is centered");
+    const Channels behind = RenderObject(modes[i], 2.0f, 0.0f, 0.0f, kPi);
+    ok &= Check(Rms(behind.left) > 2.0f * Rms(behind.right),
+                "source to the right is on the left after turning around");
+    if (modes[i] != GVR_AUDIO_RENDERING_STEREO_PANNING) {
+      // At most the Woodworth delay of a source at the ear, about 31
+      // samples; less at low quality, whose nearest speakers are 55 degrees
+      // from the ear.
+      const int lag = InterauralLag(right.right, right.left);
+      char what[80];
+      snprintf(what, sizeof(what),
+               "left ear hears a source to the right %d samples later", lag);
+      ok &= Check(lag >= 10 && lag <= 32, what);
+    }
+  }
+
+  printf("distance rolloff:\n");
+  const float near = Rms(RenderObject(GVR_AUDIO_RENDERING_STEREO_PANNING,
+                                      0.0f, 0.0f, -2.0f, 0.0f).left);
+  const float far = Rms(RenderObject(GVR_AUDIO_RENDERING_STEREO_PANNING,
+                                     0.0f, 0.0f, -4.0f, 0.0f).left);
+  ok &= Check(fabsf(near / far - 2.0f) < 0.1f,
+              "logarithmic: twice the distance is half the amplitude");
+  // Within the default minimum distance of 1 m, there is no attenuation.
+  const float full = Rms(RenderObject(GVR_AUDIO_RENDERING_STEREO_PANNING,
+                                      0.0f, 0.0f, -1.0f, 0.0f).left);
+  {
+    gvr::AudioApi audio;
+    audio.Init(GVR_AUDIO_RENDERING_STEREO_PANNING);
+    audio.PreloadSoundfile(kNoiseFile);
+    const gvr::AudioSourceId source = audio.CreateSoundObject(kNoiseFile);
+    audio.SetSoundObjectDistanceRolloffModel(
+        source, GVR_AUDIO_ROLLOFF_LINEAR, 1.0f, 5.0f);
+    audio.SetSoundObjectPosition(source, 0.0f, 0.0f, -3.0f);
+    audio.PlaySound(source, true);
+    Render(&audio, 1024);
+    const float halfway = Rms(Render(&audio, 8192).left);
+    audio.SetSoundObjectPosition(source, 0.0f, 0.0f, -6.0f);
+    Render(&audio, 1024);
+    const float beyond = Rms(Render(&audio, 8192).left);
+    ok &= Check(fabsf(halfway / full - 0.5f) < 0.05f && beyond == 0.0f,
+                "linear: half way is half the amplitude, beyond is silent");
+  }
+
+  printf("soundfields:\n");
+  for (int i = 0; i < 3; ++i) {
+    gvr::AudioApi audio;
+    audio.Init(modes[i]);
+    audio.PreloadSoundfile(kFieldFile);
+    const gvr::AudioSourceId field = audio.CreateSoundfield(kFieldFile);
+    audio.PlaySound(field, true);
+    Render(&audio, 4096);
+    const Channels unrotated = Render(&audio, 8192);
+    // Half a turn about the vertical axis.
+    gvr::Quatf rotation = {0.0f, 1.0f, 0.0f, 0.0f};
+    audio.SetSoundfieldRotation(field, rotation);
+    Render(&audio, 4096);
+    const Channels rotated = Render(&audio, 8192);
+    // First order soundfields are decoded with wider lobes than the second
+    // order sound objects, so the difference between the ears is smaller.
+    char what[80];
+    snprintf(what, sizeof(what), "%s: from the right, then the left",
+             mode_names[i]);
+    ok &= Check(Rms(unrotated.right) > 1.5f * Rms(unrotated.left) &&
+                    Rms(rotated.left) > 1.5f * Rms(rotated.right),
+                what);
+  }
+
+  printf("sources:\n");
+  {
+    gvr::AudioApi audio;
+    audio.Init(GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY);
+    audio.PreloadSoundfile(kShortFile);
+    audio.PreloadSoundfile(kNoiseFile);
+    const gvr::AudioSourceId once = audio.CreateSoundObject(kShortFile);
+    const gvr::AudioSourceId looped = audio.CreateStereoSound(kNoiseFile);
+    audio.PlaySound(once, false);
+    audio.PlaySound(looped, true);
+    ok &= Check(audio.CreateSoundfield(kNoiseFile) == -1,
+                "soundfields need four channels");
+    Render(&audio, kSampleRate / 5);
+    ok &= Check(!audio.IsSourceIdValid(once) && audio.IsSoundPlaying(looped),
+                "a sound that does not loop destroys itself when it ends");
+    audio.PauseSound(looped);
+    ok &= Check(audio.IsSourceIdValid(looped) &&
+                    Rms(Render(&audio, 1024).left) == 0.0f,
+                "a paused sound is silent but valid");
+    audio.ResumeSound(looped);
+    audio.Pause();
+    ok &= Check(Rms(Render(&audio, 1024).left) == 0.0f,
+                "a paused engine is silent");
+    audio.Resume();
+    ok &= Check(Rms(Render(&audio, 1024).left) > 0.0f,
+                "a resumed engine plays again");
+    audio.StopSound(looped);
+    ok &= Check(!audio.IsSourceIdValid(looped),
+                "a stopped sound is destroyed");
+  }
+  return ok;
+}
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * Return the time to render kBenchmarkSeconds with |count| sources, as a
+ * fraction of real time.
+ */
+double MeasureLoad(gvr::AudioRenderingMode mode, int count) {
+  gvr::AudioApi audio;
+  audio.Init(mode);
+  audio.PreloadSoundfile(kNoiseFile);
+  std::vector<gvr::AudioSourceId> sources;
+  for (int i = 0; i < count; ++i) {
+    sources.push_back(audio.CreateSoundObject(kNoiseFile));
+    audio.PlaySound(sources.back(), true);
+  }
+  std::vector<float> output(2 * kUpdateFrames);
+  const size_t updates = kBenchmarkSeconds * kSampleRate / kUpdateFrames;
+  double seconds = 0.0;
+  for (size_t update = 0; update < updates; ++update) {
+    const double start = NowSeconds();
+    const float time = static_cast<float>(update * kUpdateFrames) /
+                       kSampleRate;
+    audio.SetHeadPose(YawMatrix(0.3f * sinf(time)));
+    for (int i = 0; i < count; ++i) {
+      const float angle = 2.0f * kPi * i / count + time;
+      const float distance = 1.0f + (i % 8);
+      audio.SetSoundObjectPosition(sources[i], distance * sinf(angle),
+                                   0.2f * (i % 3), -distance * cosf(angle));
+    }
+    audio.Update();
+    gvr_audio_host_render(audio.cobj(), output.data(), kUpdateFrames);
+    seconds += NowSeconds() - start;
+  }
+  return seconds / kBenchmarkSeconds;
+}
+
+void WriteDemo(const char* filename) {
+  gvr::AudioApi audio;
+  audio.Init(GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY);
+  audio.PreloadSoundfile(kNoiseFile);
+  const gvr::AudioSourceId source = audio.CreateSoundObject(kNoiseFile);
+  audio.SetSoundVolume(source, 0.5f);
+  audio.PlaySound(source, true);
+  if (!gvr_audio_host_open_wav_sink(audio.cobj(), filename)) {
+    fprintf(stderr, "Cannot write %s\n", filename);
+    return;
+  }
+  const size_t updates = 10 * kSampleRate / kUpdateFrames;
+  for (size_t update = 0; update < updates; ++update) {
+    const float angle = 2.0f * kPi * update * kUpdateFrames / kSampleRate / 5;
+    audio.SetSoundObjectPosition(source, 2.0f * sinf(angle), 0.0f,
+                                 -2.0f * cosf(angle));
+    gvr_audio_host_render(audio.cobj(), nullptr, kUpdateFrames);
+  }
+  printf("Wrote %s\n", filename);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!WriteTestSounds()) {
+    fprintf(stderr, "Cannot write the test sounds\n");
+    return 1;
+  }
+  const bool ok = RunChecks();
+
+  printf("\nload, as %% of one core per %zu Hz stream\n", kSampleRate);
+  printf("mode                     fixed  per source  sources per core\n");
+  const gvr::AudioRenderingMode modes[] = {
+      GVR_AUDIO_RENDERING_STEREO_PANNING,
+      GVR_AUDIO_RENDERING_BINAURAL_LOW_QUALITY,
+      GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY};
+  const char* mode_names[] = {"stereo panning", "binaural low",
+                              "binaural high"};
+  const size_t count_count = sizeof(kSourceCounts) / sizeof(kSourceCounts[0]);
+  for (int i = 0; i < 3; ++i) {
+    // Least squares fit of load = fixed + per_source * count.
+    double sum_n = 0.0, sum_load = 0.0, sum_nn = 0.0, sum_n_load = 0.0;
+    for (int count : kSourceCounts) {
+      const double load = MeasureLoad(modes[i], count);
+      sum_n += count;
+      sum_load += load;
+      sum_nn += static_cast<double>(count) * count;
+      sum_n_load += count * load;
+    }
+    const double per_source =
+        (count_count * sum_n_load - sum_n * sum_load) /
+        (count_count * sum_nn - sum_n * sum_n);
+    const double fixed = (sum_load - per_source * sum_n) / count_count;
+    printf("%-21s %7.3f%% %10.4f%% %17.0f\n", mode_names[i], 100.0 * fixed,
+           100.0 * per_source, (1.0 - fixed) / per_source);
+  }
+
+  if (argc > 1) WriteDemo(argv[1]);
+  printf(ok ? "All checks passed.\n" : "Some checks FAILED.\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,1121 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side reference implementation of the gvr_audio C API
+// (libraries/headers/vr/gvr/capi/include/gvr_audio.h), for measuring the
+// cost and checking the behavior of audio code on Linux, where the closed
+// libgvr_audio is not available. See gvr_audio_host.h for the additions that
+// drive it, and gvr_audio_bench.cc for a benchmark.
+//
+// The renderer follows the structure that gvr_audio.h describes:
+//
+//  * Sound objects are panned onto a virtual array of loudspeakers around
+//    the head with an ambisonic projection decoder: 8 speakers on the corners
+//    of a cube at first order for GVR_AUDIO_RENDERING_BINAURAL_LOW_QUALITY,
+//    16 speakers on a Fibonacci sphere at second order for
+//    GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY. First order ambisonic
+//    soundfields are decoded onto the same speakers, rotated by the head pose
+//    and the soundfield rotation.
+//  * Each speaker feed is convolved with the head related impulse responses
+//    (HRIRs) of its direction, by uniformly partitioned overlap-save FFT
+//    convolution. The left and right HRIRs are packed into one complex filter
+//    and the speakers are summed in the frequency domain, so each block takes
+//    one forward FFT per speaker and a single inverse FFT. The cost of the
+//    convolution is therefore fixed, and each source only costs its share of
+//    the mixing into the speaker feeds.
+//  * GVR_AUDIO_RENDERING_STEREO_PANNING pans sound objects between the two
+//    output channels with a constant power law, and decodes soundfields to
+//    two virtual cardioids, without any convolution.
+//  * Stereo sounds are mixed into the output directly.
+//
+// The HRIRs are synthesized from a spherical head model: the Woodworth
+// interaural time difference and the Brown-Duda head shadow filter. They
+// give the right cues for measuring cost and for checking directions, but
+// are not measured HRIRs.
+//
+// Distance rolloff follows gvr_audio_distance_rolloff_type; the default is
+// logarithmic (inverse distance) beyond 1 m, flat beyond 1000 m. Gains are
+// ramped linearly over each block, so that moving sources, head rotation and
+// volume changes do not cause zipper noise.
+//
+// Not modeled: room effects (the room calls are accepted and ignored),
+// streaming of files that were not preloaded, resampling (sound files must
+// be GVR_AUDIO_HOST_SAMPLE_RATE), and the stereo speaker mode (headphones are
+// assumed to be plugged in).
+//
+// The mixing and the frequency domain multiply-accumulate use NEON or SSE2
+// when the target has them; define GVR_AUDIO_HOST_DISABLE_SIMD to measure the
+// portable code.
+
+#include "gvr_audio_host.h"  // NOLINT
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#if !defined(GVR_AUDIO_HOST_DISABLE_SIMD)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GVR_AUDIO_HOST_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define GVR_AUDIO_HOST_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace {
+const int32_t kInvalidSourceId = -1;
+
+// Frames rendered at a time, which is also the partition size of the
+// convolution.
+const size_t kBlockFrames = 128;
+const size_t kFftSize = 2 * kBlockFrames;
+const size_t kHrirLength = 256;
+const size_t kPartitions = kHrirLength / kBlockFrames;
+
+const float kPi = 3.14159265358979f;
+const float kSampleRate = GVR_AUDIO_HOST_SAMPLE_RATE;
+const float kSpeedOfSound = 343.0f;
+const float kHeadRadius = 0.0875f;
+
+// Half the length of the windowed sinc used for the fractional delays of the
+// HRIRs.
+const int kSincHalfWidth = 8;
+
+const float kDefaultMinDistance = 1.0f;
+const float kDefaultMaxDistance = 1000.0f;
+
+/**
+ * Add |input| times a gain that ramps linearly from |gain_start| (just
+ * before the first sample) to |gain_end| (at the last sample) to |output|.
+ */
+void MixRamp(const float* input, float gain_start, float gain_end,
+             size_t count, float* output) {
+  const float step = (gain_end - gain_start) / count;
+  const size_t vector_count = count & ~static_cast<size_t>(3);
+  size_t i = 0;
+#if defined(GVR_AUDIO_HOST_NEON)
+  const float offsets[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+  const float32x4_t steps = vmulq_n_f32(vld1q_f32(offsets), step);
+  for (; i < vector_count; i += 4) {
+    const float32x4_t gain = vaddq_f32(vdupq_n_f32(gain_start + step * i),
+                                       steps);
+    vst1q_f32(output + i,
+              vmlaq_f32(vld1q_f32(output + i), vld1q_f32(input + i), gain));
+  }
+#elif defined(GVR_AUDIO_HOST_SSE2)
+  const __m128 steps =
+      _mm_mul_ps(_mm_set_ps(4.0f, 3.0f, 2.0f, 1.0f), _mm_set1_ps(step));
+  for (; i < vector_count; i += 4) {
+    const __m128 gain = _mm_add_ps(_mm_set1_ps(gain_start + step * i), steps);
+    _mm_storeu_ps(output + i,
+                  _mm_add_ps(_mm_loadu_ps(output + i),
+                             _mm_mul_ps(_mm_loadu_ps(input + i), gain)));
+  }
+#endif
+  for (; i < count; ++i) {
+    output[i] += input[i] * (gain_start + step * (i + 1));
+  }
+}
+
+/**
+ * Add the element-wise complex product of |a| and |b| to |sum|; all three
+ * are split into real and imaginary arrays of |count| elements.
+ */
+void ComplexMultiplyAccumulate(const float* a_re, const float* a_im,
+                               const float* b_re, const float* b_im,
+                               size_t count, float* sum_re, float* sum_im) {
+  const size_t vector_count = count & ~static_cast<size_t>(3);
+  size_t i = 0;
+#if defined(GVR_AUDIO_HOST_NEON)
+  for (; i < vector_count; i += 4) {
+    const float32x4_t ar = vld1q_f32(a_re + i);
+    const float32x4_t ai = vld1q_f32(a_im + i);
+    const float32x4_t br = vld1q_f32(b_re + i);
+    const float32x4_t bi = vld1q_f32(b_im + i);
+    float32x4_t re = vmlaq_f32(vld1q_f32(sum_re + i), ar, br);
+    float32x4_t im = vmlaq_f32(vld1q_f32(sum_im + i), ar, bi);
+    vst1q_f32(sum_re + i, vmlsq_f32(re, ai, bi));
+    vst1q_f32(sum_im + i, vmlaq_f32(im, ai, br));
+  }
+#elif defined(GVR_AUDIO_HOST_SSE2)
+  for (; i < vector_count; i += 4) {
+    const __m128 ar = _mm_loadu_ps(a_re + i);
+    const __m128 ai = _mm_loadu_ps(a_im + i);
+    const __m128 br = _mm_loadu_ps(b_re + i);
+    const __m128 bi = _mm_loadu_ps(b_im + i);
+    const __m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+    const __m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+    _mm_storeu_ps(sum_re + i, _mm_add_ps(_mm_loadu_ps(sum_re + i), re));
+    _mm_storeu_ps(sum_im + i, _mm_add_ps(_mm_loadu_ps(sum_im + i), im));
+  }
+#endif
+  for (; i < count; ++i) {
+    sum_re[i] += a_re[i] * b_re[i] - a_im[i] * b_im[i];
+    sum_im[i] += a_re[i] * b_im[i] + a_im[i] * b_re[i];
+  }
+}
+
+/**
+ * In-place radix-2 complex FFT on split real and imaginary arrays.
+ */
+class Fft {
+ public:
+  explicit Fft(size_t size)
+      : size_(size), cos_(size / 2), sin_(size / 2), reverse_(size) {
+    for (size_t i = 0; i < size / 2; ++i) {
+      cos_[i] = cosf(2.0f * kPi * i / size);
+      sin_[i] = sinf(2.0f * kPi * i / size);
+    }
+    int bits = 0;
+    while ((static_cast<size_t>(1) << bits) < size) ++bits;
+    for (size_t i = 0; i < size; ++i) {
+      size_t reversed = 0;
+      for (int bit = 0; bit < bits; ++bit) {
+        if (i & (static_cast<size_t>(1) << bit)) {
+          reversed |= static_cast<size_t>(1) << (bits - 1 - bit);
+        }
+      }
+      reverse_[i] = reversed;
+    }
+  }
+
+  /**
+   * Transform |re| and |im|. The inverse transform is scaled by 1 / size, so
+   * that it undoes the forward one.
+   */
+  void Transform(float* re, float* im, bool inverse) const {
+    for (size_t i = 0; i < size_; ++i) {
+      const size_t j = reverse_[i];
+      if (j > i) {
+        std::swap(re[i], re[j]);
+        std::swap(im[i], im[j]);
+      }
+    }
+    const float sign = inverse ? 1.0f : -1.0f;
+    for (size_t length = 2; length <= size_; length *= 2) {
+      const size_t half = length / 2;
+      const size_t stride = size_ / length;
+      for (size_t start = 0; start < size_; start += length) {
+        for (size_t k = 0; k < half; ++k) {
+          const float wr = cos_[k * stride];
+          const float wi = sign * sin_[k * stride];
+          const size_t a = start + k;
+          const size_t b = a + half;
+          const float tr = re[b] * wr - im[b] * wi;
+          const float ti = re[b] * wi + im[b] * wr;
+          re[b] = re[a] - tr;
+          im[b] = im[a] - ti;
+          re[a] += tr;
+          im[a] += ti;
+        }
+      }
+    }
+    if (inverse) {
+      const float scale = 1.0f / size_;
+      for (size_t i = 0; i < size_; ++i) {
+        re[i] *= scale;
+        im[i] *= scale;
+      }
+    }
+  }
+
+ private:
+  const size_t size_;
+  std::vector<float> cos_;
+  std::vector<float> sin_;
+  std::vector<size_t> reverse_;
+};
+
+/**
+ * Synthesize the HRIR of one ear for a source in direction |direction|
+ * (unit length, head space), with a spherical head model. |ear| is the
+ * direction of the ear, (-1, 0, 0) or (1, 0, 0).
+ */
+void SynthesizeHrir(const float direction[3], const float ear[3],
+                    float hrir[kHrirLength]) {
+  const float cos_angle = direction[0] * ear[0] + direction[1] * ear[1] +
+                          direction[2] * ear[2];
+  const float angle = acosf(fmaxf(-1.0f, fminf(1.0f, cos_angle)));
+
+  // Woodworth's formula for the delay relative to the center of the head,
+  // offset so that it is never negative and the sinc fits.
+  const float head_delay = kHeadRadius / kSpeedOfSound;
+  const float delay_seconds =
+      angle < 0.5f * kPi ? -head_delay * cos_angle
+                         : head_delay * (angle - 0.5f * kPi);
+  const float delay =
+      (delay_seconds + head_delay) * kSampleRate + kSincHalfWidth;
+
+  // Brown-Duda head shadow: a one-pole, one-zero filter whose high
+  // frequency gain |alpha| goes from 2 facing the ear to 0.1 at 150 degrees
+  // away, discretized with the bilinear transform.
+  const float alpha_min = 0.1f;
+  const float angle_min = 150.0f / 180.0f * kPi;
+  const float alpha = (1.0f + 0.5f * alpha_min) +
+                      (1.0f - 0.5f * alpha_min) * cosf(angle / angle_min * kPi);
+  const float w0 = kSpeedOfSound / kHeadRadius;
+  const float k = 2.0f * kSampleRate;
+  const float a0 = 2.0f * w0 + k;
+  const float a1 = 2.0f * w0 - k;
+  const float b0 = 2.0f * w0 + alpha * k;
+  const float b1 = 2.0f * w0 - alpha * k;
+  float shadow[kHrirLength];
+  float previous_out = 0.0f;
+  for (size_t n = 0; n < kHrirLength; ++n) {
+    const float in = n == 0 ? 1.0f : 0.0f;
+    const float previous_in = n == 1 ? 1.0f : 0.0f;
+    previous_out = (b0 * in + b1 * previous_in - a1 * previous_out) / a0;
+    shadow[n] = previous_out;
+  }
+
+  // Delay the head shadow response with a Hann windowed sinc.
+  for (size_t n = 0; n < kHrirLength; ++n) {
+    float sum = 0.0f;
+    const int first = static_cast<int>(ceilf(n - delay - kSincHalfWidth));
+    for (int m = first < 0 ? 0 : first;
+         m < static_cast<int>(kHrirLength); ++m) {
+      const float x = n - m - delay;
+      if (x <= -kSincHalfWidth) break;
+      const float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf(kPi * x) / (kPi * x);
+      const float window = 0.5f + 0.5f * cosf(kPi * x / kSincHalfWidth);
+      sum += shadow[m] * sinc * window;
+    }
+    hrir[n] = sum;
+  }
+  // Fade out the tail of the truncated response.
+  const size_t fade = 16;
+  for (size_t n = 0; n < fade; ++n) {
+    hrir[kHrirLength - 1 - n] *= static_cast<float>(n) / fade;
+  }
+}
+
+float Legendre(int order, float x) {
+  switch (order) {
+    case 0:
+      return 1.0f;
+    case 1:
+      return x;
+    default:
+      return 0.5f * (3.0f * x * x - 1.0f);
+  }
+}
+
+/**
+ * Return the max-rE weight of order |order| of a decoder of order
+ * |max_order|, which narrows the panning lobe and removes most of the
+ * signal from the speakers opposite the source.
+ */
+float MaxReWeight(int order, int max_order) {
+  const float angle = 137.9f / 180.0f * kPi / (max_order + 1.51f);
+  return Legendre(order, cosf(angle));
+}
+
+struct Sound {
+  int channels;
+  size_t frames;
+  std::vector<std::vector<float>> planes;
+};
+
+/**
+ * Read a 16-bit PCM or 32-bit float WAV file. Returns null, after printing
+ * why, if the file cannot be used.
+ */
+std::shared_ptr<Sound> ReadWav(const char* filename) {
+  FILE* file = fopen(filename, "rb");
+  if (!file) {
+    fprintf(stderr, "gvr_audio_host: cannot open %s\n", filename);
+    return nullptr;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[65536];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.insert(data.end(), buffer, buffer + read);
+  }
+  fclose(file);
+
+  auto u16 = [&data](size_t offset) {
+    return static_cast<uint32_t>(data[offset] | data[offset + 1] << 8);
+  };
+  auto u32 = [&data, &u16](size_t offset) {
+    return u16(offset) | u16(offset + 2) << 16;
+  };
+  if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 ||
+      memcmp(&data[8], "WAVE", 4) != 0) {
+    fprintf(stderr, "gvr_audio_host: %s is not a WAV file\n", filename);
+    return nullptr;
+  }
+  uint32_t format = 0, channels = 0, rate = 0, bits = 0;
+  size_t samples_offset = 0, samples_size = 0;
+  for (size_t offset = 12; offset + 8 <= data.size();) {
+    const uint32_t size = u32(offset + 4);
+    const size_t body = offset + 8;
+    if (body + size > data.size()) break;
+    if (memcmp(&data[offset], "fmt ", 4) == 0 && size >= 16) {
+      format = u16(body);
+      channels = u16(body + 2);
+      rate = u32(body + 4);
+      bits = u16(body + 14);
+      // WAVE_FORMAT_EXTENSIBLE keeps the format in the subformat GUID.
+      if (format == 0xfffe && size >= 26) format = u16(body + 24);
+    } else if (memcmp(&data[offset], "data", 4) == 0) {
+      samples_offset = body;
+      samples_size = size;
+    }
+    offset = body + size + (size & 1);
+  }
+  const bool pcm16 = format == 1 && bits == 16;
+  const bool float32 = format == 3 && bits == 32;
+  if (!(pcm16 || float32) || channels == 0 || samples_offset == 0) {
+    fprintf(stderr, "gvr_audio_host: %s is not 16-bit PCM or float\n",
+            filename);
+    return nullptr;
+  }
+  if (rate != GVR_AUDIO_HOST_SAMPLE_RATE) {
+    fprintf(stderr, "gvr_audio_host: %s is %u Hz, not %d Hz\n", filename,
+            rate, GVR_AUDIO_HOST_SAMPLE_RATE);
+    return nullptr;
+  }
+
+  std::shared_ptr<Sound> sound(new Sound);
+  sound->channels = channels;
+  sound->frames = samples_size / (channels * bits / 8);
+  sound->planes.assign(channels, std::vector<float>(sound->frames));
+  const uint8_t* samples = &data[samples_offset];
+  for (size_t frame = 0; frame < sound->frames; ++frame) {
+    for (uint32_t channel = 0; channel < channels; ++channel) {
+      const size_t index = frame * channels + channel;
+      float value;
+      if (pcm16) {
+        int16_t sample;
+        memcpy(&sample, samples + 2 * index, 2);
+        value = sample * (1.0f / 32768.0f);
+      } else {
+        memcpy(&value, samples + 4 * index, 4);
+      }
+      sound->planes[channel][frame] = value;
+    }
+  }
+  return sound;
+}
+
+enum SourceType {
+  kSoundObject,
+  kSoundfield,
+  kStereoSound,
+};
+
+struct Source {
+  SourceType type;
+  std::shared_ptr<const Sound> sound;
+  size_t frame;
+  bool started;
+  bool playing;
+  bool looping;
+  float volume;
+  float position[3];
+  int32_t rolloff_model;
+  float min_distance;
+  float max_distance;
+  gvr_quatf rotation;
+  // Gains reached at the end of the previous block, from which the next
+  // block ramps. Empty before the first block.
+  std::vector<float> gains;
+};
+
+/**
+ * Return the distance attenuation of |source| at |distance|.
+ */
+float Rolloff(const Source& source, float distance) {
+  switch (source.rolloff_model) {
+    case GVR_AUDIO_ROLLOFF_LOGARITHMIC:
+      if (distance <= source.min_distance) return 1.0f;
+      return source.min_distance / fminf(distance, source.max_distance);
+    case GVR_AUDIO_ROLLOFF_LINEAR:
+      if (distance <= source.min_distance) return 1.0f;
+      if (distance >= source.max_distance) return 0.0f;
+      return (source.max_distance - distance) /
+             (source.max_distance - source.min_distance);
+    default:
+      return 1.0f;
+  }
+}
+
+/**
+ * Rotate |v| by the unit quaternion |q|, or by its inverse.
+ */
+void Rotate(const gvr_quatf& q, bool inverse, const float v[3],
+            float result[3]) {
+  const float s = inverse ? -1.0f : 1.0f;
+  const float x = s * q.qx, y = s * q.qy, z = s * q.qz, w = q.qw;
+  // v + 2w (u x v) + 2 u x (u x v), with u = (x, y, z).
+  const float cx = y * v[2] - z * v[1];
+  const float cy = z * v[0] - x * v[2];
+  const float cz = x * v[1] - y * v[0];
+  result[0] = v[0] + 2.0f * (w * cx + y * cz - z * cy);
+  result[1] = v[1] + 2.0f * (w * cy + z * cx - x * cz);
+  result[2] = v[2] + 2.0f * (w * cz + x * cy - y * cx);
+}
+}  // anonymous namespace
+
+struct gvr_audio_context_ {
+  explicit gvr_audio_context_(int32_t rendering_mode);
+
+  /**
+   * Render one block of interleaved stereo into |output|.
+   */
+  void RenderBlock(float* output);
+
+  /**
+   * Copy the next block of |source| into |block|, one plane per channel,
+   * and advance it. Returns false once a sound that does not loop has
+   * ended.
+   */
+  bool ReadBlock(Source* source, std::vector<std::vector<float>>* block);
+
+  /**
+   * Compute the gains of |source| for the current head pose.
+   */
+  void ComputeGains(const Source& source, std::vector<float>* gains) const;
+
+  mutable std::mutex mutex;
+  const int32_t rendering_mode;
+  bool paused;
+  float master_volume;
+  float previous_master_volume;
+  gvr_mat4f head_pose;
+
+  std::map<std::string, std::shared_ptr<const Sound>> sounds;
+  std::map<gvr_audio_source_id, Source> sources;
+  gvr_audio_source_id next_source_id;
+
+  // Virtual speakers, as head space directions, and the order of the
+  // ambisonic decoder that pans onto them.
+  std::vector<std::array<float, 3>> speakers;
+  int order;
+
+  Fft fft;
+  // For each speaker: its feed for the current block, the previous block,
+  // the spectra of the latest kPartitions input blocks (a frequency domain
+  // delay line, indexed from delay_line_position) and the spectra of the
+  // kPartitions parts of its HRIRs, left + i * right. Spectra are stored as
+  // kFftSize real parts followed by kFftSize imaginary parts.
+  std::vector<std::vector<float>> feeds;
+  std::vector<std::vector<float>> previous_feeds;
+  std::vector<std::vector<std::vector<float>>> input_spectra;
+  std::vector<std::vector<std::vector<float>>> filter_spectra;
+  size_t delay_line_position;
+
+  // Stereo sounds, mixed into the output directly.
+  std::vector<float> direct[2];
+
+  // Scratch buffers.
+  std::vector<std::vector<float>> source_block;
+  std::vector<float> gains;
+  std::vector<float> spectrum;
+  std::vector<float> sum;
+
+  // Output rendered in the last block but not yet returned.
+  std::vector<float> pending;
+  size_t pending_frames;
+
+  FILE* wav;
+  uint32_t wav_frames;
+};
+
+gvr_audio_context_::gvr_audio_context_(int32_t rendering_mode)
+    : rendering_mode(rendering_mode),
+      paused(false),
+      master_volume(1.0f),
+      previous_master_volume(1.0f),
+      next_source_id(0),
+      order(1),
+      fft(kFftSize),
+      delay_line_position(0),
+      pending(2 * kBlockFrames),
+      pending_frames(0),
+      wav(nullptr),
+      wav_frames(0) {
+  memset(&head_pose, 0, sizeof(head_pose));
+  for (int i = 0; i < 4; ++i) head_pose.m[i][i] = 1.0f;
+
+  if (rendering_mode == GVR_AUDIO_RENDERING_STEREO_PANNING) {
+    speakers.push_back({{-1.0f, 0.0f, 0.0f}});
+    speakers.push_back({{1.0f, 0.0f, 0.0f}});
+  } else if (rendering_mode == GVR_AUDIO_RENDERING_BINAURAL_LOW_QUALITY) {
+    const float c = 1.0f / sqrtf(3.0f);
+    for (int corner = 0; corner < 8; ++corner) {
+      speakers.push_back({{corner & 1 ? c : -c, corner & 2 ? c : -c,
+                           corner & 4 ? c : -c}});
+    }
+  } else {
+    // A Fibonacci sphere: equal area bands of height, with the points
+    // spread around by the golden angle.
+    const size_t count = 16;
+    const float golden_angle = kPi * (3.0f - sqrtf(5.0f));
+    for (size_t i = 0; i < count; ++i) {
+      const float y = 1.0f - (i + 0.5f) * 2.0f / count;
+      const float radius = sqrtf(1.0f - y * y);
+      speakers.push_back({{radius * cosf(golden_angle * i), y,
+                           radius * sinf(golden_angle * i)}});
+    }
+    order = 2;
+  }
+
+  const size_t speaker_count = speakers.size();
+  feeds.assign(speaker_count, std::vector<float>(kBlockFrames));
+  direct[0].resize(kBlockFrames);
+  direct[1].resize(kBlockFrames);
+  spectrum.resize(2 * kFftSize);
+  sum.resize(2 * kFftSize);
+  if (rendering_mode == GVR_AUDIO_RENDERING_STEREO_PANNING) return;
+
+  previous_feeds.assign(speaker_count, std::vector<float>(kBlockFrames));
+  input_spectra.assign(
+      speaker_count, std::vector<std::vector<float>>(
+                         kPartitions, std::vector<float>(2 * kFftSize)));
+  filter_spectra = input_spectra;
+  const float left_ear[3] = {-1.0f, 0.0f, 0.0f};
+  const float right_ear[3] = {1.0f, 0.0f, 0.0f};
+  for (size_t speaker = 0; speaker < speaker_count; ++speaker) {
+    float left[kHrirLength];
+    float right[kHrirLength];
+    SynthesizeHrir(speakers[speaker].data(), left_ear, left);
+    SynthesizeHrir(speakers[speaker].data(), right_ear, right);
+    for (size_t partition = 0; partition < kPartitions; ++partition) {
+      std::vector<float>& filter = filter_spectra[speaker][partition];
+      for (size_t i = 0; i < kBlockFrames; ++i) {
+        filter[i] = left[partition * kBlockFrames + i];
+        filter[kFftSize + i] = right[partition * kBlockFrames + i];
+      }
+      fft.Transform(&filter[0], &filter[kFftSize], false);
+    }
+  }
+}
+
+void gvr_audio_context_::RenderBlock(float* output) {
+  if (paused) {
+    memset(output, 0, 2 * kBlockFrames * sizeof(float));
+    return;
+  }
+  for (std::vector<float>& feed : feeds) {
+    std::fill(feed.begin(), feed.end(), 0.0f);
+  }
+  std::fill(direct[0].begin(), direct[0].end(), 0.0f);
+  std::fill(direct[1].begin(), direct[1].end(), 0.0f);
+
+  const size_t speaker_count = speakers.size();
+  for (auto it = sources.begin(); it != sources.end();) {
+    Source& source = it->second;
+    if (!source.playing) {
+      ++it;
+      continue;
+    }
+    const bool more = ReadBlock(&source, &source_block);
+    ComputeGains(source, &gains);
+    if (source.gains.empty()) source.gains = gains;
+    const int channels = source.sound->channels;
+    switch (source.type) {
+      case kSoundObject: {
+        float* mono = &source_block[0][0];
+        if (channels > 1) {
+          for (int channel = 1; channel < channels; ++channel) {
+            for (size_t i = 0; i < kBlockFrames; ++i) {
+              mono[i] += source_block[channel][i];
+            }
+          }
+          for (size_t i = 0; i < kBlockFrames; ++i) mono[i] /= channels;
+        }
+        for (size_t speaker = 0; speaker < speaker_count; ++speaker) {
+          MixRamp(mono, source.gains[speaker], gains[speaker], kBlockFrames,
+                  &feeds[speaker][0]);
+        }
+        break;
+      }
+      case kSoundfield:
+        for (size_t speaker = 0; speaker < speaker_count; ++speaker) {
+          for (int channel = 0; channel < 4; ++channel) {
+            const size_t gain = 4 * speaker + channel;
+            MixRamp(&source_block[channel][0], source.gains[gain],
+                    gains[gain], kBlockFrames, &feeds[speaker][0]);
+          }
+        }
+        break;
+      case kStereoSound:
+        for (int channel = 0; channel < 2; ++channel) {
+          const int input = channel < channels ? channel : 0;
+          MixRamp(&source_block[input][0], source.gains[channel],
+                  gains[channel], kBlockFrames, &direct[channel][0]);
+        }
+        break;
+    }
+    source.gains.swap(gains);
+    if (more) {
+      ++it;
+    } else {
+      // Sources destroy themselves when they stop.
+      it = sources.erase(it);
+    }
+  }
+
+  const float* left = &feeds[0][0];
+  const float* right = &feeds[1][0];
+  if (rendering_mode != GVR_AUDIO_RENDERING_STEREO_PANNING) {
+    // Overlap-save: transform the previous and the current block of each
+    // feed, multiply the latest kPartitions spectra by the matching
+    // partitions of the HRIRs, and keep the second half of the result.
+    float* sum_re = &sum[0];
+    float* sum_im = &sum[kFftSize];
+    std::fill(sum.begin(), sum.end(), 0.0f);
+    for (size_t speaker = 0; speaker < speaker_count; ++speaker) {
+      std::vector<float>& input =
+          input_spectra[speaker][delay_line_position];
+      std::copy(previous_feeds[speaker].begin(),
+                previous_feeds[speaker].end(), input.begin());
+      std::copy(feeds[speaker].begin(), feeds[speaker].end(),
+                input.begin() + kBlockFrames);
+      std::fill(input.begin() + kFftSize, input.end(), 0.0f);
+      fft.Transform(&input[0], &input[kFftSize], false);
+      previous_feeds[speaker].swap(feeds[speaker]);
+      for (size_t partition = 0; partition < kPartitions; ++partition) {
+        const std::vector<float>& delayed =
+            input_spectra[speaker][(delay_line_position + kPartitions -
+                                    partition) %
+                                   kPartitions];
+        const std::vector<float>& filter = filter_spectra[speaker][partition];
+        ComplexMultiplyAccumulate(&delayed[0], &delayed[kFftSize],
+                                  &filter[0], &filter[kFftSize], kFftSize,
+                                  sum_re, sum_im);
+      }
+    }
+    delay_line_position = (delay_line_position + 1) % kPartitions;
+    // The HRIRs are real and packed as left + i * right, so the inverse
+    // transform holds the left ear in the real part and the right ear in the
+    // imaginary part.
+    fft.Transform(sum_re, sum_im, true);
+    left = sum_re + kBlockFrames;
+    right = sum_im + kBlockFrames;
+  }
+
+  const float master_step =
+      (master_volume - previous_master_volume) / kBlockFrames;
+  for (size_t i = 0; i < kBlockFrames; ++i) {
+    const float master = previous_master_volume + master_step * (i + 1);
+    output[2 * i] = (left[i] + direct[0][i]) * master;
+    output[2 * i + 1] = (right[i] + direct[1][i]) * master;
+  }
+  previous_master_volume = master_volume;
+}
+
+bool gvr_audio_context_::ReadBlock(Source* source,
+                                   std::vector<std::vector<float>>* block) {
+  const Sound& sound = *source->sound;
+  block->resize(sound.channels);
+  for (std::vector<float>& plane : *block) plane.resize(kBlockFrames);
+  size_t done = 0;
+  bool more = true;
+  while (done < kBlockFrames) {
+    if (source->frame >= sound.frames) {
+      if (!source->looping || sound.frames == 0) {
+        more = false;
+        break;
+      }
+      source->frame = 0;
+    }
+    const size_t count =
+        std::min(kBlockFrames - done, sound.frames - source->frame);
+    for (int channel = 0; channel < sound.channels; ++channel) {
+      memcpy(&(*block)[channel][done], &sound.planes[channel][source->frame],
+             count * sizeof(float));
+    }
+    done += count;
+    source->frame += count;
+  }
+  for (std::vector<float>& plane : *block) {
+    std::fill(plane.begin() + done, plane.end(), 0.0f);
+  }
+  return more;
+}
+
+void gvr_audio_context_::ComputeGains(const Source& source,
+                                      std::vector<float>* gains) const {
+  const size_t speaker_count = speakers.size();
+  const float(&m)[4][4] = head_pose.m;
+  switch (source.type) {
+    case kSoundObject: {
+      float relative[3];
+      for (int i = 0; i < 3; ++i) {
+        relative[i] = m[i][0] * source.position[0] +
+                      m[i][1] * source.position[1] +
+                      m[i][2] * source.position[2] + m[i][3];
+      }
+      const float distance =
+          sqrtf(relative[0] * relative[0] + relative[1] * relative[1] +
+                relative[2] * relative[2]);
+      // A source at the listener is heard from the front.
+      float direction[3] = {0.0f, 0.0f, -1.0f};
+      if (distance > 1e-6f) {
+        for (int i = 0; i < 3; ++i) direction[i] = relative[i] / distance;
+      }
+      const float gain = source.volume * Rolloff(source, distance);
+      gains->resize(speaker_count);
+      if (rendering_mode == GVR_AUDIO_RENDERING_STEREO_PANNING) {
+        const float angle = 0.25f * kPi * (direction[0] + 1.0f);
+        (*gains)[0] = gain * cosf(angle);
+        (*gains)[1] = gain * sinf(angle);
+        return;
+      }
+      for (size_t speaker = 0; speaker < speaker_count; ++speaker) {
+        const float* d = speakers[speaker].data();
+        const float cos_angle = direction[0] * d[0] +
+                                direction[1] * d[1] +
+                                direction[2] * d[2];
+        float speaker_gain = 0.0f;
+        for (int l = 0; l <= order; ++l) {
+          speaker_gain += (2 * l + 1) * MaxReWeight(l, order) *
+                          Legendre(l, cos_angle);
+        }
+        (*gains)[speaker] = gain * speaker_gain / speaker_count;
+      }
+      return;
+    }
+    case kSoundfield: {
+      // Soundfields are first order, so they are decoded at first order.
+      const float weight = 3.0f * MaxReWeight(1, 1);
+      const float scale = source.volume / speaker_count;
+      gains->resize(4 * speaker_count);
+      for (size_t speaker = 0; speaker < speaker_count; ++speaker) {
+        // The speaker direction in the world, then in the soundfield.
+        const float* d = speakers[speaker].data();
+        float world[3];
+        for (int j = 0; j < 3; ++j) {
+          world[j] = m[0][j] * d[0] + m[1][j] * d[1] + m[2][j] * d[2];
+        }
+        float field[3];
+        Rotate(source.rotation, true, world, field);
+        // ACN channel order W, Y, Z, X, with ambisonic X forward (-z), Y
+        // left (-x) and Z up (y).
+        float* speaker_gains = &(*gains)[4 * speaker];
+        speaker_gains[0] = scale;
+        speaker_gains[1] = scale * weight * -field[0];
+        speaker_gains[2] = scale * weight * field[1];
+        speaker_gains[3] = scale * weight * -field[2];
+      }
+      return;
+    }
+    case kStereoSound:
+      gains->assign(2, source.volume);
+      return;
+  }
+}
+
+namespace {
+gvr_audio_source_id CreateSource(gvr_audio_context* api, const char* filename,
+                                 SourceType type) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  auto sound = api->sounds.find(filename);
+  if (sound == api->sounds.end()) return kInvalidSourceId;
+  const int channels = sound->second->channels;
+  if ((type == kSoundfield && channels != 4) ||
+      (type == kStereoSound && channels > 2)) {
+    return kInvalidSourceId;
+  }
+  Source source;
+  source.type = type;
+  source.sound = sound->second;
+  source.frame = 0;
+  source.started = false;
+  source.playing = false;
+  source.looping = false;
+  source.volume = 1.0f;
+  source.position[0] = source.position[1] = source.position[2] = 0.0f;
+  source.rolloff_model = GVR_AUDIO_ROLLOFF_LOGARITHMIC;
+  source.min_distance = kDefaultMinDistance;
+  source.max_distance = kDefaultMaxDistance;
+  source.rotation.qx = source.rotation.qy = source.rotation.qz = 0.0f;
+  source.rotation.qw = 1.0f;
+  const gvr_audio_source_id id = api->next_source_id++;
+  api->sources[id] = source;
+  return id;
+}
+
+Source* FindSource(gvr_audio_context* api, gvr_audio_source_id source_id) {
+  auto source = api->sources.find(source_id);
+  return source == api->sources.end() ? nullptr : &source->second;
+}
+
+void WriteU32(FILE* file, uint32_t value) {
+  const uint8_t bytes[4] = {
+      static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+      static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+  fwrite(bytes, 1, 4, file);
+}
+
+void WriteU16(FILE* file, uint16_t value) {
+  const uint8_t bytes[2] = {static_cast<uint8_t>(value),
+                            static_cast<uint8_t>(value >> 8)};
+  fwrite(bytes, 1, 2, file);
+}
+
+/**
+ * Write the header of a stereo float WAV file of |frames| frames.
+ */
+void WriteWavHeader(FILE* file, uint32_t frames) {
+  const uint32_t data_size = frames * 2 * sizeof(float);
+  fwrite("RIFF", 1, 4, file);
+  WriteU32(file, 36 + data_size);
+  fwrite("WAVEfmt ", 1, 8, file);
+  WriteU32(file, 16);
+  WriteU16(file, 3);  // IEEE float.
+  WriteU16(file, 2);
+  WriteU32(file, GVR_AUDIO_HOST_SAMPLE_RATE);
+  WriteU32(file, GVR_AUDIO_HOST_SAMPLE_RATE * 2 * sizeof(float));
+  WriteU16(file, 2 * sizeof(float));
+  WriteU16(file, 32);
+  fwrite("data", 1, 4, file);
+  WriteU32(file, data_size);
+}
+}  // anonymous namespace
+
+gvr_audio_context* gvr_audio_create(int32_t rendering_mode) {
+  if (rendering_mode < GVR_AUDIO_RENDERING_STEREO_PANNING ||
+      rendering_mode > GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY) {
+    return nullptr;
+  }
+  return new gvr_audio_context(rendering_mode);
+}
+
+void gvr_audio_destroy(gvr_audio_context** api) {
+  if (!api || !*api) return;
+  if ((*api)->wav) {
+    // Now that the length is known, fill it in.
+    fseek((*api)->wav, 0, SEEK_SET);
+    WriteWavHeader((*api)->wav, (*api)->wav_frames);
+    fclose((*api)->wav);
+  }
+  delete *api;
+  *api = nullptr;
+}
+
+void gvr_audio_resume(gvr_audio_context* api) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  api->paused = false;
+}
+
+void gvr_audio_pause(gvr_audio_context* api) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  api->paused = true;
+}
+
+void gvr_audio_update(gvr_audio_context* /* api */) {
+  // The host renderer has no background work: everything happens in
+  // gvr_audio_host_render().
+}
+
+bool gvr_audio_preload_soundfile(gvr_audio_context* api,
+                                 const char* filename) {
+  {
+    std::lock_guard<std::mutex> lock(api->mutex);
+    if (api->sounds.count(filename)) return true;
+  }
+  std::shared_ptr<Sound> sound = ReadWav(filename);
+  if (!sound) return false;
+  std::lock_guard<std::mutex> lock(api->mutex);
+  api->sounds[filename] = sound;
+  return true;
+}
+
+void gvr_audio_unload_soundfile(gvr_audio_context* api,
+                                const char* filename) {
+  // Sources playing the sound keep it until they stop.
+  std::lock_guard<std::mutex> lock(api->mutex);
+  api->sounds.erase(filename);
+}
+
+gvr_audio_source_id gvr_audio_create_sound_object(gvr_audio_context* api,
+                                                  const char* filename) {
+  return CreateSource(api, filename, kSoundObject);
+}
+
+gvr_audio_source_id gvr_audio_create_soundfield(gvr_audio_context* api,
+                                                const char* filename) {
+  return CreateSource(api, filename, kSoundfield);
+}
+
+gvr_audio_source_id gvr_audio_create_stereo_sound(gvr_audio_context* api,
+                                                  const char* filename) {
+  return CreateSource(api, filename, kStereoSound);
+}
+
+void gvr_audio_play_sound(gvr_audio_context* api, gvr_audio_source_id source_id,
+                          bool looping_enabled) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  Source* source = FindSource(api, source_id);
+  if (!source) return;
+  source->started = true;
+  source->playing = true;
+  source->looping = looping_enabled;
+}
+
+void gvr_audio_pause_sound(gvr_audio_context* api,
+                           gvr_audio_source_id source_id) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  Source* source = FindSource(api, source_id);
+  if (source) source->playing = false;
+}
+
+void gvr_audio_resume_sound(gvr_audio_context* api,
+                            gvr_audio_source_id source_id) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  Source* source = FindSource(api, source_id);
+  if (source && source->started) source->playing = true;
+}
+
+void gvr_audio_stop_sound(gvr_audio_context* api,
+                          gvr_audio_source_id source_id) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  api->sources.erase(source_id);
+}
+
+bool gvr_audio_is_sound_playing(const gvr_audio_context* api,
+                                gvr_audio_source_id source_id) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  auto source = api->sources.find(source_id);
+  return source != api->sources.end() && source->second.playing;
+}
+
+bool gvr_audio_is_source_id_valid(const gvr_audio_context* api,
+                                  gvr_audio_source_id source_id) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  return api->sources.count(source_id) != 0;
+}
+
+void gvr_audio_set_sound_object_position(gvr_audio_context* api,
+                                         gvr_audio_source_id sound_object_id,
+                                         float x, float y, float z) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  Source* source = FindSource(api, sound_object_id);
+  if (!source || source->type != kSoundObject) return;
+  source->position[0] = x;
+  source->position[1] = y;
+  source->position[2] = z;
+}
+
+void gvr_audio_set_soundfield_rotation(gvr_audio_context* api,
+                                       gvr_audio_source_id soundfield_id,
+                                       gvr_quatf soundfield_rotation) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  Source* source = FindSource(api, soundfield_id);
+  if (source && source->type == kSoundfield) {
+    source->rotation = soundfield_rotation;
+  }
+}
+
+void gvr_audio_set_sound_object_distance_rolloff_model(
+    gvr_audio_context* api, gvr_audio_source_id sound_object_id,
+    int32_t rolloff_model, float min_distance, float max_distance) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  Source* source = FindSource(api, sound_object_id);
+  if (!source || source->type != kSoundObject) return;
+  if (rolloff_model != GVR_AUDIO_ROLLOFF_NONE &&
+      max_distance <= min_distance) {
+    return;
+  }
+  source->rolloff_model = rolloff_model;
+  source->min_distance = min_distance;
+  source->max_distance = max_distance;
+}
+
+void gvr_audio_set_master_volume(gvr_audio_context* api, float volume) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  api->master_volume = volume;
+}
+
+void gvr_audio_set_sound_volume(gvr_audio_context* api,
+                                gvr_audio_source_id source_id, float volume) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  Source* source = FindSource(api, source_id);
+  if (source) source->volume = volume;
+}
+
+void gvr_audio_set_head_pose(gvr_audio_context* api,
+                             gvr_mat4f head_pose_matrix) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  api->head_pose = head_pose_matrix;
+}
+
+void gvr_audio_enable_room(gvr_audio_context* /* api */,
+                           bool /* enable */) {}
+
+void gvr_audio_set_room_properties(gvr_audio_context* /* api */,
+                                   float /* size_x */, float /* size_y */,
+                                   float /* size_z */,
+                                   int32_t /* wall_material */,
+                                   int32_t /* ceiling_material */,
+                                   int32_t /* floor_material */) {}
+
+void gvr_audio_set_room_reverb_adjustments(gvr_audio_context* /* api */,
+                                           float /* gain */,
+                                           float /* time_adjust */,
+                                           float /* brightness_adjust */) {}
+
+void gvr_audio_enable_stereo_speaker_mode(gvr_audio_context* /* api */,
+                                          bool /* enable */) {}
+
+void gvr_audio_host_render(gvr_audio_context* api, float* output,
+                           size_t frames) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  while (frames > 0) {
+    if (api->pending_frames == 0) {
+      api->RenderBlock(&api->pending[0]);
+      api->pending_frames = kBlockFrames;
+    }
+    const size_t count = std::min(frames, api->pending_frames);
+    const float* block =
+        &api->pending[2 * (kBlockFrames - api->pending_frames)];
+    if (output) {
+      memcpy(output, block, 2 * count * sizeof(float));
+      output += 2 * count;
+    }
+    if (api->wav) {
+      fwrite(block, sizeof(float), 2 * count, api->wav);
+      api->wav_frames += count;
+    }
+    api->pending_frames -= count;
+    frames -= count;
+  }
+}
+
+bool gvr_audio_host_open_wav_sink(gvr_audio_context* api,
+                                  const char* filename) {
+  std::lock_guard<std::mutex> lock(api->mutex);
+  if (api->wav) return false;
+  api->wav = fopen(filename, "wb");
+  if (!api->wav) return false;
+  // The sizes are filled in when the context is destroyed.
+  WriteWavHeader(api->wav, 0);
+  api->wav_frames = 0;
+  return true;
+}
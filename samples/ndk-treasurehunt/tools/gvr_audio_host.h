@@ -0,0 +1,60 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_TOOLS_GVRAUDIOHOST_H_  // NOLINT
+#define TREASUREHUNT_TOOLS_GVRAUDIOHOST_H_  // NOLINT
+
+#include <stddef.h>
+
+#include "vr/gvr/capi/include/gvr_audio.h"
+
+/**
+ * Host-only additions to the gvr_audio C API, implemented together with it
+ * in gvr_audio_host.cc, a reference renderer for Linux.
+ *
+ * The host renderer has no audio device. Instead of an audio thread pulling
+ * buffers, the caller renders the output with gvr_audio_host_render(), which
+ * makes runs deterministic and lets them go faster than real time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Output sample rate, which sound files must also have. */
+#define GVR_AUDIO_HOST_SAMPLE_RATE 48000
+
+/**
+ * Render |frames| frames of interleaved stereo float output into |output|,
+ * which may be null to discard it, and append them to the WAV sink if one is
+ * open. While the engine is paused the output is silent and the sounds do
+ * not advance.
+ */
+void gvr_audio_host_render(gvr_audio_context* api, float* output,
+                           size_t frames);
+
+/**
+ * Open a 32-bit float stereo WAV file that receives everything rendered from
+ * now on, until the context is destroyed. Returns false if the file cannot
+ * be created.
+ */
+bool gvr_audio_host_open_wav_sink(gvr_audio_context* api,
+                                  const char* filename);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif  // TREASUREHUNT_TOOLS_GVRAUDIOHOST_H_  // NOLINT
@@ -0,0 +1,269 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side measurement of the hidden-area mask in
+// src/main/jni/hidden_area_mesh.h for the default Cardboard viewer profiles,
+// run against the GL stub in gl_stub.h.
+//
+// The lens distortion of each viewer is modeled as GVR describes viewer
+// profiles: a point of the screen at tangent-angle radius r_d from the
+// center of the lens shows the point of the eye buffer at radius r_u, where
+// r_d = r_u * (1 + k1 * r_u^2 + k2 * r_u^4). The field of view of the eye is
+// the viewer's maximum, clipped to what the screen edges show. The phone is
+// a 5.5" 16:9 screen in landscape.
+//
+// For each viewer, the tool builds the mask of the left eye through
+// HiddenAreaMesh::Update() and rasterizes it, then samples the screen
+// densely to find the pixels of the eye buffer that are actually shown. It
+// reports the area of the mask, the fraction of the buffer that is hidden,
+// and how much of it the mask covers, and checks that:
+//
+//  * the area from HiddenAreaMesh matches the rasterized coverage;
+//  * the mask covers almost no pixel that is shown (it errs on the side of
+//    drawing);
+//  * the mask covers most of the hidden pixels;
+//  * Draw() draws every vertex of the mask with color writes disabled.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -I../../../libraries/headers
+//       -o hidden_area_coverage hidden_area_coverage.cc gl_stub.cc
+//       $JNI/hidden_area_mesh.cc
+//   ./hidden_area_coverage [resolution]
+
+#include <GLES2/gl2.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gl_stub.h"           // NOLINT
+#include "hidden_area_mesh.h"  // NOLINT
+
+namespace {
+const float kPi = 3.14159265f;
+
+// Pixel XL class screen: 5.5", 16:9, in meters.
+const float kScreenWidth = 0.1218f;
+const float kScreenHeight = 0.0685f;
+// Distance from the bottom edge of the phone to the bottom of the screen.
+const float kBottomBezel = 0.0035f;
+
+// The parameters of a viewer profile, in meters and degrees.
+struct Viewer {
+  const char* name;
+  float inter_lens_distance;
+  float screen_to_lens_distance;
+  float tray_to_lens_distance;
+  float field_of_view;  // Maximum on every side.
+  float k1;
+  float k2;
+};
+
+const Viewer kViewers[] = {
+    {"Cardboard v1", 0.060f, 0.042f, 0.035f, 40.0f, 0.441f, 0.156f},
+    {"Cardboard v2", 0.064f, 0.039f, 0.035f, 60.0f, 0.34f, 0.55f},
+};
+
+// The screen half and lens of the left eye, and the field of view it shows.
+class EyeModel {
+ public:
+  explicit EyeModel(const Viewer& viewer) : viewer_(viewer) {
+    lens_x_ = kScreenWidth / 2 - viewer.inter_lens_distance / 2;
+    lens_y_ = viewer.tray_to_lens_distance - kBottomBezel;
+    const float d = viewer.screen_to_lens_distance;
+    const float max_tan = tanf(viewer.field_of_view * kPi / 180.0f);
+    left_ = -std::min(max_tan, Undistort(lens_x_ / d));
+    right_ = std::min(max_tan, Undistort((kScreenWidth / 2 - lens_x_) / d));
+    bottom_ = -std::min(max_tan, Undistort(lens_y_ / d));
+    top_ = std::min(max_tan, Undistort((kScreenHeight - lens_y_) / d));
+  }
+
+  // Maps a point of the eye's half of the screen to the point of the eye
+  // buffer shown there, both in [0, 1]^2.
+  gvr_vec2f Distort(const gvr_vec2f& screen) const {
+    const float d = viewer_.screen_to_lens_distance;
+    const float x = (screen.x * kScreenWidth / 2 - lens_x_) / d;
+    const float y = (screen.y * kScreenHeight - lens_y_) / d;
+    const float r_d = sqrtf(x * x + y * y);
+    const float scale = r_d > 0.0f ? Undistort(r_d) / r_d : 1.0f;
+    return {(x * scale - left_) / (right_ - left_),
+            (y * scale - bottom_) / (top_ - bottom_)};
+  }
+
+  void PrintFov() const {
+    printf("  field of view: left %.1f, right %.1f, bottom %.1f, top %.1f\n",
+           atanf(-left_) * 180.0f / kPi, atanf(right_) * 180.0f / kPi,
+           atanf(-bottom_) * 180.0f / kPi, atanf(top_) * 180.0f / kPi);
+  }
+
+ private:
+  // Solves r_d = r_u * (1 + k1 * r_u^2 + k2 * r_u^4) for r_u.
+  float Undistort(float r_d) const {
+    float r_u = r_d;
+    for (int i = 0; i < 20; ++i) {
+      const float r2 = r_u * r_u;
+      const float f = r_u * (1.0f + viewer_.k1 * r2 + viewer_.k2 * r2 * r2) -
+                      r_d;
+      const float df =
+          1.0f + 3.0f * viewer_.k1 * r2 + 5.0f * viewer_.k2 * r2 * r2;
+      r_u -= f / df;
+    }
+    return r_u;
+  }
+
+  const Viewer& viewer_;
+  float lens_x_;
+  float lens_y_;
+  float left_;
+  float right_;
+  float bottom_;
+  float top_;
+};
+
+bool ok = true;
+
+void Check(bool condition, const std::string& what) {
+  printf("%s: %s\n", condition ? "PASS" : "FAIL", what.c_str());
+  if (!condition) ok = false;
+}
+
+// Sets the pixels of a |resolution|^2 grid whose centers are inside the
+// triangles of |mesh|.
+std::vector<bool> Rasterize(const std::vector<float>& mesh, int resolution) {
+  std::vector<bool> covered(resolution * resolution, false);
+  for (size_t t = 0; t + 6 <= mesh.size(); t += 6) {
+    const float* v = &mesh[t];
+    const float area =
+        (v[2] - v[0]) * (v[5] - v[1]) - (v[4] - v[0]) * (v[3] - v[1]);
+    if (area == 0.0f) continue;
+    const float sign = area > 0.0f ? 1.0f : -1.0f;
+    const int x0 = std::max(
+        0, static_cast<int>(std::min({v[0], v[2], v[4]}) * resolution));
+    const int x1 = std::min(
+        resolution - 1,
+        static_cast<int>(std::max({v[0], v[2], v[4]}) * resolution));
+    const int y0 = std::max(
+        0, static_cast<int>(std::min({v[1], v[3], v[5]}) * resolution));
+    const int y1 = std::min(
+        resolution - 1,
+        static_cast<int>(std::max({v[1], v[3], v[5]}) * resolution));
+    for (int y = y0; y <= y1; ++y) {
+      const float py = (y + 0.5f) / resolution;
+      for (int x = x0; x <= x1; ++x) {
+        const float px = (x + 0.5f) / resolution;
+        bool inside = true;
+        for (int e = 0; e < 3 && inside; ++e) {
+          const float* a = &v[2 * e];
+          const float* b = &v[2 * ((e + 1) % 3)];
+          const float edge =
+              (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+          inside = sign * edge >= 0.0f;
+        }
+        if (inside) covered[y * resolution + x] = true;
+      }
+    }
+  }
+  return covered;
+}
+
+// Sets the pixels of a |resolution|^2 grid of the eye buffer that some
+// point of the screen shows.
+std::vector<bool> FindShown(const EyeModel& eye, int resolution) {
+  std::vector<bool> shown(resolution * resolution, false);
+  const int samples = 4 * resolution;
+  for (int j = 0; j <= samples; ++j) {
+    for (int i = 0; i <= samples; ++i) {
+      const gvr_vec2f uv = eye.Distort(
+          {static_cast<float>(i) / samples, static_cast<float>(j) / samples});
+      const int x = static_cast<int>(floorf(uv.x * resolution));
+      const int y = static_cast<int>(floorf(uv.y * resolution));
+      if (x >= 0 && x < resolution && y >= 0 && y < resolution) {
+        shown[y * resolution + x] = true;
+      }
+    }
+  }
+  return shown;
+}
+
+void MeasureViewer(const Viewer& viewer, int resolution) {
+  printf("%s\n", viewer.name);
+  const EyeModel eye(viewer);
+  eye.PrintFov();
+  GlStubReset("OpenGL ES 3.0", "");
+  GlStubSetViewer(viewer.name, [&eye](int32_t /* eye */, const gvr_vec2f& in,
+                                     gvr_vec2f out[3]) {
+    out[0] = out[1] = out[2] = eye.Distort(in);
+  });
+
+  std::unique_ptr<gvr::GvrApi> gvr_api =
+      gvr::GvrApi::WrapNonOwned(reinterpret_cast<gvr_context*>(&ok));
+  HiddenAreaMesh mesh;
+  mesh.InitializeGl();
+  mesh.Update(gvr_api.get(), GVR_LEFT_EYE, {-1.0f, 1.0f, -1.0f, 1.0f});
+  const std::vector<float> vertices = HiddenAreaMesh::BuildMesh(
+      [&eye](const gvr::Vec2f& uv) { return eye.Distort(uv); });
+  const float mesh_area = mesh.GetHiddenFraction(GVR_LEFT_EYE);
+
+  const std::vector<bool> covered = Rasterize(vertices, resolution);
+  const std::vector<bool> shown = FindShown(eye, resolution);
+  int covered_count = 0, hidden_count = 0, covered_hidden = 0;
+  int covered_shown = 0;
+  for (int i = 0; i < resolution * resolution; ++i) {
+    if (covered[i]) ++covered_count;
+    if (!shown[i]) ++hidden_count;
+    if (covered[i] && !shown[i]) ++covered_hidden;
+    if (covered[i] && shown[i]) ++covered_shown;
+  }
+  const float pixels = static_cast<float>(resolution) * resolution;
+  const float rasterized = covered_count / pixels;
+  const float hidden = hidden_count / pixels;
+  const float masked =
+      hidden_count > 0 ? static_cast<float>(covered_hidden) / hidden_count
+                       : 1.0f;
+  const float overdraw = covered_shown / pixels;
+  printf("  mask: %zu triangles, area %.2f%%, rasterized %.2f%%\n",
+         vertices.size() / 6, 100.0f * mesh_area, 100.0f * rasterized);
+  printf("  hidden: %.2f%% of the buffer, %.1f%% of it masked\n",
+         100.0f * hidden, 100.0f * masked);
+  printf("  shown pixels masked: %.3f%% of the buffer\n", 100.0f * overdraw);
+
+  const std::string name = viewer.name;
+  Check(fabsf(mesh_area - rasterized) < 0.005f,
+        name + ": mask area matches its rasterization");
+  Check(overdraw < 0.002f, name + ": mask hides almost nothing shown");
+  Check(masked > 0.8f, name + ": mask covers most of the hidden area");
+
+  GlStubClearCalls();
+  mesh.Draw(GVR_LEFT_EYE);
+  char text[64];
+  snprintf(text, sizeof(text), "glDrawArrays(%#x, 0, %zu)", GL_TRIANGLES,
+           vertices.size() / 2);
+  Check(GlStubFind("glColorMask(0, 0, 0, 0)") >= 0 && GlStubFind(text) > 0 &&
+            GlStubCalls().back() == "glColorMask(1, 1, 1, 1)",
+        name + ": Draw() draws the mask without color writes");
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int resolution = argc > 1 ? atoi(argv[1]) : 512;
+  for (const Viewer& viewer : kViewers) MeasureViewer(viewer, resolution);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side benchmark of the light binning in src/main/jni/light_clusters.h.
+//
+// For each number of point lights, scattered around a viewer with the field
+// of view of a Daydream eye, the tool reports the time to bin them, per
+// binning and per light, and how many lights a fragment evaluates on
+// average, against the number that actually reach it. It also checks, at
+// random points of the frustum, that the cluster of each point lists every
+// light whose sphere contains it.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -o light_clusters_bench
+//       light_clusters_bench.cc $JNI/light_clusters.cc
+//   ./light_clusters_bench
+//
+// Add -DLIGHT_CLUSTERS_DISABLE_SIMD to measure the portable code.
+
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>  // NOLINT
+#include <random>
+#include <vector>
+
+#include "light_clusters.h"  // NOLINT
+
+namespace {
+const int kLightCounts[] = {32, 64, 128, 256, 512, 1024};
+
+// Each measurement bins at least this many lights.
+const int kLightsPerMeasurement = 20000000;
+
+const int kPointsPerCheck = 20000;
+
+const float kFov = 50.0f;
+const float kZNear = 1.0f;
+const float kZFar = 100.0f;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Returns the lights of |clusters| that contain |point|, in view space, and
+// the number of lights listed in its cluster.
+void Evaluate(const LightClusters& clusters, const float point[3],
+              int* listed_containing, int* listed) {
+  float tiles[4], slices[2];
+  clusters.GetTileTransform(tiles);
+  clusters.GetSliceTransform(slices);
+  const float depth = -point[2];
+  int x = static_cast<int>(floorf(point[0] / depth * tiles[0] + tiles[1]));
+  int y = static_cast<int>(floorf(point[1] / depth * tiles[2] + tiles[3]));
+  int z = static_cast<int>(floorf(logf(depth) * slices[0] + slices[1]));
+  x = std::min(std::max(x, 0), LightClusters::kTilesX - 1);
+  y = std::min(std::max(y, 0), LightClusters::kTilesY - 1);
+  z = std::min(std::max(z, 0), LightClusters::kSlices - 1);
+  const int cluster =
+      (z * LightClusters::kTilesY + y) * LightClusters::kTilesX + x;
+  const int first = static_cast<int>(clusters.GetClusterData()[2 * cluster]);
+  *listed = static_cast<int>(clusters.GetClusterData()[2 * cluster + 1]);
+  *listed_containing = 0;
+  for (int i = 0; i < *listed; ++i) {
+    const int slot = static_cast<int>(clusters.GetIndexData()[first + i]);
+    const float* sphere = &clusters.GetLightData()[4 * slot];
+    float distance_squared = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+      const float d = sphere[axis] - point[axis];
+      distance_squared += d * d;
+    }
+    *listed_containing += distance_squared < sphere[3] * sphere[3];
+  }
+}
+}  // namespace
+
+int main() {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  // A viewer looking down a little, turned to the side.
+  const float pitch = -0.3f, yaw = 0.7f;
+  const float view[4][4] = {
+      {cosf(yaw), 0.0f, -sinf(yaw), 0.0f},
+      {sinf(pitch) * sinf(yaw), cosf(pitch), sinf(pitch) * cosf(yaw), 0.0f},
+      {cosf(pitch) * sinf(yaw), -sinf(pitch), cosf(pitch) * cosf(yaw), 0.0f},
+      {0.0f, 0.0f, 0.0f, 1.0f}};
+
+  LightClusters clusters;
+  clusters.SetFrustum(kFov, kFov, kFov, kFov, kZNear, kZFar);
+  const float tangent = tanf(kFov * 3.14159265f / 180.0f);
+
+  bool ok = true;
+  printf("%8s %10s %10s %10s %12s %12s %10s\n", "lights", "visible",
+         "us/bin", "ns/light", "evaluated", "reaching", "missed");
+  for (int light_count : kLightCounts) {
+    std::vector<PointLight> lights(light_count);
+    for (PointLight& light : lights) {
+      light.position[0] = 120.0f * unit(random) - 60.0f;
+      light.position[1] = 30.0f * unit(random) - 20.0f;
+      light.position[2] = 120.0f * unit(random) - 60.0f;
+      light.radius = 2.0f + 6.0f * unit(random);
+      for (int c = 0; c < 3; ++c) light.color[c] = unit(random);
+    }
+
+    const LightClusterStats before = clusters.GetStats();
+    const int repeats = kLightsPerMeasurement / light_count;
+    const double start = NowSeconds();
+    for (int r = 0; r < repeats; ++r) {
+      clusters.Bin(lights.data(), lights.size(), view);
+    }
+    const double seconds = (NowSeconds() - start) / repeats;
+
+    // Every light that reaches a point must be listed in its cluster, unless
+    // lights were dropped.
+    double evaluated = 0.0, reaching = 0.0;
+    int missed = 0;
+    for (int p = 0; p < kPointsPerCheck; ++p) {
+      const float depth = kZNear * powf(kZFar / kZNear, unit(random));
+      const float point[3] = {(2.0f * unit(random) - 1.0f) * tangent * depth,
+                              (2.0f * unit(random) - 1.0f) * tangent * depth,
+                              -depth};
+      int containing = 0;
+      for (int slot = 0; slot < clusters.GetVisibleLightCount(); ++slot) {
+        const float* sphere = &clusters.GetLightData()[4 * slot];
+        float distance_squared = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+          const float d = sphere[axis] - point[axis];
+          distance_squared += d * d;
+        }
+        containing += distance_squared < sphere[3] * sphere[3];
+      }
+      int listed_containing, listed;
+      Evaluate(clusters, point, &listed_containing, &listed);
+      evaluated += listed;
+      reaching += containing;
+      missed += containing - listed_containing;
+    }
+    const LightClusterStats after = clusters.GetStats();
+    printf("%8d %10d %10.2f %10.1f %12.2f %12.2f %10d\n", light_count,
+           clusters.GetVisibleLightCount(), 1e6 * seconds,
+           1e9 * seconds / light_count, evaluated / kPointsPerCheck,
+           reaching / kPointsPerCheck, missed);
+    if (after.lights_dropped == before.lights_dropped &&
+        after.cluster_overflows == before.cluster_overflows) {
+      ok &= missed == 0;
+    }
+  }
+  const LightClusterStats stats = clusters.GetStats();
+  printf("dropped lights: %llu, cluster overflows: %llu\n",
+         static_cast<unsigned long long>(stats.lights_dropped),     // NOLINT
+         static_cast<unsigned long long>(stats.cluster_overflows));  // NOLINT
+  printf("%s: clusters list every light reaching their points\n",
+         ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
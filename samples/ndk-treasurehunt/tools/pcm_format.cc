@@ -0,0 +1,422 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pcm_format.h"  // NOLINT
+
+#include <assert.h>
+#include <math.h>
+
+#if !defined(PCM_FORMAT_DISABLE_SIMD)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PCM_FORMAT_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PCM_FORMAT_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace {
+// Samples are converted in blocks of this many frames, so that the dither
+// and the planes being (de)interleaved stay in L1 cache.
+static const size_t kBlockFrames = 64;
+
+static const float kInt16Scale = 32768.0f;
+static const float kInverseInt16Scale = 1.0f / 32768.0f;
+static const float kInt16Min = -32768.0f;
+static const float kInt16Max = 32767.0f;
+
+#if defined(PCM_FORMAT_NEON) && !defined(__aarch64__)
+// Adding and subtracting 1.5 * 2^23 rounds a float of magnitude below 2^22
+// to the nearest integer, ties to even, as vcvtnq_s32_f32 does on AArch64.
+static const float kRoundingBias = 12582912.0f;
+#endif
+
+/**
+ * Fill |dither| with |count| TPDF dither values in (-1, 1) LSB: each is the
+ * sum of two uniform values taken from the halves of a xorshift32 output.
+ * The four generators are independent, so that the compiler can vectorize
+ * the loop.
+ */
+static void FillDither(PcmDither* state, size_t count, float* dither) {
+  uint32_t* s = state->state;
+  for (size_t i = 0; i < count; i += 4) {
+    float values[4];
+    for (int lane = 0; lane < 4; ++lane) {
+      uint32_t x = s[lane];
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      s[lane] = x;
+      const int32_t sum = static_cast<int32_t>((x & 0xffff) + (x >> 16));
+      values[lane] = static_cast<float>(sum - 0xffff) * (1.0f / 65536.0f);
+    }
+    for (size_t lane = 0; lane < 4 && i + lane < count; ++lane) {
+      dither[i + lane] = values[lane];
+    }
+  }
+}
+
+static inline int16_t FloatToInt16(float sample, float dither) {
+  float x = sample * kInt16Scale + dither;
+  x = x < kInt16Min ? kInt16Min : x;
+  x = x > kInt16Max ? kInt16Max : x;
+  // lrintf rounds to nearest, ties to even, like the SIMD paths.
+  return static_cast<int16_t>(lrintf(x));
+}
+
+/**
+ * Convert |count| samples; |dither| is null or holds |count| values.
+ */
+static void ConvertBlock(const float* input, const float* dither,
+                         size_t count, int16_t* output) {
+  size_t i = 0;
+#if defined(PCM_FORMAT_NEON)
+  const float32x4_t scale = vdupq_n_f32(kInt16Scale);
+  const float32x4_t low = vdupq_n_f32(kInt16Min);
+  const float32x4_t high = vdupq_n_f32(kInt16Max);
+  for (; i + 8 <= count; i += 8) {
+    float32x4_t x0 = vmulq_f32(vld1q_f32(input + i), scale);
+    float32x4_t x1 = vmulq_f32(vld1q_f32(input + i + 4), scale);
+    if (dither) {
+      x0 = vaddq_f32(x0, vld1q_f32(dither + i));
+      x1 = vaddq_f32(x1, vld1q_f32(dither + i + 4));
+    }
+    x0 = vminq_f32(vmaxq_f32(x0, low), high);
+    x1 = vminq_f32(vmaxq_f32(x1, low), high);
+#if defined(__aarch64__)
+    const int32x4_t i0 = vcvtnq_s32_f32(x0);
+    const int32x4_t i1 = vcvtnq_s32_f32(x1);
+#else
+    const float32x4_t bias = vdupq_n_f32(kRoundingBias);
+    const int32x4_t i0 = vcvtq_s32_f32(vsubq_f32(vaddq_f32(x0, bias), bias));
+    const int32x4_t i1 = vcvtq_s32_f32(vsubq_f32(vaddq_f32(x1, bias), bias));
+#endif
+    vst1q_s16(output + i, vcombine_s16(vqmovn_s32(i0), vqmovn_s32(i1)));
+  }
+#elif defined(PCM_FORMAT_SSE2)
+  const __m128 scale = _mm_set1_ps(kInt16Scale);
+  const __m128 low = _mm_set1_ps(kInt16Min);
+  const __m128 high = _mm_set1_ps(kInt16Max);
+  for (; i + 8 <= count; i += 8) {
+    __m128 x0 = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+    __m128 x1 = _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale);
+    if (dither) {
+      x0 = _mm_add_ps(x0, _mm_loadu_ps(dither + i));
+      x1 = _mm_add_ps(x1, _mm_loadu_ps(dither + i + 4));
+    }
+    x0 = _mm_min_ps(_mm_max_ps(x0, low), high);
+    x1 = _mm_min_ps(_mm_max_ps(x1, low), high);
+    // Rounds to nearest, ties to even, in the default rounding mode.
+    const __m128i packed =
+        _mm_packs_epi32(_mm_cvtps_epi32(x0), _mm_cvtps_epi32(x1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), packed);
+  }
+#endif
+  for (; i < count; ++i) {
+    output[i] = FloatToInt16(input[i], dither ? dither[i] : 0.0f);
+  }
+}
+
+static void ConvertBlock(const int16_t* input, size_t count, float* output) {
+  size_t i = 0;
+#if defined(PCM_FORMAT_NEON)
+  for (; i + 8 <= count; i += 8) {
+    const int16x8_t x = vld1q_s16(input + i);
+    vst1q_f32(output + i,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))),
+                          kInverseInt16Scale));
+    vst1q_f32(output + i + 4,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))),
+                          kInverseInt16Scale));
+  }
+#elif defined(PCM_FORMAT_SSE2)
+  const __m128 scale = _mm_set1_ps(kInverseInt16Scale);
+  for (; i + 8 <= count; i += 8) {
+    const __m128i x =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    // Sign extend by moving each sample to the top half of a 32-bit lane.
+    const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+    _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+  }
+#endif
+  for (; i < count; ++i) {
+    output[i] = static_cast<float>(input[i]) * kInverseInt16Scale;
+  }
+}
+
+typedef int16_t PlaneBlock[kBlockFrames];
+
+/**
+ * Interleave |frames| frames of kChannels planes. The channel count is a
+ * template argument so that the inner loop is unrolled.
+ */
+template <size_t kChannels>
+static void InterleaveBlock(const PlaneBlock* planes, size_t frames,
+                            int16_t* output) {
+  for (size_t frame = 0; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < kChannels; ++channel) {
+      output[frame * kChannels + channel] = planes[channel][frame];
+    }
+  }
+}
+
+template <size_t kChannels>
+static void DeinterleaveBlock(const int16_t* input, size_t frames,
+                              PlaneBlock* planes) {
+  for (size_t frame = 0; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < kChannels; ++channel) {
+      planes[channel][frame] = input[frame * kChannels + channel];
+    }
+  }
+}
+
+#if defined(PCM_FORMAT_NEON) || defined(PCM_FORMAT_SSE2)
+// Stereo and first order ambisonics have their own SIMD kernels; the other
+// channel counts do not map onto 8-lane registers as neatly.
+template <>
+void InterleaveBlock<2>(const PlaneBlock* planes, size_t frames,
+                        int16_t* output) {
+  size_t frame = 0;
+  for (; frame + 8 <= frames; frame += 8) {
+#if defined(PCM_FORMAT_NEON)
+    int16x8x2_t x;
+    x.val[0] = vld1q_s16(planes[0] + frame);
+    x.val[1] = vld1q_s16(planes[1] + frame);
+    vst2q_s16(output + frame * 2, x);
+#else
+    const __m128i left =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + frame));
+    const __m128i right =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + frame));
+    __m128i* out = reinterpret_cast<__m128i*>(output + frame * 2);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(left, right));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(left, right));
+#endif
+  }
+  for (; frame < frames; ++frame) {
+    output[frame * 2] = planes[0][frame];
+    output[frame * 2 + 1] = planes[1][frame];
+  }
+}
+
+template <>
+void InterleaveBlock<4>(const PlaneBlock* planes, size_t frames,
+                        int16_t* output) {
+  size_t frame = 0;
+  for (; frame + 8 <= frames; frame += 8) {
+#if defined(PCM_FORMAT_NEON)
+    int16x8x4_t x;
+    for (int channel = 0; channel < 4; ++channel) {
+      x.val[channel] = vld1q_s16(planes[channel] + frame);
+    }
+    vst4q_s16(output + frame * 4, x);
+#else
+    __m128i x[4];
+    for (int channel = 0; channel < 4; ++channel) {
+      x[channel] = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(planes[channel] + frame));
+    }
+    // Pairs of channels 0 and 1, and of 2 and 3, then whole frames.
+    const __m128i a_low = _mm_unpacklo_epi16(x[0], x[1]);
+    const __m128i a_high = _mm_unpackhi_epi16(x[0], x[1]);
+    const __m128i b_low = _mm_unpacklo_epi16(x[2], x[3]);
+    const __m128i b_high = _mm_unpackhi_epi16(x[2], x[3]);
+    __m128i* out = reinterpret_cast<__m128i*>(output + frame * 4);
+    _mm_storeu_si128(out, _mm_unpacklo_epi32(a_low, b_low));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(a_low, b_low));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi32(a_high, b_high));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi32(a_high, b_high));
+#endif
+  }
+  for (; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < 4; ++channel) {
+      output[frame * 4 + channel] = planes[channel][frame];
+    }
+  }
+}
+
+template <>
+void DeinterleaveBlock<2>(const int16_t* input, size_t frames,
+                          PlaneBlock* planes) {
+  size_t frame = 0;
+  for (; frame + 8 <= frames; frame += 8) {
+#if defined(PCM_FORMAT_NEON)
+    const int16x8x2_t x = vld2q_s16(input + frame * 2);
+    vst1q_s16(planes[0] + frame, x.val[0]);
+    vst1q_s16(planes[1] + frame, x.val[1]);
+#else
+    const __m128i* in = reinterpret_cast<const __m128i*>(input + frame * 2);
+    const __m128i x0 = _mm_loadu_si128(in);
+    const __m128i x1 = _mm_loadu_si128(in + 1);
+    // Each 32-bit lane holds a frame, left sample in the low half. Sign
+    // extending each half to 32 bits and packing separates the channels.
+    const __m128i left = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_slli_epi32(x0, 16), 16),
+        _mm_srai_epi32(_mm_slli_epi32(x1, 16), 16));
+    const __m128i right =
+        _mm_packs_epi32(_mm_srai_epi32(x0, 16), _mm_srai_epi32(x1, 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[0] + frame), left);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[1] + frame), right);
+#endif
+  }
+  for (; frame < frames; ++frame) {
+    planes[0][frame] = input[frame * 2];
+    planes[1][frame] = input[frame * 2 + 1];
+  }
+}
+#endif
+
+#if defined(PCM_FORMAT_NEON)
+template <>
+void DeinterleaveBlock<4>(const int16_t* input, size_t frames,
+                          PlaneBlock* planes) {
+  size_t frame = 0;
+  for (; frame + 8 <= frames; frame += 8) {
+    const int16x8x4_t x = vld4q_s16(input + frame * 4);
+    for (int channel = 0; channel < 4; ++channel) {
+      vst1q_s16(planes[channel] + frame, x.val[channel]);
+    }
+  }
+  for (; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < 4; ++channel) {
+      planes[channel][frame] = input[frame * 4 + channel];
+    }
+  }
+}
+#endif
+
+static void InterleaveBlock(const PlaneBlock* planes, size_t channels,
+                            size_t frames, int16_t* output) {
+  switch (channels) {
+    case 1:
+      return InterleaveBlock<1>(planes, frames, output);
+    case 2:
+      return InterleaveBlock<2>(planes, frames, output);
+    case 4:
+      return InterleaveBlock<4>(planes, frames, output);
+    case 6:
+      return InterleaveBlock<6>(planes, frames, output);
+    case 9:
+      return InterleaveBlock<9>(planes, frames, output);
+    case 16:
+      return InterleaveBlock<16>(planes, frames, output);
+  }
+  for (size_t frame = 0; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < channels; ++channel) {
+      output[frame * channels + channel] = planes[channel][frame];
+    }
+  }
+}
+
+static void DeinterleaveBlock(const int16_t* input, size_t channels,
+                              size_t frames, PlaneBlock* planes) {
+  switch (channels) {
+    case 1:
+      return DeinterleaveBlock<1>(input, frames, planes);
+    case 2:
+      return DeinterleaveBlock<2>(input, frames, planes);
+    case 4:
+      return DeinterleaveBlock<4>(input, frames, planes);
+    case 6:
+      return DeinterleaveBlock<6>(input, frames, planes);
+    case 9:
+      return DeinterleaveBlock<9>(input, frames, planes);
+    case 16:
+      return DeinterleaveBlock<16>(input, frames, planes);
+  }
+  for (size_t frame = 0; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < channels; ++channel) {
+      planes[channel][frame] = input[frame * channels + channel];
+    }
+  }
+}
+}  // anonymous namespace
+
+void InitPcmDither(uint32_t seed, PcmDither* dither) {
+  for (int lane = 0; lane < 4; ++lane) {
+    // Spread the seed over the lanes; xorshift32 must not start at zero.
+    uint32_t x = (seed + lane) * 0x9e3779b9u;
+    x ^= x >> 16;
+    dither->state[lane] = x ? x : 1;
+  }
+}
+
+size_t GetSurroundChannelCount(gvr::AudioSurroundFormat format) {
+  switch (format) {
+    case GVR_AUDIO_SURROUND_FORMAT_SURROUND_STEREO:
+      return 2;
+    case GVR_AUDIO_SURROUND_FORMAT_SURROUND_FIVE_DOT_ONE:
+      return 6;
+    case GVR_AUDIO_SURROUND_FORMAT_FIRST_ORDER_AMBISONICS:
+      return 4;
+    case GVR_AUDIO_SURROUND_FORMAT_SECOND_ORDER_AMBISONICS:
+      return 9;
+    case GVR_AUDIO_SURROUND_FORMAT_THIRD_ORDER_AMBISONICS:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+void ConvertFloatToInt16(const float* input, size_t count, PcmDither* dither,
+                         int16_t* output) {
+  float dither_block[kBlockFrames];
+  for (size_t i = 0; i < count; i += kBlockFrames) {
+    const size_t block = count - i < kBlockFrames ? count - i : kBlockFrames;
+    if (dither) FillDither(dither, block, dither_block);
+    ConvertBlock(input + i, dither ? dither_block : nullptr, block,
+                 output + i);
+  }
+}
+
+void ConvertInt16ToFloat(const int16_t* input, size_t count, float* output) {
+  ConvertBlock(input, count, output);
+}
+
+void InterleaveFloatToInt16(const float* const* planes, size_t channels,
+                            size_t frames, PcmDither* dither,
+                            int16_t* output) {
+  assert(channels >= 1 && channels <= kMaxPcmChannels);
+  PlaneBlock converted[kMaxPcmChannels];
+  float dither_block[kBlockFrames];
+  for (size_t frame = 0; frame < frames; frame += kBlockFrames) {
+    const size_t block =
+        frames - frame < kBlockFrames ? frames - frame : kBlockFrames;
+    for (size_t channel = 0; channel < channels; ++channel) {
+      if (dither) FillDither(dither, block, dither_block);
+      ConvertBlock(planes[channel] + frame, dither ? dither_block : nullptr,
+                   block, converted[channel]);
+    }
+    InterleaveBlock(converted, channels, block, output + frame * channels);
+  }
+}
+
+void DeinterleaveInt16ToFloat(const int16_t* input, size_t channels,
+                              size_t frames, float* const* planes) {
+  assert(channels >= 1 && channels <= kMaxPcmChannels);
+  PlaneBlock deinterleaved[kMaxPcmChannels];
+  for (size_t frame = 0; frame < frames; frame += kBlockFrames) {
+    const size_t block =
+        frames - frame < kBlockFrames ? frames - frame : kBlockFrames;
+    DeinterleaveBlock(input + frame * channels, channels, block,
+                      deinterleaved);
+    for (size_t channel = 0; channel < channels; ++channel) {
+      ConvertBlock(deinterleaved[channel], block, planes[channel] + frame);
+    }
+  }
+}
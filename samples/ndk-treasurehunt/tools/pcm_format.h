@@ -0,0 +1,92 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TREASUREHUNT_TOOLS_PCMFORMAT_H_  // NOLINT
+#define TREASUREHUNT_TOOLS_PCMFORMAT_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+/**
+ * Sample format conversion between the planar float buffers that decoders
+ * produce and the interleaved int16_t buffers that gvr::AudioSurroundApi
+ * consumes and produces. The app plays its sounds from files through
+ * gvr::AudioApi and has no such buffers, so the kernels live with the tools
+ * until it streams audio, and only pcm_format_bench runs them.
+ *
+ * The kernels use NEON or SSE2 where the target has them, and portable code
+ * otherwise; every path gives bit-identical results. Define
+ * PCM_FORMAT_DISABLE_SIMD to force the portable code, e.g. to benchmark it.
+ * The rounding relies on IEEE float arithmetic, so the file must not be
+ * compiled with -ffast-math.
+ */
+
+// Largest channel count of a gvr::AudioSurroundFormat (third order
+// ambisonics).
+static const size_t kMaxPcmChannels = 16;
+
+/**
+ * State of the triangular (TPDF) dither added by the float to int16_t
+ * conversions. The sequence continues across calls, so use one PcmDither
+ * per stream.
+ */
+struct PcmDither {
+  uint32_t state[4];
+};
+
+/**
+ * Seed |dither|. Any seed, including zero, is valid.
+ */
+void InitPcmDither(uint32_t seed, PcmDither* dither);
+
+/**
+ * Return the number of channels of |format|, or 0 if it is invalid.
+ */
+size_t GetSurroundChannelCount(gvr::AudioSurroundFormat format);
+
+/**
+ * Convert |count| float samples in [-1, 1) to int16_t, rounding to nearest
+ * and saturating. If |dither| is not null, +/-1 LSB of TPDF dither is added
+ * before rounding.
+ */
+void ConvertFloatToInt16(const float* input, size_t count, PcmDither* dither,
+                         int16_t* output);
+
+/**
+ * Convert |count| int16_t samples to float in [-1, 1). Converting back
+ * without dither gives the original samples.
+ */
+void ConvertInt16ToFloat(const int16_t* input, size_t count, float* output);
+
+/**
+ * Convert |frames| frames of |channels| planar float channels to interleaved
+ * int16_t, as ConvertFloatToInt16 does. |channels| must be between 1 and
+ * kMaxPcmChannels.
+ */
+void InterleaveFloatToInt16(const float* const* planes, size_t channels,
+                            size_t frames, PcmDither* dither,
+                            int16_t* output);
+
+/**
+ * Convert |frames| frames of interleaved int16_t with |channels| channels to
+ * planar float, as ConvertInt16ToFloat does. |channels| must be between 1
+ * and kMaxPcmChannels.
+ */
+void DeinterleaveInt16ToFloat(const int16_t* input, size_t channels,
+                              size_t frames, float* const* planes);
+
+#endif  // TREASUREHUNT_TOOLS_PCMFORMAT_H_  // NOLINT
@@ -0,0 +1,197 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side benchmark of the sample format kernels in pcm_format.h.
+//
+// For each channel count of the gvr::AudioSurroundFormat formats, the tool
+// converts planar float to interleaved int16_t and back, both with plain
+// per-sample loops, as decoders usually do, and with the kernels, and
+// reports the throughput of each in millions of samples per second. It also
+// checks that:
+//
+//  * without dither, the kernels match the plain loops exactly, including
+//    for out of range input, which saturates;
+//  * with dither, each output is within 1 LSB of the undithered one, and the
+//    mean error stays near zero;
+//  * int16_t to float and back gives the original samples.
+//
+// Build and run on the host with:
+//
+//   g++ -std=c++11 -O2 -I../../../libraries/headers
+//       -o pcm_format_bench pcm_format_bench.cc pcm_format.cc
+//   ./pcm_format_bench [frames per buffer]
+//
+// Add -DPCM_FORMAT_DISABLE_SIMD to measure the portable kernels.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>  // NOLINT
+#include <random>
+#include <vector>
+
+#include "pcm_format.h"  // NOLINT
+
+namespace {
+const size_t kChannelCounts[] = {2, 4, 6, 9, 16};
+
+// Each measurement converts at least this many samples.
+const size_t kSamplesPerMeasurement = 50000000;
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void PlainInterleave(const std::vector<std::vector<float>>& planes,
+                     size_t frames, int16_t* output) {
+  const size_t channels = planes.size();
+  for (size_t frame = 0; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < channels; ++channel) {
+      float x = planes[channel][frame] * 32768.0f;
+      x = x < -32768.0f ? -32768.0f : x;
+      x = x > 32767.0f ? 32767.0f : x;
+      output[frame * channels + channel] = static_cast<int16_t>(lrintf(x));
+    }
+  }
+}
+
+void PlainDeinterleave(const int16_t* input, size_t frames,
+                       std::vector<std::vector<float>>* planes) {
+  const size_t channels = planes->size();
+  for (size_t frame = 0; frame < frames; ++frame) {
+    for (size_t channel = 0; channel < channels; ++channel) {
+      (*planes)[channel][frame] =
+          input[frame * channels + channel] * (1.0f / 32768.0f);
+    }
+  }
+}
+
+// Runs |convert| until kSamplesPerMeasurement samples are converted, and
+// returns millions of samples per second.
+template <typename Function>
+double Measure(size_t samples_per_call, Function convert) {
+  const size_t calls = kSamplesPerMeasurement / samples_per_call + 1;
+  convert();
+  const double start = NowSeconds();
+  for (size_t call = 0; call < calls; ++call) convert();
+  const double seconds = NowSeconds() - start;
+  return calls * samples_per_call / seconds * 1e-6;
+}
+
+std::vector<float*> Pointers(std::vector<std::vector<float>>* planes) {
+  std::vector<float*> pointers;
+  for (std::vector<float>& plane : *planes) pointers.push_back(plane.data());
+  return pointers;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  // 1024 frames is a typical buffer of a 48 kHz audio callback. An odd size
+  // also exercises the scalar tails of the kernels.
+  const size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1024;
+  if (frames == 0) {
+    fprintf(stderr, "Usage: %s [frames per buffer]\n", argv[0]);
+    return 1;
+  }
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> amplitude(-1.1f, 1.1f);
+  bool ok = true;
+
+  printf("Msamples/s at %zu frames  float -> int16      int16 -> float\n",
+         frames);
+  printf("channels                  plain  kernel      plain  kernel\n");
+  for (size_t channels : kChannelCounts) {
+    const size_t samples = channels * frames;
+    // Slightly out of range, to exercise the saturation.
+    std::vector<std::vector<float>> planes(channels,
+                                           std::vector<float>(frames));
+    for (std::vector<float>& plane : planes) {
+      for (float& x : plane) x = amplitude(random);
+    }
+    std::vector<const float*> inputs;
+    for (const std::vector<float>& plane : planes) inputs.push_back(&plane[0]);
+
+    std::vector<int16_t> expected(samples);
+    std::vector<int16_t> interleaved(samples);
+    PlainInterleave(planes, frames, expected.data());
+    InterleaveFloatToInt16(inputs.data(), channels, frames, nullptr,
+                           interleaved.data());
+    if (interleaved != expected) {
+      printf("FAIL: %zu channel interleave differs from the plain loop\n",
+             channels);
+      ok = false;
+    }
+
+    PcmDither dither;
+    InitPcmDither(channels, &dither);
+    std::vector<int16_t> dithered(samples);
+    InterleaveFloatToInt16(inputs.data(), channels, frames, &dither,
+                           dithered.data());
+    double total_error = 0.0;
+    for (size_t i = 0; i < samples; ++i) {
+      const int error = dithered[i] - expected[i];
+      if (error < -1 || error > 1) {
+        printf("FAIL: %zu channel dither error of %d LSB\n", channels, error);
+        ok = false;
+        break;
+      }
+      total_error += error;
+    }
+    if (fabs(total_error / samples) > 0.05) {
+      printf("FAIL: %zu channel dither has a mean error of %f LSB\n",
+             channels, total_error / samples);
+      ok = false;
+    }
+
+    std::vector<std::vector<float>> outputs(channels,
+                                            std::vector<float>(frames));
+    std::vector<float*> output_pointers = Pointers(&outputs);
+    DeinterleaveInt16ToFloat(expected.data(), channels, frames,
+                             output_pointers.data());
+    std::vector<std::vector<float>> expected_outputs = outputs;
+    PlainDeinterleave(expected.data(), frames, &expected_outputs);
+    std::vector<int16_t> round_trip(samples);
+    std::vector<const float*> round_trip_inputs(output_pointers.begin(),
+                                                output_pointers.end());
+    InterleaveFloatToInt16(round_trip_inputs.data(), channels, frames,
+                           nullptr, round_trip.data());
+    if (outputs != expected_outputs || round_trip != expected) {
+      printf("FAIL: %zu channel deinterleave or round trip differs\n",
+             channels);
+      ok = false;
+    }
+
+    const double plain_to_int16 = Measure(
+        samples, [&]() { PlainInterleave(planes, frames, expected.data()); });
+    const double kernel_to_int16 = Measure(samples, [&]() {
+      InterleaveFloatToInt16(inputs.data(), channels, frames, &dither,
+                             interleaved.data());
+    });
+    const double plain_to_float = Measure(samples, [&]() {
+      PlainDeinterleave(expected.data(), frames, &expected_outputs);
+    });
+    const double kernel_to_float = Measure(samples, [&]() {
+      DeinterleaveInt16ToFloat(expected.data(), channels, frames,
+                               output_pointers.data());
+    });
+    printf("%8zu               %8.0f %7.0f   %8.0f %7.0f\n", channels,
+           plain_to_int16, kernel_to_int16, plain_to_float, kernel_to_float);
+  }
+  printf(ok ? "All checks passed.\n" : "Some checks FAILED.\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shared by the NDK samples; keep the copy in each sample identical.
+
+#ifndef NDK_SAMPLES_TOOLS_PERFHARNESS_H_  // NOLINT
+#define NDK_SAMPLES_TOOLS_PERFHARNESS_H_  // NOLINT
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Host-side benchmark runner shared by the perf_suite tools of the samples,
+ * implemented in perf_harness.cc.
+ *
+ * Each benchmark is a function that runs the measured operation a given
+ * number of times. The runner calibrates that number so that one sample
+ * lasts a few milliseconds, then takes a fixed number of samples and reports
+ * their median and median absolute deviation, in nanoseconds per operation.
+ *
+ * The results are written as JSON:
+ *
+ *   {"suite": "treasurehunt", "benchmarks": [
+ *     {"name": "math/MatrixMul", "unit": "ns", "median": 12.5,
+ *      "mad": 0.1, "iterations": 262144, "runs": [12.5],
+ *      "samples": [12.4, ...]}, ...]}
+ *
+ * where "runs" holds the median of each run that the samples come from. A
+ * baseline may pool several runs, recorded with --append:
+ *
+ *   rm -f baseline.json
+ *   for run in $(seq 10); do ./perf_suite --json baseline.json --append; done
+ *
+ * A benchmark regresses when its median is
+ *
+ *  * more than the threshold above the median of the baseline, so that
+ *    changes too small to matter are ignored;
+ *  * above the median of every run of the baseline. A run shares some drift
+ *    across all of its samples, from where the heap and the stack land and
+ *    from the load of the machine, so the runs, rather than the samples,
+ *    are what is independent. With 10 runs, this alone has a false alarm
+ *    rate of 1/11;
+ *  * slower by a one-sided Mann-Whitney U test on the samples, with
+ *    p < 0.01, so that a run as noisy as to straddle the baseline is not a
+ *    regression either.
+ *
+ * Improvements are reported the same way, and do not fail the run. Timings
+ * only compare on the same machine and compiler, so the checked-in baselines
+ * are only meaningful on the host they were recorded on, and are recorded
+ * again whenever that changes.
+ */
+class PerfSuite {
+ public:
+  /**
+   * Body of a benchmark: runs the measured operation |iterations| times.
+   */
+  typedef std::function<void(int iterations)> Body;
+
+  explicit PerfSuite(const std::string& name);
+
+  /**
+   * Parses the command line of a perf_suite tool:
+   *
+   *   --baseline FILE   compare against the results in FILE
+   *   --json FILE       write the results to FILE
+   *   --append          keep the runs already in FILE
+   *   --filter TEXT     only run benchmarks whose name contains TEXT
+   *   --threshold PCT   smallest regression reported, 20 by default
+   *
+   * Relative paths are relative to the current directory at this call.
+   * Prints the usage and returns false if the command line is invalid.
+   */
+  bool ParseArgs(int argc, char** argv);
+
+  /**
+   * Measures |body| as benchmark |name|, unless it is filtered out.
+   */
+  void Run(const std::string& name, const Body& body);
+
+  /**
+   * Writes the JSON results and compares them with the baseline, if any.
+   * Returns the exit status of the tool: 1 if a benchmark regressed or a
+   * file could not be read or written, 0 otherwise.
+   */
+  int Finish();
+
+ private:
+  struct Result {
+    std::string name;
+    double median;
+    double mad;
+    int iterations;
+    std::vector<double> runs;
+    std::vector<double> samples;
+  };
+
+  // Sets the median and the median absolute deviation of |result|.
+  static void Summarize(Result* result);
+
+  // Adds the runs of the benchmarks already in |path| to the results.
+  bool AppendTo(const std::string& path);
+
+  bool WriteJson(const std::string& path) const;
+
+  std::string name_;
+  std::string baseline_path_;
+  std::string json_path_;
+  std::string filter_;
+  bool append_;
+  double threshold_;
+  std::vector<Result> results_;
+};
+
+/**
+ * Keeps the compiler from optimizing away the computation of |value|.
+ */
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * A benchmark of a baseline: the median of each run, and all the samples.
+ */
+struct PerfBaseline {
+  std::string name;
+  std::vector<double> runs;
+  std::vector<double> samples;
+};
+
+/**
+ * Reads the benchmarks of a JSON file written by PerfSuite. Only that format
+ * is understood. Returns false if |path| cannot be read.
+ */
+bool ReadPerfBaseline(const std::string& path,
+                      std::vector<PerfBaseline>* benchmarks);
+
+/**
+ * Returns the one-sided p-value of the Mann-Whitney U test that the values
+ * in |slower| tend to be larger than those in |faster|, with the normal
+ * approximation and the correction for ties.
+ */
+double MannWhitneyPValue(const std::vector<double>& faster,
+                         const std::vector<double>& slower);
+
+#endif  // NDK_SAMPLES_TOOLS_PERFHARNESS_H_  // NOLINT
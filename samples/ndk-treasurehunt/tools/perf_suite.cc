@@ -0,0 +1,291 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side performance suite of TreasureHunt, run against the GL stub in
+// gl_stub.h and the host audio renderer in gvr_audio_host.h, with the
+// runner in perf_harness.h.
+//
+// The microbenchmarks time the matrix helpers of
+// src/main/jni/treasure_hunt_renderer.cc and the two picking functions,
+// IsLookingAtObject() and IsPointingAtObject(). The macro benchmarks replay
+// kReplayFrames frames of the whole app, in a Cardboard and in a Daydream
+// viewer, with the head turning back and forth, and the cube found every
+// kTriggerPeriod frames, by a trigger or a click of the controller. They
+// time DrawFrame(), which on the host is the CPU cost of a frame: the stub
+// GL records nothing and draws nothing, and without vsync the frame
+// scheduler does not wait.
+//
+// The results are compared with perf_baselines/treasurehunt.json, 20 runs
+// recorded on the machine that last updated it. Record it again, as
+// perf_harness.h describes, after a change of machine, compiler or flags.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -I../../../libraries/headers
+//       -o perf_suite perf_suite.cc perf_harness.cc gl_stub.cc
+//       gvr_audio_host.cc $JNI/audio_occlusion.cc
+//       $JNI/choreographer_vsync.cc $JNI/clustered_lighting.cc
+//       $JNI/egl_fence.cc $JNI/frame_acquirer.cc $JNI/frame_graph.cc
+//       $JNI/frame_limiter.cc $JNI/frame_scheduler.cc
+//       $JNI/gpu_memory_tracker.cc $JNI/gvr_voice_backend.cc
+//       $JNI/hidden_area_mesh.cc $JNI/layer_compositor.cc
+//       $JNI/light_baker.cc $JNI/light_clusters.cc $JNI/pose_history.cc
+//       $JNI/render_pass.cc $JNI/trace_log.cc $JNI/voice_manager.cc
+//       -lpthread
+//   ./perf_suite --baseline perf_baselines/treasurehunt.json
+//
+// See perf_harness.h for the other options.
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gl_stub.h"       // NOLINT
+#include "perf_harness.h"  // NOLINT
+
+// The math helpers are file-local, so the renderer is built into the suite.
+#include "treasure_hunt_renderer.cc"  // NOLINT
+
+// Runs the private picking functions of a renderer.
+class TreasureHuntRendererPeer {
+ public:
+  explicit TreasureHuntRendererPeer(TreasureHuntRenderer* renderer)
+      : renderer_(renderer) {}
+
+  bool IsLookingAtObject() { return renderer_->IsLookingAtObject(); }
+  bool IsPointingAtObject() { return renderer_->IsPointingAtObject(); }
+
+ private:
+  TreasureHuntRenderer* renderer_;
+};
+
+namespace {
+// Where the app finds its sounds.
+const char* kAssetDirectory = "../src/main/assets";
+
+const int kReplayFrames = 600;
+const int kTriggerPeriod = 90;
+const float kFrameSeconds = 1.0f / 60.0f;
+
+// Inputs of the microbenchmarks, cycled through so that no result is known
+// at compile time. They are aligned to cache lines, so that the timings do
+// not change between runs with where the inputs are placed.
+const int kInputs = 64;
+struct MathInputs {
+  alignas(64) gvr::Mat4f matrices[kInputs];
+  alignas(64) gvr::Rectf fovs[kInputs];
+  alignas(64) gvr::ControllerQuat quats[kInputs];
+  alignas(64) std::array<float, 4> vectors[kInputs];
+} inputs;
+
+// Returns the head pose of frame |frame| of the replay: the head turns from
+// side to side with a period of 4 s, and nods with a period of 3 s.
+gvr::Mat4f HeadPose(int frame) {
+  const float t = (frame % kReplayFrames) * kFrameSeconds;
+  const float yaw = 0.6f * sinf(2.0f * 3.14159265f * t / 4.0f);
+  const float pitch = 0.2f * sinf(2.0f * 3.14159265f * t / 3.0f);
+  const float cy = cosf(yaw), sy = sinf(yaw);
+  const float cp = cosf(pitch), sp = sinf(pitch);
+  // Rotation about x by |pitch|, after rotation about y by |yaw|.
+  return {{{cy, 0.0f, sy, 0.0f},
+           {sp * sy, cp, -sp * cy, 0.0f},
+           {-cp * sy, sp, cp * cy, 0.0f},
+           {0.0f, 0.0f, 0.0f, 1.0f}}};
+}
+
+// Returns the controller of frame |frame|: it follows the head, and clicks
+// once every kTriggerPeriod frames.
+GlStubController Controller(int frame) {
+  const float t = (frame % kReplayFrames) * kFrameSeconds;
+  const float yaw = 0.6f * sinf(2.0f * 3.14159265f * t / 4.0f);
+  GlStubController controller = {};
+  controller.orientation = {0.0f, sinf(-0.5f * yaw), 0.0f, cosf(-0.5f * yaw)};
+  controller.buttons[GVR_CONTROLLER_BUTTON_CLICK] =
+      frame % kTriggerPeriod == 0;
+  return controller;
+}
+
+void RunMathBenchmarks(PerfSuite* suite) {
+  for (int i = 0; i < kInputs; ++i) {
+    gvr::Mat4f& matrix = inputs.matrices[i];
+    matrix = HeadPose(7 * i);
+    matrix.m[0][3] = 0.1f * i;
+    matrix.m[2][3] = -2.0f - 0.05f * i;
+    const float angle = 30.0f + 0.25f * i;
+    inputs.fovs[i] = {angle, angle + 1.0f, angle - 1.0f, angle + 2.0f};
+    const float half_yaw = 0.01f * i;
+    inputs.quats[i] = {0.0f, sinf(half_yaw), 0.0f, cosf(half_yaw)};
+    inputs.vectors[i] = {0.1f * i, 1.0f, -3.0f + 0.02f * i, 1.0f};
+  }
+  const gvr::Mat4f* matrices = inputs.matrices;
+  const gvr::Rectf* fovs = inputs.fovs;
+  const gvr::ControllerQuat* quats = inputs.quats;
+  const std::array<float, 4>* vectors = inputs.vectors;
+
+  suite->Run("math/MatrixToGLArray", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(MatrixToGLArray(matrices[i % kInputs]));
+    }
+  });
+  suite->Run("math/MatrixVectorMul", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(
+          MatrixVectorMul(matrices[i % kInputs], vectors[(i + 1) % kInputs]));
+    }
+  });
+  suite->Run("math/MatrixMul", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(
+          MatrixMul(matrices[i % kInputs], matrices[(i + 1) % kInputs]));
+    }
+  });
+  suite->Run("math/PerspectiveMatrixFromView", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(PerspectiveMatrixFromView(fovs[i % kInputs], kZNear,
+                                              kZFar));
+    }
+  });
+  suite->Run("math/CalculatePixelSpaceRect", [&](int iterations) {
+    const gvr::Sizei size = {2048, 1024};
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(CalculatePixelSpaceRect(size, fovs[i % kInputs]));
+    }
+  });
+  suite->Run("math/ControllerQuatToMatrix", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(ControllerQuatToMatrix(quats[i % kInputs]));
+    }
+  });
+  suite->Run("math/VectorNorm", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(VectorNorm(vectors[i % kInputs]));
+    }
+  });
+  suite->Run("math/VectorInnerProduct", [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      DoNotOptimize(
+          VectorInnerProduct(vectors[i % kInputs], vectors[(i + 1) % kInputs]));
+    }
+  });
+}
+
+// Creates the app as TreasureHuntActivity does, in a viewer of type |type|,
+// and renders a first frame.
+std::unique_ptr<TreasureHuntRenderer> CreateApp(int32_t type,
+                                                const std::string& cache) {
+  GlStubReset("OpenGL ES 3.0", "");
+  GlStubSetViewerType(type);
+  GlStubSetHeadPose(HeadPose(0));
+  GlStubSetController(Controller(1));
+  std::unique_ptr<gvr::AudioApi> audio(new gvr::AudioApi);
+  CHECK(audio->Init(GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY));
+  std::unique_ptr<TreasureHuntRenderer> app(
+      new TreasureHuntRenderer(GlStubContext(), std::move(audio), cache));
+  app->InitializeGl();
+  app->OnResume();
+  app->DrawFrame();
+  return app;
+}
+
+// Replays frames of |app| in a viewer of type |type|, from |*frame| on.
+void ReplayFrames(TreasureHuntRenderer* app, int32_t type, int frames,
+                  int* frame) {
+  for (int i = 0; i < frames; ++i, ++*frame) {
+    GlStubSetHeadPose(HeadPose(*frame));
+    GlStubSetController(Controller(*frame));
+    if (type == GVR_VIEWER_TYPE_CARDBOARD && *frame % kTriggerPeriod == 0) {
+      app->OnTriggerEvent();
+    }
+    app->DrawFrame();
+  }
+}
+
+void RunAppBenchmarks(PerfSuite* suite, const std::string& cache) {
+  const struct {
+    const char* name;
+    int32_t type;
+  } kViewers[] = {{"cardboard", GVR_VIEWER_TYPE_CARDBOARD},
+                  {"daydream", GVR_VIEWER_TYPE_DAYDREAM}};
+  for (const auto& viewer : kViewers) {
+    std::unique_ptr<TreasureHuntRenderer> app = CreateApp(viewer.type, cache);
+    int frame = 1;
+    // One full replay first, to settle the caches and the voices.
+    ReplayFrames(app.get(), viewer.type, kReplayFrames, &frame);
+
+    suite->Run(std::string("frame/") + viewer.name, [&](int iterations) {
+      ReplayFrames(app.get(), viewer.type, iterations, &frame);
+    });
+
+    TreasureHuntRendererPeer peer(app.get());
+    if (viewer.type == GVR_VIEWER_TYPE_CARDBOARD) {
+      suite->Run("picking/IsLookingAtObject", [&](int iterations) {
+        for (int i = 0; i < iterations; ++i) {
+          DoNotOptimize(peer.IsLookingAtObject());
+        }
+      });
+    } else {
+      suite->Run("picking/IsPointingAtObject", [&](int iterations) {
+        for (int i = 0; i < iterations; ++i) {
+          DoNotOptimize(peer.IsPointingAtObject());
+        }
+      });
+    }
+    app->OnPause();
+  }
+}
+
+// Removes |directory| and the files in it.
+void RemoveDirectory(const std::string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (!dir) return;
+  while (const dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      unlink((directory + "/" + entry->d_name).c_str());
+    }
+  }
+  closedir(dir);
+  rmdir(directory.c_str());
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  PerfSuite suite("treasurehunt");
+  if (!suite.ParseArgs(argc, argv)) return 2;
+
+  // The stub only records calls for the tests.
+  GlStubSetRecording(false);
+  if (chdir(kAssetDirectory) != 0) {
+    fprintf(stderr, "perf_suite: run from the tools directory\n");
+    return 2;
+  }
+  // The lightmap is baked into an empty cache, as on a first launch.
+  char cache[] = "/tmp/perf_suite.XXXXXX";
+  if (!mkdtemp(cache)) {
+    perror("perf_suite: mkdtemp");
+    return 2;
+  }
+
+  RunMathBenchmarks(&suite);
+  RunAppBenchmarks(&suite, cache);
+  RemoveDirectory(cache);
+  return suite.Finish();
+}
@@ -0,0 +1,289 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side replay of a recorded head motion through the pose history in
+// src/main/jni/pose_history.h, measuring how far its poses are from the
+// true head rotation.
+//
+// The motion combines a slow yaw and pitch sway with quick 90 degree turns,
+// which peak at 900 degrees per second. It is sampled once per frame, as the
+// render thread does, with a jittered frame time and an occasional dropped
+// frame. After each sample the tool queries the history at random past
+// times, and checks that:
+//
+//  * queries between two samples are interpolated, and stay within two
+//    degrees of the true rotation at 60 Hz even during the quick turns;
+//  * queries at a sample time return that sample;
+//  * queries after the newest sample, or before the oldest one, return that
+//    sample unchanged rather than a prediction;
+//  * samples out of time order are ignored, and nothing is answered before
+//    the first sample.
+//
+// It also reports the error of extrapolating the history past the newest
+// sample, at the angular velocity over the last 8 ms, which is why poses
+// for future times, such as the display time of a frame, come from the
+// tracker instead.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -I../../../libraries/headers
+//       -o pose_history_replay pose_history_replay.cc $JNI/pose_history.cc
+//   ./pose_history_replay
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "pose_history.h"  // NOLINT
+
+namespace {
+const uint64_t kMillis = 1000000;
+const double kPi = 3.14159265358979323846;
+const double kDegrees = kPi / 180.0;
+const double kDurationSeconds = 10.0;
+const int kQueriesPerSample = 8;
+// Velocity window of the extrapolation that the report compares against.
+const uint64_t kVelocityWindowNanos = 8 * kMillis;
+
+struct Quat {
+  double x, y, z, w;
+};
+
+Quat Multiply(const Quat& a, const Quat& b) {
+  return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+          a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+// Slerp from |a| (t = 0) to |b| (t = 1); larger |t| extrapolates.
+Quat Slerp(const Quat& a, Quat b, double t) {
+  double cos_angle = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+  if (cos_angle < 0.0) {
+    b = {-b.x, -b.y, -b.z, -b.w};
+    cos_angle = -cos_angle;
+  }
+  double weight_a = 1.0 - t, weight_b = t;
+  if (cos_angle < 0.9999999) {
+    const double angle = std::acos(cos_angle);
+    weight_a = std::sin((1.0 - t) * angle) / std::sin(angle);
+    weight_b = std::sin(t * angle) / std::sin(angle);
+  }
+  Quat q = {weight_a * a.x + weight_b * b.x, weight_a * a.y + weight_b * b.y,
+            weight_a * a.z + weight_b * b.z, weight_a * a.w + weight_b * b.w};
+  const double norm = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  return {q.x / norm, q.y / norm, q.z / norm, q.w / norm};
+}
+
+gvr::Mat4f ToMatrix(const Quat& q) {
+  const double x = q.x, y = q.y, z = q.z, w = q.w;
+  gvr::Mat4f m = {{{static_cast<float>(1.0 - 2.0 * (y * y + z * z)),
+                    static_cast<float>(2.0 * (x * y - z * w)),
+                    static_cast<float>(2.0 * (x * z + y * w)), 0.0f},
+                   {static_cast<float>(2.0 * (x * y + z * w)),
+                    static_cast<float>(1.0 - 2.0 * (x * x + z * z)),
+                    static_cast<float>(2.0 * (y * z - x * w)), 0.0f},
+                   {static_cast<float>(2.0 * (x * z - y * w)),
+                    static_cast<float>(2.0 * (y * z + x * w)),
+                    static_cast<float>(1.0 - 2.0 * (x * x + y * y)), 0.0f},
+                   {0.0f, 0.0f, 0.0f, 1.0f}}};
+  return m;
+}
+
+// Angle in degrees of the rotation between two rotation matrices, from the
+// distance between them, which unlike the trace stays accurate for small
+// angles: |A - B|^2 = 8 sin^2(angle / 2).
+double AngleBetween(const gvr::Mat4f& a, const gvr::Mat4f& b) {
+  double distance_squared = 0.0;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      const double difference = a.m[i][j] - b.m[i][j];
+      distance_squared += difference * difference;
+    }
+  }
+  const double half_sine = std::sqrt(distance_squared / 8.0);
+  return 2.0 * std::asin(std::min(1.0, half_sine)) / kDegrees;
+}
+
+// The true head rotation at |time_nanos|.
+Quat TruePose(uint64_t time_nanos) {
+  const double t = time_nanos * 1e-9;
+  // A quick turn in the middle of every two seconds, alternately to 90
+  // degrees and back, with a smoothstep profile lasting 150 ms.
+  const double phase = std::fmod(t, 2.0);
+  const double s = std::max(0.0, std::min(1.0, (phase - 1.0) / 0.15));
+  const double step = s * s * (3.0 - 2.0 * s);
+  const bool turning_back = static_cast<int>(t / 2.0) % 2 == 1;
+  const double turn = 90.0 * (turning_back ? 1.0 - step : step);
+  const double yaw = (30.0 * std::sin(2.0 * kPi * 0.4 * t) + turn) * kDegrees;
+  const double pitch = 20.0 * std::sin(2.0 * kPi * 0.7 * t + 1.0) * kDegrees;
+  const Quat yaw_rotation = {0.0, std::sin(yaw / 2), 0.0, std::cos(yaw / 2)};
+  const Quat pitch_rotation = {std::sin(pitch / 2), 0.0, 0.0,
+                               std::cos(pitch / 2)};
+  return Multiply(yaw_rotation, pitch_rotation);
+}
+
+// A small deterministic generator, so that every run replays the same
+// motion.
+uint32_t Random(uint32_t* state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+  if (values.empty()) return 0.0;
+  std::sort(values.begin(), values.end());
+  return values[static_cast<size_t>(fraction * (values.size() - 1))];
+}
+
+double Mean(const std::vector<double>& values) {
+  double sum = 0.0;
+  for (double value : values) sum += value;
+  return values.empty() ? 0.0 : sum / values.size();
+}
+
+double Max(const std::vector<double>& values) {
+  return values.empty() ? 0.0 : *std::max_element(values.begin(),
+                                                  values.end());
+}
+
+bool ok = true;
+
+void Check(bool condition, const std::string& what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what.c_str());
+    ok = false;
+  }
+}
+
+struct Sample {
+  uint64_t time_nanos;
+  Quat rotation;
+};
+
+void Replay(int frames_per_second, double max_interpolation_degrees) {
+  const std::string name = std::to_string(frames_per_second) + " Hz";
+  const uint64_t frame_nanos = 1000000000ull / frames_per_second;
+  const uint64_t ahead_nanos[] = {frame_nanos, 2 * frame_nanos, 50 * kMillis};
+  PoseHistory history;
+  uint32_t random = 1;
+  gvr::Mat4f head_view;
+  Check(!history.GetHeadPose(0, &head_view),
+        name + ": nothing is answered before the first sample");
+
+  std::vector<Sample> samples;
+  std::vector<double> interpolation_errors;
+  std::vector<double> extrapolation_errors[3];
+  double max_sample_error = 0.0, max_clamp_error = 0.0;
+  uint64_t interpolated_queries = 0, clamped_queries = 0;
+  const uint64_t end_nanos =
+      static_cast<uint64_t>(kDurationSeconds * 1000000000.0);
+  for (uint64_t frame = 1; frame * frame_nanos < end_nanos; ++frame) {
+    // Every 30th frame is dropped, and the others start up to 2 ms late.
+    if (frame % 30 == 0) continue;
+    const uint64_t time_nanos =
+        frame * frame_nanos + Random(&random) % (2 * kMillis);
+    const Sample sample = {time_nanos, TruePose(time_nanos)};
+    history.AddSample(time_nanos, ToMatrix(sample.rotation));
+    samples.push_back(sample);
+
+    // The history keeps the newest samples only; query within them.
+    const size_t kept = std::min<size_t>(samples.size(), 64);
+    const uint64_t oldest_nanos = samples[samples.size() - kept].time_nanos;
+    for (int i = 0; i < kQueriesPerSample && kept > 1; ++i) {
+      const uint64_t query_nanos =
+          oldest_nanos + 1 + Random(&random) % (time_nanos - oldest_nanos - 1);
+      history.GetHeadPose(query_nanos, &head_view);
+      interpolation_errors.push_back(
+          AngleBetween(head_view, ToMatrix(TruePose(query_nanos))));
+      ++interpolated_queries;
+    }
+    history.GetHeadPose(time_nanos, &head_view);
+    max_sample_error = std::max(
+        max_sample_error, AngleBetween(head_view, ToMatrix(sample.rotation)));
+    ++interpolated_queries;
+    // A query after the newest sample returns it, however old it is.
+    history.GetHeadPose(time_nanos + frame_nanos, &head_view);
+    max_clamp_error = std::max(
+        max_clamp_error, AngleBetween(head_view, ToMatrix(sample.rotation)));
+    history.GetHeadPose(oldest_nanos - 1, &head_view);
+    max_clamp_error = std::max(
+        max_clamp_error,
+        AngleBetween(head_view,
+                     ToMatrix(samples[samples.size() - kept].rotation)));
+    clamped_queries += 2;
+    const PoseHistoryStats stats = history.GetStats();
+    Check(stats.queries_interpolated == interpolated_queries &&
+              stats.queries_clamped == clamped_queries,
+          name + ": every query is counted as interpolated or clamped");
+
+    // What extrapolating the history would have given.
+    size_t base = samples.size() - 1;
+    while (base > 0 && time_nanos - samples[base].time_nanos <
+                           kVelocityWindowNanos) {
+      --base;
+    }
+    if (base == samples.size() - 1) continue;
+    const double span_nanos =
+        static_cast<double>(time_nanos - samples[base].time_nanos);
+    for (int i = 0; i < 3; ++i) {
+      const Quat predicted = Slerp(samples[base].rotation, sample.rotation,
+                                   1.0 + ahead_nanos[i] / span_nanos);
+      extrapolation_errors[i].push_back(
+          AngleBetween(ToMatrix(predicted),
+                       ToMatrix(TruePose(time_nanos + ahead_nanos[i]))));
+    }
+  }
+
+  history.AddSample(samples.back().time_nanos - frame_nanos,
+                    ToMatrix(samples.front().rotation));
+  Check(history.GetStats().samples == samples.size(),
+        name + ": samples out of time order are ignored");
+  Check(max_sample_error < 0.01,
+        name + ": a query at a sample time returns that sample");
+  Check(max_clamp_error < 0.01,
+        name + ": queries outside the samples return the nearest one");
+  Check(Max(interpolation_errors) < max_interpolation_degrees,
+        name + ": interpolation stays close to the true rotation");
+  Check(Percentile(interpolation_errors, 0.99) <
+            Percentile(extrapolation_errors[0], 0.99),
+        name + ": interpolation is more accurate than extrapolation");
+
+  printf("%s, %zu samples, error in degrees:\n", name.c_str(),
+         samples.size());
+  printf("  interpolated    mean %6.3f  p99 %6.3f  max %6.3f\n",
+         Mean(interpolation_errors), Percentile(interpolation_errors, 0.99),
+         Max(interpolation_errors));
+  for (int i = 0; i < 3; ++i) {
+    const std::vector<double>& errors = extrapolation_errors[i];
+    printf("  +%2llu ms ahead     mean %6.3f  p99 %6.3f  max %6.3f\n",
+           static_cast<unsigned long long>(ahead_nanos[i] / kMillis),
+           Mean(errors), Percentile(errors, 0.99), Max(errors));
+  }
+}
+}  // namespace
+
+int main() {
+  Replay(60, 2.0);
+  Replay(90, 1.2);
+
+  if (ok) printf("PASS: past poses are interpolated, not predicted\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side checks of the load and store actions of the render passes in
+// src/main/jni/render_pass.h, run against the recording GL stub in
+// gl_stub.h.
+//
+// For each way the context can invalidate attachments (OpenGL ES 3,
+// EXT_discard_framebuffer, or not at all), the tool begins and ends passes
+// with every load and store action and checks that:
+//
+//  * cleared attachments are cleared, after the scissor test is disabled
+//    and the write masks are enabled, over the whole framebuffer;
+//  * don't-care attachments are invalidated before the pass where that is
+//    supported, and cleared otherwise;
+//  * loaded attachments are neither cleared nor invalidated;
+//  * discarded attachments are invalidated after the pass where that is
+//    supported, and stored ones never are;
+//  * the framebuffer is bound for the pass and unbound after it, for GVR
+//    frames and application framebuffers alike.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -I../../../libraries/headers
+//       -o render_pass_test render_pass_test.cc gl_stub.cc
+//       $JNI/render_pass.cc
+//   ./render_pass_test
+
+#include <GLES2/gl2.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gl_stub.h"      // NOLINT
+#include "render_pass.h"  // NOLINT
+
+namespace {
+const gvr::Sizei kSize = {1024, 512};
+const GLuint kFramebuffer = 7;
+
+enum Invalidation {
+  kInvalidationNone,
+  kInvalidationDiscardExt,
+  kInvalidationEs3,
+};
+
+const char* kInvalidationNames[] = {"none", "EXT_discard_framebuffer",
+                                    "OpenGL ES 3"};
+
+bool ok = true;
+
+void Check(bool condition, const std::string& what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what.c_str());
+    ok = false;
+  }
+}
+
+void PrintCalls() {
+  for (const std::string& call : GlStubCalls()) {
+    printf("    %s\n", call.c_str());
+  }
+}
+
+void InitializeContext(Invalidation invalidation) {
+  switch (invalidation) {
+    case kInvalidationNone:
+      GlStubReset("OpenGL ES 2.0", "GL_OES_depth24");
+      break;
+    case kInvalidationDiscardExt:
+      GlStubReset("OpenGL ES 2.0", "GL_OES_depth24 GL_EXT_discard_framebuffer");
+      break;
+    case kInvalidationEs3:
+      GlStubReset("OpenGL ES 3.2 V@258.0", "");
+      break;
+  }
+  RenderPass::InitializeGl();
+  GlStubClearCalls();
+}
+
+// The text of an invalidation of |attachments|, or "" if there are none.
+std::string Invalidate(Invalidation invalidation,
+                       const std::vector<GLenum>& attachments) {
+  if (attachments.empty() || invalidation == kInvalidationNone) return "";
+  std::string text = invalidation == kInvalidationEs3
+                         ? "glInvalidateFramebuffer("
+                         : "glDiscardFramebufferEXT(";
+  char number[32];
+  snprintf(number, sizeof(number), "%#x, %d, {", GL_FRAMEBUFFER,
+           static_cast<int>(attachments.size()));
+  text += number;
+  for (size_t i = 0; i < attachments.size(); ++i) {
+    snprintf(number, sizeof(number), "%s%#x", i > 0 ? ", " : "",
+             attachments[i]);
+    text += number;
+  }
+  return text + "})";
+}
+
+// Returns the index of the first invalidation at or after |from|, or -1.
+int FindInvalidation(int from) {
+  const int invalidate = GlStubFind("glInvalidateFramebuffer", from);
+  const int discard = GlStubFind("glDiscardFramebufferEXT", from);
+  if (invalidate < 0) return discard;
+  if (discard < 0) return invalidate;
+  return std::min(invalidate, discard);
+}
+
+// Runs an empty pass with |desc| into an application framebuffer, with the
+// scissor test left enabled by earlier rendering, and checks the calls.
+void CheckPass(Invalidation invalidation, const RenderPassDesc& desc) {
+  char name[128];
+  snprintf(name, sizeof(name), "%s, color %d/%d, depth %d/%d",
+           kInvalidationNames[invalidation], desc.color_load, desc.color_store,
+           desc.depth_load, desc.depth_store);
+  const bool invalidates = invalidation != kInvalidationNone;
+
+  GlStubClearCalls();
+  glEnable(GL_SCISSOR_TEST);
+  RenderPass pass(desc);
+  pass.Begin(kFramebuffer, kSize);
+  const int end = static_cast<int>(GlStubCalls().size());
+  pass.End();
+
+  GLbitfield clear_mask = 0;
+  std::vector<GLenum> invalidated_before;
+  if (desc.color_load == kLoadActionClear ||
+      (desc.color_load == kLoadActionDontCare && !invalidates)) {
+    clear_mask |= GL_COLOR_BUFFER_BIT;
+  } else if (desc.color_load == kLoadActionDontCare) {
+    invalidated_before.push_back(GL_COLOR_ATTACHMENT0);
+  }
+  if (desc.depth_load == kLoadActionClear ||
+      (desc.depth_load == kLoadActionDontCare && !invalidates)) {
+    clear_mask |= GL_DEPTH_BUFFER_BIT;
+  } else if (desc.depth_load == kLoadActionDontCare) {
+    invalidated_before.push_back(GL_DEPTH_ATTACHMENT);
+  }
+  std::vector<GLenum> invalidated_after;
+  if (desc.color_store == kStoreActionDiscard) {
+    invalidated_after.push_back(GL_COLOR_ATTACHMENT0);
+  }
+  if (desc.depth_store == kStoreActionDiscard) {
+    invalidated_after.push_back(GL_DEPTH_ATTACHMENT);
+  }
+
+  const bool was_ok = ok;
+  char text[64];
+  snprintf(text, sizeof(text), "glBindFramebuffer(%#x, %u)", GL_FRAMEBUFFER,
+           kFramebuffer);
+  const int bind = GlStubFind(text);
+  Check(bind == 1, std::string(name) + ": binds the framebuffer first");
+
+  const std::string before = Invalidate(invalidation, invalidated_before);
+  int invalidate = -1;
+  if (before.empty()) {
+    const int first = FindInvalidation(0);
+    Check(first < 0 || first >= end,
+          std::string(name) + ": invalidates nothing before the pass");
+  } else {
+    invalidate = GlStubFind(before);
+    Check(invalidate > bind && invalidate < end,
+          std::string(name) + ": " + before + " after binding");
+  }
+
+  snprintf(text, sizeof(text), "glClear(%#x)", clear_mask);
+  const int clear = GlStubFind("glClear(");
+  if (clear_mask == 0) {
+    Check(clear < 0, std::string(name) + ": does not clear");
+  } else {
+    Check(clear >= 0 && clear < end && GlStubCalls()[clear] == text,
+          std::string(name) + ": " + text);
+    snprintf(text, sizeof(text), "glDisable(%#x)", GL_SCISSOR_TEST);
+    const int scissor = GlStubFind(text);
+    Check(scissor >= 0 && scissor < clear,
+          std::string(name) + ": disables the scissor test before clearing");
+    snprintf(text, sizeof(text), "glViewport(0, 0, %d, %d)", kSize.width,
+             kSize.height);
+    const int viewport = GlStubFind(text);
+    Check(viewport >= 0 && viewport < clear,
+          std::string(name) + ": clears the whole framebuffer");
+    const int color_mask = GlStubFind("glColorMask(1, 1, 1, 1)");
+    const int depth_mask = GlStubFind("glDepthMask(1)");
+    Check(color_mask >= 0 && color_mask < clear && depth_mask >= 0 &&
+              depth_mask < clear,
+          std::string(name) + ": enables the write masks before clearing");
+    Check(invalidate < clear,
+          std::string(name) + ": invalidates before clearing");
+  }
+
+  const std::string after = Invalidate(invalidation, invalidated_after);
+  if (after.empty()) {
+    Check(FindInvalidation(end) < 0,
+          std::string(name) + ": invalidates nothing after the pass");
+  } else {
+    const int discard = GlStubFind(after, end);
+    Check(discard >= end, std::string(name) + ": " + after + " after the pass");
+  }
+  snprintf(text, sizeof(text), "glBindFramebuffer(%#x, 0)", GL_FRAMEBUFFER);
+  Check(GlStubCalls().back() == text,
+        std::string(name) + ": unbinds the framebuffer last");
+  if (!ok && was_ok) PrintCalls();
+}
+}  // namespace
+
+int main() {
+  const LoadAction kLoadActions[] = {kLoadActionLoad, kLoadActionClear,
+                                     kLoadActionDontCare};
+  const StoreAction kStoreActions[] = {kStoreActionStore,
+                                       kStoreActionDiscard};
+  for (int invalidation = kInvalidationNone; invalidation <= kInvalidationEs3;
+       ++invalidation) {
+    InitializeContext(static_cast<Invalidation>(invalidation));
+    Check(RenderPass::SupportsInvalidation() ==
+              (invalidation != kInvalidationNone),
+          std::string(kInvalidationNames[invalidation]) +
+              ": detects invalidation support");
+    int passes = 0;
+    for (LoadAction color_load : kLoadActions) {
+      for (StoreAction color_store : kStoreActions) {
+        for (LoadAction depth_load : kLoadActions) {
+          for (StoreAction depth_store : kStoreActions) {
+            RenderPassDesc desc = {color_load, color_store, depth_load,
+                                   depth_store, {0.1f, 0.2f, 0.3f, 0.5f},
+                                   1.0f};
+            CheckPass(static_cast<Invalidation>(invalidation), desc);
+            ++passes;
+          }
+        }
+      }
+    }
+    printf("%-24s %d passes checked\n", kInvalidationNames[invalidation],
+           passes);
+  }
+
+  // GVR frames are bound and unbound through the frame.
+  InitializeContext(kInvalidationEs3);
+  gvr::Frame frame(reinterpret_cast<gvr_frame*>(&ok));
+  RenderPass pass({kLoadActionClear, kStoreActionStore, kLoadActionClear,
+                   kStoreActionDiscard, {0.0f, 0.0f, 0.0f, 0.0f}, 1.0f});
+  pass.Begin(&frame, 1, kSize);
+  Check(pass.IsActive(), "frame pass is active");
+  pass.End();
+  Check(!pass.IsActive(), "frame pass is inactive after End()");
+  Check(GlStubCalls().front() == "gvr_frame_bind_buffer(1)" &&
+            GlStubCalls().back() == "gvr_frame_unbind()" &&
+            GlStubCount("glBindFramebuffer") == 0,
+        "frame pass binds and unbinds the frame buffer");
+  if (!ok) PrintCalls();
+
+  if (ok) printf("PASS: load and store actions\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,361 @@
+/* Copyright 2017 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host-side checks of the voice manager in src/main/jni/voice_manager.h,
+// run against a stub audio backend that records the sources it creates and
+// their volume, position and state.
+//
+// With a listener at the origin and voices placed around it, stepped by a
+// simulated clock at 60 ticks per second, the tool checks that:
+//
+//  * voices are ranked by gain, so the most audible ones are rendered
+//    binaurally, the next ones as stereo sources, and the rest virtualized,
+//    and the backend never has more settled sources than the budgets;
+//  * a louder new voice evicts the least audible voice of each full tier,
+//    crossfading from the old source to the new one, which then stops;
+//  * voices already rendered binaurally are only evicted by one clearly
+//    louder, and new voices are boosted for their first second;
+//  * inaudible voices, whether far away or turned down, are virtualized
+//    whatever the budget;
+//  * one-shot voices are dropped when they finish or are virtualized, and
+//    removed voices and the manager itself stop all their sources.
+//
+// Build and run on the host with:
+//
+//   JNI=../src/main/jni
+//   g++ -std=c++11 -O2 -I$JNI -o voice_manager_test voice_manager_test.cc
+//       $JNI/voice_manager.cc
+//   ./voice_manager_test
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+
+#include "voice_manager.h"  // NOLINT
+
+namespace {
+const uint64_t kMillis = 1000000;
+const uint64_t kTickNanos = 16666667;
+
+// Records every source, so the checks can look at what the audio engine
+// would be rendering.
+class StubVoiceBackend : public VoiceBackend {
+ public:
+  struct Source {
+    std::string filename;
+    bool spatial;
+    bool playing;
+    bool looping;
+    bool stopped;
+    float volume;
+    float position[3];
+  };
+
+  StubVoiceBackend() : next_source_(1) {}
+
+  SourceId CreateSpatialSource(const std::string& filename) override {
+    return Create(filename, true);
+  }
+  SourceId CreateStereoSource(const std::string& filename) override {
+    return Create(filename, false);
+  }
+  void Play(SourceId source, bool looping) override {
+    sources_[source].playing = true;
+    sources_[source].looping = looping;
+  }
+  void Stop(SourceId source) override {
+    sources_[source].playing = false;
+    sources_[source].stopped = true;
+  }
+  bool IsPlaying(SourceId source) override {
+    return sources_[source].playing;
+  }
+  void SetVolume(SourceId source, float volume) override {
+    sources_[source].volume = volume;
+  }
+  void SetPosition(SourceId source, float x, float y, float z) override {
+    float* position = sources_[source].position;
+    position[0] = x;
+    position[1] = y;
+    position[2] = z;
+  }
+
+  // A one-shot sound playing |filename| reaches its end.
+  void Finish(const std::string& filename) {
+    for (auto& entry : sources_) {
+      if (entry.second.filename == filename) entry.second.playing = false;
+    }
+  }
+
+  // Number of sources not yet stopped, binaural or stereo.
+  int GetLiveCount(bool spatial) const {
+    int count = 0;
+    for (const auto& entry : sources_) {
+      if (!entry.second.stopped && entry.second.spatial == spatial) ++count;
+    }
+    return count;
+  }
+
+  // The sources playing |filename| that are not stopped yet, newest last.
+  std::vector<const Source*> GetLive(const std::string& filename) const {
+    std::vector<const Source*> live;
+    for (const auto& entry : sources_) {
+      if (!entry.second.stopped && entry.second.filename == filename) {
+        live.push_back(&entry.second);
+      }
+    }
+    return live;
+  }
+
+ private:
+  SourceId Create(const std::string& filename, bool spatial) {
+    const SourceId id = next_source_++;
+    sources_[id] = {filename, spatial, false, false, false, -1.0f,
+                    {0.0f, 0.0f, 0.0f}};
+    return id;
+  }
+
+  SourceId next_source_;
+  std::map<SourceId, Source> sources_;
+};
+
+bool ok = true;
+
+void Check(bool condition, const std::string& what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what.c_str());
+    ok = false;
+  }
+}
+
+VoiceParams Looping(const std::string& filename) {
+  VoiceParams params;
+  params.filename = filename;
+  params.volume = 1.0f;
+  params.looping = true;
+  params.min_distance = 1.0f;
+  return params;
+}
+
+// Tick the manager for |duration_nanos| with a listener at the origin.
+void Run(VoiceManager* manager, uint64_t* now_nanos, uint64_t duration_nanos) {
+  const uint64_t end_nanos = *now_nanos + duration_nanos;
+  while (*now_nanos < end_nanos) {
+    *now_nanos += kTickNanos;
+    manager->Update(0.0f, 0.0f, 0.0f, *now_nanos);
+  }
+}
+
+// Settle long enough for the recency boost and every fade to end.
+const uint64_t kSettleNanos = 1500 * kMillis;
+
+void CheckRanking() {
+  StubVoiceBackend backend;
+  uint64_t now_nanos = 0;
+  const float kDistances[] = {1.5f, 2.0f, 3.0f, 4.0f, 6.0f, 8.0f};
+  VoiceManager::VoiceId voices[6];
+  {
+    VoiceManager manager(&backend, 2, 2);
+    // Added quietest first, so the ranking cannot follow the order.
+    for (int i = 5; i >= 0; --i) {
+      voices[i] = manager.AddVoice(Looping("v" + std::to_string(i)),
+                                   kDistances[i], 0.0f, 0.0f, now_nanos);
+    }
+    Run(&manager, &now_nanos, kSettleNanos);
+    const VoiceTier kExpected[] = {VoiceTier::kSpatial, VoiceTier::kSpatial,
+                                   VoiceTier::kStereo,  VoiceTier::kStereo,
+                                   VoiceTier::kVirtual, VoiceTier::kVirtual};
+    for (int i = 0; i < 6; ++i) {
+      Check(manager.GetVoiceTier(voices[i]) == kExpected[i],
+            "ranking: voice v" + std::to_string(i) +
+                " is in the tier of its distance");
+    }
+    const VoiceStats stats = manager.GetStats();
+    Check(stats.spatial_voices == 2 && stats.stereo_voices == 2 &&
+              stats.virtual_voices == 2,
+          "ranking: the stats count the voices of each tier");
+    Check(backend.GetLiveCount(true) == 2 && backend.GetLiveCount(false) == 2,
+          "ranking: the backend has as many sources as the budgets");
+    const std::vector<const StubVoiceBackend::Source*> nearest =
+        backend.GetLive("v0");
+    Check(nearest.size() == 1 && nearest[0]->spatial &&
+              nearest[0]->position[0] == kDistances[0] &&
+              nearest[0]->volume == 1.0f && nearest[0]->looping,
+          "ranking: a binaural source is placed and left to attenuate");
+    const std::vector<const StubVoiceBackend::Source*> stereo =
+        backend.GetLive("v2");
+    Check(stereo.size() == 1 && !stereo[0]->spatial &&
+              stereo[0]->volume == 1.0f / kDistances[2],
+          "ranking: a stereo source is attenuated by distance");
+
+    // A louder voice evicts the least audible voice of each full tier.
+    const VoiceManager::VoiceId loud =
+        manager.AddVoice(Looping("loud"), 0.0f, 1.0f, 0.0f, now_nanos);
+    Run(&manager, &now_nanos, kTickNanos);
+    Check(manager.GetVoiceTier(loud) == VoiceTier::kSpatial &&
+              manager.GetVoiceTier(voices[1]) == VoiceTier::kStereo &&
+              manager.GetVoiceTier(voices[3]) == VoiceTier::kVirtual,
+          "eviction: a louder voice pushes the others down a tier");
+    std::vector<const StubVoiceBackend::Source*> evicted =
+        backend.GetLive("v1");
+    Check(evicted.size() == 2, "eviction: the old and new sources overlap");
+    if (evicted.size() == 2) {
+      Check(evicted[0]->spatial && !evicted[1]->spatial &&
+                evicted[0]->volume > 0.0f &&
+                evicted[1]->volume < evicted[0]->volume,
+            "eviction: the old source fades out as the new one fades in");
+      const float fading_volume = evicted[0]->volume;
+      const float rising_volume = evicted[1]->volume;
+      Run(&manager, &now_nanos, 50 * kMillis);
+      evicted = backend.GetLive("v1");
+      Check(evicted.size() == 2 && evicted[0]->volume < fading_volume &&
+                evicted[1]->volume > rising_volume,
+            "eviction: the fade carries on over the next ticks");
+    }
+    Run(&manager, &now_nanos, 100 * kMillis);
+    evicted = backend.GetLive("v1");
+    Check(evicted.size() == 1 && evicted[0]->volume == 1.0f / kDistances[1],
+          "eviction: the old source stops when the fade ends");
+    Check(backend.GetLive("v3").empty(),
+          "eviction: a virtualized voice has no source left");
+    Check(backend.GetLiveCount(true) == 2 && backend.GetLiveCount(false) == 2,
+          "eviction: the backend is back within the budgets");
+    // Four voices started rendering, then three changed tier.
+    Check(manager.GetStats().transitions == 4 + 3,
+          "eviction: only the voices that changed tier transitioned");
+
+    manager.RemoveVoice(loud);
+    Check(backend.GetLive("loud").empty(),
+          "removal: a removed voice stops its source");
+    Run(&manager, &now_nanos, kSettleNanos);
+    Check(manager.GetVoiceTier(voices[1]) == VoiceTier::kSpatial &&
+              manager.GetVoiceTier(voices[3]) == VoiceTier::kStereo,
+          "removal: the other voices move back up");
+  }
+  Check(backend.GetLiveCount(true) == 0 && backend.GetLiveCount(false) == 0,
+        "destruction: the manager stops every source");
+}
+
+void CheckHysteresisAndRecency() {
+  StubVoiceBackend backend;
+  uint64_t now_nanos = 0;
+  VoiceManager manager(&backend, 1, 1);
+  const VoiceManager::VoiceId a =
+      manager.AddVoice(Looping("a"), 2.0f, 0.0f, 0.0f, now_nanos);
+  const VoiceManager::VoiceId b =
+      manager.AddVoice(Looping("b"), 3.0f, 0.0f, 0.0f, now_nanos);
+  Run(&manager, &now_nanos, kSettleNanos);
+  const uint64_t transitions = manager.GetStats().transitions;
+
+  // Slightly louder than the binaural voice is not enough to swap.
+  manager.SetVoicePosition(b, 1.8f, 0.0f, 0.0f);
+  Run(&manager, &now_nanos, kSettleNanos);
+  Check(manager.GetVoiceTier(a) == VoiceTier::kSpatial &&
+            manager.GetStats().transitions == transitions,
+        "hysteresis: similar voices do not swap");
+  manager.SetVoicePosition(b, 1.5f, 0.0f, 0.0f);
+  Run(&manager, &now_nanos, kTickNanos);
+  Check(manager.GetVoiceTier(b) == VoiceTier::kSpatial &&
+            manager.GetVoiceTier(a) == VoiceTier::kStereo &&
+            manager.GetStats().transitions == transitions + 2,
+        "hysteresis: a clearly louder voice swaps once");
+
+  // A new voice, quieter than both, starts binaural and then drops back.
+  manager.SetVoicePosition(a, 4.0f, 0.0f, 0.0f);
+  manager.SetVoicePosition(b, 4.0f, 0.0f, 0.0f);
+  Run(&manager, &now_nanos, kSettleNanos);
+  const VoiceManager::VoiceId c =
+      manager.AddVoice(Looping("c"), 5.0f, 0.0f, 0.0f, now_nanos);
+  Run(&manager, &now_nanos, kTickNanos);
+  Check(manager.GetVoiceTier(c) == VoiceTier::kSpatial,
+        "recency: a new voice is boosted");
+  Run(&manager, &now_nanos, kSettleNanos);
+  Check(manager.GetVoiceTier(c) == VoiceTier::kVirtual,
+        "recency: the boost wears off after a second");
+}
+
+void CheckInaudibleAndOneShot() {
+  StubVoiceBackend backend;
+  uint64_t now_nanos = 0;
+  VoiceManager manager(&backend, 4, 4);
+  VoiceParams silent = Looping("silent");
+  silent.volume = 0.0f;
+  const VoiceManager::VoiceId quiet =
+      manager.AddVoice(silent, 0.5f, 0.0f, 0.0f, now_nanos);
+  const VoiceManager::VoiceId fading =
+      manager.AddVoice(Looping("fading"), 0.5f, 0.0f, 0.0f, now_nanos);
+  Run(&manager, &now_nanos, kSettleNanos);
+  Check(manager.GetVoiceTier(quiet) == VoiceTier::kVirtual &&
+            backend.GetLive("silent").empty(),
+        "inaudible: a silent voice is virtualized with budget to spare");
+  manager.SetVoicePosition(fading, 5000.0f, 0.0f, 0.0f);
+  Run(&manager, &now_nanos, kSettleNanos);
+  Check(manager.GetVoiceTier(fading) == VoiceTier::kVirtual &&
+            backend.GetLive("fading").empty(),
+        "inaudible: a voice moved out of earshot is virtualized");
+  manager.SetVoicePosition(fading, 0.5f, 0.0f, 0.0f);
+  Run(&manager, &now_nanos, kTickNanos);
+  Check(manager.GetVoiceTier(fading) == VoiceTier::kSpatial,
+        "inaudible: a looping voice comes back within earshot");
+  manager.SetVoiceVolume(fading, 0.0005f);
+  Run(&manager, &now_nanos, kSettleNanos);
+  Check(manager.GetVoiceTier(fading) == VoiceTier::kVirtual &&
+            backend.GetLive("fading").empty(),
+        "inaudible: a voice turned down is virtualized");
+  manager.SetVoiceVolume(fading, 1.0f);
+  Run(&manager, &now_nanos, kTickNanos);
+  Check(manager.GetVoiceTier(fading) == VoiceTier::kSpatial,
+        "inaudible: a looping voice comes back when turned up");
+
+  VoiceParams shot = Looping("shot");
+  shot.looping = false;
+  const VoiceManager::VoiceId one_shot =
+      manager.AddVoice(shot, 1.0f, 0.0f, 0.0f, now_nanos);
+  Run(&manager, &now_nanos, kSettleNanos);
+  Check(manager.GetVoiceTier(one_shot) == VoiceTier::kSpatial &&
+            backend.GetLive("shot").size() == 1 &&
+            !backend.GetLive("shot")[0]->looping,
+        "one-shot: a one-shot voice plays once");
+  backend.Finish("shot");
+  Run(&manager, &now_nanos, kTickNanos);
+  Check(backend.GetLive("shot").empty() &&
+            manager.GetStats().spatial_voices == 1,
+        "one-shot: a finished voice is dropped and its source stopped");
+
+  const VoiceManager::VoiceId virtualized =
+      manager.AddVoice(shot, 1.0f, 0.0f, 0.0f, now_nanos);
+  Check(virtualized == one_shot, "one-shot: the slot of a dropped voice "
+                                 "is reused");
+  Run(&manager, &now_nanos, kTickNanos);
+  manager.SetVoicePosition(virtualized, 5000.0f, 0.0f, 0.0f);
+  Run(&manager, &now_nanos, kSettleNanos);
+  manager.SetVoicePosition(virtualized, 1.0f, 0.0f, 0.0f);
+  Run(&manager, &now_nanos, kSettleNanos);
+  Check(backend.GetLive("shot").empty() &&
+            manager.GetStats().spatial_voices == 1,
+        "one-shot: a virtualized one-shot voice does not come back");
+}
+}  // namespace
+
+int main() {
+  CheckRanking();
+  CheckHysteresisAndRecency();
+  CheckInaudibleAndOneShot();
+
+  if (ok) printf("PASS: voices are ranked and evicted by audibility\n");
+  return ok ? 0 : 1;
+}